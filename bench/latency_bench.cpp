@@ -0,0 +1,158 @@
+/**
+ * @file latency_bench.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief 延迟基准测试：用若干条长连接向服务器发送请求，统计请求延迟的分布
+ * 
+ * 用法：latency_bench [-h host] [-p port] [-c connections] [-n requests]
+ *                     [-w warmup] [-i interval_us] [path]
+ * 
+ * 每条连接在一个独立线程中以“发送请求 -> 读完响应”的方式依次发送请求，
+ * `-i` 指定两次请求之间的间隔（模拟非饱和负载，此时忙轮询的效果最明显）。
+*/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 7777;
+    int conns = 4;
+    int requests = 10000;      // 每条连接的请求数
+    int warmup = 100;          // 每条连接预热的请求数（不计入统计）
+    int interval_us = 0;       // 请求之间的间隔
+    std::string path = "/index.html";
+};
+
+static int connect_to(const Options &opt) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+/**
+ * @brief 读取一个完整的响应（根据 Content-Length 确定响应体的长度）
+ * @return 是否读取成功
+*/
+static bool read_response(int fd, std::string &buf) {
+    buf.clear();
+    size_t header_end = std::string::npos;
+    size_t total = 0;
+    char tmp[65536];
+    while (true) {
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) return false;
+        buf.append(tmp, n);
+        if (header_end == std::string::npos) {
+            header_end = buf.find("\r\n\r\n");
+            if (header_end == std::string::npos) continue;
+            size_t body_len = 0;
+            std::string headers = buf.substr(0, header_end);
+            std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+            auto pos = headers.find("content-length:");
+            if (pos != std::string::npos) {
+                body_len = std::strtoul(headers.c_str() + pos + 15, nullptr, 10);
+            }
+            total = header_end + 4 + body_len;
+        }
+        if (buf.size() >= total) return true;
+    }
+}
+
+static void run_conn(const Options &opt, std::vector<double> &lat, std::atomic<int> &errors) {
+    int fd = connect_to(opt);
+    if (fd < 0) {
+        ++errors;
+        return;
+    }
+    std::string req = "GET " + opt.path + " HTTP/1.1\r\nHost: " + opt.host +
+        "\r\nConnection: keep-alive\r\n\r\n";
+    std::string resp;
+    lat.reserve(opt.requests);
+    for (int i=0; i<opt.warmup+opt.requests; ++i) {
+        auto start = Clock::now();
+        if (send(fd, req.data(), req.size(), 0) != static_cast<ssize_t>(req.size()) ||
+            !read_response(fd, resp)) {
+            ++errors;
+            break;
+        }
+        auto end = Clock::now();
+        if (i >= opt.warmup) {
+            lat.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        }
+        if (opt.interval_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(opt.interval_us));
+        }
+    }
+    close(fd);
+}
+
+static double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t idx = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+int main(int argc, char *argv[]) {
+    Options opt;
+    int ch;
+    while ((ch = getopt(argc, argv, "h:p:c:n:w:i:")) != -1) {
+        switch (ch) {
+            case 'h': opt.host = optarg; break;
+            case 'p': opt.port = std::atoi(optarg); break;
+            case 'c': opt.conns = std::atoi(optarg); break;
+            case 'n': opt.requests = std::atoi(optarg); break;
+            case 'w': opt.warmup = std::atoi(optarg); break;
+            case 'i': opt.interval_us = std::atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-h host] [-p port] [-c connections] "
+                    "[-n requests] [-w warmup] [-i interval_us] [path]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc) opt.path = argv[optind];
+
+    std::vector<std::vector<double>> lats(opt.conns);
+    std::vector<std::thread> threads;
+    std::atomic<int> errors(0);
+    auto start = Clock::now();
+    for (int i=0; i<opt.conns; ++i) {
+        threads.emplace_back(run_conn, std::cref(opt), std::ref(lats[i]), std::ref(errors));
+    }
+    for (auto &t : threads) t.join();
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> all;
+    for (const auto &l : lats) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    printf("requests: %zu, errors: %d, throughput: %.0f req/s\n",
+        all.size(), errors.load(), all.size() / secs);
+    printf("latency(us): p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+        percentile(all, 50), percentile(all, 90), percentile(all, 99),
+        percentile(all, 99.9), all.empty() ? 0.0 : all.back());
+    return errors.load() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file affinity.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for CPU affinity and NUMA topology
+*/
+#include <sched.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <algorithm>
+#include <fstream>
+#include <cstdlib>
+#include "affinity.h"
+
+
+bool parse_cpu_list(const std::string &spec, CpuList &cpus) {
+    cpus.clear();
+    const char *p = spec.c_str();
+    while (*p) {
+        while (*p == ' ' || *p == ',') ++p;
+        if (!*p) break;
+        char *end = nullptr;
+        long first = std::strtol(p, &end, 10);
+        if (end == p || first < 0) return false;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            ++p;
+            last = std::strtol(p, &end, 10);
+            if (end == p || last < first) return false;
+            p = end;
+        }
+        if (*p && *p != ',' && *p != ' ') return false;
+        if (last >= CPU_SETSIZE) return false;
+        for (long cpu=first; cpu<=last; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return !cpus.empty();
+}
+
+std::string cpu_list_to_string(const CpuList &cpus) {
+    std::string str;
+    for (size_t i=0; i<cpus.size(); ) {
+        size_t j = i;
+        while (j+1 < cpus.size() && cpus[j+1] == cpus[j] + 1) ++j;
+        if (!str.empty()) str.push_back(',');
+        str += std::to_string(cpus[i]);
+        if (j > i) {
+            str.push_back('-');
+            str += std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return str;
+}
+
+bool bind_thread_to_cpus(pthread_t tid, const CpuList &cpus) {
+    if (cpus.empty()) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(tid, sizeof(set), &set) == 0;
+}
+
+bool place_current_thread(const CpuList &cpus) {
+    if (!bind_thread_to_cpus(pthread_self(), cpus)) {
+        return false;
+    }
+    // 线程被固定在一个节点上之后，让它首次触碰（分配）的内存页优先落在本节点，
+    // 这样由该线程创建和填充的缓冲区、连接对象都是本地内存
+    int node = NumaTopology::get_instance().node_of_cpus(cpus);
+    if (node >= 0 && NumaTopology::get_instance().node_count() > 1) {
+        unsigned long mask[16] = {0};
+        const unsigned long bits = sizeof(unsigned long) * 8;
+        if (static_cast<unsigned long>(node) < sizeof(mask) * 8) {
+            mask[node / bits] |= 1UL << (node % bits);
+            syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8);
+        }
+    }
+    return true;
+}
+
+const NumaTopology &NumaTopology::get_instance() {
+    static NumaTopology topo;
+    return topo;
+}
+
+NumaTopology::NumaTopology() {
+    const char *node_dir = "/sys/devices/system/node";
+    DIR *dir = opendir(node_dir);
+    if (dir) {
+        struct dirent *ent;
+        while ((ent = readdir(dir)) != nullptr) {
+            std::string name(ent->d_name);
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+                name.find_first_not_of("0123456789", 4) != std::string::npos) {
+                continue;
+            }
+            int node = std::atoi(name.c_str() + 4);
+            std::ifstream fs(std::string(node_dir) + "/" + name + "/cpulist");
+            std::string spec;
+            CpuList cpus;
+            if (!std::getline(fs, spec) || !parse_cpu_list(spec, cpus)) {
+                continue;
+            }
+            if (static_cast<size_t>(node) >= m_nodes.size()) {
+                m_nodes.resize(node + 1);
+            }
+            m_nodes[node] = cpus;
+        }
+        closedir(dir);
+    }
+    if (m_nodes.empty()) {
+        // 没有 NUMA 信息时，视所有在线 CPU 属于节点 0
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        m_nodes.emplace_back();
+        for (long cpu=0; cpu<ncpu; ++cpu) {
+            m_nodes[0].push_back(static_cast<int>(cpu));
+        }
+    }
+    for (size_t node=0; node<m_nodes.size(); ++node) {
+        for (int cpu : m_nodes[node]) {
+            if (static_cast<size_t>(cpu) >= m_cpu_node.size()) {
+                m_cpu_node.resize(cpu + 1, -1);
+            }
+            m_cpu_node[cpu] = static_cast<int>(node);
+        }
+    }
+}
+
+int NumaTopology::node_count() const {
+    int cnt = 0;
+    for (const auto &cpus : m_nodes) {
+        if (!cpus.empty()) ++cnt;
+    }
+    return cnt;
+}
+
+const CpuList &NumaTopology::node_cpus(int node) const {
+    static const CpuList empty;
+    if (node < 0 || static_cast<size_t>(node) >= m_nodes.size()) {
+        return empty;
+    }
+    return m_nodes[node];
+}
+
+int NumaTopology::node_of_cpu(int cpu) const {
+    if (cpu < 0 || static_cast<size_t>(cpu) >= m_cpu_node.size()) {
+        return -1;
+    }
+    return m_cpu_node[cpu];
+}
+
+int NumaTopology::node_of_cpus(const CpuList &cpus) const {
+    int node = -1;
+    for (int cpu : cpus) {
+        int n = node_of_cpu(cpu);
+        if (n < 0 || (node >= 0 && n != node)) {
+            return -1;
+        }
+        node = n;
+    }
+    return node;
+}
+
+std::string NumaTopology::to_string() const {
+    std::string str;
+    for (size_t node=0; node<m_nodes.size(); ++node) {
+        if (m_nodes[node].empty()) continue;
+        if (!str.empty()) str += "; ";
+        str += "node" + std::to_string(node) + ": " + cpu_list_to_string(m_nodes[node]);
+    }
+    return str;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file affinity.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for CPU affinity and NUMA topology
+*/
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+using CpuList = std::vector<int>;
+
+/**
+ * @brief 解析 CPU 列表，格式与 `/sys/devices/system/node/nodeN/cpulist` 相同
+ * @param spec CPU 列表字符串，例如 `0-3,8,10-11`
+ * @param cpus 解析结果（升序、去重）
+ * @return 是否解析成功，空字符串视为解析失败
+*/
+bool parse_cpu_list(const std::string &spec, CpuList &cpus);
+
+/**
+ * @brief 将 CPU 列表格式化为紧凑的字符串，例如 `0-3,8`
+ * @param cpus CPU 列表
+ * @return 格式化后的字符串
+*/
+std::string cpu_list_to_string(const CpuList &cpus);
+
+/**
+ * @brief 将指定线程绑定到一组 CPU 上
+ * @param tid 线程 id
+ * @param cpus CPU 列表
+ * @return 是否绑定成功
+*/
+bool bind_thread_to_cpus(pthread_t tid, const CpuList &cpus);
+
+/**
+ * @brief 将当前线程绑定到一组 CPU 上，并让其之后分配的内存优先落在这组 CPU 所在的
+ *        NUMA 节点上（仅当这组 CPU 属于同一个节点时）
+ * @param cpus CPU 列表
+ * @return 是否绑定成功
+*/
+bool place_current_thread(const CpuList &cpus);
+
+/**
+ * @brief 机器的 NUMA 拓扑，从 `/sys/devices/system/node` 中读取
+*/
+class NumaTopology {
+public:
+    static const NumaTopology &get_instance();
+
+    /**
+     * @brief NUMA 节点的数量（不支持 NUMA 的机器视为只有一个节点）
+    */
+    int node_count() const;
+
+    /**
+     * @brief 获取节点上的 CPU 列表
+     * @param node 节点编号
+    */
+    const CpuList &node_cpus(int node) const;
+
+    /**
+     * @brief 获取 CPU 所在的节点
+     * @param cpu CPU 编号
+     * @return 节点编号，未知的 CPU 返回 -1
+    */
+    int node_of_cpu(int cpu) const;
+
+    /**
+     * @brief 获取一组 CPU 所在的节点
+     * @param cpus CPU 列表
+     * @return 节点编号，CPU 跨越多个节点或未知时返回 -1
+    */
+    int node_of_cpus(const CpuList &cpus) const;
+
+    /**
+     * @brief 拓扑的文字描述，例如 `node0: 0-7; node1: 8-15`
+    */
+    std::string to_string() const;
+
+private:
+    NumaTopology();
+
+    std::vector<CpuList> m_nodes;  // 节点编号 -> CPU 列表
+    std::vector<int> m_cpu_node;   // CPU 编号 -> 节点编号
+};
+
+#endif // AFFINITY_H
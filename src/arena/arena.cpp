@@ -0,0 +1,88 @@
+/**
+ * @file arena.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for arena (bump allocator)
+*/
+#include <cassert>
+#include "arena.h"
+
+
+Arena::Arena(size_type block_size)
+: m_block_size(block_size), m_cur_block(0), m_cur_pos(0), m_used(0), m_reserved(0) {
+    assert(m_block_size > 0);
+}
+
+void * Arena::allocate(size_type sz, size_type align) {
+    assert(align > 0 && (align & (align - 1)) == 0);
+    if (sz == 0) sz = 1;
+    if (m_cur_block < m_blocks.size()) {
+        auto &blk = m_blocks[m_cur_block];
+        auto base = reinterpret_cast<uintptr_t>(blk.data.get());
+        size_type pos = ((base + m_cur_pos + align - 1) & ~(align - 1)) - base;
+        if (pos + sz <= blk.size) {
+            m_cur_pos = pos + sz;
+            m_used += sz;
+            return blk.data.get() + pos;
+        }
+    }
+    // 当前块的剩余空间不够，切换到新的块（块的起始地址满足 max_align_t 对齐，
+    // 更严格的对齐要求需要预留余量）
+    size_type extra = align > alignof(std::max_align_t) ? align : 0;
+    next_block(sz + extra);
+    auto &blk = m_blocks[m_cur_block];
+    auto base = reinterpret_cast<uintptr_t>(blk.data.get());
+    size_type pos = ((base + align - 1) & ~(align - 1)) - base;
+    assert(pos + sz <= blk.size);
+    m_cur_pos = pos + sz;
+    m_used += sz;
+    return blk.data.get() + pos;
+}
+
+void Arena::reset() {
+    m_cur_block = 0;
+    m_cur_pos = 0;
+    m_used = 0;
+}
+
+void Arena::release() {
+    m_blocks.clear();
+    m_reserved = 0;
+    reset();
+}
+
+Arena::size_type Arena::used_bytes() const {
+    return m_used;
+}
+
+Arena::size_type Arena::reserved_bytes() const {
+    return m_reserved;
+}
+
+void Arena::next_block(size_type sz) {
+    // 优先复用 reset() 之前已经申请的块
+    size_type idx = m_blocks.empty() ? 0 : m_cur_block + 1;
+    for (; idx < m_blocks.size(); ++idx) {
+        if (m_blocks[idx].size >= sz) {
+            if (idx != m_cur_block + 1 && m_cur_block + 1 < m_blocks.size()) {
+                // 将合适的块换到当前块之后，被跳过的块留待之后使用
+                std::swap(m_blocks[idx], m_blocks[m_cur_block + 1]);
+                idx = m_cur_block + 1;
+            }
+            m_cur_block = idx;
+            m_cur_pos = 0;
+            return;
+        }
+    }
+    // 没有可复用的块，向系统申请新块；超大的分配单独占用一个块
+    size_type blk_size = sz > m_block_size ? sz : m_block_size;
+    m_blocks.push_back(Block{std::unique_ptr<char[]>(new char[blk_size]), blk_size});
+    m_reserved += blk_size;
+    idx = m_blocks.size() - 1;
+    if (idx != m_cur_block + 1 && m_blocks.size() > 1) {
+        std::swap(m_blocks[idx], m_blocks[m_cur_block + 1]);
+        idx = m_cur_block + 1;
+    }
+    m_cur_block = idx;
+    m_cur_pos = 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file arena.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for arena (bump allocator)
+*/
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <scoped_allocator>
+
+/**
+ * @brief 线性（bump）内存分配区
+ *
+ * 内存以块(block)为单位向系统申请，分配时只需移动块内的游标；单次释放是空操作，
+ * 调用 `reset()` 时一次性回卷所有块。已申请的块在 `reset()` 后仍然保留并被复用，
+ * 因此在经过“预热”后，同样规模的分配不会再调用 `malloc`。
+ * @code
+ * +---------+---------+-----+---------+
+ * | block 0 | block 1 | ... | block n |
+ * +---------+---------+-----+---------+
+ *      ^ 已分配 ... cur_block:cur_pos ... 空闲
+ * @endcode
+ * @note 非线程安全，一个 Arena 只应由同一时刻处理该连接的那个线程使用
+*/
+class Arena {
+public:
+    using size_type = std::size_t;
+
+    /**
+     * @brief 初始化分配区
+     * @param block_size 每个内存块的默认大小（单位为字节）
+    */
+    explicit Arena(size_type block_size = 4096);
+
+    ~Arena() = default;
+
+    Arena(const Arena &) = delete;
+    Arena& operator=(const Arena &) = delete;
+
+    /**
+     * @brief 分配一段内存
+     * @param sz 内存大小（单位为字节）
+     * @param align 对齐要求，必须是 2 的幂
+     * @return 内存地址
+    */
+    void * allocate(size_type sz, size_type align = alignof(std::max_align_t));
+
+    /**
+     * @brief 回卷分配区，之前分配的内存全部失效，但内存块被保留以供复用
+    */
+    void reset();
+
+    /**
+     * @brief 将所有内存块归还给系统
+    */
+    void release();
+
+    /**
+     * @brief 自上一次 `reset()` 以来分配出去的字节数
+     * @return 字节数目
+    */
+    size_type used_bytes() const;
+
+    /**
+     * @brief 分配区当前持有的内存总量
+     * @return 字节数目
+    */
+    size_type reserved_bytes() const;
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_type size;
+    };
+
+    /**
+     * @brief 切换到下一个能容纳 `sz` 字节的内存块，必要时向系统申请新块
+     * @param sz 需要的空间大小（单位为字节），已包含对齐所需的余量
+    */
+    void next_block(size_type sz);
+
+    size_type m_block_size;      // 默认的块大小
+    std::vector<Block> m_blocks; // 持有的所有内存块
+    size_type m_cur_block;       // 当前正在使用的块的索引号
+    size_type m_cur_pos;         // 当前块中空闲空间的起始位置
+    size_type m_used;            // 已分配出去的字节数
+    size_type m_reserved;        // 持有的内存总量
+};
+
+/**
+ * @brief 基于 Arena 的有状态分配器，可用于标准库容器
+ *
+ * 与 `std::pmr::polymorphic_allocator` 一样，容器赋值和交换时不传播分配器，
+ * 因此容器中的元素始终分配在容器自己的 Arena 上。
+ * 不绑定 Arena 时（默认构造）退化为全局的 `operator new/delete`，
+ * 便于构造不需要分配内存的临时对象（例如查找用的短字符串键）。
+*/
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator() noexcept : m_arena(nullptr) {}
+    ArenaAllocator(Arena *arena) noexcept : m_arena(arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+    : m_arena(other.arena()) {}
+
+    T * allocate(std::size_t n) {
+        if (m_arena) {
+            return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T)));
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, std::size_t) noexcept {
+        // Arena 中的内存在 reset() 时统一回收
+        if (!m_arena) {
+            ::operator delete(p);
+        }
+    }
+
+    Arena * arena() const noexcept { return m_arena; }
+
+private:
+    Arena *m_arena;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+    return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+    return !(lhs == rhs);
+}
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+/**
+ * @brief ArenaString 的哈希函数 (FNV-1a)
+*/
+struct ArenaStringHash {
+    std::size_t operator()(const ArenaString &str) const noexcept {
+        uint64_t h = 14695981039346656037ULL;
+        for (unsigned char ch : str) {
+            h ^= ch;
+            h *= 1099511628211ULL;
+        }
+        return static_cast<std::size_t>(h);
+    }
+};
+
+/**
+ * @brief 键为 ArenaString 的哈希表
+ * @details 借助 `scoped_allocator_adaptor`，插入时键和值都以 uses-allocator 的
+ * 方式构造，即与哈希表共用同一个 Arena（与 std::pmr 容器的行为一致）
+*/
+template <typename V>
+using ArenaMap = std::unordered_map<ArenaString, V, ArenaStringHash,
+    std::equal_to<ArenaString>,
+    std::scoped_allocator_adaptor<ArenaAllocator<std::pair<const ArenaString, V>>>>;
+
+/**
+ * @brief 与一个新构造的空容器交换，旧容器持有的内存随临时对象一起释放
+ * @details `clear()` 或移动赋值都可能保留原有的容量，而那部分内存在 Arena
+ * 回卷后会被重新分配出去，所以回卷之前必须用此函数释放容器
+*/
+template <typename C>
+inline void release_container(C &c) {
+    C(c.get_allocator()).swap(c);
+}
+
+#endif // ARENA_H
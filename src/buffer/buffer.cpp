@@ -72,6 +72,10 @@ const char * Buffer::begin_write() const {
     return begin() + write_pos;
 }
 
+void Buffer::has_written(size_type len) {
+    write_pos += len;
+}
+
 void Buffer::ensure_writable(size_type sz) {
     if (writable_bytes() < sz) {
         make_space(sz);
@@ -129,6 +133,13 @@ ssize_t Buffer::write_fd(int fd, int * saved_errno) {
     return len;
 }
 
+void Buffer::shrink(size_type size) {
+    if (readable_bytes() > 0 || buff.size() <= size) return;
+    std::vector<char>(size).swap(buff);
+    read_pos = 0;
+    write_pos = 0;
+}
+
 char * Buffer::begin() {
     return &*buff.begin();
 }
@@ -141,7 +152,7 @@ void Buffer::make_space(size_type sz) {
     if (prependable_bytes() + writable_bytes() < sz) {
         // “前置的空闲空间”加上“可写入的空间”已经不够写入 `sz` 个字节
         // 需要扩容（如果大小没有超过 vector<char> 的 capcity，则不会申请内存空间）
-        buff.resize(read_pos + sz);
+        buff.resize(write_pos + sz);
     } else {
         // “前置的空闲空间”加上“可写入的空间”已经足够写入 `sz` 个字节
         // 此时无需扩容，只需要将可读数据移动到缓冲区的起始位置，覆盖“前置的空闲空间”即可
@@ -101,6 +101,12 @@ public:
      */
     const char * begin_write() const;
 
+    /**
+     * @brief 直接写入`begin_write()`之后，移动写指针
+     * @param len 写入的数据长度（单位为字节），不能超过`writable_bytes()`
+     */
+    void has_written(size_type len);
+
     /**
      * @brief 确保能写入指定长度的数据
      * @param sz 数据长度（单位为字节）
@@ -149,6 +155,12 @@ public:
     */
     ssize_t write_fd(int fd, int * saved_errno);
 
+    /**
+     * @brief 缓冲区为空且容量超过指定大小时，将容量缩减为该大小
+     * @param size 保留的容量（单位为字节）
+     */
+    void shrink(size_type size);
+
 private:
     /**
      * @brief 获取缓冲区的起始地址
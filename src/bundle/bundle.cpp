@@ -0,0 +1,233 @@
+/**
+ * @file bundle.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for the static resource bundle
+*/
+#include "bundle.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static bool in_range(const BundleSpan &span, size_t size) {
+    return span.off <= size && span.len <= size - span.off;
+}
+
+static bool token_equal(const char *begin, const char *end, const char *token) {
+    size_t len = strlen(token);
+    return static_cast<size_t>(end - begin) == len && strncasecmp(begin, token, len) == 0;
+}
+
+/**
+ * @brief Accept-Encoding 中一项的参数是否为 q=0（包括 q=0.0、q=0.000 等）
+*/
+static bool is_q_zero(const char *p, const char *end) {
+    while (p < end && (*p == ';' || *p == ' ' || *p == '\t')) ++p;
+    if (p == end || (*p != 'q' && *p != 'Q')) return false;
+    ++p;
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    if (p == end || *p != '=') return false;
+    ++p;
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    if (p == end || *p != '0') return false;
+    ++p;
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && *p == '0') ++p;
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    return p == end;
+}
+
+bool StaticBundle::File::has_variants() const {
+    for (int enc=BUNDLE_IDENTITY+1; enc<BUNDLE_ENCODING_COUNT; ++enc) {
+        if (body[enc]) return true;
+    }
+    return false;
+}
+
+StaticBundle::StaticBundle():
+base(nullptr), map_len(0), seeds(nullptr), slots(nullptr), bucket_count(0), slot_mask(0) {}
+
+StaticBundle::~StaticBundle() {
+    release();
+}
+
+void StaticBundle::release() {
+    if (base) {
+        munmap(base, map_len);
+    }
+    base = nullptr;
+    map_len = 0;
+    seeds = slots = nullptr;
+    bucket_count = slot_mask = 0;
+    files.clear();
+}
+
+bool StaticBundle::fail(const std::string &msg) {
+    err_msg = msg;
+    release();
+    return false;
+}
+
+bool StaticBundle::open(const std::string &filename) {
+    release();
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return fail(filename + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(BundleHeader)) {
+        ::close(fd);
+        return fail(filename + ": not a resource bundle");
+    }
+    // 映射之后文件描述符就不再需要了；打包文件被替换（而不是原地改写）时映射不受影响
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return fail(filename + ": " + strerror(errno));
+    }
+    base = static_cast<char*>(addr);
+    map_len = st.st_size;
+
+    const BundleHeader *hdr = reinterpret_cast<const BundleHeader*>(base);
+    if (memcmp(hdr->magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0) {
+        return fail(filename + ": not a resource bundle");
+    }
+    if (hdr->version != BUNDLE_VERSION) {
+        return fail(filename + ": unsupported bundle version " + std::to_string(hdr->version));
+    }
+    if (hdr->total_size != map_len) {
+        return fail(filename + ": truncated bundle");
+    }
+    const BundleSpan seeds_span = {hdr->seeds_off, uint64_t(hdr->bucket_count) * sizeof(uint32_t)};
+    const BundleSpan slots_span = {hdr->slots_off, uint64_t(hdr->slot_count) * sizeof(uint32_t)};
+    const BundleSpan entries_span = {hdr->entries_off,
+        uint64_t(hdr->file_count) * sizeof(BundleEntry)};
+    if (hdr->bucket_count == 0 || hdr->slot_count == 0 ||
+        (hdr->slot_count & (hdr->slot_count - 1)) != 0 || hdr->slot_count < hdr->file_count ||
+        !in_range(seeds_span, map_len) || seeds_span.off % alignof(uint32_t) != 0 ||
+        !in_range(slots_span, map_len) || slots_span.off % alignof(uint32_t) != 0 ||
+        !in_range(entries_span, map_len) || entries_span.off % alignof(BundleEntry) != 0) {
+        return fail(filename + ": corrupted bundle header");
+    }
+    seeds = reinterpret_cast<const uint32_t*>(base + hdr->seeds_off);
+    slots = reinterpret_cast<const uint32_t*>(base + hdr->slots_off);
+    bucket_count = hdr->bucket_count;
+    slot_mask = hdr->slot_count - 1;
+
+    const BundleEntry *entries = reinterpret_cast<const BundleEntry*>(base + hdr->entries_off);
+    files.resize(hdr->file_count);
+    for (size_t i=0; i<files.size(); ++i) {
+        const BundleEntry &e = entries[i];
+        File &f = files[i];
+        bool ok = in_range(e.path, map_len) && e.path.len > 0 && in_range(e.mime, map_len) &&
+            e.body[BUNDLE_IDENTITY].off != 0;
+        for (int enc=0; ok && enc<BUNDLE_ENCODING_COUNT; ++enc) {
+            ok = in_range(e.etag[enc], map_len) && in_range(e.body[enc], map_len);
+        }
+        if (!ok || base[e.path.off] != '/') {
+            return fail(filename + ": corrupted entry " + std::to_string(i));
+        }
+        f.path = base + e.path.off;
+        f.path_len = e.path.len;
+        f.mime = base + e.mime.off;
+        f.mime_len = e.mime.len;
+        f.mtime = e.mtime;
+        for (int enc=0; enc<BUNDLE_ENCODING_COUNT; ++enc) {
+            f.etag[enc] = base + e.etag[enc].off;
+            f.etag_len[enc] = e.etag[enc].len;
+            f.body[enc] = e.body[enc].off ? base + e.body[enc].off : nullptr;
+            f.body_len[enc] = e.body[enc].len;
+        }
+    }
+    for (uint32_t i=0; i<=slot_mask; ++i) {
+        if (slots[i] != BUNDLE_EMPTY_SLOT && slots[i] >= files.size()) {
+            return fail(filename + ": corrupted path index");
+        }
+    }
+    // 每个文件都必须能通过索引找到，同时确认打包时使用的哈希函数与这里一致
+    for (const auto &f : files) {
+        if (find(f.path, f.path_len) != &f) {
+            return fail(filename + ": corrupted path index");
+        }
+    }
+    // 提示内核在后台预读，不阻塞启动；之后的第一次访问通常已经在页缓存中
+    madvise(base, map_len, MADV_WILLNEED);
+    err_msg.clear();
+    return true;
+}
+
+const StaticBundle::File* StaticBundle::find(const char *path, size_t len) const {
+    if (files.empty()) {
+        return nullptr;
+    }
+    uint32_t seed = seeds[hash(path, len, 0) % bucket_count];
+    uint32_t idx = slots[hash(path, len, seed) & slot_mask];
+    if (idx >= files.size()) {
+        return nullptr;
+    }
+    const File &f = files[idx];
+    if (f.path_len != len || memcmp(f.path, path, len) != 0) {
+        return nullptr;
+    }
+    return &f;
+}
+
+BUNDLE_ENCODING StaticBundle::negotiate(const File &file, const char *accept, size_t len) {
+    // -1 表示 Accept-Encoding 没有提到，此时看通配符 *
+    int accepted[BUNDLE_ENCODING_COUNT] = {1, -1, -1};
+    int any = -1;
+    const char *p = accept, *end = accept + len;
+    while (p < end) {
+        const char *comma = std::find(p, end, ',');
+        const char *semi = std::find(p, comma, ';');
+        const char *q = semi;
+        while (p < q && (*p == ' ' || *p == '\t')) ++p;
+        while (q > p && (q[-1] == ' ' || q[-1] == '\t')) --q;
+        int ok = is_q_zero(semi, comma) ? 0 : 1;
+        if (token_equal(p, q, "br")) {
+            accepted[BUNDLE_BROTLI] = ok;
+        } else if (token_equal(p, q, "gzip") || token_equal(p, q, "x-gzip")) {
+            accepted[BUNDLE_GZIP] = ok;
+        } else if (token_equal(p, q, "*")) {
+            any = ok;
+        }
+        p = comma == end ? end : comma + 1;
+    }
+    for (int enc : {BUNDLE_BROTLI, BUNDLE_GZIP}) {
+        int ok = accepted[enc] < 0 ? any : accepted[enc];
+        if (ok > 0 && file.has(static_cast<BUNDLE_ENCODING>(enc))) {
+            return static_cast<BUNDLE_ENCODING>(enc);
+        }
+    }
+    return BUNDLE_IDENTITY;
+}
+
+const char* StaticBundle::encoding_name(BUNDLE_ENCODING enc) {
+    switch (enc) {
+        case BUNDLE_GZIP: return "gzip";
+        case BUNDLE_BROTLI: return "br";
+        default: return nullptr;
+    }
+}
+
+uint64_t StaticBundle::hash(const char *data, size_t len, uint32_t seed) {
+    // FNV-1a，种子混入初始值，最后用 MurmurHash3 的 fmix64 打散
+    uint64_t h = 14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    for (size_t i=0; i<len; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
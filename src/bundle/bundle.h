@@ -0,0 +1,151 @@
+/**
+ * @file bundle.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for the static resource bundle
+*/
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+/**
+ * 打包文件的布局（小端，所有偏移量都相对于文件开头）：
+ *
+ *   BundleHeader
+ *   uint32_t seeds[bucket_count]       一级哈希的每个桶选定的二级哈希种子
+ *   uint32_t slots[slot_count]         二级哈希的槽位到文件编号的映射，空槽位为 BUNDLE_EMPTY_SLOT
+ *   BundleEntry entries[file_count]
+ *   字符串区：路径、媒体类型和 ETag
+ *   文件内容：每个编码的内容都从页边界开始
+ *
+ * 路径索引是“哈希-位移”(hash and displace) 的完美哈希：路径先按一级哈希分到桶里，
+ * 每个桶选一个种子，使桶内所有路径的二级哈希落在互不相同的空槽位上，查找只需要两次哈希和
+ * 一次路径比较
+*/
+
+static const char BUNDLE_MAGIC[8] = {'Y', 'A', 'W', 'N', 'P', 'A', 'C', 'K'};
+static const uint32_t BUNDLE_VERSION = 1;
+static const size_t BUNDLE_ALIGN = 4096;
+static const uint32_t BUNDLE_EMPTY_SLOT = UINT32_MAX;
+
+/**
+ * @brief 文件内容的编码，identity 总是存在，压缩的版本只在更小时才保存
+*/
+enum BUNDLE_ENCODING {
+    BUNDLE_IDENTITY = 0,
+    BUNDLE_GZIP,
+    BUNDLE_BROTLI,
+    BUNDLE_ENCODING_COUNT
+};
+
+struct BundleSpan {
+    uint64_t off;    // 不存在时为 0
+    uint64_t len;
+};
+
+struct BundleHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t file_count;
+    uint32_t bucket_count;
+    uint32_t slot_count;      // 2 的幂
+    uint64_t seeds_off;
+    uint64_t slots_off;
+    uint64_t entries_off;
+    uint64_t total_size;      // 整个打包文件的大小，用于发现被截断的文件
+};
+
+struct BundleEntry {
+    BundleSpan path;                             // 以 '/' 开头的请求路径
+    BundleSpan mime;
+    int64_t mtime;                               // 源文件的修改时间，用于 Last-Modified
+    BundleSpan etag[BUNDLE_ENCODING_COUNT];      // 每个编码各自的 ETag
+    BundleSpan body[BUNDLE_ENCODING_COUNT];
+};
+
+/**
+ * @brief 以只读方式映射到内存的静态资源包，由 yawn-pack 生成
+ *
+ * 打开之后不再修改，查找不分配内存、不进行系统调用，可以被多个线程同时使用
+*/
+class StaticBundle {
+public:
+    /**
+     * @brief 打包的一个文件，所有指针都指向映射的内存
+    */
+    struct File {
+        const char *path;
+        size_t path_len;
+        const char *mime;
+        size_t mime_len;
+        time_t mtime;
+        const char *etag[BUNDLE_ENCODING_COUNT];
+        size_t etag_len[BUNDLE_ENCODING_COUNT];
+        const char *body[BUNDLE_ENCODING_COUNT];    // 没有这个编码时为空
+        size_t body_len[BUNDLE_ENCODING_COUNT];
+
+        bool has(BUNDLE_ENCODING enc) const { return body[enc] != nullptr; }
+        /**
+         * @brief 是否有压缩的版本，有时响应需要带上 Vary: Accept-Encoding
+        */
+        bool has_variants() const;
+    };
+
+    StaticBundle();
+    ~StaticBundle();
+
+    StaticBundle(const StaticBundle&) = delete;
+    StaticBundle& operator=(const StaticBundle&) = delete;
+
+    /**
+     * @brief 映射并校验打包文件
+     * @return 是否成功，失败的原因通过`error()`获取
+    */
+    bool open(const std::string &filename);
+
+    /**
+     * @brief 按请求路径查找文件
+     * @return 没有打包这个路径时返回空
+    */
+    const File* find(const char *path, size_t len) const;
+
+    /**
+     * @brief 按 Accept-Encoding 从文件已有的编码中选择：br 优先于 gzip，q=0 表示不接受
+    */
+    static BUNDLE_ENCODING negotiate(const File &file, const char *accept, size_t len);
+
+    /**
+     * @brief 编码在 Content-Encoding 中的名字，identity 返回空
+    */
+    static const char* encoding_name(BUNDLE_ENCODING enc);
+
+    /**
+     * @brief 路径索引使用的哈希函数，打包和查找必须一致
+    */
+    static uint64_t hash(const char *data, size_t len, uint32_t seed);
+
+    size_t file_count() const { return files.size(); }
+    size_t mapped_bytes() const { return map_len; }
+    const std::vector<File>& get_files() const { return files; }
+    const std::string& error() const { return err_msg; }
+
+private:
+    bool fail(const std::string &msg);
+    void release();
+
+    char *base;
+    size_t map_len;
+    const uint32_t *seeds;
+    const uint32_t *slots;
+    uint32_t bucket_count;
+    uint32_t slot_mask;
+    std::vector<File> files;
+    std::string err_msg;
+};
+
+#endif // BUNDLE_H
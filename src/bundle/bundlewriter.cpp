@@ -0,0 +1,286 @@
+/**
+ * @file bundlewriter.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for building static resource bundles
+*/
+#include "bundlewriter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef YAWN_PACK_BROTLI
+#include <brotli/encode.h>
+#endif
+
+// 每个桶尝试的种子数目，超过后扩大槽位表重新开始
+static const uint32_t MAX_SEED = 1u << 20;
+// 压缩后至少要节省这个比例，否则只保存原始内容
+static const int MIN_SAVING_PERCENT = 10;
+
+static uint64_t align_up(uint64_t off, uint64_t align) {
+    return (off + align - 1) / align * align;
+}
+
+static uint32_t next_pow2(uint64_t n) {
+    uint32_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+static bool gzip_compress(const std::string &in, std::string &out) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 加 16 生成 gzip 格式，头部的修改时间为 0，同样的输入得到同样的输出
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9,
+        Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&zs, in.size()));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = in.size();
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+static bool brotli_compress(const std::string &in, std::string &out) {
+#ifdef YAWN_PACK_BROTLI
+    size_t out_len = BrotliEncoderMaxCompressedSize(in.size());
+    if (out_len == 0) {
+        return false;
+    }
+    out.resize(out_len);
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC,
+        in.size(), reinterpret_cast<const uint8_t*>(in.data()), &out_len,
+        reinterpret_cast<uint8_t*>(&out[0]))) {
+        return false;
+    }
+    out.resize(out_len);
+    return true;
+#else
+    (void)in;
+    (void)out;
+    return false;
+#endif
+}
+
+bool BundleWriter::brotli_supported() {
+#ifdef YAWN_PACK_BROTLI
+    return true;
+#else
+    return false;
+#endif
+}
+
+BundleWriter::BundleWriter(const Options &opts_): opts(opts_), stats() {}
+
+bool BundleWriter::fail(const std::string &msg) {
+    err_msg = msg;
+    return false;
+}
+
+bool BundleWriter::add(const std::string &path, const std::string &content,
+    const std::string &mime, time_t mtime
+) {
+    if (path.empty() || path[0] != '/') {
+        return fail(path + ": path must start with '/'");
+    }
+    if (!paths.insert(path).second) {
+        return fail(path + ": duplicate path");
+    }
+    items.emplace_back();
+    Item &item = items.back();
+    item.path = path;
+    item.mime = mime;
+    item.mtime = mtime;
+    item.body[BUNDLE_IDENTITY] = content;
+
+    // ETag 取决于内容而不是修改时间，重新部署没有变化的文件不会让客户端的缓存失效；
+    // 各个编码的内容不同，ETag 也必须不同
+    char tag[24];
+    snprintf(tag, sizeof(tag), "%016llx",
+        static_cast<unsigned long long>(StaticBundle::hash(content.data(), content.size(), 0)));
+    item.etag[BUNDLE_IDENTITY] = tag;
+
+    ++stats.files;
+    stats.bytes += content.size();
+    ++stats.variants[BUNDLE_IDENTITY];
+    stats.variant_bytes[BUNDLE_IDENTITY] += content.size();
+    if (content.size() < opts.min_size) {
+        return true;
+    }
+    const size_t limit = content.size() - content.size() * MIN_SAVING_PERCENT / 100;
+    const struct {
+        BUNDLE_ENCODING enc;
+        bool enabled;
+        bool (*compress)(const std::string&, std::string&);
+    } CODECS[] = {
+        {BUNDLE_GZIP, opts.gzip, gzip_compress},
+        {BUNDLE_BROTLI, opts.brotli, brotli_compress},
+    };
+    for (const auto &codec : CODECS) {
+        std::string out;
+        if (!codec.enabled || !codec.compress(content, out) || out.size() >= limit) {
+            continue;
+        }
+        item.body[codec.enc] = std::move(out);
+        item.etag[codec.enc] = item.etag[BUNDLE_IDENTITY] + "-" +
+            StaticBundle::encoding_name(codec.enc);
+        ++stats.variants[codec.enc];
+        stats.variant_bytes[codec.enc] += item.body[codec.enc].size();
+    }
+    return true;
+}
+
+bool BundleWriter::build_index(uint32_t bucket_count, uint32_t slot_count,
+    std::vector<uint32_t> &seeds, std::vector<uint32_t> &slots
+) const {
+    std::vector<std::vector<uint32_t>> buckets(bucket_count);
+    for (uint32_t i=0; i<items.size(); ++i) {
+        const std::string &p = items[i].path;
+        buckets[StaticBundle::hash(p.data(), p.size(), 0) % bucket_count].push_back(i);
+    }
+    // 先放置大的桶，这时空槽位多，容易找到合适的种子
+    std::vector<uint32_t> order(bucket_count);
+    for (uint32_t b=0; b<bucket_count; ++b) order[b] = b;
+    std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    seeds.assign(bucket_count, 0);
+    slots.assign(slot_count, BUNDLE_EMPTY_SLOT);
+    std::vector<uint32_t> pos;
+    for (uint32_t b : order) {
+        const auto &bucket = buckets[b];
+        if (bucket.empty()) break;
+        uint32_t seed = 1;
+        for (; seed<MAX_SEED; ++seed) {
+            pos.clear();
+            bool ok = true;
+            for (uint32_t i : bucket) {
+                const std::string &p = items[i].path;
+                uint32_t s = StaticBundle::hash(p.data(), p.size(), seed) & (slot_count - 1);
+                if (slots[s] != BUNDLE_EMPTY_SLOT ||
+                    std::find(pos.begin(), pos.end(), s) != pos.end()) {
+                    ok = false;
+                    break;
+                }
+                pos.push_back(s);
+            }
+            if (ok) break;
+        }
+        if (seed == MAX_SEED) {
+            return false;
+        }
+        seeds[b] = seed;
+        for (size_t k=0; k<bucket.size(); ++k) {
+            slots[pos[k]] = bucket[k];
+        }
+    }
+    return true;
+}
+
+bool BundleWriter::write(const std::string &filename) {
+    // 平均每个桶 3 个路径，槽位表的装载率不超过 0.8
+    const uint32_t bucket_count = items.size() / 3 + 1;
+    uint32_t slot_count = next_pow2(items.size() + items.size() / 4 + 1);
+    std::vector<uint32_t> seeds, slots;
+    while (!build_index(bucket_count, slot_count, seeds, slots)) {
+        if (slot_count >= (1u << 30)) {
+            return fail("failed to build the path index");
+        }
+        slot_count <<= 1;
+    }
+
+    BundleHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BUNDLE_MAGIC, sizeof(hdr.magic));
+    hdr.version = BUNDLE_VERSION;
+    hdr.file_count = items.size();
+    hdr.bucket_count = bucket_count;
+    hdr.slot_count = slot_count;
+    hdr.seeds_off = align_up(sizeof(hdr), alignof(uint32_t));
+    hdr.slots_off = align_up(hdr.seeds_off + seeds.size() * sizeof(uint32_t), alignof(uint32_t));
+    hdr.entries_off = align_up(hdr.slots_off + slots.size() * sizeof(uint32_t),
+        alignof(BundleEntry));
+
+    // 先排布字符串区，再把每个编码的内容放在页边界上
+    std::vector<BundleEntry> entries(items.size());
+    std::string strings;
+    const uint64_t strings_off = hdr.entries_off + entries.size() * sizeof(BundleEntry);
+    auto put_string = [&strings, strings_off](const std::string &s) {
+        BundleSpan span = {strings_off + strings.size(), s.size()};
+        strings.append(s);
+        return span;
+    };
+    for (size_t i=0; i<items.size(); ++i) {
+        memset(&entries[i], 0, sizeof(BundleEntry));
+        entries[i].path = put_string(items[i].path);
+        entries[i].mime = put_string(items[i].mime);
+        entries[i].mtime = items[i].mtime;
+        for (int enc=0; enc<BUNDLE_ENCODING_COUNT; ++enc) {
+            if (!items[i].etag[enc].empty()) {
+                entries[i].etag[enc] = put_string(items[i].etag[enc]);
+            }
+        }
+    }
+    uint64_t off = align_up(strings_off + strings.size(), BUNDLE_ALIGN);
+    for (size_t i=0; i<items.size(); ++i) {
+        for (int enc=0; enc<BUNDLE_ENCODING_COUNT; ++enc) {
+            if (items[i].etag[enc].empty()) continue;
+            entries[i].body[enc] = BundleSpan{off, items[i].body[enc].size()};
+            off = align_up(off + items[i].body[enc].size(), BUNDLE_ALIGN);
+        }
+    }
+    hdr.total_size = off;
+
+    std::string tmp = filename + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "wb");
+    if (!fp) {
+        return fail(tmp + ": " + strerror(errno));
+    }
+    uint64_t written = 0;
+    static const char ZEROS[BUNDLE_ALIGN] = {0};
+    auto put = [fp, &written](const void *data, size_t len) {
+        written += len;
+        return len == 0 || fwrite(data, 1, len, fp) == len;
+    };
+    auto pad_to = [&put, &written](uint64_t target) {
+        bool ok = true;
+        while (ok && written < target) {
+            ok = put(ZEROS, std::min<uint64_t>(target - written, sizeof(ZEROS)));
+        }
+        return ok;
+    };
+    bool ok = put(&hdr, sizeof(hdr)) && pad_to(hdr.seeds_off) &&
+        put(seeds.data(), seeds.size() * sizeof(uint32_t)) && pad_to(hdr.slots_off) &&
+        put(slots.data(), slots.size() * sizeof(uint32_t)) && pad_to(hdr.entries_off) &&
+        put(entries.data(), entries.size() * sizeof(BundleEntry)) &&
+        put(strings.data(), strings.size());
+    for (size_t i=0; ok && i<items.size(); ++i) {
+        for (int enc=0; ok && enc<BUNDLE_ENCODING_COUNT; ++enc) {
+            if (entries[i].body[enc].off == 0) continue;
+            ok = pad_to(entries[i].body[enc].off) &&
+                put(items[i].body[enc].data(), items[i].body[enc].size());
+        }
+    }
+    ok = ok && pad_to(hdr.total_size);
+    if (fclose(fp) != 0 || !ok) {
+        std::string msg = tmp + ": " + strerror(errno);
+        unlink(tmp.c_str());
+        return fail(msg);
+    }
+    if (rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::string msg = filename + ": " + strerror(errno);
+        unlink(tmp.c_str());
+        return fail(msg);
+    }
+    stats.total_size = hdr.total_size;
+    return true;
+}
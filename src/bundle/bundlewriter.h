@@ -0,0 +1,84 @@
+/**
+ * @file bundlewriter.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for building static resource bundles
+*/
+#ifndef BUNDLEWRITER_H
+#define BUNDLEWRITER_H
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "bundle.h"
+
+/**
+ * @brief 生成 StaticBundle 读取的打包文件：预先计算 ETag、压缩的版本和完美哈希索引
+*/
+class BundleWriter {
+public:
+    struct Options {
+        bool gzip;          // 是否生成 gzip 版本
+        bool brotli;        // 是否生成 br 版本，编译时没有 brotli 库则忽略
+        size_t min_size;    // 小于这个大小(字节)的文件不压缩
+
+        Options() : gzip(true), brotli(true), min_size(256) {}
+    };
+
+    struct Stats {
+        size_t files;
+        uint64_t bytes;                                 // 原始内容的总大小
+        size_t variants[BUNDLE_ENCODING_COUNT];         // 每种编码保存的文件数目
+        uint64_t variant_bytes[BUNDLE_ENCODING_COUNT];  // 每种编码保存的总大小
+        uint64_t total_size;                            // 打包文件的大小，write() 之后有效
+    };
+
+    explicit BundleWriter(const Options &opts = Options());
+
+    /**
+     * @brief 添加一个文件，压缩后更小的编码会一起保存
+     * @param path 请求路径，必须以 '/' 开头并且不能重复
+     * @return 是否成功，失败的原因通过`error()`获取
+    */
+    bool add(const std::string &path, const std::string &content, const std::string &mime,
+        time_t mtime);
+
+    /**
+     * @brief 生成索引并写入打包文件，先写到临时文件再改名，正在使用旧文件的进程不受影响
+    */
+    bool write(const std::string &filename);
+
+    const Stats& get_stats() const { return stats; }
+    const std::string& error() const { return err_msg; }
+
+    /**
+     * @brief 是否在编译时启用了 brotli 压缩
+    */
+    static bool brotli_supported();
+
+private:
+    struct Item {
+        std::string path;
+        std::string mime;
+        time_t mtime;
+        std::string body[BUNDLE_ENCODING_COUNT];   // 为空并且不是 identity 时表示没有这个编码
+        std::string etag[BUNDLE_ENCODING_COUNT];
+    };
+
+    /**
+     * @brief 为每个桶寻找种子，使所有路径落在不同的槽位上
+    */
+    bool build_index(uint32_t bucket_count, uint32_t slot_count, std::vector<uint32_t> &seeds,
+        std::vector<uint32_t> &slots) const;
+    bool fail(const std::string &msg);
+
+    Options opts;
+    std::vector<Item> items;
+    std::unordered_set<std::string> paths;
+    Stats stats;
+    std::string err_msg;
+};
+
+#endif // BUNDLEWRITER_H
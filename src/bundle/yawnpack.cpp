@@ -0,0 +1,146 @@
+/**
+ * @file yawnpack.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief yawn-pack: compile a static resource directory into a bundle
+*/
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "bundlewriter.h"
+#include "../http/mimetype.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s [options] <resource_dir> <bundle_file>\n"
+        "Compile the static resources under <resource_dir> into <bundle_file>, which the\n"
+        "server maps at startup when `static_bundle` points to it.\n\n"
+        "Options:\n"
+        "  --no-gzip         do not store gzip variants\n"
+        "  --no-brotli       do not store br variants\n"
+        "  --min-size BYTES  do not compress files smaller than BYTES (default 256)\n"
+        "  -q                only print errors\n", prog);
+}
+
+/**
+ * @brief 递归地收集目录下的普通文件（跟随符号链接），路径相对于资源根目录并以 '/' 开头
+*/
+static bool collect(const std::string &root, const std::string &rel,
+    std::vector<std::string> &files
+) {
+    std::string dir = root + rel;
+    DIR *dp = opendir(dir.c_str());
+    if (!dp) {
+        fprintf(stderr, "yawn-pack: %s: %s\n", dir.c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = true;
+    while (dirent *ent = readdir(dp)) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        std::string path = rel + "/" + ent->d_name;
+        struct stat st;
+        if (stat((root + path).c_str(), &st) < 0) {
+            fprintf(stderr, "yawn-pack: %s: %s\n", (root + path).c_str(), strerror(errno));
+            ok = false;
+        } else if (S_ISDIR(st.st_mode)) {
+            ok = collect(root, path, files) && ok;
+        } else if (S_ISREG(st.st_mode)) {
+            files.push_back(path);
+        }
+    }
+    closedir(dp);
+    return ok;
+}
+
+static bool read_file(const std::string &filename, std::string &content) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    content = ss.str();
+    return !in.bad();
+}
+
+int main(int argc, char *argv[]) {
+    BundleWriter::Options opts;
+    bool quiet = false;
+    std::vector<std::string> args;
+    for (int i=1; i<argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--no-gzip") {
+            opts.gzip = false;
+        } else if (arg == "--no-brotli") {
+            opts.brotli = false;
+        } else if (arg == "--min-size" && i + 1 < argc) {
+            opts.min_size = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-q") {
+            quiet = true;
+        } else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.size() != 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::string root = args[0];
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    if (opts.brotli && !BundleWriter::brotli_supported() && !quiet) {
+        fprintf(stderr, "yawn-pack: built without brotli, storing gzip variants only\n");
+    }
+
+    std::vector<std::string> files;
+    if (!collect(root, "", files)) {
+        return EXIT_FAILURE;
+    }
+    // 按路径排序，同样的目录总是生成同样的打包文件
+    std::sort(files.begin(), files.end());
+    BundleWriter writer(opts);
+    for (const auto &path : files) {
+        std::string content;
+        struct stat st;
+        if (stat((root + path).c_str(), &st) < 0 || !read_file(root + path, content)) {
+            fprintf(stderr, "yawn-pack: %s: %s\n", (root + path).c_str(), strerror(errno));
+            return EXIT_FAILURE;
+        }
+        if (!writer.add(path, content, mime_type(path.data(), path.size()), st.st_mtime)) {
+            fprintf(stderr, "yawn-pack: %s\n", writer.error().c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    if (!writer.write(args[1])) {
+        fprintf(stderr, "yawn-pack: %s\n", writer.error().c_str());
+        return EXIT_FAILURE;
+    }
+
+    if (!quiet) {
+        const auto &stats = writer.get_stats();
+        printf("%s: %zu files, %llu bytes\n", args[1].c_str(), stats.files,
+            static_cast<unsigned long long>(stats.bytes));
+        for (int enc=BUNDLE_IDENTITY+1; enc<BUNDLE_ENCODING_COUNT; ++enc) {
+            printf("  %-4s %zu variants, %llu bytes\n",
+                StaticBundle::encoding_name(static_cast<BUNDLE_ENCODING>(enc)),
+                stats.variants[enc], static_cast<unsigned long long>(stats.variant_bytes[enc]));
+        }
+        printf("  bundle size %llu bytes\n", static_cast<unsigned long long>(stats.total_size));
+    }
+    return EXIT_SUCCESS;
+}
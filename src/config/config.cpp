@@ -4,6 +4,7 @@
  * @date 2024-03-31
  * @brief source file for config
 */
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include "config.h"
@@ -17,8 +18,9 @@ std::ostream& operator<<(std::ostream &os, const Config &cfg) {
     return os;
 }
 
-Config::Config(const string &filename) {
+Config::Config(const string &filename_): filename(filename_), is_loaded(false) {
     if (parse_file(filename)) {
+        is_loaded = true;
         printf("Load config from \"%s\"\n", filename.c_str());
     } else {
         printf("Failed to load config from \"%s\"! "
@@ -96,6 +98,23 @@ Config::size_type  Config::items_num() const {
     return tb.size();
 }
 
+std::vector<string> Config::diff(const Config &other) const {
+    std::vector<string> keys;
+    for (const auto &item : tb) {
+        auto target = other.tb.find(item.first);
+        if (target == other.tb.end() || target->second != item.second) {
+            keys.push_back(item.first);
+        }
+    }
+    for (const auto &item : other.tb) {
+        if (tb.find(item.first) == tb.end()) {
+            keys.push_back(item.first);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
 bool Config::parse_file(const string &filename) {
     std::ifstream fs(filename);
     if (!fs.is_open()) {
@@ -172,8 +191,27 @@ void Config::gen_default() {
             {"listen_ip", "0.0.0.0"}, // 监听的 IP 地址
             {"listen_port", "6789"},  // 监听的端口号
             {"timeout", "60000"},     // 定时时间
+            {"header_timeout", "10000"}, // 接收请求头的最长时间(毫秒)
+            {"body_timeout", "60000"},   // 接收请求体的最长时间(毫秒)
+            {"send_timeout", "60000"},   // 发送响应的最长时间(毫秒)
+            {"min_recv_rate", "1024"},   // 接收请求体的最低速率(字节/秒)
+            {"min_send_rate", "1024"},   // 发送响应的最低速率(字节/秒)
+            {"rate_grace", "5000"},      // 检查最低速率前的宽限期(毫秒)
+            {"max_request_line", "8192"},  // 请求行的最大长度
+            {"max_header_size", "16384"},  // 请求头的最大总长度
+            {"max_body_size", "1073741824"},  // 请求体的最大长度
+            {"body_buffer_size", "65536"},  // 在内存中缓存的请求体的最大长度
+            {"body_spool_dir", "/tmp"},     // 暂存大请求体的目录
             {"open_linger", "true"},  // 开启 linger
             {"trig_mode", "3"},       // 监听socket 和 连接socket 上触发事件的模式
+            {"listen_backlog", "1024"}, // 监听队列的长度
+            {"tcp_defer_accept", "0"}, // TCP_DEFER_ACCEPT 的秒数
+            {"tcp_fastopen", "0"},    // TCP_FASTOPEN 的队列长度
+            {"tcp_nodelay", "true"},  // 是否开启 TCP_NODELAY
+            {"tcp_cork", "true"},     // 发送响应头和文件时是否使用 TCP_CORK
+            {"sock_sndbuf", "0"},     // 发送缓冲区大小
+            {"sock_rcvbuf", "0"},     // 接收缓冲区大小
+            {"busy_poll_us", "0"},    // 忙轮询的时长(微秒)
             {"max_num_fds", "1024"},  // epoll 监听的最大文件描述符数量
             {"thread_pool_num", "8"}, // 线程池中线程的数量
             {"src_dir", "/var/www/html"}, // 静态资源根目录
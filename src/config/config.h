@@ -9,6 +9,7 @@
 
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 using std::unordered_map;
 using std::string;
@@ -29,6 +30,18 @@ public:
     double get_float(const string &key, double default_val=0.0) const;
     bool get_bool(const string &key, bool default_val=false) const;
     size_type items_num() const;
+    /**
+     * @brief 配置文件的路径，重新加载时使用
+    */
+    const string& get_filename() const { return filename; }
+    /**
+     * @brief 是否成功读取了配置文件，否则使用的是默认配置
+    */
+    bool loaded() const { return is_loaded; }
+    /**
+     * @brief 与另一份配置相比，取值不同或者只在一方出现的键，按字典序排列
+    */
+    std::vector<string> diff(const Config &other) const;
 private:
     bool parse_file(const string &filename);
     bool parse_line(const string &line);
@@ -36,6 +49,8 @@ private:
     bool is_valid(const string &kv);
 
     unordered_map<string,string> tb; // 存储键值对的表
+    string filename;
+    bool is_loaded;
 };
 
 
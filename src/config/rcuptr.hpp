@@ -0,0 +1,155 @@
+/**
+ * @file rcuptr.hpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief read-copy-update pointer to an immutable configuration snapshot
+*/
+#ifndef RCUPTR_HPP
+#define RCUPTR_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 所有 RcuPtr 共用的读端计数：读者进入临界区时在当前纪元的计数上加一，退出时减一
+ *
+ * 写者在确认上一个纪元的读者全部退出之后才推进纪元，替换下来的旧版本在纪元前进两次之后
+ * 不会再有读者引用，可以释放。推进纪元和释放旧版本只在写者所在的线程中进行
+*/
+class RcuEpoch {
+public:
+    /**
+     * @brief 进入读端临界区，返回的纪元在退出时传给 read_unlock
+    */
+    static unsigned read_lock() {
+        State &s = state();
+        while (true) {
+            unsigned e = s.epoch.load(std::memory_order_seq_cst);
+            s.readers[e & 1].fetch_add(1, std::memory_order_seq_cst);
+            // 计数之前纪元可能已经前进，这时写者可能已经检查过这个计数，换到新的纪元重试
+            if (s.epoch.load(std::memory_order_seq_cst) == e) return e;
+            s.readers[e & 1].fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    static void read_unlock(unsigned e) {
+        state().readers[e & 1].fetch_sub(1, std::memory_order_release);
+    }
+
+    static unsigned current() { return state().epoch.load(std::memory_order_seq_cst); }
+
+    /**
+     * @brief 上上个纪元的读者已经全部退出时推进纪元，返回推进之后的纪元
+    */
+    static unsigned advance() {
+        State &s = state();
+        unsigned e = s.epoch.load(std::memory_order_seq_cst);
+        // 下一个纪元与上一个纪元共用计数，上一个纪元的读者没有退出时不能推进
+        if (s.readers[(e + 1) & 1].load(std::memory_order_acquire) == 0) {
+            s.epoch.store(++e, std::memory_order_seq_cst);
+        }
+        return e;
+    }
+private:
+    struct State {
+        std::atomic<unsigned> epoch{0};
+        std::atomic<long> readers[2] = {{0}, {0}};
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+};
+
+/**
+ * @brief 读端临界区的作用域守卫，工作线程在处理一个任务期间持有
+*/
+class RcuReadGuard {
+public:
+    RcuReadGuard() : epoch(RcuEpoch::read_lock()) {}
+    ~RcuReadGuard() { RcuEpoch::read_unlock(epoch); }
+
+    RcuReadGuard(const RcuReadGuard&) = delete;
+    RcuReadGuard& operator=(const RcuReadGuard&) = delete;
+private:
+    unsigned epoch;
+};
+
+/**
+ * @brief 指向不可变快照的指针：读者无锁地读取当前版本，写者复制、修改之后整体替换
+ *
+ * 读者只做一次 acquire 的原子读。写者所在的线程不需要守卫；其他线程只能在 RcuReadGuard
+ * 的作用域内读取，并且不能把指针保留到作用域之外。替换下来的版本在 reclaim() 确认
+ * 读者全部退出之后释放；只适合像配置这样很少更新、体积很小的数据
+*/
+template <typename T>
+class RcuPtr {
+public:
+    RcuPtr() : RcuPtr(std::unique_ptr<T>(new T())) {}
+
+    explicit RcuPtr(std::unique_ptr<T> init) : cur(init.release()) {}
+
+    ~RcuPtr() {
+        delete cur.load(std::memory_order_relaxed);
+    }
+
+    RcuPtr(const RcuPtr&) = delete;
+    RcuPtr& operator=(const RcuPtr&) = delete;
+
+    const T* get() const { return cur.load(std::memory_order_acquire); }
+    const T* operator->() const { return get(); }
+    const T& operator*() const { return *get(); }
+
+    /**
+     * @brief 发布新的版本，之后的读者看到它，已经取得旧版本的读者不受影响
+    */
+    void publish(std::unique_ptr<T> next) {
+        std::lock_guard<std::mutex> lck(mtx);
+        const T *old = cur.exchange(next.release(), std::memory_order_seq_cst);
+        retired.emplace_back(RcuEpoch::current(), std::unique_ptr<const T>(old));
+    }
+
+    /**
+     * @brief 推进纪元并释放没有读者的旧版本，由写者所在的线程定期调用
+     * @return 是否还有等待释放的旧版本
+    */
+    bool reclaim() {
+        std::lock_guard<std::mutex> lck(mtx);
+        if (retired.empty()) return false;
+        unsigned now = RcuEpoch::advance();
+        // 替换时的纪元和它之前的读者在纪元前进两次之后都已经退出
+        auto it = retired.begin();
+        while (it != retired.end() && now - it->first >= 2) {
+            ++it;
+        }
+        retired.erase(retired.begin(), it);
+        return !retired.empty();
+    }
+
+    /**
+     * @brief 当前版本的副本，写者在它的基础上修改之后发布
+    */
+    std::unique_ptr<T> copy() const {
+        return std::unique_ptr<T>(new T(*get()));
+    }
+
+    /**
+     * @brief 当前版本和还没有释放的旧版本的数目
+    */
+    size_t version_count() const {
+        std::lock_guard<std::mutex> lck(mtx);
+        return retired.size() + 1;
+    }
+
+private:
+    std::atomic<const T*> cur;
+    mutable std::mutex mtx;    // 只由写者使用
+    // 替换下来的旧版本和替换时的纪元，按替换的先后排列
+    std::vector<std::pair<unsigned, std::unique_ptr<const T>>> retired;
+};
+
+#endif // RCUPTR_HPP
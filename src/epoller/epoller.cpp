@@ -4,11 +4,13 @@
  * @date 2024-03-24
  * @brief source file for epoller
 */
+#include <chrono>
+#include <algorithm>
 #include "epoller.h"
 
 
 Epoller::Epoller(int num_fds)
-: m_epoll_fd(epoll_create(512)), m_epoll_events(num_fds) {
+: m_epoll_fd(epoll_create(512)), m_epoll_events(num_fds), m_busy_poll_us(0) {
     if (m_epoll_fd < 0) {
         LOG_ERROR("epoll_create failed: %s", strerror(errno));
         exit(EXIT_FAILURE);
@@ -45,8 +47,39 @@ bool Epoller::del_fd(int fd) {
 }
 
 int Epoller::wait(int timeout) {
-    return epoll_wait(m_epoll_fd, &m_epoll_events[0], 
-        static_cast<int>(m_epoll_events.size()), timeout);
+    int max_events = static_cast<int>(m_epoll_events.size());
+    if (m_busy_poll_us <= 0 || timeout == 0) {
+        return epoll_wait(m_epoll_fd, &m_epoll_events[0], max_events, timeout);
+    }
+
+    using std::chrono::steady_clock;
+    using std::chrono::microseconds;
+    using std::chrono::milliseconds;
+    auto start = steady_clock::now();
+    auto spin_end = start + microseconds(m_busy_poll_us);
+    if (timeout > 0) {
+        spin_end = std::min(spin_end, start + milliseconds(timeout));
+    }
+    auto now = start;
+    do {
+        int n = epoll_wait(m_epoll_fd, &m_epoll_events[0], max_events, 0);
+        if (n != 0) {
+            return n;
+        }
+        now = steady_clock::now();
+    } while (now < spin_end);
+
+    // 忙轮询的时长已用完，阻塞等待剩余的超时时间
+    int remain = timeout;
+    if (timeout > 0) {
+        auto elapsed = std::chrono::duration_cast<milliseconds>(now - start).count();
+        remain = elapsed >= timeout ? 0 : timeout - static_cast<int>(elapsed);
+    }
+    return epoll_wait(m_epoll_fd, &m_epoll_events[0], max_events, remain);
+}
+
+void Epoller::set_busy_poll(int budget_us) {
+    m_busy_poll_us = budget_us > 0 ? budget_us : 0;
 }
 
 int Epoller::get_event_fd(size_t idx) const {
@@ -53,11 +53,21 @@ public:
     
     /**
      * @brief 等待就绪事件
-     * @param timeout 超时时间，单位为毫秒(milliseconds)
+     * 
+     * 开启忙轮询时，先以零超时反复调用 `epoll_wait`，直到有事件、忙轮询的时长
+     * 用完或者超时时间已到，之后才进入阻塞等待。
+     * @param timeout 超时时间，单位为毫秒(milliseconds)，-1 表示一直等待
      * @return 有就绪事件的文件描述符的数量
     */
     int wait(int timeout);
 
+    /**
+     * @brief 设置忙轮询的时长
+     * @param budget_us 每次 `wait` 在阻塞之前空转轮询的最长时间，单位为微秒，
+     *                  0 表示关闭忙轮询
+    */
+    void set_busy_poll(int budget_us);
+
     /**
      * @brief 获取有事件发生的文件描述符
      * @param idx 索引
@@ -78,6 +88,9 @@ private:
 
     // 存放 `epoll_event` 的数组
     std::vector<struct epoll_event> m_epoll_events;
+
+    // 忙轮询的时长，单位为微秒，0 表示关闭
+    int m_busy_poll_us;
 };
 
 #endif // EPOLLER_H
\ No newline at end of file
@@ -0,0 +1,464 @@
+/**
+ * @file hpack.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for HPACK header compression (RFC 7541)
+*/
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include "hpack.h"
+
+// 条目的额外开销 (RFC 7541 4.1)
+static const size_t ENTRY_OVERHEAD = 32;
+// 编码器使用的动态表的最大大小
+static const size_t ENCODER_TABLE_SIZE = 4096;
+
+// 静态表 (RFC 7541 附录 A)，索引从 1 开始
+static const char * const STATIC_TABLE[][2] = {
+    {"", ""},
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""}
+};
+static const size_t STATIC_COUNT = sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]) - 1;
+
+/**
+ * Huffman 编码各个符号（256 为 EOS）的码长 (RFC 7541 附录 B)。
+ * 该编码是范式 Huffman 编码：码长相同的符号按符号值递增依次分配码字，
+ * 因此只需码长即可还原出完整的码表
+*/
+static const uint8_t HUFFMAN_LEN[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30
+};
+static const int HUFFMAN_MAX_LEN = 30;
+static const int HUFFMAN_EOS = 256;
+
+namespace {
+
+/**
+ * @brief 由码长还原出的范式 Huffman 码表
+*/
+struct HuffmanCode {
+    uint32_t code[257];                      // 符号 -> 码字
+    uint32_t first[HUFFMAN_MAX_LEN + 1];     // 各个码长的第一个码字
+    uint16_t count[HUFFMAN_MAX_LEN + 1];     // 各个码长的码字数目
+    uint16_t offset[HUFFMAN_MAX_LEN + 1];    // 各个码长的第一个符号在 symbols 中的位置
+    uint16_t symbols[257];                   // 按 (码长, 符号值) 排序的符号
+
+    HuffmanCode() {
+        std::memset(count, 0, sizeof(count));
+        for (int sym=0; sym<=HUFFMAN_EOS; ++sym) {
+            symbols[sym] = sym;
+            ++count[HUFFMAN_LEN[sym]];
+        }
+        std::stable_sort(symbols, symbols + 257, [](uint16_t a, uint16_t b) {
+            return HUFFMAN_LEN[a] < HUFFMAN_LEN[b];
+        });
+        uint32_t next = 0;
+        uint16_t pos = 0;
+        for (int len=1; len<=HUFFMAN_MAX_LEN; ++len) {
+            next <<= 1;
+            first[len] = next;
+            offset[len] = pos;
+            next += count[len];
+            pos += count[len];
+        }
+        for (int i=0; i<=HUFFMAN_EOS; ++i) {
+            int len = HUFFMAN_LEN[symbols[i]];
+            code[symbols[i]] = first[len] + (i - offset[len]);
+        }
+    }
+};
+
+} // namespace
+
+static const HuffmanCode& huffman_code() {
+    static const HuffmanCode code;
+    return code;
+}
+
+/**
+ * @brief 在静态表中查找字段
+ * @param name_idx 名字匹配的第一个条目，没有时为 0
+ * @return 名字和值都匹配的条目，没有时为 0
+*/
+static size_t find_static(const std::string &name, const std::string &value, size_t &name_idx) {
+    static const std::unordered_map<std::string, size_t> NAME_INDEX = [] {
+        std::unordered_map<std::string, size_t> index;
+        for (size_t i=STATIC_COUNT; i>=1; --i) {
+            index[STATIC_TABLE[i][0]] = i;
+        }
+        return index;
+    }();
+    const auto it = NAME_INDEX.find(name);
+    if (it == NAME_INDEX.end()) {
+        name_idx = 0;
+        return 0;
+    }
+    name_idx = it->second;
+    // 同名的条目在静态表中是连续的
+    for (size_t i=name_idx; i<=STATIC_COUNT && name == STATIC_TABLE[i][0]; ++i) {
+        if (value == STATIC_TABLE[i][1]) return i;
+    }
+    return 0;
+}
+
+static void encode_string(std::string &out, const std::string &str) {
+    size_t huff_len = huffman_encoded_len(str.data(), str.size());
+    if (huff_len < str.size()) {
+        hpack_encode_integer(out, huff_len, 7, 0x80);
+        huffman_encode(out, str.data(), str.size());
+    } else {
+        hpack_encode_integer(out, str.size(), 7, 0x00);
+        out.append(str);
+    }
+}
+
+/**
+ * @brief 解码一个字符串字面量
+ * @return 消耗的字节数，出错返回 0
+*/
+static size_t decode_string(const uint8_t *p, const uint8_t *end, std::string &str) {
+    uint64_t len = 0;
+    size_t used = hpack_decode_integer(p, end, 7, len);
+    if (used == 0 || len > static_cast<uint64_t>(end - p) - used) {
+        return 0;
+    }
+    str.clear();
+    if (*p & 0x80) {
+        if (!huffman_decode(str, p + used, len)) return 0;
+    } else {
+        str.assign(reinterpret_cast<const char *>(p + used), len);
+    }
+    return used + len;
+}
+
+
+void hpack_encode_integer(std::string &out, uint64_t value, int prefix_bits, uint8_t first) {
+    const uint64_t max_prefix = (1u << prefix_bits) - 1;
+    if (value < max_prefix) {
+        out.push_back(static_cast<char>(first | value));
+        return;
+    }
+    out.push_back(static_cast<char>(first | max_prefix));
+    value -= max_prefix;
+    while (value >= 128) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+size_t hpack_decode_integer(const uint8_t *p, const uint8_t *end, int prefix_bits,
+    uint64_t &value
+) {
+    if (p >= end) return 0;
+    const uint8_t *begin = p;
+    const uint64_t max_prefix = (1u << prefix_bits) - 1;
+    value = *p++ & max_prefix;
+    if (value < max_prefix) return 1;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        if (p >= end || shift > 28) {
+            // 不完整，或者超过了任何合理取值的范围
+            return 0;
+        }
+        byte = *p++;
+        value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return p - begin;
+}
+
+size_t huffman_encoded_len(const char *data, size_t len) {
+    size_t bits = 0;
+    for (size_t i=0; i<len; ++i) {
+        bits += HUFFMAN_LEN[static_cast<unsigned char>(data[i])];
+    }
+    return (bits + 7) / 8;
+}
+
+void huffman_encode(std::string &out, const char *data, size_t len) {
+    const auto &huff = huffman_code();
+    uint64_t acc = 0;
+    int bits = 0;
+    for (size_t i=0; i<len; ++i) {
+        unsigned char sym = data[i];
+        acc = (acc << HUFFMAN_LEN[sym]) | huff.code[sym];
+        bits += HUFFMAN_LEN[sym];
+        while (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(acc >> bits));
+        }
+        acc &= (1ull << bits) - 1;
+    }
+    if (bits > 0) {
+        // 用 EOS 的高位（全 1）填充最后一个字节
+        out.push_back(static_cast<char>((acc << (8 - bits)) | (0xff >> bits)));
+    }
+}
+
+bool huffman_decode(std::string &out, const uint8_t *data, size_t len) {
+    const auto &huff = huffman_code();
+    uint64_t acc = 0;
+    int bits = 0;
+    for (size_t i=0; i<len; ++i) {
+        acc = (acc << 8) | data[i];
+        bits += 8;
+        // 范式编码中，长度为 L 的码字落在 [first[L], first[L] + count[L]) 内，
+        // 更长码字的前 L 位一定不小于 first[L] + count[L]
+        bool found = true;
+        while (found && bits >= 5) {
+            found = false;
+            int limit = std::min(bits, HUFFMAN_MAX_LEN);
+            for (int l=5; l<=limit; ++l) {
+                uint32_t c = static_cast<uint32_t>(acc >> (bits - l)) & ((1u << l) - 1);
+                if (c - huff.first[l] < huff.count[l]) {
+                    int sym = huff.symbols[huff.offset[l] + c - huff.first[l]];
+                    if (sym == HUFFMAN_EOS) return false;
+                    out.push_back(static_cast<char>(sym));
+                    bits -= l;
+                    acc &= (1ull << bits) - 1;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found && bits >= HUFFMAN_MAX_LEN) return false;
+        }
+    }
+    // 剩余的位是填充，必须是 EOS 码字的前缀（全 1）且不超过 7 位
+    return bits <= 7 && acc == (1ull << bits) - 1;
+}
+
+HpackTable::HpackTable(size_t max_size) : m_size(0), m_max_size(max_size) {}
+
+void HpackTable::set_max_size(size_t max_size) {
+    m_max_size = max_size;
+    evict(m_max_size);
+}
+
+void HpackTable::add(const std::string &name, const std::string &value) {
+    size_t entry_size = name.size() + value.size() + ENTRY_OVERHEAD;
+    if (entry_size > m_max_size) {
+        m_entries.clear();
+        m_size = 0;
+        return;
+    }
+    evict(m_max_size - entry_size);
+    m_entries.emplace_front(name, value);
+    m_size += entry_size;
+}
+
+void HpackTable::evict(size_t limit) {
+    while (m_size > limit && !m_entries.empty()) {
+        const auto &oldest = m_entries.back();
+        m_size -= oldest.first.size() + oldest.second.size() + ENTRY_OVERHEAD;
+        m_entries.pop_back();
+    }
+}
+
+bool HpackDecoder::lookup(size_t index, const std::string *&name,
+    const std::string *&value
+) const {
+    static const std::vector<std::pair<std::string, std::string>> STATIC_ENTRIES = [] {
+        std::vector<std::pair<std::string, std::string>> entries;
+        for (size_t i=0; i<=STATIC_COUNT; ++i) {
+            entries.emplace_back(STATIC_TABLE[i][0], STATIC_TABLE[i][1]);
+        }
+        return entries;
+    }();
+    if (index == 0) {
+        return false;
+    } else if (index <= STATIC_COUNT) {
+        name = &STATIC_ENTRIES[index].first;
+        value = &STATIC_ENTRIES[index].second;
+        return true;
+    } else if (index - STATIC_COUNT - 1 < m_table.count()) {
+        const auto &entry = m_table.get(index - STATIC_COUNT - 1);
+        name = &entry.first;
+        value = &entry.second;
+        return true;
+    }
+    return false;
+}
+
+bool HpackDecoder::decode(const uint8_t *data, size_t len, HpackHeaderList &headers,
+    size_t max_list_size
+) {
+    const uint8_t *p = data, *end = data + len;
+    size_t list_size = 0;
+    bool seen_field = false;
+    std::string name, value;
+    while (p < end) {
+        uint8_t first = *p;
+        uint64_t index = 0;
+        size_t used = 0;
+        if (first & 0x80) {
+            // 索引字段
+            used = hpack_decode_integer(p, end, 7, index);
+            const std::string *n, *v;
+            if (used == 0 || !lookup(index, n, v)) return false;
+            name = *n;
+            value = *v;
+            p += used;
+        } else if ((first & 0xe0) == 0x20) {
+            // 动态表大小更新，只能出现在头部块的开头
+            used = hpack_decode_integer(p, end, 5, index);
+            if (used == 0 || seen_field || index > m_settings_max) return false;
+            m_table.set_max_size(index);
+            p += used;
+            continue;
+        } else {
+            // 字面量字段：01 加入动态表，0000 不加入，0001 永不加入
+            bool incremental = (first & 0xc0) == 0x40;
+            used = hpack_decode_integer(p, end, incremental ? 6 : 4, index);
+            if (used == 0) return false;
+            p += used;
+            if (index > 0) {
+                const std::string *n, *v;
+                if (!lookup(index, n, v)) return false;
+                name = *n;
+            } else {
+                used = decode_string(p, end, name);
+                if (used == 0) return false;
+                p += used;
+            }
+            used = decode_string(p, end, value);
+            if (used == 0) return false;
+            p += used;
+            if (incremental) {
+                m_table.add(name, value);
+            }
+        }
+        seen_field = true;
+        list_size += name.size() + value.size() + ENTRY_OVERHEAD;
+        if (list_size > max_list_size) return false;
+        headers.emplace_back(name, value);
+    }
+    return true;
+}
+
+void HpackEncoder::set_max_table_size(size_t size) {
+    size = std::min(size, ENCODER_TABLE_SIZE);
+    if (size != m_table.max_size()) {
+        m_table.set_max_size(size);
+        m_pending_update = true;
+    }
+}
+
+void HpackEncoder::begin(std::string &out) {
+    if (m_pending_update) {
+        hpack_encode_integer(out, m_table.max_size(), 5, 0x20);
+        m_pending_update = false;
+    }
+}
+
+void HpackEncoder::encode(std::string &out, const std::string &name,
+    const std::string &value, bool index
+) {
+    size_t name_idx = 0;
+    size_t idx = find_static(name, value, name_idx);
+    if (idx > 0) {
+        hpack_encode_integer(out, idx, 7, 0x80);
+        return;
+    }
+    for (size_t i=0; i<m_table.count(); ++i) {
+        const auto &entry = m_table.get(i);
+        if (entry.first == name) {
+            if (entry.second == value) {
+                hpack_encode_integer(out, STATIC_COUNT + 1 + i, 7, 0x80);
+                return;
+            }
+            if (name_idx == 0) name_idx = STATIC_COUNT + 1 + i;
+        }
+    }
+    index = index && name.size() + value.size() + ENTRY_OVERHEAD <= m_table.max_size();
+    if (index) {
+        hpack_encode_integer(out, name_idx, 6, 0x40);
+    } else {
+        hpack_encode_integer(out, name_idx, 4, 0x00);
+    }
+    if (name_idx == 0) {
+        encode_string(out, name);
+    }
+    encode_string(out, value);
+    if (index) {
+        m_table.add(name, value);
+    }
+}
@@ -0,0 +1,152 @@
+/**
+ * @file hpack.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for HPACK header compression (RFC 7541)
+*/
+#ifndef HPACK_H
+#define HPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 头部字段列表，字段名均为小写
+using HpackHeaderList = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * @brief HPACK 的动态表
+ *
+ * 新加入的条目索引最小，表的大小超过上限时从最旧的条目开始淘汰。
+ * 条目的大小为 名字长度 + 值长度 + 32
+*/
+class HpackTable {
+public:
+    explicit HpackTable(size_t max_size = 4096);
+
+    /**
+     * @brief 修改表的大小上限，必要时淘汰旧条目
+    */
+    void set_max_size(size_t max_size);
+    size_t max_size() const { return m_max_size; }
+    size_t size() const { return m_size; }
+    size_t count() const { return m_entries.size(); }
+
+    /**
+     * @brief 加入一个条目，比整个表还大的条目会清空表且不被加入
+    */
+    void add(const std::string &name, const std::string &value);
+
+    /**
+     * @brief 第 idx 个条目，0 为最新加入的条目
+    */
+    const std::pair<std::string, std::string>& get(size_t idx) const {
+        return m_entries[idx];
+    }
+
+private:
+    void evict(size_t limit);
+
+    std::deque<std::pair<std::string, std::string>> m_entries;
+    size_t m_size;
+    size_t m_max_size;
+};
+
+/**
+ * @brief HPACK 解码器，每个 HTTP/2 连接一个，对端的所有头部块必须按顺序交给它
+*/
+class HpackDecoder {
+public:
+    HpackDecoder() : m_settings_max(4096) {}
+
+    /**
+     * @brief 本端通过 SETTINGS_HEADER_TABLE_SIZE 声明的动态表大小上限，
+     * 对端的表大小更新不能超过它
+    */
+    void set_max_table_size(size_t size) { m_settings_max = size; }
+
+    /**
+     * @brief 解码一个完整的头部块
+     * @param data 头部块
+     * @param len 头部块的长度
+     * @param headers 解码结果追加到其中
+     * @param max_list_size 解码后头部列表的最大大小（按 RFC 7540 的方式计算）
+     * @return 是否解码成功；失败后解码器的状态不再可靠，连接必须关闭
+    */
+    bool decode(const uint8_t *data, size_t len, HpackHeaderList &headers,
+        size_t max_list_size);
+
+private:
+    bool lookup(size_t index, const std::string *&name, const std::string *&value) const;
+
+    HpackTable m_table;
+    size_t m_settings_max;
+};
+
+/**
+ * @brief HPACK 编码器
+ *
+ * 静态表和动态表中完全匹配的字段编码为一个索引，其余字段以字面量输出，
+ * 字面量在 Huffman 编码更短时使用 Huffman 编码
+*/
+class HpackEncoder {
+public:
+    HpackEncoder() : m_table(4096), m_pending_update(false) {}
+
+    /**
+     * @brief 对端通过 SETTINGS_HEADER_TABLE_SIZE 声明的动态表大小上限
+     * @note 新的大小在下一个头部块的开头通知对端
+    */
+    void set_max_table_size(size_t size);
+
+    /**
+     * @brief 开始一个新的头部块
+    */
+    void begin(std::string &out);
+
+    /**
+     * @brief 编码一个字段
+     * @param index 是否把字段加入动态表，每次都变化的字段不应加入
+    */
+    void encode(std::string &out, const std::string &name, const std::string &value,
+        bool index);
+
+private:
+    HpackTable m_table;
+    bool m_pending_update;   // 是否需要在下一个头部块中通知表大小的变化
+};
+
+/**
+ * @brief 编码带前缀的整数
+ * @param prefix_bits 前缀的位数 (1 ~ 8)
+ * @param first 第一个字节中前缀之外的高位
+*/
+void hpack_encode_integer(std::string &out, uint64_t value, int prefix_bits, uint8_t first);
+
+/**
+ * @brief 解码带前缀的整数
+ * @return 成功时返回消耗的字节数，数据不完整或溢出时返回 0
+*/
+size_t hpack_decode_integer(const uint8_t *p, const uint8_t *end, int prefix_bits,
+    uint64_t &value);
+
+/**
+ * @brief Huffman 编码后的长度（单位为字节）
+*/
+size_t huffman_encoded_len(const char *data, size_t len);
+
+/**
+ * @brief Huffman 编码，结果追加到 out
+*/
+void huffman_encode(std::string &out, const char *data, size_t len);
+
+/**
+ * @brief Huffman 解码，结果追加到 out
+ * @return 编码是否合法（不能包含 EOS，填充必须是不超过 7 位的全 1）
+*/
+bool huffman_decode(std::string &out, const uint8_t *data, size_t len);
+
+#endif // HPACK_H
@@ -0,0 +1,624 @@
+/**
+ * @file http2.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for HTTP/2 (RFC 7540) framing, streams and flow control
+*/
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include "http2.h"
+
+const char Http2Session::PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const size_t Http2Session::PREFACE_LEN;
+Http2Limits Http2Session::limits;
+
+// 帧头部的长度
+static const size_t FRAME_HEADER_LEN = 9;
+// 帧的标志位
+static const uint8_t FLAG_END_STREAM = 0x1;
+static const uint8_t FLAG_ACK = 0x1;
+static const uint8_t FLAG_END_HEADERS = 0x4;
+static const uint8_t FLAG_PADDED = 0x8;
+static const uint8_t FLAG_PRIORITY = 0x20;
+// 流量控制窗口的上限和初始值，帧负载长度的默认值和上限
+static const int64_t MAX_WINDOW = 0x7fffffff;
+static const uint32_t DEFAULT_WINDOW = 65535;
+static const uint32_t DEFAULT_MAX_FRAME = 16384;
+static const uint32_t MAX_FRAME_LIMIT = 16777215;
+
+// SETTINGS 帧中的参数
+enum SETTINGS_ID {
+    SETTINGS_HEADER_TABLE_SIZE = 0x1,
+    SETTINGS_ENABLE_PUSH = 0x2,
+    SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+    SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+    SETTINGS_MAX_FRAME_SIZE = 0x5,
+    SETTINGS_MAX_HEADER_LIST_SIZE = 0x6
+};
+
+static uint32_t read_u32(const uint8_t *p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+        (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+static void append_u32(Buffer &out, uint32_t v) {
+    char buf[4] = {
+        static_cast<char>(v >> 24), static_cast<char>(v >> 16),
+        static_cast<char>(v >> 8), static_cast<char>(v)
+    };
+    out.append(buf, sizeof(buf));
+}
+
+static void append_setting(Buffer &out, uint16_t id, uint32_t value) {
+    char buf[2] = {static_cast<char>(id >> 8), static_cast<char>(id)};
+    out.append(buf, sizeof(buf));
+    append_u32(out, value);
+}
+
+/**
+ * @brief 每个响应都不同的字段，加入动态表只会挤掉可以复用的条目
+*/
+static bool is_volatile_header(const std::string &name) {
+    return name == "content-length" || name == "etag" || name == "last-modified";
+}
+
+/**
+ * @brief 解码 base64url（不带填充），用于 HTTP2-Settings
+*/
+static bool base64url_decode(const std::string &in, std::string &out) {
+    uint32_t acc = 0;
+    int bits = 0;
+    for (char ch : in) {
+        int v;
+        if (ch >= 'A' && ch <= 'Z') v = ch - 'A';
+        else if (ch >= 'a' && ch <= 'z') v = ch - 'a' + 26;
+        else if (ch >= '0' && ch <= '9') v = ch - '0' + 52;
+        else if (ch == '-' || ch == '+') v = 62;
+        else if (ch == '_' || ch == '/') v = 63;
+        else if (ch == '=') break;
+        else return false;
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(acc >> bits));
+        }
+    }
+    return true;
+}
+
+Http2Limits::Http2Limits()
+: max_concurrent_streams(100), initial_window_size(DEFAULT_WINDOW),
+max_frame_size(DEFAULT_MAX_FRAME), header_table_size(4096), max_header_list_size(16384) {}
+
+Http2Stream::Http2Stream(uint32_t id_)
+: id(id_), remote_closed(false), send_window(0), recv_window(0), recv_consumed(0),
+status(200), body(nullptr), body_len(0), mm_file(nullptr), mm_len(0),
+responded(false), headers_sent(false), body_sent(0) {}
+
+Http2Stream::~Http2Stream() {
+    if (mm_file) {
+        munmap(mm_file, mm_len);
+    }
+}
+
+const std::string& Http2Stream::header(const char *name) const {
+    static const std::string EMPTY;
+    for (const auto &h : headers) {
+        if (h.first == name) return h.second;
+    }
+    return EMPTY;
+}
+
+Http2Session::Http2Session(Http2Handler *handler)
+: m_handler(handler), m_last_stream_id(0), m_next_send_id(0),
+m_preface_received(false), m_settings_received(false),
+m_send_window(DEFAULT_WINDOW), m_recv_window(DEFAULT_WINDOW), m_recv_consumed(0),
+m_peer_initial_window(DEFAULT_WINDOW), m_peer_max_frame(DEFAULT_MAX_FRAME),
+m_continuation_id(0), m_continuation_end(false),
+m_goaway_sent(false), m_goaway_received(false), m_error(NO_ERROR) {
+    m_decoder.set_max_table_size(limits.header_table_size);
+}
+
+void Http2Session::start(Buffer &out) {
+    write_settings(out);
+}
+
+bool Http2Session::upgrade(const std::string &settings, HpackHeaderList &&headers,
+    Buffer &out
+) {
+    // HTTP2-Settings 相当于客户端的第一个 SETTINGS 帧，101 响应就是对它的确认
+    std::string payload;
+    if (!base64url_decode(settings, payload) || payload.size() % 6 != 0 ||
+        apply_settings(reinterpret_cast<const uint8_t *>(payload.data()),
+            payload.size()) != NO_ERROR) {
+        return false;
+    }
+    write_settings(out);
+    std::unique_ptr<Http2Stream> stream(new Http2Stream(1));
+    stream->headers = std::move(headers);
+    stream->remote_closed = true;
+    stream->send_window = m_peer_initial_window;
+    m_last_stream_id = 1;
+    auto &s = *stream;
+    m_streams.emplace(1, std::move(stream));
+    dispatch(s);
+    return true;
+}
+
+bool Http2Session::receive(Buffer &in, Buffer &out) {
+    if (m_error != NO_ERROR) {
+        in.retrieve_all();
+        return false;
+    }
+    ERROR_CODE err = NO_ERROR;
+    if (!m_preface_received) {
+        size_t n = std::min(in.readable_bytes(), PREFACE_LEN);
+        if (std::memcmp(in.peek(), PREFACE, n) != 0) {
+            err = PROTOCOL_ERROR;
+        } else if (n < PREFACE_LEN) {
+            return true;
+        } else {
+            in.retrieve(PREFACE_LEN);
+            m_preface_received = true;
+        }
+    }
+    while (err == NO_ERROR && in.readable_bytes() >= FRAME_HEADER_LEN) {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(in.peek());
+        size_t len = (static_cast<size_t>(p[0]) << 16) | (p[1] << 8) | p[2];
+        uint8_t type = p[3], flags = p[4];
+        uint32_t id = read_u32(p + 5) & 0x7fffffff;
+        if (len > limits.max_frame_size) {
+            err = FRAME_SIZE_ERROR;
+            break;
+        }
+        if (in.readable_bytes() < FRAME_HEADER_LEN + len) {
+            break;
+        }
+        if (!m_settings_received && type != SETTINGS) {
+            // 连接序言之后的第一个帧必须是 SETTINGS
+            err = PROTOCOL_ERROR;
+            break;
+        }
+        err = on_frame(type, flags, id, p + FRAME_HEADER_LEN, len, out);
+        in.retrieve(FRAME_HEADER_LEN + len);
+    }
+    if (err != NO_ERROR) {
+        m_error = err;
+        write_goaway(err, out);
+        in.retrieve_all();
+        return false;
+    }
+    return true;
+}
+
+Http2Session::ERROR_CODE Http2Session::on_frame(uint8_t type, uint8_t flags, uint32_t id,
+    const uint8_t *p, size_t len, Buffer &out
+) {
+    if (m_continuation_id != 0 && type != CONTINUATION) {
+        // 头部块必须由连续的 HEADERS/CONTINUATION 帧组成
+        return PROTOCOL_ERROR;
+    }
+    switch (type) {
+    case DATA:
+        return on_data(flags, id, p, len, out);
+    case HEADERS:
+        return on_headers(flags, id, p, len, out);
+    case CONTINUATION:
+        return on_continuation(flags, id, p, len, out);
+    case PRIORITY:
+        // 不支持优先级，各个流轮流发送
+        if (id == 0) return PROTOCOL_ERROR;
+        if (len != 5) return FRAME_SIZE_ERROR;
+        return NO_ERROR;
+    case RST_STREAM:
+        if (id == 0 || id > m_last_stream_id) return PROTOCOL_ERROR;
+        if (len != 4) return FRAME_SIZE_ERROR;
+        close_stream(id);
+        return NO_ERROR;
+    case SETTINGS:
+        return on_settings(flags, id, p, len, out);
+    case PUSH_PROMISE:
+        // 客户端不能推送
+        return PROTOCOL_ERROR;
+    case PING:
+        if (id != 0) return PROTOCOL_ERROR;
+        if (len != 8) return FRAME_SIZE_ERROR;
+        if (!(flags & FLAG_ACK)) {
+            write_frame_header(out, 8, PING, FLAG_ACK, 0);
+            out.append(p, 8);
+        }
+        return NO_ERROR;
+    case GOAWAY:
+        if (id != 0) return PROTOCOL_ERROR;
+        if (len < 8) return FRAME_SIZE_ERROR;
+        m_goaway_received = true;
+        return NO_ERROR;
+    case WINDOW_UPDATE:
+        return on_window_update(id, p, len, out);
+    default:
+        // 未知类型的帧必须被忽略
+        return NO_ERROR;
+    }
+}
+
+Http2Session::ERROR_CODE Http2Session::on_data(uint8_t flags, uint32_t id, const uint8_t *p,
+    size_t len, Buffer &out
+) {
+    if (id == 0) return PROTOCOL_ERROR;
+    if (flags & FLAG_PADDED) {
+        if (len < 1 || p[0] >= len) return PROTOCOL_ERROR;
+    }
+    // 整个帧（包括填充）都计入流量控制
+    m_recv_window -= len;
+    if (m_recv_window < 0) return FLOW_CONTROL_ERROR;
+    // 请求体不交给处理者，收到后立即丢弃，所以窗口可以马上归还
+    m_recv_consumed += len;
+    if (m_recv_consumed >= DEFAULT_WINDOW / 2) {
+        write_window_update(0, m_recv_consumed, out);
+        m_recv_window += m_recv_consumed;
+        m_recv_consumed = 0;
+    }
+
+    auto it = m_streams.find(id);
+    if (it == m_streams.end()) {
+        // 已经关闭的流上仍在途中的数据，忽略
+        return id > m_last_stream_id ? PROTOCOL_ERROR : NO_ERROR;
+    }
+    auto &stream = *it->second;
+    if (stream.remote_closed) {
+        write_rst_stream(id, STREAM_CLOSED, out);
+        close_stream(id);
+        return NO_ERROR;
+    }
+    stream.recv_window -= len;
+    if (stream.recv_window < 0) {
+        write_rst_stream(id, FLOW_CONTROL_ERROR, out);
+        close_stream(id);
+        return NO_ERROR;
+    }
+    if (flags & FLAG_END_STREAM) {
+        stream.remote_closed = true;
+        dispatch(stream);
+        return NO_ERROR;
+    }
+    stream.recv_consumed += len;
+    if (stream.recv_consumed >= limits.initial_window_size / 2) {
+        write_window_update(id, stream.recv_consumed, out);
+        stream.recv_window += stream.recv_consumed;
+        stream.recv_consumed = 0;
+    }
+    return NO_ERROR;
+}
+
+Http2Session::ERROR_CODE Http2Session::on_headers(uint8_t flags, uint32_t id,
+    const uint8_t *p, size_t len, Buffer &out
+) {
+    if (id == 0) return PROTOCOL_ERROR;
+    size_t offset = 0, pad = 0;
+    if (flags & FLAG_PADDED) {
+        if (len < 1) return FRAME_SIZE_ERROR;
+        pad = p[0];
+        offset = 1;
+    }
+    if (flags & FLAG_PRIORITY) {
+        if (len < offset + 5) return FRAME_SIZE_ERROR;
+        offset += 5;
+    }
+    if (offset + pad > len) return PROTOCOL_ERROR;
+    if (m_streams.find(id) == m_streams.end()) {
+        if ((id & 1) == 0) {
+            // 客户端发起的流的标识符必须是奇数
+            return PROTOCOL_ERROR;
+        } else if (id <= m_last_stream_id) {
+            return STREAM_CLOSED;
+        }
+    }
+    m_header_block.assign(reinterpret_cast<const char *>(p + offset), len - offset - pad);
+    if (m_header_block.size() > limits.max_header_list_size) {
+        return ENHANCE_YOUR_CALM;
+    }
+    if (!(flags & FLAG_END_HEADERS)) {
+        m_continuation_id = id;
+        m_continuation_end = flags & FLAG_END_STREAM;
+        return NO_ERROR;
+    }
+    return on_header_block(id, flags & FLAG_END_STREAM, out);
+}
+
+Http2Session::ERROR_CODE Http2Session::on_continuation(uint8_t flags, uint32_t id,
+    const uint8_t *p, size_t len, Buffer &out
+) {
+    if (m_continuation_id == 0 || id != m_continuation_id) {
+        return PROTOCOL_ERROR;
+    }
+    m_header_block.append(reinterpret_cast<const char *>(p), len);
+    if (m_header_block.size() > limits.max_header_list_size) {
+        return ENHANCE_YOUR_CALM;
+    }
+    if (!(flags & FLAG_END_HEADERS)) {
+        return NO_ERROR;
+    }
+    m_continuation_id = 0;
+    return on_header_block(id, m_continuation_end, out);
+}
+
+Http2Session::ERROR_CODE Http2Session::on_header_block(uint32_t id, bool end_stream,
+    Buffer &out
+) {
+    // 不管流最终是否被接受，头部块都要解码，否则两端的动态表会不一致
+    HpackHeaderList headers;
+    if (!m_decoder.decode(reinterpret_cast<const uint8_t *>(m_header_block.data()),
+        m_header_block.size(), headers, limits.max_header_list_size)) {
+        return COMPRESSION_ERROR;
+    }
+    m_header_block.clear();
+
+    auto it = m_streams.find(id);
+    if (it != m_streams.end()) {
+        // 已经打开的流上的第二个头部块是尾部字段，必须结束这个流
+        auto &stream = *it->second;
+        if (stream.remote_closed || !end_stream) {
+            write_rst_stream(id, stream.remote_closed ? STREAM_CLOSED : PROTOCOL_ERROR, out);
+            close_stream(id);
+            return NO_ERROR;
+        }
+        stream.remote_closed = true;
+        dispatch(stream);
+        return NO_ERROR;
+    }
+
+    m_last_stream_id = id;
+    if (m_goaway_sent || m_goaway_received) {
+        write_rst_stream(id, REFUSED_STREAM, out);
+        return NO_ERROR;
+    }
+    if (m_streams.size() >= limits.max_concurrent_streams) {
+        write_rst_stream(id, REFUSED_STREAM, out);
+        return NO_ERROR;
+    }
+    if (!validate_request(headers)) {
+        write_rst_stream(id, PROTOCOL_ERROR, out);
+        return NO_ERROR;
+    }
+    std::unique_ptr<Http2Stream> stream(new Http2Stream(id));
+    stream->headers = std::move(headers);
+    stream->remote_closed = end_stream;
+    stream->send_window = m_peer_initial_window;
+    // 对端确认本端的 SETTINGS 之前，仍可能按默认的窗口发送
+    stream->recv_window = std::max(limits.initial_window_size, DEFAULT_WINDOW);
+    auto &s = *stream;
+    m_streams.emplace(id, std::move(stream));
+    if (end_stream) {
+        dispatch(s);
+    }
+    return NO_ERROR;
+}
+
+Http2Session::ERROR_CODE Http2Session::on_settings(uint8_t flags, uint32_t id,
+    const uint8_t *p, size_t len, Buffer &out
+) {
+    if (id != 0) return PROTOCOL_ERROR;
+    if (flags & FLAG_ACK) {
+        return len == 0 ? NO_ERROR : FRAME_SIZE_ERROR;
+    }
+    if (len % 6 != 0) return FRAME_SIZE_ERROR;
+    ERROR_CODE err = apply_settings(p, len);
+    if (err != NO_ERROR) return err;
+    m_settings_received = true;
+    write_frame_header(out, 0, SETTINGS, FLAG_ACK, 0);
+    return NO_ERROR;
+}
+
+Http2Session::ERROR_CODE Http2Session::apply_settings(const uint8_t *p, size_t len) {
+    for (size_t i=0; i+6<=len; i+=6) {
+        uint16_t id = (p[i] << 8) | p[i + 1];
+        uint32_t value = read_u32(p + i + 2);
+        switch (id) {
+        case SETTINGS_HEADER_TABLE_SIZE:
+            m_encoder.set_max_table_size(value);
+            break;
+        case SETTINGS_ENABLE_PUSH:
+            if (value > 1) return PROTOCOL_ERROR;
+            break;
+        case SETTINGS_INITIAL_WINDOW_SIZE: {
+            if (value > MAX_WINDOW) return FLOW_CONTROL_ERROR;
+            // 初始窗口的变化作用于所有已经打开的流
+            int64_t delta = static_cast<int64_t>(value) - m_peer_initial_window;
+            for (auto &it : m_streams) {
+                it.second->send_window += delta;
+                if (it.second->send_window > MAX_WINDOW) return FLOW_CONTROL_ERROR;
+            }
+            m_peer_initial_window = value;
+            break;
+        }
+        case SETTINGS_MAX_FRAME_SIZE:
+            if (value < DEFAULT_MAX_FRAME || value > MAX_FRAME_LIMIT) return PROTOCOL_ERROR;
+            m_peer_max_frame = value;
+            break;
+        default:
+            // 不限制并发的流数目（不推送），不关心对端的头部列表大小；未知的参数忽略
+            break;
+        }
+    }
+    return NO_ERROR;
+}
+
+Http2Session::ERROR_CODE Http2Session::on_window_update(uint32_t id, const uint8_t *p,
+    size_t len, Buffer &out
+) {
+    if (len != 4) return FRAME_SIZE_ERROR;
+    uint32_t increment = read_u32(p) & 0x7fffffff;
+    if (id == 0) {
+        if (increment == 0) return PROTOCOL_ERROR;
+        m_send_window += increment;
+        return m_send_window > MAX_WINDOW ? FLOW_CONTROL_ERROR : NO_ERROR;
+    }
+    auto it = m_streams.find(id);
+    if (it == m_streams.end()) {
+        return id > m_last_stream_id ? PROTOCOL_ERROR : NO_ERROR;
+    }
+    auto &stream = *it->second;
+    stream.send_window += increment;
+    if (increment == 0 || stream.send_window > MAX_WINDOW) {
+        write_rst_stream(id, increment == 0 ? PROTOCOL_ERROR : FLOW_CONTROL_ERROR, out);
+        close_stream(id);
+    }
+    return NO_ERROR;
+}
+
+bool Http2Session::validate_request(const HpackHeaderList &headers) {
+    bool has_method = false, has_scheme = false, has_path = false, regular = false;
+    for (const auto &h : headers) {
+        const auto &name = h.first;
+        if (name.empty()) return false;
+        if (name[0] == ':') {
+            // 伪头部必须在普通字段之前，且各自只能出现一次
+            bool *seen = nullptr;
+            if (name == ":method") seen = &has_method;
+            else if (name == ":scheme") seen = &has_scheme;
+            else if (name == ":path") seen = &has_path;
+            else if (name != ":authority") return false;
+            if (regular || (seen && *seen)) return false;
+            if (seen) *seen = true;
+            if (seen == &has_path && h.second.empty()) return false;
+            continue;
+        }
+        regular = true;
+        for (char ch : name) {
+            if (ch >= 'A' && ch <= 'Z') return false;
+        }
+        // HTTP/2 中不允许出现逐跳的字段
+        if (name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+            name == "transfer-encoding" || name == "upgrade" ||
+            (name == "te" && h.second != "trailers")) {
+            return false;
+        }
+    }
+    return has_method && has_scheme && has_path;
+}
+
+void Http2Session::dispatch(Http2Stream &stream) {
+    m_handler->on_request(stream);
+    stream.responded = true;
+}
+
+void Http2Session::send(Buffer &out, size_t high_water) {
+    // 响应头不受流量控制，生成后立即发送
+    for (auto it = m_streams.begin(); it != m_streams.end(); ) {
+        auto &stream = *it->second;
+        ++it;
+        if (stream.responded && !stream.headers_sent) {
+            write_headers(stream, out);
+            if (stream.body_len == 0) {
+                close_stream(stream.id);
+            }
+        }
+    }
+    // 响应体按轮转的方式切成 DATA 帧，每个流每轮最多发送一个帧
+    bool progress = true;
+    while (progress && !m_streams.empty() && out.readable_bytes() < high_water &&
+        m_send_window > 0) {
+        progress = false;
+        auto it = m_streams.lower_bound(m_next_send_id);
+        for (size_t n=m_streams.size(); n>0 && !m_streams.empty(); --n) {
+            if (out.readable_bytes() >= high_water || m_send_window <= 0) break;
+            if (it == m_streams.end()) it = m_streams.begin();
+            auto &stream = *it->second;
+            ++it;
+            if (!stream.headers_sent || stream.body_sent >= stream.body_len ||
+                stream.send_window <= 0) {
+                continue;
+            }
+            size_t chunk = std::min<int64_t>(std::min<int64_t>(
+                stream.body_len - stream.body_sent, m_peer_max_frame),
+                std::min(m_send_window, stream.send_window));
+            bool last = stream.body_sent + chunk == stream.body_len;
+            write_frame_header(out, chunk, DATA, last ? FLAG_END_STREAM : 0, stream.id);
+            out.append(stream.body + stream.body_sent, chunk);
+            stream.body_sent += chunk;
+            stream.send_window -= chunk;
+            m_send_window -= chunk;
+            m_next_send_id = it == m_streams.end() ? 0 : it->first;
+            progress = true;
+            if (last) {
+                close_stream(stream.id);
+            }
+        }
+    }
+}
+
+void Http2Session::shutdown(Buffer &out) {
+    if (!m_goaway_sent) {
+        write_goaway(NO_ERROR, out);
+    }
+}
+
+bool Http2Session::is_finished() const {
+    return m_error != NO_ERROR ||
+        ((m_goaway_sent || m_goaway_received) && m_streams.empty());
+}
+
+void Http2Session::close_stream(uint32_t id) {
+    m_streams.erase(id);
+}
+
+void Http2Session::write_settings(Buffer &out) {
+    write_frame_header(out, 4 * 6, SETTINGS, 0, 0);
+    append_setting(out, SETTINGS_MAX_CONCURRENT_STREAMS, limits.max_concurrent_streams);
+    append_setting(out, SETTINGS_INITIAL_WINDOW_SIZE, limits.initial_window_size);
+    append_setting(out, SETTINGS_MAX_FRAME_SIZE, limits.max_frame_size);
+    append_setting(out, SETTINGS_MAX_HEADER_LIST_SIZE, limits.max_header_list_size);
+}
+
+void Http2Session::write_headers(Http2Stream &stream, Buffer &out) {
+    static const std::string STATUS(":status");
+    m_scratch.clear();
+    m_encoder.begin(m_scratch);
+    m_encoder.encode(m_scratch, STATUS, std::to_string(stream.status), true);
+    for (const auto &h : stream.resp_headers) {
+        m_encoder.encode(m_scratch, h.first, h.second, !is_volatile_header(h.first));
+    }
+    // 头部块超过对端的帧长度上限时，其余部分放在 CONTINUATION 帧中
+    bool end_stream = stream.body_len == 0;
+    size_t offset = 0;
+    do {
+        size_t n = std::min<size_t>(m_scratch.size() - offset, m_peer_max_frame);
+        uint8_t flags = offset + n == m_scratch.size() ? FLAG_END_HEADERS : 0;
+        if (offset == 0 && end_stream) flags |= FLAG_END_STREAM;
+        write_frame_header(out, n, offset == 0 ? HEADERS : CONTINUATION, flags, stream.id);
+        out.append(m_scratch.data() + offset, n);
+        offset += n;
+    } while (offset < m_scratch.size());
+    stream.headers_sent = true;
+}
+
+void Http2Session::write_rst_stream(uint32_t id, ERROR_CODE code, Buffer &out) {
+    write_frame_header(out, 4, RST_STREAM, 0, id);
+    append_u32(out, code);
+}
+
+void Http2Session::write_window_update(uint32_t id, uint32_t increment, Buffer &out) {
+    write_frame_header(out, 4, WINDOW_UPDATE, 0, id);
+    append_u32(out, increment);
+}
+
+void Http2Session::write_goaway(ERROR_CODE code, Buffer &out) {
+    write_frame_header(out, 8, GOAWAY, 0, 0);
+    append_u32(out, m_last_stream_id);
+    append_u32(out, code);
+    m_goaway_sent = true;
+}
+
+void Http2Session::write_frame_header(Buffer &out, size_t len, uint8_t type, uint8_t flags,
+    uint32_t id
+) {
+    char buf[FRAME_HEADER_LEN] = {
+        static_cast<char>(len >> 16), static_cast<char>(len >> 8), static_cast<char>(len),
+        static_cast<char>(type), static_cast<char>(flags),
+        static_cast<char>(id >> 24), static_cast<char>(id >> 16),
+        static_cast<char>(id >> 8), static_cast<char>(id)
+    };
+    out.append(buf, sizeof(buf));
+}
@@ -0,0 +1,230 @@
+/**
+ * @file http2.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for HTTP/2 (RFC 7540) framing, streams and flow control
+*/
+#ifndef HTTP2_H
+#define HTTP2_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include "hpack.h"
+#include "../buffer/buffer.h"
+
+/**
+ * @brief 本端通过 SETTINGS 帧声明的参数
+*/
+struct Http2Limits {
+    uint32_t max_concurrent_streams;   // 同时打开的流的最大数目
+    uint32_t initial_window_size;      // 流的初始接收窗口
+    uint32_t max_frame_size;           // 接收的帧负载的最大长度
+    uint32_t header_table_size;        // 解码用的动态表的最大大小
+    uint32_t max_header_list_size;     // 解码后请求头的最大大小
+
+    Http2Limits();
+};
+
+/**
+ * @brief 一个 HTTP/2 流，即一对请求和响应
+*/
+struct Http2Stream {
+    explicit Http2Stream(uint32_t id_);
+    ~Http2Stream();
+    Http2Stream(const Http2Stream&) = delete;
+    Http2Stream& operator=(const Http2Stream&) = delete;
+
+    /**
+     * @brief 请求头（包括伪头部）中某个字段的值，不存在时返回空串
+    */
+    const std::string& header(const char *name) const;
+
+    uint32_t id;
+    HpackHeaderList headers;     // 请求头
+    bool remote_closed;          // 对端是否已经发送了 END_STREAM
+    int64_t send_window;         // 发送窗口
+    int64_t recv_window;         // 接收窗口
+    uint32_t recv_consumed;      // 已经消费但还没有通过 WINDOW_UPDATE 归还的字节数
+
+    // 响应，由 Http2Handler 填写
+    int status;
+    HpackHeaderList resp_headers;  // 除 :status 之外的响应头
+    const char *body;              // 响应体，指向 mm_file 或者常驻内存的数据
+    size_t body_len;
+    char *mm_file;                 // 响应的文件映射，流关闭时释放
+    size_t mm_len;
+
+    bool responded;              // 响应是否已经生成
+    bool headers_sent;           // 响应头是否已经发送
+    size_t body_sent;            // 已经发送的响应体字节数
+};
+
+/**
+ * @brief 请求的处理者，请求接收完整后（收到 END_STREAM）被调用，负责填写响应
+*/
+class Http2Handler {
+public:
+    virtual ~Http2Handler() = default;
+    virtual void on_request(Http2Stream &stream) = 0;
+};
+
+/**
+ * @brief 一个 HTTP/2 连接的协议状态
+ *
+ * 只处理字节流：从输入缓冲区中取出完整的帧进行处理，把要发送的帧追加到输出缓冲区，
+ * 不直接读写 socket。多个流的响应体按轮转的方式切成 DATA 帧交错发送，
+ * 受连接和流两级发送窗口的限制
+*/
+class Http2Session {
+public:
+    enum ERROR_CODE {
+        NO_ERROR = 0x0,
+        PROTOCOL_ERROR = 0x1,
+        INTERNAL_ERROR = 0x2,
+        FLOW_CONTROL_ERROR = 0x3,
+        SETTINGS_TIMEOUT = 0x4,
+        STREAM_CLOSED = 0x5,
+        FRAME_SIZE_ERROR = 0x6,
+        REFUSED_STREAM = 0x7,
+        CANCEL = 0x8,
+        COMPRESSION_ERROR = 0x9,
+        CONNECT_ERROR = 0xa,
+        ENHANCE_YOUR_CALM = 0xb,
+        INADEQUATE_SECURITY = 0xc,
+        HTTP_1_1_REQUIRED = 0xd
+    };
+
+    static const char PREFACE[];           // 客户端的连接序言
+    static const size_t PREFACE_LEN = 24;
+    static Http2Limits limits;
+
+    explicit Http2Session(Http2Handler *handler);
+
+    /**
+     * @brief 开始会话（prior knowledge 方式），输出服务器的 SETTINGS 帧
+    */
+    void start(Buffer &out);
+
+    /**
+     * @brief 从 HTTP/1.1 升级 (Upgrade: h2c)，输出服务器的 SETTINGS 帧，
+     * 升级请求本身成为已经接收完整的流 1
+     * @param settings HTTP2-Settings 头部的值（base64url 编码的 SETTINGS 负载）
+     * @param headers 升级请求转换成的 HTTP/2 请求头
+     * @return HTTP2-Settings 是否合法
+    */
+    bool upgrade(const std::string &settings, HpackHeaderList &&headers, Buffer &out);
+
+    /**
+     * @brief 处理输入缓冲区中所有完整的帧，控制帧的应答追加到 out
+     * @return 是否没有发生连接错误；出错时 GOAWAY 已经追加到 out
+    */
+    bool receive(Buffer &in, Buffer &out);
+
+    /**
+     * @brief 把已经生成的响应编码成 HEADERS 和 DATA 帧，直到 out 中的数据达到 high_water
+     * 或者没有可以发送的数据（窗口耗尽）
+    */
+    void send(Buffer &out, size_t high_water);
+
+    /**
+     * @brief 优雅关闭：发送 GOAWAY，不再接受新的流，已有的流照常完成
+    */
+    void shutdown(Buffer &out);
+
+    /**
+     * @brief 连接是否可以关闭：发生了连接错误，或者某一端已发送 GOAWAY 且所有的流都已结束
+    */
+    bool is_finished() const;
+
+    /**
+     * @brief 是否有已经打开、尚未结束的流
+    */
+    bool has_streams() const { return !m_streams.empty(); }
+
+    /**
+     * @brief 导致连接关闭的错误码
+    */
+    uint32_t get_error() const { return m_error; }
+
+private:
+    enum FRAME_TYPE {
+        DATA = 0x0,
+        HEADERS = 0x1,
+        PRIORITY = 0x2,
+        RST_STREAM = 0x3,
+        SETTINGS = 0x4,
+        PUSH_PROMISE = 0x5,
+        PING = 0x6,
+        GOAWAY = 0x7,
+        WINDOW_UPDATE = 0x8,
+        CONTINUATION = 0x9
+    };
+
+    /**
+     * @brief 处理一个帧
+     * @return 连接错误的错误码，没有错误时为 NO_ERROR
+    */
+    ERROR_CODE on_frame(uint8_t type, uint8_t flags, uint32_t id, const uint8_t *p,
+        size_t len, Buffer &out);
+    ERROR_CODE on_data(uint8_t flags, uint32_t id, const uint8_t *p, size_t len, Buffer &out);
+    ERROR_CODE on_headers(uint8_t flags, uint32_t id, const uint8_t *p, size_t len, Buffer &out);
+    ERROR_CODE on_continuation(uint8_t flags, uint32_t id, const uint8_t *p, size_t len,
+        Buffer &out);
+    ERROR_CODE on_header_block(uint32_t id, bool end_stream, Buffer &out);
+    ERROR_CODE on_settings(uint8_t flags, uint32_t id, const uint8_t *p, size_t len,
+        Buffer &out);
+    ERROR_CODE apply_settings(const uint8_t *p, size_t len);
+    ERROR_CODE on_window_update(uint32_t id, const uint8_t *p, size_t len, Buffer &out);
+
+    /**
+     * @brief 请求已接收完整，交给处理者生成响应
+    */
+    void dispatch(Http2Stream &stream);
+
+    /**
+     * @brief 检查请求头是否符合 HTTP/2 的要求
+    */
+    static bool validate_request(const HpackHeaderList &headers);
+
+    void write_settings(Buffer &out);
+    void write_headers(Http2Stream &stream, Buffer &out);
+    void write_rst_stream(uint32_t id, ERROR_CODE code, Buffer &out);
+    void write_window_update(uint32_t id, uint32_t increment, Buffer &out);
+    void write_goaway(ERROR_CODE code, Buffer &out);
+    static void write_frame_header(Buffer &out, size_t len, uint8_t type, uint8_t flags,
+        uint32_t id);
+
+    /**
+     * @brief 关闭一个流：对端发送了 RST_STREAM，或者双方都已发送了 END_STREAM
+    */
+    void close_stream(uint32_t id);
+
+    Http2Handler *m_handler;
+    std::map<uint32_t, std::unique_ptr<Http2Stream>> m_streams;  // 打开的流
+    uint32_t m_last_stream_id;     // 对端发起的最大的流标识符
+    uint32_t m_next_send_id;       // 下一轮发送从这个流开始，保证各个流轮流发送
+    bool m_preface_received;       // 是否收到了客户端的连接序言
+    bool m_settings_received;      // 是否收到了客户端的第一个 SETTINGS 帧
+
+    int64_t m_send_window;         // 连接级的发送窗口
+    int64_t m_recv_window;         // 连接级的接收窗口
+    uint32_t m_recv_consumed;      // 连接级已经消费但还没有归还的字节数
+    int64_t m_peer_initial_window; // 对端声明的流的初始窗口
+    uint32_t m_peer_max_frame;     // 对端能够接收的帧负载的最大长度
+
+    uint32_t m_continuation_id;    // 正在等待 CONTINUATION 帧的流，0 表示没有
+    bool m_continuation_end;       // 该头部块所属的 HEADERS 帧是否带有 END_STREAM
+    std::string m_header_block;    // 正在接收的头部块
+    std::string m_scratch;         // 编码响应头用的临时缓冲区
+
+    HpackDecoder m_decoder;
+    HpackEncoder m_encoder;
+
+    bool m_goaway_sent;
+    bool m_goaway_received;
+    uint32_t m_error;
+};
+
+#endif // HTTP2_H
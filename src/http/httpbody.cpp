@@ -0,0 +1,210 @@
+/**
+ * @file httpbody.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for streaming request body
+*/
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include "httpbody.h"
+
+// 尾部字段的最大总长度
+static const size_t MAX_TRAILER_BYTES = 8192;
+
+
+FileSpool::FileSpool() : m_fd(-1), m_pipe{-1, -1}, m_size(0) {}
+
+FileSpool::~FileSpool() {
+    close();
+}
+
+bool FileSpool::open(const std::string &dir) {
+    close();
+#ifdef O_TMPFILE
+    m_fd = ::open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+    if (m_fd < 0) {
+        // 文件系统不支持 O_TMPFILE
+        std::string tmpl = dir + "/yawn-body-XXXXXX";
+        m_fd = mkostemp(&tmpl[0], O_CLOEXEC);
+        if (m_fd < 0) return false;
+        unlink(tmpl.c_str());
+    }
+    return true;
+}
+
+bool FileSpool::write(const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(m_fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+        m_size += n;
+    }
+    return true;
+}
+
+ssize_t FileSpool::splice_from(int sock_fd, size_t len, int *saved_errno) {
+    if (m_pipe[0] < 0 && pipe2(m_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        *saved_errno = errno;
+        return -1;
+    }
+    ssize_t in = splice(sock_fd, nullptr, m_pipe[1], nullptr, len,
+        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (in <= 0) {
+        *saved_errno = errno;
+        return in;
+    }
+    // 管道中的数据全部转移到文件后才返回，保证管道在两次调用之间是空的
+    ssize_t left = in;
+    while (left > 0) {
+        ssize_t out = splice(m_pipe[0], nullptr, m_fd, nullptr, left, SPLICE_F_MOVE);
+        if (out < 0) {
+            if (errno == EINTR) continue;
+            *saved_errno = errno;
+            return -1;
+        }
+        left -= out;
+    }
+    m_size += in;
+    return in;
+}
+
+bool FileSpool::finish() {
+    return lseek(m_fd, 0, SEEK_SET) == 0;
+}
+
+void FileSpool::close() {
+    for (int &fd : m_pipe) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_size = 0;
+}
+
+void ChunkedDecoder::reset() {
+    m_state = SIZE;
+    m_chunk_size = 0;
+    m_size_digits = 0;
+    m_trailer_bytes = 0;
+}
+
+ChunkedDecoder::RESULT ChunkedDecoder::feed(
+    const char *data, size_t len, size_t &consumed, BodySink &sink
+) {
+    const char *p = data, *end = data + len;
+    RESULT res = NEED_MORE;
+    while (p < end && res == NEED_MORE) {
+        char ch = *p;
+        switch (m_state) {
+        case SIZE: {
+            int digit = -1;
+            if (ch >= '0' && ch <= '9') digit = ch - '0';
+            else if (ch >= 'a' && ch <= 'f') digit = ch - 'a' + 10;
+            else if (ch >= 'A' && ch <= 'F') digit = ch - 'A' + 10;
+            if (digit >= 0) {
+                // 最多 15 位十六进制数，避免溢出
+                if (++m_size_digits > 15) {
+                    res = ERROR;
+                    break;
+                }
+                m_chunk_size = (m_chunk_size << 4) | digit;
+            } else if (m_size_digits == 0) {
+                res = ERROR;
+                break;
+            } else if (ch == ';' || ch == ' ' || ch == '\t') {
+                m_state = EXT;
+            } else if (ch == '\r') {
+                m_state = SIZE_LF;
+            } else {
+                res = ERROR;
+                break;
+            }
+            ++p;
+            break;
+        }
+        case EXT:
+            if (ch == '\r') m_state = SIZE_LF;
+            ++p;
+            break;
+        case SIZE_LF:
+            if (ch != '\n') {
+                res = ERROR;
+                break;
+            }
+            m_state = m_chunk_size == 0 ? TRAILER_START : DATA;
+            ++p;
+            break;
+        case DATA: {
+            size_t n = static_cast<size_t>(end - p);
+            if (n > m_chunk_size) n = m_chunk_size;
+            if (!sink.write(p, n)) {
+                res = ERROR;
+                break;
+            }
+            p += n;
+            m_chunk_size -= n;
+            if (m_chunk_size == 0) m_state = DATA_CR;
+            break;
+        }
+        case DATA_CR:
+            if (ch != '\r') {
+                res = ERROR;
+                break;
+            }
+            m_state = DATA_LF;
+            ++p;
+            break;
+        case DATA_LF:
+            if (ch != '\n') {
+                res = ERROR;
+                break;
+            }
+            m_state = SIZE;
+            m_size_digits = 0;
+            ++p;
+            break;
+        case TRAILER_START:
+            m_state = ch == '\r' ? END_LF : TRAILER;
+            ++p;
+            break;
+        case TRAILER:
+            if (ch == '\r') m_state = TRAILER_LF;
+            ++p;
+            break;
+        case TRAILER_LF:
+            if (ch != '\n') {
+                res = ERROR;
+                break;
+            }
+            m_state = TRAILER_START;
+            ++p;
+            break;
+        case END_LF:
+            if (ch != '\n') {
+                res = ERROR;
+                break;
+            }
+            ++p;
+            res = DONE;
+            break;
+        }
+        if (m_state >= TRAILER_START && res == NEED_MORE &&
+            ++m_trailer_bytes > MAX_TRAILER_BYTES) {
+            res = ERROR;
+        }
+    }
+    consumed = p - data;
+    return res;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file httpbody.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for streaming request body
+*/
+#ifndef HTTPBODY_H
+#define HTTPBODY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @brief 请求体的接收端
+ *
+ * 请求体不再整体缓存后一次性交付，而是在数据到达（并解码）后逐块交给接收端处理
+*/
+class BodySink {
+public:
+    virtual ~BodySink() = default;
+
+    /**
+     * @brief 处理一块请求体数据
+     * @param data 数据的起始地址
+     * @param len 数据长度（单位为字节）
+     * @return 是否处理成功，失败时请求被中止
+    */
+    virtual bool write(const char *data, size_t len) = 0;
+
+    /**
+     * @brief 请求体接收完毕
+     * @return 是否处理成功
+    */
+    virtual bool finish() { return true; }
+};
+
+/**
+ * @brief 把请求体暂存到磁盘上的匿名临时文件中
+ *
+ * 文件以 `O_TMPFILE` 创建（不支持时退化为 `mkstemp` + `unlink`），关闭后自动删除。
+ * 长度已知的请求体可以通过 `splice_from()` 经由管道从 socket 直接搬运到文件，
+ * 数据不经过用户态缓冲区
+*/
+class FileSpool : public BodySink {
+public:
+    FileSpool();
+    ~FileSpool();
+
+    FileSpool(const FileSpool &) = delete;
+    FileSpool& operator=(const FileSpool &) = delete;
+
+    /**
+     * @brief 在指定目录中创建临时文件
+     * @param dir 目录
+     * @return 是否创建成功
+    */
+    bool open(const std::string &dir);
+
+    bool write(const char *data, size_t len) override;
+
+    /**
+     * @brief 从 socket 中搬运最多 `len` 字节到文件中（零拷贝）
+     * @param sock_fd 非阻塞的 socket
+     * @param len 最多搬运的字节数
+     * @param saved_errno 出错时保存错误码
+     * @return 搬运的字节数，0 表示对端关闭，小于 0 表示出错（包括 EAGAIN）
+    */
+    ssize_t splice_from(int sock_fd, size_t len, int *saved_errno);
+
+    /**
+     * @brief 把文件的读写位置移回开头，供处理请求体的代码读取
+    */
+    bool finish() override;
+
+    void close();
+
+    int get_fd() const { return m_fd; }
+    size_t size() const { return m_size; }
+
+private:
+    int m_fd;         // 临时文件
+    int m_pipe[2];    // splice 使用的管道，首次使用时创建
+    size_t m_size;    // 已写入的字节数
+};
+
+/**
+ * @brief `Transfer-Encoding: chunked` 的增量解码器
+ *
+ * 每次喂入任意长度的数据，解出的数据块交给 BodySink；
+ * 数据可以在任意位置被截断，解码器会记住当前所处的位置
+ * @code
+ * chunked-body = *chunk last-chunk trailer-section CRLF
+ * chunk        = chunk-size [ chunk-ext ] CRLF chunk-data CRLF
+ * last-chunk   = 1*("0") [ chunk-ext ] CRLF
+ * @endcode
+*/
+class ChunkedDecoder {
+public:
+    enum RESULT {
+        NEED_MORE,  // 数据不完整，等待更多数据
+        DONE,       // 解码完成（已读到结尾的空行）
+        ERROR       // 格式错误或接收端出错
+    };
+
+    ChunkedDecoder() { reset(); }
+
+    void reset();
+
+    /**
+     * @brief 解码一段数据
+     * @param data 数据的起始地址
+     * @param len 数据长度（单位为字节）
+     * @param consumed 被消费的字节数，解码完成时之后的数据属于下一个请求
+     * @param sink 解出的数据块交给它处理
+     * @return 解码结果
+    */
+    RESULT feed(const char *data, size_t len, size_t &consumed, BodySink &sink);
+
+private:
+    enum STATE {
+        SIZE,           // 块大小（十六进制）
+        EXT,            // 块扩展，忽略
+        SIZE_LF,        // 块大小所在行的 LF
+        DATA,           // 块数据
+        DATA_CR,        // 块数据之后的 CR
+        DATA_LF,        // 块数据之后的 LF
+        TRAILER_START,  // 尾部字段行的开头
+        TRAILER,        // 尾部字段，忽略
+        TRAILER_LF,     // 尾部字段行的 LF
+        END_LF          // 结尾空行的 LF
+    };
+
+    STATE m_state;
+    uint64_t m_chunk_size;    // 当前块的大小
+    int m_size_digits;        // 块大小的位数
+    size_t m_trailer_bytes;   // 尾部字段的总长度
+};
+
+#endif // HTTPBODY_H
@@ -4,110 +4,130 @@
  * @date 2024-03-30
  * @brief source file for http connection
 */
+#include <cerrno>
 #include <cstring>
+#include <cstdlib>
 #include <cassert>
+#include <algorithm>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
 #include <fcntl.h>
 #include "httpconn.h"
 #include "../log/log.h"
 #include "../version.h"
+#include "../socket/sockopts.h"
+#include "responsewriter.h"
+#include "mimetype.h"
+#include "../pool/asyncsqlpool.h"
+#include "../user/regbatcher.h"
 
 
-using std::regex;
-using std::regex_match;
-using std::smatch;
-
 std::string HttpConn::src_dir;
+const StaticBundle *HttpConn::bundle = nullptr;
+std::string HttpConn::spool_dir;
 bool HttpConn::is_ET;
+bool HttpConn::use_cork;
+bool HttpConn::enable_h2;
+bool HttpConn::enable_db;
 std::atomic<int> HttpConn::conn_count;
+std::atomic<bool> HttpConn::draining(false);
+RcuPtr<ConnLimits> HttpConn::limits;
+
+// 请求之间分配区和读写缓冲区最多保留的容量，超出部分归还给系统
+static const size_t ARENA_RETAIN_BYTES = 64 * 1024;
+static const size_t BUFFER_RETAIN_BYTES = 64 * 1024;
+// 一个请求最多上传的文件数目
+static const size_t MAX_UPLOAD_FILES = 16;
+// HTTP/2 每次最多生成的待发送数据，写完之后再继续生成，多个流的数据在其中交错
+static const size_t H2_OUTPUT_BYTES = 64 * 1024;
 
 /**
- * 匹配 HTTP 请求行的正则表达式 
- * Request-Line   = Method SP Request-URI SP HTTP-Version CRLF 
- * HTTP-Version   = "HTTP" "/" 1*DIGIT "." 1*DIGIT
+ * @brief 从请求目标中取出路径：去掉查询串并解码 %XX，"/" 映射到首页；
+ *        HTTP/1.x 的请求行和 HTTP/2 的 :path 共用
 */
-const regex HttpConn::re_requestline("^([^ ]*) ([^ ]*) HTTP/(\\d+\\.\\d+)$");
+template <typename String>
+static void decode_path(const char *uri, size_t len, String &path) {
+    len = std::find(uri, uri + len, '?') - uri;
+    path.reserve(len);
+    for (size_t i=0; i<len; ++i) {
+        if (uri[i] == '%' && i + 2 < len) {
+            path.push_back(hexch2dec(uri[i+1])*16 + hexch2dec(uri[i+2]));
+            i += 2;
+        } else {
+            path.push_back(uri[i]);
+        }
+    }
+    if (path == "/") {
+        path.assign("/index.html");
+    }
+}
 
 /**
- * 匹配消息头部的正则表达式
- * Each header field consists of a name followed by a colon (":") and 
- * the field value. Field names are case-insensitive. The field value MAY 
- * be preceded by any amount of LWS, though a single SP is preferred.
- * 
- * message-header = field-name ":" [ field-value ]
- * field-name     = token
- * field-value    = *( field-content | LWS )
- * field-content  = <the OCTETs making up the field-value
- *                  and consisting of either *TEXT or combinations
- *                  of token, separators, and quoted-string>
+ * @brief 受保护的页面是否缺少有效的会话，需要重定向到登录页面
 */
-const regex HttpConn::re_header("^([^:]*):[ \t]*(.*)$");
-
-const std::unordered_map<std::string, std::string> HttpConn::SUFFIX_TYPE = {
-    { ".html",  "text/html" },
-    { ".xml",   "text/xml" },
-    { ".xhtml", "application/xhtml+xml" },
-    { ".txt",   "text/plain" },
-    { ".rtf",   "application/rtf" },
-    { ".pdf",   "application/pdf" },
-    { ".doc",   "application/msword" },
-    { ".docx",  "application/vnd.openxmlformats-officedocument.wordprocessingml.document"},
-    { ".xls",   "application/vnd.ms-excel"},
-    { ".xlsx",  "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"},
-    { ".ppt",   "application/vnd.ms-powerpoint"},
-    { ".pptx",  "application/vnd.openxmlformats-officedocument.presentationml.presentation"},
-    { ".ico",   "image/vnd.microsoft.icon"},
-    { ".tif",   "image/tiff"},
-    { ".tiff",  "image/tiff"},
-    { ".svg",   "image/svg+xml"},
-    { ".png",   "image/png" },
-    { ".webp",  "image/webp"},
-    { ".gif",   "image/gif" },
-    { ".jpg",   "image/jpeg" },
-    { ".jpeg",  "image/jpeg" },
-    { ".mp3",   "audio/mpeg"},
-    { ".mpeg",  "video/mpeg"},
-    { ".mpv",   "video/mpv" },
-    { ".mp4",   "video/mp4" },
-    { ".avi",   "video/x-msvideo" },
-    { ".gz",    "application/x-gzip" },
-    { ".tar",   "application/x-tar" },
-    { ".rar",   "application/vnd.rar"},
-    { ".7z",    "application/x-7z-compressed"},
-    { ".css",   "text/css "},
-    { ".js",    "text/javascript "},
-    { ".json",  "application/json"},
-    { ".woff",  "font/woff"},
-    { ".woff2", "font/woff2"},
-    { ".ttf",   "font/ttf"},
-    { ".otf",   "font/otf"},
-    { ".eot",   "application/vnd.ms-fontobject"}
-};
-
-const std::unordered_map<int,std::string> HttpConn::STATUS_TEXT {
-    {200, "OK"},
-    {304, "Not Modified"},
-    {400, "Bad Request"},
-    {403, "Forbidden"},
-    {404, "Not Found"},
-    {500, "Internal Server Error"},
-    {505, "HTTP Version Not Supported"}
-};
+static bool needs_login(const char *path, size_t len, const char *cookie, size_t cookie_len) {
+    SessionStore *sessions = SessionStore::get_instance();
+    if (!sessions->enabled() || !sessions->is_protected(path, len)) {
+        return false;
+    }
+    std::string sid = sessions->parse_cookie(cookie, cookie_len);
+    return sid.empty() || !sessions->lookup(sid);
+}
 
 /**
- * @todo 改为可配置的
+ * @brief 是否为 HTTP 定义的方法 (RFC 9110)：服务器只实现了 GET 和 HEAD，
+ *        其余已知的方法回复 405，不认识的方法回复 501
 */
-const std::unordered_map<int,std::string> HttpConn::CODE_PATH {
-    {400, "/400.html"},
-    {403, "/403.html"},
-    {404, "/404.html"},
-    {500, "/500.html"}
-};
-
-HttpConn::HttpConn(): fd(-1), is_close(true), iov_cnt(0), state(PARSE_STATE::REQUEST_LINE) {
+static bool is_known_method(const char *method, size_t len) {
+    static const char *METHODS[] = {
+        "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH"
+    };
+    for (const char *name : METHODS) {
+        if (len == std::strlen(name) && std::memcmp(method, name, len) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 在打包的静态资源中查找路径，按 Accept-Encoding 选择编码
+ * @param enc 选择的编码
+ * @param not_modified If-None-Match 与所选编码的 ETag 相同，可以回复 304
+ * @return 打包的文件，没有打包这个路径时返回空
+*/
+static const StaticBundle::File* find_bundled(const char *path, size_t len,
+    const char *accept, size_t accept_len, const char *etag, size_t etag_len,
+    BUNDLE_ENCODING &enc, bool &not_modified
+) {
+    const StaticBundle::File *file = HttpConn::bundle ? HttpConn::bundle->find(path, len) : nullptr;
+    if (!file) {
+        return nullptr;
+    }
+    enc = StaticBundle::negotiate(*file, accept, accept_len);
+    not_modified = etag_len == file->etag_len[enc] &&
+        std::memcmp(etag, file->etag[enc], etag_len) == 0;
+    return file;
+}
+
+ConnLimits::ConnLimits()
+: header_timeout(0), body_timeout(0), send_timeout(0), process_timeout(0),
+min_recv_rate(0), min_send_rate(0), rate_grace(0),
+max_request_line(0), max_header_size(0), max_body_size(0), body_buffer_size(0),
+keepalive_timeout(0), keepalive_requests(0) {}
+
+HttpConn::HttpConn()
+: last_active(0), fd(-1), is_close(true), is_corked(false), iov_cnt(0),
+state(PARSE_STATE::REQUEST_LINE), err_code(400), header_bytes(0), keep_alive(false),
+is_deferred(false), work_class(WORK_STATIC), request_cnt(0),
+body_mode(BODY_NONE), body_remaining(0), body_received(0), body_sink(this),
+is_multipart(false), form_handler(this), upload_cnt(0), cur_file(nullptr),
+cur_field(nullptr), h2_handler(this),
+phase(IDLE), phase_start(0), phase_bytes(0), mm_file(nullptr), bundled(nullptr),
+bundled_enc(BUNDLE_IDENTITY), worker_owned(false), request(&arena), response(&arena) {
     bzero(ip, sizeof(ip));
     bzero(&addr, sizeof(addr));
+    bzero(iov, sizeof(iov));
     std::memset(&mm_file_stat, '\0', sizeof(mm_file_stat));
 }
 
@@ -115,7 +135,7 @@ HttpConn::~HttpConn() {
     close_conn();
 }
 
-void HttpConn::init(int sock_fd, const sockaddr_in &addr_) {
+void HttpConn::init(int sock_fd, const sockaddr_in &addr_, const TlsContext *tls_ctx) {
     assert(sock_fd > 0);
     fd = sock_fd;
     addr = addr_;
@@ -123,12 +143,27 @@ void HttpConn::init(int sock_fd, const sockaddr_in &addr_) {
     write_buf.retrieve_all();
     read_buf.retrieve_all();
     is_close = false;
+    is_corked = false;
+    worker_owned = false;
+    // 握手消息写完之后连接要继续处理请求，而不是被当作响应结束而关闭
+    tls.reset(tls_ctx ? new TlsConn(*tls_ctx, fd) : nullptr);
+    keep_alive = tls != nullptr;
+    is_deferred = false;
+    work_class = WORK_STATIC;
+    request_cnt = 0;
     LOG_INFO("<client %d, %s:%d> connected! Connection Count: %d", fd, get_ip(),
         get_port(), conn_count.load());
 }
 
 void HttpConn::close_conn() {
     unmap_file();
+    h2.reset();
+    if (spool) {
+        spool->close();
+    }
+    for (auto &upload : uploads) {
+        upload->close();
+    }
     if (!is_close) {
         is_close = true;
         --conn_count;
@@ -138,31 +173,92 @@ void HttpConn::close_conn() {
     }
 }
 
+bool HttpConn::handshake(int *save_errno) {
+    auto res = tls->handshake();
+    if (res == TlsConn::DONE) {
+        LOG_DEBUG("<client %d> %s %s, resumed: %s, alpn: %s, kTLS tx/rx: %d/%d", fd,
+            tls->version(), tls->cipher(), (tls->session_reused() ? "true" : "false"),
+            tls->alpn().c_str(), tls->ktls_send(), tls->ktls_recv());
+        return true;
+    }
+    if (res == TlsConn::FAILED) {
+        LOG_DEBUG("<client %d, %s:%d> TLS handshake failed: %s", fd, get_ip(), get_port(),
+            TlsContext::last_error().c_str());
+        keep_alive = false;
+        *save_errno = EPROTO;
+    } else {
+        *save_errno = EAGAIN;
+    }
+    return false;
+}
+
 ssize_t HttpConn::read(int *save_errno) {
     ssize_t len = -1, total_len = 0;
+    if (tls && !tls->is_established()) {
+        if (phase == IDLE) {
+            // 握手计入第一个请求的请求头期限，慢速握手不能无限占用连接
+            set_phase(RECV_HEADER);
+        }
+        if (!handshake(save_errno)) return -1;
+    }
+    // 请求头最多需要缓存的字节数，请求体在解析时被逐块取走，只需再留出一次读取的量；
+    // 超过后先停止读取，剩余的数据留在内核中，重新注册 EPOLLIN 时仍会触发事件
+    const size_t buf_limit = limits->max_request_line + limits->max_header_size + 65536;
     do {
-        len = read_buf.read_fd(fd, save_errno);
+        if (tls) {
+            len = tls->read(read_buf, save_errno);
+        } else if (state == PARSE_STATE::BODY && body_mode == BODY_LENGTH &&
+            body_remaining > 0 && spool && spool->get_fd() >= 0 &&
+            read_buf.readable_bytes() == 0) {
+            // 大请求体经由管道从 socket 直接搬运到临时文件，不经过读缓冲区
+            len = spool->splice_from(fd, body_remaining, save_errno);
+            if (len > 0) {
+                body_remaining -= len;
+                body_received += len;
+            }
+        } else {
+            len = read_buf.read_fd(fd, save_errno);
+        }
         if (len < 0) {
-            return len;
+            break;
         } else if (len == 0) {
             break;
         }
         total_len += len;
-    } while (is_ET);
-    return total_len;
+    } while (is_ET && read_buf.readable_bytes() < buf_limit);
+
+    if (total_len > 0) {
+        if (phase == IDLE) {
+            // 新请求的数据开始到达，请求头的计时从此刻开始
+            set_phase(RECV_HEADER);
+        } else if (phase == RECV_BODY) {
+            phase_bytes += total_len;
+        }
+    }
+    return len < 0 && total_len == 0 ? len : total_len;
 }
 
 ssize_t HttpConn::write(int *save_errno) {
     ssize_t len = -1, total_len = 0;
+    if (tls && !tls->is_established() && !handshake(save_errno)) {
+        // 握手的输出曾被阻塞，由写事件继续握手
+        return -1;
+    }
+    if (use_cork && iov_cnt > 1 && !is_corked) {
+        // 响应头和文件内容分两段发送时，先塞住连接，
+        // 保证只发出满载的报文段，直到整个响应写完才拔掉“塞子”
+        is_corked = set_tcp_cork(fd, true);
+    }
     do {
         // it is not an error for a successful call to transfer fewer bytes 
         // than requested
-        len = writev(fd, iov, iov_cnt);
+        len = tls ? tls->writev(iov, iov_cnt) : writev(fd, iov, iov_cnt);
         if (len < 0) {
             *save_errno = errno;
             return len;
         }
         total_len += len;
+        phase_bytes += len;
         if (len == 0 && iov[0].iov_len + iov[1].iov_len == 0) {
             break;
         } else if (static_cast<size_t>(len) > iov[0].iov_len) {
@@ -181,18 +277,56 @@ ssize_t HttpConn::write(int *save_errno) {
         }
     } while (is_ET || to_write_bytes());
 
+    if (is_corked && to_write_bytes() == 0) {
+        set_tcp_cork(fd, false);
+        is_corked = false;
+    }
+    if (tls && !keep_alive && to_write_bytes() == 0) {
+        // 最后一个响应已经写完，连接随后被关闭
+        tls->shutdown();
+    }
     return total_len;
 }
 
 bool HttpConn::is_keep_alive() const {
-    auto target = request.headers.find("connection");
-    return (
-        target != request.headers.end() && 
-        str_lower(target->second) == "keep-alive");
+    return keep_alive;
+}
+
+/**
+ * @brief 判断以逗号分隔的字段值中是否包含某个选项（忽略大小写）
+*/
+static bool has_token(const ArenaString &value, const char *token) {
+    const char *p = value.data(), *end = p + value.size();
+    while (p < end) {
+        const char *comma = std::find(p, end, ',');
+        const char *q = comma;
+        while (p < q && (*p == ' ' || *p == '\t')) ++p;
+        while (q > p && (q[-1] == ' ' || q[-1] == '\t')) --q;
+        if (str_case_equal(p, q - p, token)) return true;
+        p = comma == end ? end : comma + 1;
+    }
+    return false;
+}
+
+bool HttpConn::decide_keep_alive() const {
+    if (state != PARSE_STATE::FINISH) {
+        // 请求没有被完整解析（出错或被拒绝），无法确定下一个请求的起始位置
+        return false;
+    }
+    if (draining.load(std::memory_order_relaxed) || limits->keepalive_timeout <= 0 ||
+        (limits->keepalive_requests > 0 && request_cnt >= limits->keepalive_requests)) {
+        return false;
+    }
+    // HTTP/1.1 默认保持连接，除非客户端要求关闭；HTTP/1.0 只有明确要求时才保持连接
+    const auto &conn = request.get_header("connection");
+    if (request.version == "1.0") {
+        return has_token(conn, "keep-alive");
+    }
+    return request.version.compare(0, 2, "1.") == 0 && !has_token(conn, "close");
 }
 
 HttpConn::PARSE_RESULT HttpConn::parse(Buffer &buf) {
-    if (buf.readable_bytes() <= 0) return PARSE_RESULT::EMPTY;
+    if (buf.readable_bytes() <= 0 && state != BODY) return PARSE_RESULT::EMPTY;
     
     // 解析请求行和请求头
     const char CRLF[] = "\r\n";
@@ -200,104 +334,368 @@ HttpConn::PARSE_RESULT HttpConn::parse(Buffer &buf) {
         const char *data_begin = buf.peek();
         const char *data_end = data_begin + buf.readable_bytes();
         const char *line_end = std::search(data_begin, data_end, CRLF, CRLF+2);
+        size_t line_len = line_end - data_begin;
         if (line_end == data_end) {
+            // 行还不完整，但已经缓存的部分超出限制时不必再等下去
+            if (state == PARSE_STATE::REQUEST_LINE && limits->max_request_line &&
+                line_len > limits->max_request_line) {
+                err_code = 414;
+                return PARSE_RESULT::ERROR;
+            } else if (state == PARSE_STATE::HEADERS && limits->max_header_size &&
+                header_bytes + line_len > limits->max_header_size) {
+                err_code = 431;
+                return PARSE_RESULT::ERROR;
+            }
             // 没有完整的一行数据，需要继续从socket中读入数据到缓冲区
             return PARSE_RESULT::NOT_FINISH;
         }
-        std::string line(buf.peek(), line_end);
         if (state == PARSE_STATE::REQUEST_LINE) {
-            if (!parse_requestline(line)) {
+            if (limits->max_request_line && line_len > limits->max_request_line) {
+                err_code = 414;
+                return PARSE_RESULT::ERROR;
+            }
+            if (!parse_requestline(data_begin, line_end)) {
                 return PARSE_RESULT::ERROR;
             }
         } else if (state == PARSE_STATE::HEADERS) {
-            parse_header(line);
+            header_bytes += line_len + 2;
+            if (limits->max_header_size && header_bytes > limits->max_header_size) {
+                err_code = 431;
+                return PARSE_RESULT::ERROR;
+            }
+            parse_header(data_begin, line_end);
         }
         buf.retrieve_until(line_end+2);  // 跳过 "\r\n"
+        if (state == PARSE_STATE::BODY && !begin_body(buf)) {
+            return PARSE_RESULT::ERROR;
+        }
     }
-    
-    // 解析请求体
-    long content_length = 0;
-    auto content_length_str = request.get_header("content-length");
-    if (!content_length_str.empty()) {
-        content_length = std::stol(content_length_str);
-    }
-    if (content_length == 0) {
-        state = FINISH;
-        return PARSE_RESULT::OK;
-    } else if (content_length <= buf.readable_bytes()) {
-        parse_body(buf.retrieve_as_str(content_length));
-        return PARSE_RESULT::OK;
-    } else {
+    if (state != PARSE_STATE::BODY) {
+        // 缓冲区恰好在行尾结束，还没有读到请求头之后的空行
         return PARSE_RESULT::NOT_FINISH;
     }
+    
+    // 解析请求体：已经到达的部分立即交给接收端，不等待整个请求体
+    PARSE_RESULT res = PARSE_RESULT::OK;
+    if (body_mode == BODY_LENGTH) {
+        size_t n = buf.readable_bytes();
+        if (n > body_remaining) n = body_remaining;
+        if (n > 0) {
+            if (!body_sink.write(buf.peek(), n)) {
+                return PARSE_RESULT::ERROR;
+            }
+            buf.retrieve(n);
+            body_remaining -= n;
+        }
+        if (body_remaining > 0) res = PARSE_RESULT::NOT_FINISH;
+    } else if (body_mode == BODY_CHUNKED) {
+        size_t consumed = 0;
+        auto dec_res = chunked.feed(buf.peek(), buf.readable_bytes(), consumed, body_sink);
+        buf.retrieve(consumed);
+        if (dec_res == ChunkedDecoder::ERROR) {
+            return PARSE_RESULT::ERROR;
+        } else if (dec_res == ChunkedDecoder::NEED_MORE) {
+            res = PARSE_RESULT::NOT_FINISH;
+        }
+    }
+    if (res == PARSE_RESULT::NOT_FINISH) {
+        if (phase == RECV_HEADER) {
+            // 请求头已经收完，开始计算请求体的接收时间和速率
+            set_phase(RECV_BODY, body_received);
+        }
+        return res;
+    }
+    return finish_body() ? PARSE_RESULT::OK : PARSE_RESULT::ERROR;
 }
 
-bool HttpConn::parse_requestline(const std::string &line) {
-    smatch sub_match;
-    if (regex_match(line, sub_match, re_requestline)) {
-        request.method = sub_match[1];
-        request.request_uri = sub_match[2];
-        request.version = sub_match[3];
-        parse_uri(request.request_uri);
-        state = PARSE_STATE::HEADERS;
-        LOG_DEBUG("request line: %s", line.c_str());
-        return true;
+bool HttpConn::parse_requestline(const char *begin, const char *end) {
+    // Request-Line = Method SP Request-URI SP HTTP-Version CRLF
+    // HTTP-Version = "HTTP" "/" 1*DIGIT "." 1*DIGIT
+    const char *method_end = std::find(begin, end, ' ');
+    const char *uri_begin = method_end == end ? end : method_end + 1;
+    const char *uri_end = std::find(uri_begin, end, ' ');
+    if (method_end == begin || uri_end == uri_begin || end - uri_end < 6 ||
+        std::memcmp(uri_end + 1, "HTTP/", 5) != 0) {
+        LOG_ERROR("invalid request line: \"%.*s\"", static_cast<int>(end-begin), begin);
+        return false;
     }
-    LOG_ERROR("invalid request line: \"%s\"", line.c_str());
-    return false;
+    const char *ver_begin = uri_end + 6;
+    const char *p = ver_begin;
+    while (p < end && std::isdigit(static_cast<unsigned char>(*p))) ++p;
+    bool valid_ver = p > ver_begin && p < end && *p == '.';
+    const char *minor = ++p;
+    while (p < end && std::isdigit(static_cast<unsigned char>(*p))) ++p;
+    if (!valid_ver || p == minor || p != end) {
+        LOG_ERROR("invalid request line: \"%.*s\"", static_cast<int>(end-begin), begin);
+        return false;
+    }
+    request.method.assign(begin, method_end);
+    request.request_uri.assign(uri_begin, uri_end);
+    request.version.assign(ver_begin, end);
+    parse_uri(request.request_uri);
+    state = PARSE_STATE::HEADERS;
+    LOG_DEBUG("request line: %.*s", static_cast<int>(end-begin), begin);
+    return true;
 }
 
-bool HttpConn::parse_uri(const std::string &uri) {
+bool HttpConn::parse_uri(const ArenaString &uri) {
     /**
      * Request-URI    = "*" | absoluteURI | abs_path | authority
     */
     if (uri[0] == '/') {
         // abs_path
-        auto pos = uri.find_first_of('?');
-        auto tmp = uri.substr(0, pos);
-        for (decltype(tmp.size()) i=0; i<tmp.size(); ++i) {
-            if (tmp[i] == '%') {
-                auto byte = hexch2dec(tmp[i+1])*16 + hexch2dec(tmp[i+2]);
-                request.path.push_back(byte);
-                i += 2;
-            } else {
-                request.path.push_back(tmp[i]);
-            }
-        }
-        if (request.path == "/") {
-            request.path = "/index.html";
-        }
+        decode_path(uri.data(), uri.size(), request.path);
     }
     return true;
 }
 
-bool HttpConn::parse_header(const std::string &line) {
-    if (line.size() == 0) {
+bool HttpConn::parse_header(const char *begin, const char *end) {
+    if (begin == end) {
         // 如果是空行，则状态转移到解析HTTP消息体(body)
         state = PARSE_STATE::BODY;
         return true;
     }
-    smatch sub_match;
-    if (regex_match(line, sub_match, re_header)) {
-        std::string field_name = str_lower(sub_match[1]);
-        request.headers[field_name] = sub_match[2];
+    // message-header = field-name ":" [ field-value ]
+    const char *colon = std::find(begin, end, ':');
+    if (colon == end) {
+        return false;
+    }
+    const char *val_begin = colon + 1;
+    while (val_begin < end && (*val_begin == ' ' || *val_begin == '\t')) {
+        ++val_begin;
+    }
+    ArenaString field_name(begin, colon, &arena);
+    for (auto &ch : field_name) {
+        if (ch >= 'A' && ch <= 'Z') ch += 32;
+    }
+    request.headers[std::move(field_name)].assign(val_begin, end);
+    return true;
+}
+
+bool HttpConn::begin_body(const Buffer &buf) {
+    body_mode = BODY_NONE;
+    body_remaining = 0;
+    body_received = 0;
+    const auto &te = request.get_header("transfer-encoding");
+    const auto &cl = request.get_header("content-length");
+    if (!te.empty()) {
+        if (!cl.empty()) {
+            // 同时带有两者的请求可能是请求走私，拒绝
+            LOG_ERROR("both Transfer-Encoding and Content-Length are present");
+            return false;
+        }
+        if (!str_case_equal(te.data(), te.size(), "chunked")) {
+            err_code = 501;
+            return false;
+        }
+        body_mode = BODY_CHUNKED;
+        chunked.reset();
+    } else if (!cl.empty()) {
+        char *end = nullptr;
+        errno = 0;
+        unsigned long long len = std::strtoull(cl.c_str(), &end, 10);
+        if (cl[0] < '0' || cl[0] > '9' || *end != '\0' || errno == ERANGE) {
+            LOG_ERROR("invalid Content-Length: \"%s\"", cl.c_str());
+            return false;
+        }
+        if (limits->max_body_size && len > limits->max_body_size) {
+            // 不接收超出限制的请求体，直接拒绝
+            err_code = 413;
+            return false;
+        }
+        if (len > 0) {
+            body_mode = BODY_LENGTH;
+            body_remaining = len;
+        }
+    }
+    if (body_mode == BODY_NONE) {
         return true;
     }
-    return false;
+
+    const auto &type = request.get_header("content-type");
+    static const char MULTIPART[] = "multipart/";
+    if (type.size() >= sizeof(MULTIPART) - 1 &&
+        str_case_equal(type.data(), sizeof(MULTIPART) - 1, MULTIPART)) {
+        std::string boundary;
+        if (!MultipartParser::get_boundary(std::string(type.data(), type.size()), boundary)) {
+            LOG_ERROR("unsupported multipart Content-Type: \"%s\"", type.c_str());
+            return false;
+        }
+        // 表单边接收边解析，文件部分直接写入临时文件，不需要暂存整个请求体
+        if (!multipart) {
+            multipart.reset(new MultipartParser());
+        }
+        multipart->reset(boundary, &form_handler);
+        is_multipart = true;
+    } else if (body_mode == BODY_LENGTH) {
+        if (limits->body_buffer_size && body_remaining > limits->body_buffer_size) {
+            // 长度已知的大请求体直接写入临时文件
+            if (!open_spool()) return false;
+        } else {
+            request.body.reserve(body_remaining);
+        }
+    }
+    const auto &expect = request.get_header("expect");
+    if (buf.readable_bytes() == 0 && str_case_equal(expect.data(), expect.size(), "100-continue")) {
+        // 客户端在发送请求体之前等待服务器的确认
+        static const char CONTINUE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        write_buf.append(CONTINUE, sizeof(CONTINUE) - 1);
+        send_interim();
+    }
+    return true;
 }
 
-void HttpConn::parse_body(const std::string &content) {
-    request.body = content;
-    if (request.method == "POST") {
-        parse_post();
+void HttpConn::send_interim() {
+    struct iovec v = {const_cast<char*>(write_buf.peek()), write_buf.readable_bytes()};
+    // 不能直接写 socket：TLS 连接上明文会混进记录流；SSL_write 被阻塞后还必须以相同的数据重试，
+    // 所以剩余的部分不丢弃，而是留给之后的 write()
+    ssize_t len = tls ? tls->writev(&v, 1) : writev(fd, &v, 1);
+    if (len > 0) {
+        write_buf.retrieve(len);
+    }
+}
+
+bool HttpConn::append_body(const char *data, size_t len) {
+    body_received += len;
+    if (limits->max_body_size && body_received > limits->max_body_size) {
+        err_code = 413;
+        return false;
+    }
+    if (is_multipart) {
+        return multipart->write(data, len);
     }
+    bool spooled = spool && spool->get_fd() >= 0;
+    if (!spooled && limits->body_buffer_size &&
+        request.body.size() + len > limits->body_buffer_size) {
+        // 长度未知的请求体超出了内存缓存的上限，把已经收到的部分转存到临时文件
+        if (!open_spool() || !spool->write(request.body.data(), request.body.size())) {
+            err_code = 500;
+            return false;
+        }
+        release_container(request.body);
+        spooled = true;
+    }
+    if (spooled) {
+        if (!spool->write(data, len)) {
+            LOG_ERROR("Failed to write request body to spool file: %s", strerror(errno));
+            err_code = 500;
+            return false;
+        }
+        return true;
+    }
+    request.body.append(data, len);
+    return true;
+}
+
+bool HttpConn::finish_body() {
     state = PARSE_STATE::FINISH;
-    LOG_DEBUG("request body length: %d", content.size());
+    request.body_size = body_received;
+    if (is_multipart) {
+        if (!multipart->finish()) {
+            LOG_ERROR("multipart body ends without the closing boundary");
+            return false;
+        }
+    } else if (spool && spool->get_fd() >= 0) {
+        if (!spool->finish()) {
+            err_code = 500;
+            return false;
+        }
+        request.body_fd = spool->get_fd();
+    } else if (!request.body.empty()) {
+        parse_post();
+    }
+    if (body_mode != BODY_NONE) {
+        LOG_DEBUG("request body length: %llu%s", static_cast<unsigned long long>(body_received),
+            request.body_fd >= 0 ? " (spooled)" : "");
+    }
+    return true;
 }
 
+bool HttpConn::on_part_begin(const MultipartPart &part) {
+    if (part.filename.empty()) {
+        // 普通字段，与 urlencoded 表单一样存入 post
+        ArenaString key(part.name.data(), part.name.size(), &arena);
+        cur_field = &request.post[std::move(key)];
+        cur_field->clear();
+        cur_file = nullptr;
+        return true;
+    }
+    if (upload_cnt >= MAX_UPLOAD_FILES) {
+        err_code = 413;
+        return false;
+    }
+    if (upload_cnt == uploads.size()) {
+        uploads.emplace_back(new FileSpool());
+    }
+    cur_file = uploads[upload_cnt].get();
+    if (!cur_file->open(spool_dir)) {
+        LOG_ERROR("Failed to create upload file in %s: %s", spool_dir.c_str(), strerror(errno));
+        err_code = 500;
+        return false;
+    }
+    ++upload_cnt;
+    cur_field = nullptr;
+    request.files.emplace_back(ArenaAllocator<char>(&arena));
+    auto &file = request.files.back();
+    file.name.assign(part.name.data(), part.name.size());
+    file.filename.assign(part.filename.data(), part.filename.size());
+    file.content_type.assign(part.content_type.data(), part.content_type.size());
+    return true;
+}
+
+bool HttpConn::on_part_data(const char *data, size_t len) {
+    if (cur_file) {
+        if (!cur_file->write(data, len)) {
+            LOG_ERROR("Failed to write upload file: %s", strerror(errno));
+            err_code = 500;
+            return false;
+        }
+        return true;
+    }
+    if (limits->body_buffer_size && cur_field->size() + len > limits->body_buffer_size) {
+        // 普通字段保存在内存中，不允许超过内存缓存的上限
+        err_code = 413;
+        return false;
+    }
+    cur_field->append(data, len);
+    return true;
+}
+
+bool HttpConn::on_part_end() {
+    if (cur_file) {
+        if (!cur_file->finish()) {
+            err_code = 500;
+            return false;
+        }
+        auto &file = request.files.back();
+        file.fd = cur_file->get_fd();
+        file.size = cur_file->size();
+        LOG_DEBUG("uploaded file \"%s\" (%s): %zu bytes", file.filename.c_str(),
+            file.content_type.c_str(), file.size);
+    }
+    cur_file = nullptr;
+    cur_field = nullptr;
+    return true;
+}
+
+bool HttpConn::open_spool() {
+    if (!spool) {
+        spool.reset(new FileSpool());
+    }
+    if (!spool->open(spool_dir)) {
+        LOG_ERROR("Failed to create spool file in %s: %s", spool_dir.c_str(), strerror(errno));
+        err_code = 500;
+        return false;
+    }
+    return true;
+}
+
+
 void HttpConn::parse_post() {
     if (request.method != "POST") return;
-    if (request.get_header("content-length") == "application/x-www-form-urlencoded") {
+    const auto &type = request.get_header("content-type");
+    static const char FORM_TYPE[] = "application/x-www-form-urlencoded";
+    if (type.compare(0, sizeof(FORM_TYPE) - 1, FORM_TYPE) == 0) {
         parse_form_urlencoded();
     }
 }
@@ -305,7 +703,7 @@ void HttpConn::parse_post() {
 void HttpConn::parse_form_urlencoded() {
     auto body_len = request.body.size();
     if (body_len == 0) return;
-    std::string tmp, key;
+    ArenaString tmp(&arena), key(&arena);
     int byte;
     for (decltype(body_len) i=0; i<body_len; ++i) {
         char ch = request.body[i];
@@ -341,29 +739,310 @@ void HttpConn::parse_form_urlencoded() {
     }
 }
 
+void HttpConn::reset_request() {
+    // 请求边界：先让请求和响应放弃对分配区的引用，再回卷分配区
+    request.init();
+    response.init();
+    unmap_file();
+    if (arena.reserved_bytes() > ARENA_RETAIN_BYTES) {
+        // 大请求撑大的分配区不再保留，避免空闲连接长期占用内存
+        arena.release();
+    } else {
+        arena.reset();
+    }
+    read_buf.shrink(BUFFER_RETAIN_BYTES);
+    write_buf.shrink(BUFFER_RETAIN_BYTES);
+    if (spool) {
+        spool->close();
+    }
+    for (size_t i=0; i<upload_cnt; ++i) {
+        uploads[i]->close();
+    }
+    upload_cnt = 0;
+    is_multipart = false;
+    state = PARSE_STATE::REQUEST_LINE;
+    err_code = 400;
+    header_bytes = 0;
+    body_mode = BODY_NONE;
+    work_class = WORK_STATIC;
+    set_phase(read_buf.readable_bytes() > 0 ? RECV_HEADER : IDLE);
+}
+
 bool HttpConn::process() {
+    if (tls && !tls->is_established()) {
+        return tls->want_write();
+    }
+    if (h2) {
+        return process_h2();
+    }
+    if (is_deferred) {
+        // 请求已经解析（由主线程，或者由另一个线程池），只剩下可能阻塞的部分
+        is_deferred = false;
+        if (work_class == WORK_DB) {
+            handle_user_form();
+        } else if (response.status_code == 200 && wants_h2_upgrade() && upgrade_h2()) {
+            return process_h2();
+        }
+        respond();
+        return true;
+    }
     if (state == PARSE_STATE::FINISH) {
-        request.init();
-        state = PARSE_STATE::REQUEST_LINE;
+        reset_request();
     }
-    if (read_buf.readable_bytes() <= 0) {
+    if (read_buf.readable_bytes() <= 0 && state != PARSE_STATE::BODY) {
         return false;
     }
+    if (enable_h2 && request_cnt == 0 && state == PARSE_STATE::REQUEST_LINE) {
+        // 连接上的第一个请求以 HTTP/2 的连接序言开头：明文连接上的 prior knowledge，
+        // 或者 TLS 连接上由 ALPN 协商了 h2
+        size_t n = std::min(read_buf.readable_bytes(), Http2Session::PREFACE_LEN);
+        if (std::memcmp(read_buf.peek(), Http2Session::PREFACE, n) == 0) {
+            if (n < Http2Session::PREFACE_LEN) return false;
+            h2.reset(new Http2Session(&h2_handler));
+            h2->start(write_buf);
+            LOG_DEBUG("<client %d> HTTP/2 with %s", fd, tls ? "ALPN" : "prior knowledge");
+            return process_h2();
+        }
+    }
     
     auto parse_res = parse(read_buf);
     if (parse_res == PARSE_RESULT::OK) {
         response.status_code = 200;
+        work_class = handle_session() ? WORK_STATIC : classify();
+        if (response.status_code != 200) {
+            // 会话检查已经生成了重定向
+        } else if (work_class == WORK_DB && !enable_db) {
+            response.status_code = 503;
+            work_class = WORK_STATIC;
+        } else if (work_class != WORK_STATIC) {
+            // 交给该类别的线程池生成响应，当前线程不等待
+            is_deferred = true;
+            set_phase(PROCESS);
+            return false;
+        } else if (wants_h2_upgrade() && upgrade_h2()) {
+            return process_h2();
+        }
     } else if (parse_res == PARSE_RESULT::ERROR) {
-        response.status_code = 400;
+        response.status_code = err_code;
     } else if (parse_res == PARSE_RESULT::NOT_FINISH || parse_res == PARSE_RESULT::EMPTY) {
         return false;
     }
+    respond();
+    return true;
+}
+
+bool HttpConn::can_read_inline() const {
+    return !h2 && !is_deferred && (!tls || tls->is_established()) &&
+        state != PARSE_STATE::BODY;
+}
+
+bool HttpConn::can_write_inline(size_t max_bytes) const {
+    // 响应头和错误页面都在内存中，只有映射的文件可能需要从磁盘读入
+    return !h2 && (!tls || tls->is_established()) && iov[1].iov_len <= max_bytes;
+}
 
+HttpConn::INLINE_RESULT HttpConn::process_inline(size_t max_file_size) {
+    if (!can_read_inline() || state == PARSE_STATE::HEADERS) {
+        return INLINE_DEFER;
+    }
+    if (state == PARSE_STATE::FINISH) {
+        reset_request();
+    }
+    if (read_buf.readable_bytes() == 0) {
+        return INLINE_READ;
+    }
+    if (!is_simple_request(read_buf)) {
+        // 不完整的请求、带请求体的请求和 HTTP/2 的连接序言都交给工作线程
+        return INLINE_DEFER;
+    }
+    auto parse_res = parse(read_buf);
+    if (parse_res == PARSE_RESULT::NOT_FINISH || parse_res == PARSE_RESULT::EMPTY) {
+        return INLINE_READ;
+    }
+    if (parse_res == PARSE_RESULT::OK) {
+        response.status_code = 200;
+        if (handle_session()) {
+            respond();
+            return INLINE_WRITE;
+        }
+        if (wants_h2_upgrade()) {
+            is_deferred = true;
+            set_phase(PROCESS);
+            return INLINE_DEFER;
+        }
+        if (!request.path.empty()) {
+            // 只有打包的小文件在主线程上发送：它们已经在内存中，不需要 stat()、open() 和 mmap()；
+            // 文件系统中的资源交给工作线程，stat() 也可能阻塞在磁盘上，并且工作线程还要再查一次
+            const StaticBundle::File *file =
+                bundle ? bundle->find(request.path.data(), request.path.size()) : nullptr;
+            if (!file || file->body_len[BUNDLE_IDENTITY] > max_file_size) {
+                is_deferred = true;
+                set_phase(PROCESS);
+                return INLINE_DEFER;
+            }
+        }
+    } else {
+        response.status_code = err_code;
+    }
+    respond();
+    return INLINE_WRITE;
+}
+
+HttpConn::WORK_CLASS HttpConn::pending_work() const {
+    return is_deferred ? work_class : WORK_STATIC;
+}
+
+void HttpConn::reject(int code) {
+    is_deferred = false;
+    work_class = WORK_STATIC;
+    response.status_code = code;
+    respond();
+}
+
+HttpConn::WORK_CLASS HttpConn::classify() const {
+    if (request.method == "POST" && (request.path == "/login" || request.path == "/register")) {
+        return WORK_DB;
+    }
+    return WORK_STATIC;
+}
+
+bool HttpConn::handle_session() {
+    SessionStore *sessions = SessionStore::get_instance();
+    if (!sessions->enabled()) return false;
+    const auto &cookie = request.get_header("cookie");
+    if (request.path == "/logout") {
+        std::string sid = sessions->parse_cookie(cookie.data(), cookie.size());
+        if (!sid.empty()) sessions->remove(sid);
+        response.status_code = 303;
+        response.headers.emplace("Location", "/login.html");
+        response.headers.emplace("Set-Cookie", sessions->make_cookie("").c_str());
+        return true;
+    }
+    if (needs_login(request.path.data(), request.path.size(), cookie.data(), cookie.size())) {
+        response.status_code = 303;
+        response.headers.emplace("Location", "/login.html");
+        return true;
+    }
+    return false;
+}
+
+void HttpConn::handle_user_form() {
+    if (!enable_db) {
+        response.status_code = 503;
+        return;
+    }
+    const auto &name = request.get_post("username");
+    const auto &passwd = request.get_post("password");
+    std::string username(name.data(), name.size()), password(passwd.data(), passwd.size());
+    set_user_form_result(request.path == "/login" ? UserStore::verify(username, password) :
+        UserStore::add(username, password));
+}
+
+void HttpConn::query_user_form(AsyncSQLPool &db, std::function<void()> done) {
+    is_deferred = false;
+    const auto &name = request.get_post("username");
+    const auto &passwd = request.get_post("password");
+    std::string username(name.data(), name.size()), password(passwd.data(), passwd.size());
+    // 连接对象由 done 持有，查询完成之前不会被释放；在此期间连接可能因为超时被主线程关闭
+    auto on_result = [this, done](UserStore::RESULT res) {
+        if (is_close) return;
+        finish_user_form(res);
+        done();
+    };
+    if (request.path == "/login") {
+        UserStore::verify(db, username, password, on_result);
+    } else {
+        UserStore::add(db, username, password, on_result);
+    }
+}
+
+bool HttpConn::is_registration() const {
+    return is_deferred && work_class == WORK_DB && request.path == "/register";
+}
+
+void HttpConn::queue_registration(RegistrationBatcher &batcher, UserStore::Done done) {
+    is_deferred = false;
+    const auto &name = request.get_post("username");
+    const auto &passwd = request.get_post("password");
+    std::string username(name.data(), name.size()), password(passwd.data(), passwd.size());
+    batcher.add(username, password, std::move(done));
+}
+
+void HttpConn::finish_user_form(UserStore::RESULT res) {
+    set_user_form_result(res);
+    respond();
+}
+
+void HttpConn::set_user_form_result(UserStore::RESULT res) {
+    if (res == UserStore::UNAVAILABLE) {
+        response.status_code = 503;
+        return;
+    }
+    const bool is_login = request.path == "/login";
+    const char *location = "/error.html";
+    if (res == UserStore::OK) {
+        location = is_login ? "/welcome.html" : "/login.html";
+    }
+    LOG_DEBUG("<client %d> %s \"%s\": %s", fd, (is_login ? "login" : "register"),
+        request.get_post("username").c_str(), (res == UserStore::OK ? "ok" : "rejected"));
+    response.status_code = 303;
+    response.headers.emplace("Location", location);
+    SessionStore *sessions = SessionStore::get_instance();
+    if (is_login && res == UserStore::OK && sessions->enabled()) {
+        const auto &name = request.get_post("username");
+        // 密码已经校验通过；同一个用户的会话仍然有效时沿用它，不再签发新的 Cookie
+        const auto &cookie = request.get_header("cookie");
+        std::string sid = sessions->parse_cookie(cookie.data(), cookie.size());
+        std::string username;
+        if (!sid.empty() && sessions->lookup(sid, &username) &&
+            username.compare(0, std::string::npos, name.data(), name.size()) == 0) {
+            return;
+        }
+        sid = sessions->create(std::string(name.data(), name.size()));
+        if (!sid.empty()) {
+            response.headers.emplace("Set-Cookie", sessions->make_cookie(sid).c_str());
+        }
+    }
+}
+
+bool HttpConn::is_simple_request(const Buffer &buf) {
+    static const char CRLF[] = "\r\n";
+    static const char HEADER_END[] = "\r\n\r\n";
+    const char *begin = buf.peek();
+    const char *end = begin + buf.readable_bytes();
+    const size_t len = buf.readable_bytes();
+    if (!(len > 4 && std::memcmp(begin, "GET ", 4) == 0) &&
+        !(len > 5 && std::memcmp(begin, "HEAD ", 5) == 0)) {
+        return false;
+    }
+    const char *head_end = std::search(begin, end, HEADER_END, HEADER_END + 4);
+    if (head_end == end) {
+        return false;
+    }
+    // 跳过请求行，检查各个请求头中有没有描述请求体的字段
+    const char *line = std::search(begin, head_end, CRLF, CRLF + 2) + 2;
+    while (line < head_end + 2) {
+        const char *eol = std::search(line, head_end + 2, CRLF, CRLF + 2);
+        size_t n = eol - line;
+        if ((n >= 15 && str_case_equal(line, 15, "content-length:")) ||
+            (n >= 18 && str_case_equal(line, 18, "transfer-encoding:"))) {
+            return false;
+        }
+        line = eol + 2;
+    }
+    return true;
+}
+
+void HttpConn::respond() {
     // 响应的状态行、头部和响应体
     make_response();
+    set_phase(SEND);
     iov[0].iov_base = const_cast<char*>(write_buf.peek());
     iov[0].iov_len = write_buf.readable_bytes();
     iov_cnt = 1;
+    // 没有文件的响应（错误页面、重定向）不能留下上一个响应的残余，否则写不完
+    iov[1].iov_base = nullptr;
+    iov[1].iov_len = 0;
     // 响应要发送的文件
     if (get_mm_file_len() > 0 && mm_file) {
         iov[1].iov_base = mm_file;
@@ -379,9 +1058,227 @@ bool HttpConn::process() {
     );
     LOG_DEBUG("response bytes: %d, file bytes: %d", to_write_bytes(),
         iov[1].iov_len);
+}
+
+bool HttpConn::wants_h2_upgrade() const {
+    // h2c 升级只用于明文连接，TLS 连接上的 HTTP/2 由 ALPN 协商
+    if (!enable_h2 || tls || request.version != "1.1" || body_mode != BODY_NONE) {
+        return false;
+    }
+    // Upgrade: h2c，并且 Connection 中列出了 Upgrade 和 HTTP2-Settings (RFC 7540 3.2)
+    const auto &conn = request.get_header("connection");
+    return has_token(request.get_header("upgrade"), "h2c") &&
+        has_token(conn, "upgrade") && has_token(conn, "http2-settings") &&
+        request.headers.count(ArenaString("http2-settings")) > 0;
+}
+
+bool HttpConn::upgrade_h2() {
+    // 升级请求转换成流 1 上的 HTTP/2 请求，逐跳的字段不再保留
+    HpackHeaderList headers;
+    headers.emplace_back(":method", std::string(request.method.data(), request.method.size()));
+    headers.emplace_back(":scheme", "http");
+    headers.emplace_back(":path",
+        std::string(request.request_uri.data(), request.request_uri.size()));
+    for (const auto &h : request.headers) {
+        const auto &name = h.first;
+        if (name == "connection" || name == "upgrade" || name == "http2-settings" ||
+            name == "keep-alive" || name == "proxy-connection" || name == "te") {
+            continue;
+        }
+        headers.emplace_back(name == "host" ? ":authority" : std::string(name.data(), name.size()),
+            std::string(h.second.data(), h.second.size()));
+    }
+    const auto &settings = request.get_header("http2-settings");
+    ResponseWriter writer(write_buf);
+    writer.status_line(101);
+    writer.header("Connection", "Upgrade");
+    writer.header("Upgrade", "h2c");
+    writer.end_headers();
+    h2.reset(new Http2Session(&h2_handler));
+    if (!h2->upgrade(std::string(settings.data(), settings.size()), std::move(headers),
+        write_buf)) {
+        // HTTP2-Settings 不合法时忽略升级，按 HTTP/1.1 处理这个请求
+        h2.reset();
+        write_buf.retrieve_all();
+        return false;
+    }
+    LOG_DEBUG("<client %d> upgraded to HTTP/2", fd);
+    // 此后不再使用 HTTP/1.1 的请求状态
+    request.init();
+    response.init();
+    arena.reset();
     return true;
 }
 
+bool HttpConn::process_h2() {
+    if (read_buf.readable_bytes() > 0 && !h2->receive(read_buf, write_buf)) {
+        LOG_WARN("<client %d, %s:%d> HTTP/2 connection error 0x%x", fd, get_ip(),
+            get_port(), h2->get_error());
+    }
+    if (limits->keepalive_requests > 0 && request_cnt >= limits->keepalive_requests) {
+        // 请求数达到上限，通知客户端不再发起新的流，已有的流照常完成
+        h2->shutdown(write_buf);
+    }
+    h2->send(write_buf, H2_OUTPUT_BYTES);
+    keep_alive = !h2->is_finished();
+    iov[0].iov_base = const_cast<char*>(write_buf.peek());
+    iov[0].iov_len = write_buf.readable_bytes();
+    iov[1].iov_len = 0;
+    iov_cnt = 1;
+    if (iov[0].iov_len > 0 || !keep_alive) {
+        // 会话结束时即使没有数据也要经过写事件，由写事件的处理关闭连接
+        set_phase(SEND);
+        return true;
+    }
+    // 等待请求（或者对端的 WINDOW_UPDATE）
+    set_phase(h2->has_streams() ? RECV_BODY : IDLE);
+    return false;
+}
+
+void HttpConn::on_h2_request(Http2Stream &stream) {
+    ++request_cnt;
+    const auto &method = stream.header(":method");
+    const auto &uri = stream.header(":path");
+    std::string path;
+    decode_path(uri.data(), uri.size(), path);
+    const auto &cookie = stream.header("cookie");
+
+    struct stat st;
+    char *file = nullptr;
+    const StaticBundle::File *bundled_file = nullptr;
+    BUNDLE_ENCODING enc = BUNDLE_IDENTITY;
+    int code = 400;
+    auto &headers = stream.resp_headers;
+    if (method != "GET" && method != "HEAD") {
+        // 流上的请求体不会被处理，登录和注册等表单只能通过 HTTP/1.x 提交
+        code = is_known_method(method.data(), method.size()) ? 405 : 501;
+        if (code == 405) {
+            headers.emplace_back("allow", "GET, HEAD");
+        }
+    } else if (needs_login(path.data(), path.size(), cookie.data(), cookie.size())) {
+        // 受保护的页面与 HTTP/1.x 一样需要有效的会话，否则重定向到登录页面
+        code = 303;
+        headers.emplace_back("location", "/login.html");
+    } else if (!path.empty() && path[0] == '/') {
+        const auto &accept = stream.header("accept-encoding");
+        const auto &etag = stream.header("if-none-match");
+        bool not_modified = false;
+        bundled_file = find_bundled(path.data(), path.size(), accept.data(), accept.size(),
+            etag.data(), etag.size(), enc, not_modified);
+        if (bundled_file) {
+            code = not_modified ? 304 : 200;
+            st.st_size = bundled_file->body_len[enc];
+        } else {
+            code = map_resource((src_dir + path).c_str(), etag.data(), etag.size(), st, file);
+        }
+    }
+    const bool head = method == "HEAD";
+    stream.status = code;
+    headers.emplace_back("date", std::string(HttpDate::now(), HttpDate::LEN));
+    headers.emplace_back("server", _VENDOR_NAME "/" _VERSION_STRING);
+    if (code == 200 || code == 304) {
+        // HTTP/2 的字段名必须是小写
+        add_resource_headers(code, bundled_file, enc, st, path.data(), path.size(),
+            [&headers](const char *name, const char *value, size_t len) {
+                std::string field(name);
+                std::transform(field.begin(), field.end(), field.begin(), ::tolower);
+                headers.emplace_back(std::move(field), std::string(value, len));
+            });
+    }
+    if (code == 200) {
+        if (bundled_file) {
+            // 内容直接指向打包文件的映射，流不持有映射
+            stream.body = bundled_file->body[enc];
+        } else {
+            // 映射由流持有，响应发送完或者流被重置时释放
+            stream.mm_file = file;
+            stream.mm_len = st.st_size;
+            stream.body = file;
+        }
+        stream.body_len = head ? 0 : st.st_size;
+        headers.emplace_back("content-length", std::to_string(st.st_size));
+    } else if (code == 303) {
+        // 重定向到登录页面，与 HTTP/1.1 的响应一样没有响应体
+        headers.emplace_back("content-length", "0");
+    } else if (code != 304) {
+        size_t page_len = 0;
+        stream.body = ResponseTemplates::error_page(code, page_len);
+        stream.body_len = head ? 0 : page_len;
+        headers.emplace_back("content-type", "text/html");
+        headers.emplace_back("content-length", std::to_string(page_len));
+    }
+    LOG_INFO("\"%s %s HTTP/2\" %d %zu", method.c_str(), uri.c_str(), code, stream.body_len);
+}
+
+bool HttpConn::is_closed() const {
+    return is_close;
+}
+
+bool HttpConn::is_http2() const {
+    return h2 != nullptr;
+}
+
+bool HttpConn::is_tls() const {
+    return tls != nullptr;
+}
+
+HttpConn::IO_PHASE HttpConn::get_phase() const {
+    return static_cast<IO_PHASE>(phase.load());
+}
+
+int64_t HttpConn::get_deadline() const {
+    int ph = phase.load();
+    int64_t start = phase_start.load();
+    if (ph == IDLE) {
+        // 第一个请求之前按服务器的空闲超时处理，之后按 keepalive_timeout 处理
+        return request_cnt > 0 ? start + limits->keepalive_timeout : -1;
+    }
+    if (ph == PROCESS) {
+        // 响应由其他线程生成（可能在等待数据库），不按接收或发送的速率计时
+        return limits->process_timeout > 0 ? start + limits->process_timeout : -1;
+    }
+    int timeout = 0, rate = 0;
+    if (ph == RECV_HEADER) {
+        timeout = limits->header_timeout;
+    } else if (ph == RECV_BODY) {
+        timeout = limits->body_timeout;
+        rate = limits->min_recv_rate;
+    } else {
+        timeout = limits->send_timeout;
+        rate = limits->min_send_rate;
+    }
+    int64_t deadline = timeout > 0 ? start + timeout : -1;
+    if (rate > 0) {
+        // 已收发 n 字节时，只要在 start + n/rate 之前没有新的进展，
+        // 平均速率就会跌破下限（宽限期内不检查）
+        int64_t rate_deadline = start + std::max<int64_t>(limits->rate_grace,
+            phase_bytes.load() * 1000 / rate);
+        if (deadline < 0 || rate_deadline < deadline) {
+            deadline = rate_deadline;
+        }
+    }
+    return deadline;
+}
+
+int64_t HttpConn::now_ms() {
+    return monotonic_ms();
+}
+
+const std::string& HttpConn::timeout_response() {
+    static const std::string resp =
+        "HTTP/1.1 408 Request Timeout\r\n"
+        "Connection: close\r\n"
+        "Content-Length: 0\r\n"
+        "Server: " _VENDOR_NAME "/" _VERSION_STRING "\r\n\r\n";
+    return resp;
+}
+
+void HttpConn::set_phase(IO_PHASE ph, int64_t bytes) {
+    phase_start = now_ms();
+    phase_bytes = bytes;
+    phase = ph;
+}
+
 int HttpConn::get_fd() const {
     return fd;
 }
@@ -400,160 +1297,189 @@ sockaddr_in HttpConn::get_addr() const {
 }
 
 void HttpConn::make_response() {
-    response.init();
-    if (!request.path.empty()) {
-        // 用户请求的资源路径非空，则检查资源文件并尝试将其映射到内存
+    // 响应已在请求边界处重置，这里不能再调用 response.init()，
+    // 否则解析阶段设置的错误状态码会被覆盖
+    if (response.status_code == 200 && !request.path.empty()) {
+        // 用户请求的资源路径非空，先查找打包的资源，否则检查资源文件并尝试将其映射到内存
         // 检查资源文件和映射过程都可能会出错，出错会设置相应的状态码
-        if (!check_resource_and_map(src_dir + request.path)) {
-            set_err_content();
+        if (!check_bundle()) {
+            check_resource_and_map(get_file_path(request.path.data(), request.path.size()));
         }
     }
-    set_status_line();
-    set_headers();
-    write_buf.append(response.get_status_line());
-    write_buf.append(response.get_headers());
+    const int code = response.status_code;
+    ++request_cnt;
+    keep_alive = decide_keep_alive();
+    ResponseWriter writer(write_buf);
+    writer.status_line(code);
+    if (keep_alive) {
+        writer.header("Connection", "keep-alive");
+        writer.keep_alive(limits->keepalive_timeout / 1000,
+            limits->keepalive_requests > 0 ? limits->keepalive_requests - request_cnt : -1);
+    } else {
+        writer.header("Connection", "close");
+    }
+    writer.date();
+    writer.server();
+    const std::string *err_tail = code >= 400 ? ResponseTemplates::error_tail(code) : nullptr;
+    if (err_tail) {
+        // 错误响应的其余部分（包括页面）在启动时就已生成
+        unmap_file();
+        write_buf.append(*err_tail);
+        response.content_length = err_tail->size() - err_tail->find("\r\n\r\n") - 4;
+        return;
+    }
+    if (mm_file || code == 304) {
+        add_resource_headers(code, bundled, bundled_enc, mm_file_stat,
+            request.path.data(), request.path.size(),
+            [&writer](const char *name, const char *value, size_t len) {
+                writer.header(name, value, len);
+            });
+    }
+    if (mm_file) {
+        response.content_length = mm_file_stat.st_size;
+    } else {
+        response.content_length = response.body.size();
+    }
+    if (code != 304) {
+        writer.header("Content-Length", static_cast<uint64_t>(response.content_length));
+    }
+    for (const auto &h : response.headers) {
+        writer.header(h.first.c_str(), h.second.data(), h.second.size());
+    }
+    writer.end_headers();
     if (!response.body.empty()) {
-        write_buf.append(response.body);
+        write_buf.append(response.body.data(), response.body.size());
     }
 }
 
-bool HttpConn::check_resource_and_map(const std::string &fp) {
-    int ret = stat(fp.c_str(), &mm_file_stat);
-    if (ret == -1) {
-        if (errno == ENOENT) {  
-            // 请求的资源不存在，设置 Not Found 错误码
-            response.status_code = 404;
-        } else {
-            // 其他错误，设置 Internal Server Error 错误码
-            response.status_code = 500;
+template <typename AddHeader>
+void HttpConn::add_resource_headers(int code, const StaticBundle::File *file, BUNDLE_ENCODING enc,
+    const struct stat &st, const char *path, size_t len, AddHeader add
+) {
+    char buf[40];
+    add("Last-Modified", buf, http_gmt(buf, sizeof(buf), file ? file->mtime : st.st_mtim.tv_sec));
+    if (file) {
+        add("ETag", file->etag[enc], file->etag_len[enc]);
+        if (file->has_variants()) {
+            add("Vary", "Accept-Encoding", sizeof("Accept-Encoding") - 1);
         }
-        return false;
-    } else if (S_ISDIR(mm_file_stat.st_mode)) {
-        // 请求的资源是一个目录，设置 Not Found 错误码
-        response.status_code = 404;
-        return false;
-    } else if (!(mm_file_stat.st_mode & S_IROTH)) {
-        // 请求的资源没有读取权限，设置 Forbidden 错误码
-        response.status_code = 403;
-        // 如果不想让客户端知道这个资源是没有权限访问的，可以返回404
-        // 从而让客户端认为要访问的资源不存在，而不是禁止访问
-        // "An origin server that wishes to "hide" the current existence of a
-        // forbidden target resource MAY instead respond with a status code of
-        // 404 (Not Found)."  -- from RFC7231 6.5.3
-        // status_code = 404;
-        return false;
+    } else {
+        add("ETag", buf, gen_etag(st, buf, sizeof(buf)));
     }
-
-    // 处理客户端的条件请求
-    auto req_etag = request.get_header("if-none-match");
-    auto tv_ = mm_file_stat.st_mtim.tv_sec;
-    auto etag = dec2hexstr(tv_) + '-' + dec2hexstr(mm_file_stat.st_size);
-    if (req_etag == etag) {
-        response.status_code = 304;
-        return true;
+    if (code != 200) return;
+    if (file) {
+        add("Content-Type", file->mime, file->mime_len);
+        if (enc != BUNDLE_IDENTITY) {
+            const char *name = StaticBundle::encoding_name(enc);
+            add("Content-Encoding", name, std::strlen(name));
+        }
+    } else {
+        const auto &type = mime_type(path, len);
+        add("Content-Type", type.data(), type.size());
     }
+}
+
+ArenaString HttpConn::get_file_path(const char *path, size_t len) {
+    ArenaString fp(&arena);
+    fp.reserve(src_dir.size() + len);
+    fp.append(src_dir.data(), src_dir.size()).append(path, len);
+    return fp;
+}
+
+size_t HttpConn::gen_etag(const struct stat &st, char *buf, size_t size) {
+    int len = snprintf(buf, size, "%llx-%llx",
+        static_cast<unsigned long long>(st.st_mtim.tv_sec),
+        static_cast<unsigned long long>(st.st_size));
+    return len > 0 && static_cast<size_t>(len) < size ? len : 0;
+}
 
-    // 请求的资源没有问题
-    // 将客户端请求的资源文件映射到内存
-    if (!map_file(fp)) {
-        // 映射失败，设置 Internal Server Error 错误码
-        response.status_code = 500;
+bool HttpConn::check_resource_and_map(const ArenaString &fp) {
+    const auto &req_etag = request.get_header("if-none-match");
+    response.status_code = map_resource(fp.c_str(), req_etag.data(), req_etag.size(),
+        mm_file_stat, mm_file);
+    if (response.status_code != 200 && response.status_code != 304) {
+        mm_file = nullptr;
         return false;
     }
-
-    response.headers["content-type"] = get_file_type(fp);
-    response.headers["content-length"] = std::to_string(mm_file_stat.st_size);
     return true;
 }
 
-bool HttpConn::map_file(const std::string &fp) {
-    int fd = open(fp.c_str(), O_RDONLY);
-    if (fd < 0) {
-        // 打开文件失败
+bool HttpConn::check_bundle() {
+    const auto &accept = request.get_header("accept-encoding");
+    const auto &req_etag = request.get_header("if-none-match");
+    BUNDLE_ENCODING enc = BUNDLE_IDENTITY;
+    bool not_modified = false;
+    const StaticBundle::File *file = find_bundled(request.path.data(), request.path.size(),
+        accept.data(), accept.size(), req_etag.data(), req_etag.size(), enc, not_modified);
+    if (!file) {
         return false;
     }
-    void *ret = mmap(nullptr, mm_file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (ret == (void *)-1) {
-        // 映射失败
-        close(fd);
-        return false;
+    bundled = file;
+    bundled_enc = enc;
+    mm_file_stat.st_size = file->body_len[enc];
+    mm_file_stat.st_mtim.tv_sec = file->mtime;
+    if (not_modified) {
+        response.status_code = 304;
+        mm_file = nullptr;
+    } else {
+        // 打包文件在服务器的整个生命周期内保持映射，不需要打开、映射或者释放
+        response.status_code = 200;
+        mm_file = const_cast<char*>(file->body[enc]);
     }
-    mm_file = (char *)ret;
-    close(fd);
     return true;
 }
 
-std::string HttpConn::get_file_type(const std::string &fp) {
-    const auto pos = fp.find_last_of('.');
-    if (pos == std::string::npos) {
-        return "text/html";
-    }
-    std::string suffix = fp.substr(pos);
-    const auto it = SUFFIX_TYPE.find(suffix);
-    if (it != SUFFIX_TYPE.end()) {
-        return it->second;
+int HttpConn::map_resource(const char *fp, const char *etag, size_t etag_len,
+    struct stat &st, char *&file
+) {
+    file = nullptr;
+    int ret = stat(fp, &st);
+    if (ret == -1) {
+        // 请求的资源不存在返回 Not Found，其他错误返回 Internal Server Error
+        return errno == ENOENT ? 404 : 500;
+    } else if (S_ISDIR(st.st_mode)) {
+        // 请求的资源是一个目录，设置 Not Found 错误码
+        return 404;
+    } else if (!(st.st_mode & S_IROTH)) {
+        // 请求的资源没有读取权限，设置 Forbidden 错误码
+        // 如果不想让客户端知道这个资源是没有权限访问的，可以返回404
+        // 从而让客户端认为要访问的资源不存在，而不是禁止访问
+        // "An origin server that wishes to "hide" the current existence of a
+        // forbidden target resource MAY instead respond with a status code of
+        // 404 (Not Found)."  -- from RFC7231 6.5.3
+        return 403;
     }
-    return "text/html";
-}
 
-void HttpConn::set_err_content() {
-    if (response.status_code == 200) return;
-    const auto &target = CODE_PATH.find(response.status_code);
-    if (target != CODE_PATH.end()) {
-        if (!check_resource_and_map(src_dir + target->second)) {
-            response.body = get_default_err_content();
-            response.headers["content-type"] = "text/html";
-            response.headers["content-length"] = std::to_string(response.body.size());
-        }
-    } else {
-        response.body = get_default_err_content();
-        response.headers["content-type"] = "text/html";
-        response.headers["content-length"] = std::to_string(response.body.size());
-    }
-}
-
-std::string HttpConn::get_default_err_content() {
-    std::ostringstream content;
-    auto status_code = response.status_code;
-    content << "<html>\n<head><title>" 
-            << status_code << ' ' << STATUS_TEXT.at(status_code)
-            << "</title></head>\n<body>\n<center><h1>"
-            << status_code << ' ' << STATUS_TEXT.at(status_code)
-            << "</h1></center>\n<hr><center>"
-            << _VENDOR_NAME << "/" << _VERSION_STRING
-            << "</center>\n</body>\n</html>";
-    return content.str();
-}
-
-void HttpConn::set_status_line() {
-    response.version = "HTTP/1.1";
-    auto &status_code = response.status_code;
-    const auto &it = STATUS_TEXT.find(status_code);
-    if (it != STATUS_TEXT.end()) {
-        response.status_text = it->second;
-    } else {
-        status_code = 400;
-        response.status_text = "Bad Request";
+    // 处理客户端的条件请求
+    char tag[40];
+    size_t tag_len = gen_etag(st, tag, sizeof(tag));
+    if (etag_len == tag_len && std::memcmp(etag, tag, tag_len) == 0) {
+        return 304;
     }
-}
 
-void HttpConn::set_headers() {
-    auto &headers = response.headers;
-    headers["connection"] = is_keep_alive() ? "keep-alive" : "close";
-    if (mm_file || response.status_code == 304) {
-        auto tv_ = mm_file_stat.st_mtim.tv_sec;
-        headers["last-modified"] = http_gmt(tv_);
-        headers["etag"] = dec2hexstr(tv_) + '-' + dec2hexstr(mm_file_stat.st_size);
+    // 请求的资源没有问题，将其映射到内存，打开或映射失败返回 Internal Server Error
+    int fd = open(fp, O_RDONLY);
+    if (fd < 0) {
+        return 500;
+    }
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return 500;
     }
-    headers["date"] = http_gmt();
-    headers["server"] = std::string(_VENDOR_NAME) + '/' + _VERSION_STRING;
+    file = static_cast<char *>(addr);
+    return 200;
 }
 
 void HttpConn::unmap_file() {
-    if (mm_file) {
-        munmap(mm_file, mm_file_stat.st_size);
+    if (mm_file || bundled) {
+        if (mm_file && !bundled) {
+            munmap(mm_file, mm_file_stat.st_size);
+        }
         memset(&mm_file_stat, '\0', sizeof(mm_file_stat));
         mm_file = nullptr;
+        bundled = nullptr;
+        bundled_enc = BUNDLE_IDENTITY;
     }
 }
 
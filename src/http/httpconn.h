@@ -8,13 +8,52 @@
 #define HTTPCONN_H
 
 #include <atomic>
+#include <cstdint>
+#include <functional>
 #include <arpa/inet.h>
 #include <sys/uio.h>
 #include <sys/stat.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include "../buffer/buffer.h"
+#include "../arena/arena.h"
 #include "httprequest.h"
 #include "httpresponse.h"
+#include "httpbody.h"
+#include "multipart.h"
+#include "http2.h"
+#include "../tls/tlsconn.h"
+#include "../user/userstore.h"
+#include "../user/sessionstore.h"
+#include "../config/rcuptr.hpp"
+#include "../bundle/bundle.h"
 
+class AsyncSQLPool;
+class RegistrationBatcher;
+
+/**
+ * @brief 慢客户端防护相关的限制
+ *
+ * 超时时间的单位为毫秒，速率的单位为字节/秒，取值为 0 表示不限制
+*/
+struct ConnLimits {
+    int header_timeout;       // 从请求的第一个字节到请求头结束的最长时间
+    int body_timeout;         // 接收请求体的最长时间
+    int send_timeout;         // 发送一个响应的最长时间
+    int process_timeout;      // 请求接收完成之后到开始发送响应的最长时间
+    int min_recv_rate;        // 接收请求体的最低速率
+    int min_send_rate;        // 发送响应的最低速率
+    int rate_grace;           // 开始检查最低速率之前的宽限期
+    size_t max_request_line;  // 请求行的最大长度，超出返回 414
+    size_t max_header_size;   // 请求头的最大总长度，超出返回 431
+    size_t max_body_size;     // 请求体的最大长度，超出返回 413
+    size_t body_buffer_size;  // 在内存中缓存的请求体的最大长度，更大的请求体暂存到文件
+    int keepalive_timeout;    // 两个请求之间保持连接的最长空闲时间，0 表示不保持连接
+    int keepalive_requests;   // 一个连接上最多处理的请求数目，0 表示不限制
+
+    ConnLimits();
+};
 
 class HttpConn {
 public:
@@ -32,47 +71,268 @@ public:
         NOT_FINISH   // 解析失败（不完整的 HTTP 请求）
     };
 
+    /**
+     * @brief 连接当前所处的 I/O 阶段，每个阶段有各自的截止时间
+    */
+    enum IO_PHASE {
+        IDLE,         // 等待新的请求（第一个请求之前受空闲超时的限制，之后受 keepalive_timeout 的限制）
+        RECV_HEADER,  // 接收请求行和请求头
+        RECV_BODY,    // 接收请求体
+        PROCESS,      // 请求已经完整接收，等待其他线程生成响应，受 process_timeout 的限制
+        SEND          // 发送响应
+    };
+
+    /**
+     * @brief 在主线程上就地处理请求的结果
+    */
+    enum INLINE_RESULT {
+        INLINE_READ,   // 没有完整的请求，等待更多的数据
+        INLINE_WRITE,  // 响应已经生成，可以直接发送
+        INLINE_DEFER   // 需要可能阻塞的工作，交给工作线程调用 process() 继续处理
+    };
+
+    /**
+     * @brief 请求的工作类别，不同类别的工作由各自的线程池执行，互不拖累
+    */
+    enum WORK_CLASS {
+        WORK_STATIC,   // 静态资源，以及协议处理等其余的工作
+        WORK_DB,       // 需要访问数据库（登录、注册）
+        WORK_CPU,      // 计算密集的工作
+        WORK_CLASS_NUM
+    };
+
     HttpConn();
     ~HttpConn();
 
     HttpConn::PARSE_RESULT parse(Buffer &buf);
     void make_response();
 
-    void init(int sock_fd, const sockaddr_in &addr_);
+    /**
+     * @param tls_ctx TLS 监听端口上的连接使用的上下文，明文连接为 nullptr
+    */
+    void init(int sock_fd, const sockaddr_in &addr_, const TlsContext *tls_ctx = nullptr);
     void close_conn();
     ssize_t read(int *save_errno);
     ssize_t write(int *save_errno);
     bool process();
+
+    /**
+     * @brief 读事件能否在主线程上处理：TLS 握手、HTTP/2 和请求体的接收都交给工作线程
+    */
+    bool can_read_inline() const;
+
+    /**
+     * @brief 待发送的响应能否在主线程上直接写出：映射的文件不超过 max_bytes
+    */
+    bool can_write_inline(size_t max_bytes) const;
+
+    /**
+     * @brief 在主线程上处理读缓冲区中的请求
+     *
+     * 只处理完整的、没有请求体的 GET/HEAD 请求，并且目标是不超过 max_file_size 的打包文件；
+     * 其余情况原样交给工作线程，或者在解析之后交给工作线程生成响应
+    */
+    INLINE_RESULT process_inline(size_t max_file_size);
+
+    /**
+     * @brief 已经解析、等待交给其他线程池生成响应的请求的工作类别
+     *
+     * process() 返回 false 或者 process_inline() 返回 INLINE_DEFER 之后调用，
+     * 返回 WORK_STATIC 以外的类别时应把 process() 交给该类别的线程池
+    */
+    WORK_CLASS pending_work() const;
+
+    /**
+     * @brief 不再处理已经解析的请求，直接生成错误响应（例如线程池过载时的 503）
+    */
+    void reject(int code);
+
+    /**
+     * @brief 通过非阻塞的连接池处理登录和注册表单，查询期间不占用线程
+     *
+     * pending_work() 为 WORK_DB 时调用；响应生成之后调用 done，连接在此期间被关闭时不调用
+    */
+    void query_user_form(AsyncSQLPool &db, std::function<void()> done);
+
+    /**
+     * @brief 已经解析、等待处理的请求是否为注册表单
+    */
+    bool is_registration() const;
+
+    /**
+     * @brief 把注册表单交给写入线程，与其他请求的注册合并在一个事务中插入
+     *
+     * is_registration() 为真时调用；所在的一批提交之后在写入线程中以结果调用 done，
+     * 这时连接可能已经被关闭，调用方应当回到主线程确认连接仍然有效后再调用 finish_user_form()
+    */
+    void queue_registration(RegistrationBatcher &batcher, UserStore::Done done);
+
+    /**
+     * @brief 按登录或注册的结果生成响应
+    */
+    void finish_user_form(UserStore::RESULT res);
+
     int get_fd() const;
     int get_port() const;
     const char* get_ip();
     sockaddr_in get_addr() const;
 
+    /**
+     * @brief 当前的响应发送完之后是否保持连接，在生成响应时确定
+    */
     bool is_keep_alive() const;
+    bool is_closed() const;
+
+    /**
+     * @brief 连接是否已经切换到 HTTP/2
+    */
+    bool is_http2() const;
+
+    /**
+     * @brief 是否为 TLS 连接
+    */
+    bool is_tls() const;
+
+    IO_PHASE get_phase() const;
+
+    /**
+     * @brief 当前阶段的截止时间，综合了阶段超时和最低速率两项限制
+     * @return 截止时间（`now_ms()` 的时间基准），第一个请求之前的空闲阶段或不受限时返回 -1
+    */
+    int64_t get_deadline() const;
+
+    /**
+     * @brief 单调时钟的当前时间（单位为毫秒）
+    */
+    static int64_t now_ms();
+
+    /**
+     * @brief 请求超时后直接发送的 408 响应
+    */
+    static const std::string& timeout_response();
+
+    /**
+     * @brief 把连接交给线程池之前把自身的引用放进任务槽，排队的任务只需要保存裸指针
+    */
+    void pin_task(std::shared_ptr<HttpConn> self) {
+        worker_owned.store(true, std::memory_order_release);
+        task_pin = std::move(self);
+    }
+
+    /**
+     * @brief 工作线程开始执行任务时取出任务槽中的引用
+    */
+    std::shared_ptr<HttpConn> take_task() { return std::move(task_pin); }
+
+    /**
+     * @brief 连接是否由工作线程持有：交给线程池时置位，工作线程重新注册事件之前清除；
+     *        主线程不能关闭这样的连接，只能 shutdown 它的 socket，由工作线程关闭
+    */
+    bool is_worker_owned() const { return worker_owned.load(std::memory_order_acquire); }
+    void release_to_reactor() { worker_owned.store(false, std::memory_order_release); }
+
+    int64_t last_active;    // 最近一次 I/O 事件的时间，仅由主线程读写
 
     int to_write_bytes() {
         return iov[0].iov_len + iov[1].iov_len;
     }
 
     static std::string src_dir;
+    static const StaticBundle *bundle;  // 打包的静态资源，打包了的路径不再访问 src_dir
+    static std::string spool_dir;   // 暂存请求体的目录
     static bool is_ET;
+    static bool use_cork;   // 发送“响应头 + 文件”时是否使用 TCP_CORK
+    static bool enable_h2;  // 是否接受 HTTP/2 (h2c)：prior knowledge 和 Upgrade 两种方式
+    static bool enable_db;  // 是否启用了数据库，否则登录和注册返回 503
     static std::atomic<int> conn_count;
+    static std::atomic<bool> draining;  // 服务器正在平滑退出，响应之后不再保持连接
+    static RcuPtr<ConnLimits> limits;   // 可以在运行时整体替换，新的请求使用新的限制
 private:
-    bool parse_requestline(const std::string &line);
-    bool parse_uri(const std::string &uri);
-    bool parse_header(const std::string &line);
-    void parse_body(const std::string &content);
+    bool parse_requestline(const char *begin, const char *end);
+    bool parse_uri(const ArenaString &uri);
+    bool parse_header(const char *begin, const char *end);
+    bool begin_body(const Buffer &buf);
+    /**
+     * @brief 发送 write_buf 中的临时响应（100 Continue），TLS 连接上经过记录层加密
+     *
+     * 没有写完的部分留在 write_buf 的开头，随最终的响应一起重试
+    */
+    void send_interim();
+    bool append_body(const char *data, size_t len);
+    bool finish_body();
+    bool open_spool();
+    bool on_part_begin(const MultipartPart &part);
+    bool on_part_data(const char *data, size_t len);
+    bool on_part_end();
+    bool handshake(int *save_errno);
+    bool wants_h2_upgrade() const;
+    bool upgrade_h2();
+    bool process_h2();
+    void on_h2_request(Http2Stream &stream);
     void parse_post();
     void parse_form_urlencoded();
+    void reset_request();
+    void respond();
+
+    /**
+     * @brief 按请求的方法和路径确定工作类别，必须在请求解析完成之后调用
+    */
+    WORK_CLASS classify() const;
+
+    /**
+     * @brief 按会话处理请求：注销、未登录时访问受保护的页面；登录总是查询数据库校验密码
+     * @return 是否已经生成了响应（重定向），否则按普通的请求继续处理
+    */
+    bool handle_session();
+
+    /**
+     * @brief 处理登录和注册表单，以 303 重定向到结果页面
+    */
+    void handle_user_form();
+
+    /**
+     * @brief 根据登录或注册的结果设置响应的状态码和重定向的位置
+    */
+    void set_user_form_result(UserStore::RESULT res);
+
+    /**
+     * @brief 读缓冲区的开头是否为一个完整的、没有请求体的 GET 或 HEAD 请求
+    */
+    static bool is_simple_request(const Buffer &buf);
 
-    void set_status_line();
-    void set_headers();
-    bool check_resource_and_map(const std::string &fp);
-    bool map_file(const std::string &fp);
-    std::string get_file_type(const std::string &fp);
-    void set_err_content();
-    std::string get_default_err_content();
+    ArenaString get_file_path(const char *path, size_t len);
+    bool check_resource_and_map(const ArenaString &fp);
+
+    /**
+     * @brief 在打包的静态资源中查找请求的路径，按 Accept-Encoding 选择编码
+     * @return 是否打包了这个路径，是则已经设置了状态码（200 或 304）和响应的内容
+    */
+    bool check_bundle();
+
+    /**
+     * @brief 检查静态资源并将其映射到内存
+     * @param fp 资源文件的路径
+     * @param etag 客户端的 If-None-Match，与资源的 ETag 相同时不映射文件
+     * @param etag_len If-None-Match 的长度
+     * @param st 资源文件的状态信息
+     * @param file 映射的地址，只在返回 200 时有效
+     * @return 响应的状态码：200、304、403、404 或 500
+    */
+    static int map_resource(const char *fp, const char *etag, size_t etag_len,
+        struct stat &st, char *&file);
+    static size_t gen_etag(const struct stat &st, char *buf, size_t size);
+    /**
+     * @brief 静态资源的响应头：Last-Modified、ETag、Vary，200 时还有 Content-Type 和 Content-Encoding；
+     *        HTTP/1.x 和 HTTP/2 共用，add(name, value, len) 把字段写入各自的响应头
+     * @param code 200 或 304
+     * @param file 打包的文件，为空时按 st 和 path 生成
+    */
+    template <typename AddHeader>
+    static void add_resource_headers(int code, const StaticBundle::File *file, BUNDLE_ENCODING enc,
+        const struct stat &st, const char *path, size_t len, AddHeader add);
     void unmap_file();
+    void set_phase(IO_PHASE phase, int64_t bytes = 0);
+    bool decide_keep_alive() const;
     const char * get_mm_file() const;
     decltype(stat::st_size) get_mm_file_len() const;
 
@@ -80,24 +340,93 @@ private:
     struct sockaddr_in addr;
     char ip[32];
     bool is_close;
+    bool is_corked;         // 当前是否处于 TCP_CORK 状态
     int iov_cnt;
     struct iovec iov[2];
     PARSE_STATE state;    // 请求的解析状态
+    int err_code;         // 解析失败时返回的状态码
+    size_t header_bytes;  // 已解析的请求头字节数
+    bool keep_alive;      // 当前的响应之后是否保持连接
+    bool is_deferred;     // 请求已经解析，工作线程只需生成响应
+    WORK_CLASS work_class;  // 已经解析的请求的工作类别
+    std::atomic<int> request_cnt;  // 连接上已经处理的请求数目，由主线程读取
+
+    enum BODY_MODE {
+        BODY_NONE,     // 没有请求体
+        BODY_LENGTH,   // 长度由 Content-Length 给出
+        BODY_CHUNKED   // Transfer-Encoding: chunked
+    };
+
+    /**
+     * @brief 把解码后的请求体交给连接对象
+    */
+    struct ConnBodySink : public BodySink {
+        explicit ConnBodySink(HttpConn *conn_) : conn(conn_) {}
+        bool write(const char *data, size_t len) override {
+            return conn->append_body(data, len);
+        }
+        HttpConn *conn;
+    };
+
+    /**
+     * @brief 把 multipart/form-data 中的各个部分交给连接对象
+    */
+    struct FormHandler : public MultipartHandler {
+        explicit FormHandler(HttpConn *conn_) : conn(conn_) {}
+        bool on_part_begin(const MultipartPart &part) override {
+            return conn->on_part_begin(part);
+        }
+        bool on_part_data(const char *data, size_t len) override {
+            return conn->on_part_data(data, len);
+        }
+        bool on_part_end() override {
+            return conn->on_part_end();
+        }
+        HttpConn *conn;
+    };
+
+    /**
+     * @brief 把 HTTP/2 流上的请求交给连接对象
+    */
+    struct H2Handler : public Http2Handler {
+        explicit H2Handler(HttpConn *conn_) : conn(conn_) {}
+        void on_request(Http2Stream &stream) override {
+            conn->on_h2_request(stream);
+        }
+        HttpConn *conn;
+    };
+
+    BODY_MODE body_mode;
+    uint64_t body_remaining;    // Content-Length 模式下还没有收到的字节数
+    uint64_t body_received;     // 已经收到的请求体字节数（解码后）
+    ChunkedDecoder chunked;
+    ConnBodySink body_sink;
+    std::unique_ptr<FileSpool> spool;  // 暂存大请求体的临时文件，按需创建
+    bool is_multipart;                 // 请求体是否为 multipart/form-data
+    std::unique_ptr<MultipartParser> multipart;  // 按需创建，之后的请求复用
+    FormHandler form_handler;
+    std::vector<std::unique_ptr<FileSpool>> uploads;  // 上传文件的临时文件
+    size_t upload_cnt;                 // 当前请求使用的上传文件数目
+    FileSpool *cur_file;               // 正在接收的文件部分
+    ArenaString *cur_field;            // 正在接收的普通字段的值
+    H2Handler h2_handler;
+    std::unique_ptr<Http2Session> h2;  // 切换到 HTTP/2 之后的协议状态
+    std::unique_ptr<TlsConn> tls;      // TLS 连接的记录层，明文连接为空
+    // 阶段信息由工作线程更新，由主线程（定时器）读取
+    std::atomic<int> phase;              // 当前的 I/O 阶段
+    std::atomic<int64_t> phase_start;    // 进入当前阶段的时间
+    std::atomic<int64_t> phase_bytes;    // 当前阶段已经收发的字节数
     Buffer read_buf;
     Buffer write_buf;
     char * mm_file;              // 文件映射到内存中的地址
     struct stat mm_file_stat;    // 被映射文件的状态信息
+    const StaticBundle::File *bundled;  // 响应来自打包的资源时不为空，mm_file 指向打包文件的映射
+    BUNDLE_ENCODING bundled_enc;        // 选择的编码
+    Arena arena;                 // 请求和响应的分配区，在请求之间回卷
+    std::shared_ptr<HttpConn> task_pin;  // 在线程池中排队期间持有连接对象
+    std::atomic<bool> worker_owned;      // 连接交给了工作线程，主线程不能关闭
     HttpRequest request;
     HttpResponse response;
-
-    static const std::regex re_requestline;
-    static const std::regex re_header;
-    // 文件扩展名到媒体类型的映射表
-    static const std::unordered_map<std::string,std::string> SUFFIX_TYPE;
-    // 状态码到状态信息的映射表
-    static const std::unordered_map<int,std::string> STATUS_TEXT;
-    // 状态码到响应资源文件的映射表
-    static const std::unordered_map<int,std::string> CODE_PATH;
 };
 
 #endif // HTTPCONN_H
\ No newline at end of file
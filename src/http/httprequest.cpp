@@ -4,51 +4,75 @@
  * @date 2024-03-28
  * @brief source file for http-request
 */
-#include <regex>
-#include <algorithm>
-#include <mysql/mysql.h>
-#include <cstring>
 #include "httprequest.h"
-#include "../log/log.h"
-#include "../pool/sqlconnRAII.hpp"
-#include "../pool/sqlconnpool.h"
-#include "../util/util.h"
 
 
+namespace {
+const ArenaString EMPTY_STR;
+}
+
+HttpRequest::HttpRequest(Arena *arena)
+: alloc(arena), method(alloc), request_uri(alloc), path(alloc), query(alloc),
+version(alloc), body(alloc), headers(alloc), post(alloc), body_fd(-1), body_size(0) {}
+
 void HttpRequest::init() {
-    request_uri = method = path = version = body = "";
-    headers.clear();
-    post.clear();
+    release_container(method);
+    release_container(request_uri);
+    release_container(path);
+    release_container(query);
+    release_container(version);
+    release_container(body);
+    release_container(headers);
+    release_container(post);
+    body_fd = -1;
+    body_size = 0;
+    release_container(files);
 }
 
-std::string HttpRequest::get_path() const {
+const ArenaString& HttpRequest::get_path() const {
     return path;
 }
 
-std::string& HttpRequest::get_path() {
+ArenaString& HttpRequest::get_path() {
     return path;
 }
 
-std::string HttpRequest::get_method() const {
+const ArenaString& HttpRequest::get_method() const {
     return method;
 }
 
-std::string HttpRequest::get_version() const {
+const ArenaString& HttpRequest::get_version() const {
     return version;
 }
 
-std::string HttpRequest::get_post(const std::string &key) const {
+const ArenaString& HttpRequest::get_post(const ArenaString &key) const {
     auto target = post.find(key);
     if (target != post.end()) {
         return target->second;
     }
-    return "";
+    return EMPTY_STR;
 }
 
-std::string HttpRequest::get_header(const std::string &key) const {
+const ArenaString& HttpRequest::get_header(const ArenaString &key) const {
     auto target = headers.find(key);
     if (target != headers.end()) {
         return target->second;
     }
-    return "";
+    return EMPTY_STR;
+}
+
+const ArenaString& HttpRequest::get_body() const {
+    return body;
+}
+
+int HttpRequest::get_body_fd() const {
+    return body_fd;
+}
+
+size_t HttpRequest::get_body_size() const {
+    return body_size;
+}
+
+const std::vector<UploadedFile>& HttpRequest::get_files() const {
+    return files;
 }
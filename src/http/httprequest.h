@@ -8,36 +8,83 @@
 #define HTTPREQUEST_H
 
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
-#include <regex>
+#include <vector>
 #include "../buffer/buffer.h"
+#include "../arena/arena.h"
 
 
+/**
+ * @brief 通过 multipart/form-data 上传的文件
+*/
+struct UploadedFile {
+    ArenaString name;          // 表单字段名
+    ArenaString filename;      // 客户端提供的文件名
+    ArenaString content_type;  // 文件的媒体类型
+    int fd;                    // 保存文件内容的匿名临时文件，读写位置在开头
+    size_t size;               // 文件大小
+
+    UploadedFile(const ArenaAllocator<char> &alloc)
+    : name(alloc), filename(alloc), content_type(alloc), fd(-1), size(0) {}
+};
+
 class HttpRequest {
 public:
     friend class HttpConn;
 
-    HttpRequest() { init(); }
+    /**
+     * @brief 构造一个 HTTP 请求对象
+     * @param arena 存放请求中所有字符串和映射表的分配区，为空时使用全局堆
+    */
+    explicit HttpRequest(Arena *arena = nullptr);
     ~HttpRequest() = default;
 
+    /**
+     * @brief 清空请求，释放所有容器对分配区的引用
+     * @note 调用者需在此之后才能回卷分配区
+    */
     void init();
 
-    std::string get_path() const;
-    std::string& get_path();
-    std::string get_method() const;
-    std::string get_version() const;
-    std::string get_post(const std::string &key) const;
-    std::string get_header(const std::string &key) const;
+    const ArenaString& get_path() const;
+    ArenaString& get_path();
+    const ArenaString& get_method() const;
+    const ArenaString& get_version() const;
+    const ArenaString& get_post(const ArenaString &key) const;
+    const ArenaString& get_header(const ArenaString &key) const;
+
+    /**
+     * @brief 请求体，较大的请求体被暂存到临时文件中，此时为空
+    */
+    const ArenaString& get_body() const;
+
+    /**
+     * @brief 暂存请求体的临时文件，请求体在内存中时为 -1
+     * @note 文件由连接对象持有，在请求处理完毕后关闭
+    */
+    int get_body_fd() const;
+
+    /**
+     * @brief 请求体的长度（解码后）
+    */
+    size_t get_body_size() const;
+
+    /**
+     * @brief multipart/form-data 请求中上传的文件
+     * @note 临时文件由连接对象持有，在请求处理完毕后关闭
+    */
+    const std::vector<UploadedFile>& get_files() const;
 private:
-    std::string method;   // 请求方法
-    std::string request_uri;
-    std::string path;     // 要访问的资源路径
-    std::unordered_map<std::string,std::string> query;
-    std::string version;  // HTTP 版本
-    std::string body;     // 请求的消息体
-    std::unordered_map<std::string,std::string> headers;  // 请求头部
-    std::unordered_map<std::string,std::string> post;  // POST请求
+    ArenaAllocator<char> alloc;
+    ArenaString method;   // 请求方法
+    ArenaString request_uri;
+    ArenaString path;     // 要访问的资源路径
+    ArenaMap<ArenaString> query;
+    ArenaString version;  // HTTP 版本
+    ArenaString body;     // 请求的消息体
+    ArenaMap<ArenaString> headers;  // 请求头部
+    ArenaMap<ArenaString> post;  // POST请求
+    int body_fd;          // 暂存请求体的临时文件
+    size_t body_size;     // 请求体的长度
+    std::vector<UploadedFile> files;  // 上传的文件
 };
 
-#endif
\ No newline at end of file
+#endif
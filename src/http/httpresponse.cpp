@@ -7,16 +7,16 @@
 #include "httpresponse.h"
 
 
-HttpResponse::HttpResponse() : status_code(200), version("HTTP/1.1") {}
+HttpResponse::HttpResponse(Arena *arena)
+: status_code(200), content_length(0), headers(arena), body(arena) {}
 
 HttpResponse::~HttpResponse() {}
 
 void HttpResponse::init() {
     status_code = 200;
-    version.clear();
-    status_text.clear();
-    headers.clear();
-    body.clear();
+    content_length = 0;
+    release_container(headers);
+    release_container(body);
 }
 
 int HttpResponse::get_status_code() const {
@@ -24,24 +24,5 @@ int HttpResponse::get_status_code() const {
 }
 
 size_t HttpResponse::get_content_length() const {
-    const auto &it = headers.find("content-length");
-    size_t content_length = 0;
-    if (it != headers.end() && !it->second.empty()) {
-        content_length = std::stol(it->second);
-    }
     return content_length;
 }
-
-std::string HttpResponse::get_status_line() const {
-    // Status-Line = HTTP-Version SP Status-Code SP Reason-Phrase CRLF
-    return version + ' ' + std::to_string(status_code) + ' ' + status_text + "\r\n";
-}
-
-std::string HttpResponse::get_headers() const {
-    std::string headers_str;
-    for (const auto &p : headers) {
-        headers_str.append(p.first + ": " + p.second + "\r\n");
-    }
-    headers_str.append("\r\n");
-    return headers_str;
-}
\ No newline at end of file
@@ -7,28 +7,34 @@
 #ifndef HTTP_RESPONSE_H
 #define HTTP_RESPONSE_H
 
-#include <unordered_map>
 #include <string>
+#include "../arena/arena.h"
 
 class HttpResponse {
 public:
     friend class HttpConn;
 
-    HttpResponse();
+    /**
+     * @brief 构造一个 HTTP 响应对象
+     * @param arena 存放响应中所有字符串和映射表的分配区，为空时使用全局堆
+    */
+    explicit HttpResponse(Arena *arena = nullptr);
     ~HttpResponse();
 
+    /**
+     * @brief 清空响应，释放所有容器对分配区的引用
+     * @note 调用者需在此之后才能回卷分配区
+    */
     void init();
     int get_status_code() const;
     size_t get_content_length() const;
-    std::string get_status_line() const;
-    std::string get_headers() const;
 
 private:
     int status_code;
-    std::string status_text;
-    std::string version;
-    std::unordered_map<std::string,std::string> headers;
-    std::string body;
+    size_t content_length;
+    // 额外的响应头；状态行和常用的响应头由 ResponseWriter 直接写入写缓冲区
+    ArenaMap<ArenaString> headers;
+    ArenaString body;
 };
 
-#endif // HTTP_RESPONSE_H
\ No newline at end of file
+#endif // HTTP_RESPONSE_H
@@ -0,0 +1,70 @@
+/**
+ * @file mimetype.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for media types of static resources
+*/
+#include "mimetype.h"
+#include <unordered_map>
+
+// 文件扩展名到媒体类型的映射表
+static const std::unordered_map<std::string, std::string> SUFFIX_TYPE = {
+    { ".html",  "text/html" },
+    { ".xml",   "text/xml" },
+    { ".xhtml", "application/xhtml+xml" },
+    { ".txt",   "text/plain" },
+    { ".rtf",   "application/rtf" },
+    { ".pdf",   "application/pdf" },
+    { ".doc",   "application/msword" },
+    { ".docx",  "application/vnd.openxmlformats-officedocument.wordprocessingml.document"},
+    { ".xls",   "application/vnd.ms-excel"},
+    { ".xlsx",  "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"},
+    { ".ppt",   "application/vnd.ms-powerpoint"},
+    { ".pptx",  "application/vnd.openxmlformats-officedocument.presentationml.presentation"},
+    { ".ico",   "image/vnd.microsoft.icon"},
+    { ".tif",   "image/tiff"},
+    { ".tiff",  "image/tiff"},
+    { ".svg",   "image/svg+xml"},
+    { ".png",   "image/png" },
+    { ".webp",  "image/webp"},
+    { ".gif",   "image/gif" },
+    { ".jpg",   "image/jpeg" },
+    { ".jpeg",  "image/jpeg" },
+    { ".mp3",   "audio/mpeg"},
+    { ".mpeg",  "video/mpeg"},
+    { ".mpv",   "video/mpv" },
+    { ".mp4",   "video/mp4" },
+    { ".avi",   "video/x-msvideo" },
+    { ".gz",    "application/x-gzip" },
+    { ".tar",   "application/x-tar" },
+    { ".rar",   "application/vnd.rar"},
+    { ".7z",    "application/x-7z-compressed"},
+    { ".css",   "text/css"},
+    { ".js",    "text/javascript"},
+    { ".json",  "application/json"},
+    { ".woff",  "font/woff"},
+    { ".woff2", "font/woff2"},
+    { ".ttf",   "font/ttf"},
+    { ".otf",   "font/otf"},
+    { ".eot",   "application/vnd.ms-fontobject"}
+};
+
+const std::string& mime_type(const char *path, size_t len) {
+    static const std::string DEFAULT_TYPE("text/html");
+    const char *dot = nullptr;
+    for (const char *p = path + len; p > path; --p) {
+        if (p[-1] == '.') {
+            dot = p - 1;
+            break;
+        }
+    }
+    if (!dot) {
+        return DEFAULT_TYPE;
+    }
+    std::string suffix(dot, path + len - dot);
+    const auto it = SUFFIX_TYPE.find(suffix);
+    if (it != SUFFIX_TYPE.end()) {
+        return it->second;
+    }
+    return DEFAULT_TYPE;
+}
@@ -0,0 +1,20 @@
+/**
+ * @file mimetype.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for media types of static resources
+*/
+#ifndef MIMETYPE_H
+#define MIMETYPE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief 按文件扩展名确定静态资源的媒体类型，未知的扩展名按 text/html 处理
+ *
+ * 服务器和 yawn-pack 共用，打包的文件与直接从目录读取时的 Content-Type 相同
+*/
+const std::string& mime_type(const char *path, size_t len);
+
+#endif // MIMETYPE_H
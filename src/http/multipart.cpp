@@ -0,0 +1,235 @@
+/**
+ * @file multipart.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for streaming multipart/form-data parser
+*/
+#include <cstring>
+#include <algorithm>
+#include "multipart.h"
+#include "../util/util.h"
+
+// 一个部分的头部的最大长度
+static const size_t MAX_PART_HEADER = 8192;
+// boundary 的最大长度 (RFC 2046)
+static const size_t MAX_BOUNDARY = 70;
+
+
+void BMHSearcher::set_pattern(const std::string &pattern) {
+    m_pattern = pattern;
+    size_t m = m_pattern.size();
+    for (auto &skip : m_skip) {
+        skip = m;
+    }
+    for (size_t i=0; i+1<m; ++i) {
+        m_skip[static_cast<unsigned char>(m_pattern[i])] = m - 1 - i;
+    }
+}
+
+size_t BMHSearcher::find(const char *text, size_t n) const {
+    size_t m = m_pattern.size();
+    if (m == 0 || n < m) return n;
+    const char *pat = m_pattern.data();
+    const char last = pat[m - 1];
+    size_t pos = 0;
+    while (pos <= n - m) {
+        char ch = text[pos + m - 1];
+        if (ch == last && std::memcmp(text + pos, pat, m - 1) == 0) {
+            return pos;
+        }
+        pos += m_skip[static_cast<unsigned char>(ch)];
+    }
+    return n;
+}
+
+/**
+ * @brief 在 `; key=value` 形式的参数列表中查找参数，值可以带引号
+*/
+static bool find_param(const char *begin, const char *end, const char *key, std::string &val) {
+    size_t key_len = std::strlen(key);
+    const char *p = begin;
+    while (p < end) {
+        p = std::find(p, end, ';');
+        if (p == end) break;
+        ++p;
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        const char *eq = std::find(p, end, '=');
+        if (eq == end) break;
+        bool matched = static_cast<size_t>(eq - p) == key_len &&
+            str_case_equal(p, key_len, key);
+        const char *v = eq + 1;
+        const char *v_end;
+        if (v < end && *v == '"') {
+            ++v;
+            v_end = std::find(v, end, '"');
+            p = v_end == end ? end : v_end + 1;
+        } else {
+            v_end = std::find(v, end, ';');
+            while (v_end > v && (v_end[-1] == ' ' || v_end[-1] == '\t')) --v_end;
+            p = v_end;
+        }
+        if (matched) {
+            val.assign(v, v_end);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MultipartParser::get_boundary(const std::string &content_type, std::string &boundary) {
+    static const char TYPE[] = "multipart/form-data";
+    const size_t type_len = sizeof(TYPE) - 1;
+    if (content_type.size() < type_len ||
+        !str_case_equal(content_type.data(), type_len, TYPE)) {
+        return false;
+    }
+    const char *begin = content_type.data() + type_len;
+    const char *end = content_type.data() + content_type.size();
+    if (!find_param(begin, end, "boundary", boundary)) {
+        return false;
+    }
+    return !boundary.empty() && boundary.size() <= MAX_BOUNDARY;
+}
+
+void MultipartParser::reset(const std::string &boundary, MultipartHandler *handler) {
+    m_handler = handler;
+    m_state = PREAMBLE;
+    m_delim.set_pattern("\r\n--" + boundary);
+    m_first.set_pattern("--" + boundary);
+    m_carry.clear();
+}
+
+bool MultipartParser::write(const char *data, size_t len) {
+    while (len > 0) {
+        if (m_carry.empty()) {
+            // 常见情况：直接在新数据上查找，只把末尾无法判断的几个字节暂存起来
+            ssize_t used = consume(data, len);
+            if (used < 0) return false;
+            m_carry.assign(data + used, len - used);
+            break;
+        }
+        // 把新数据的开头补到暂存数据之后，补足到能判断出暂存数据归属的长度
+        size_t old = m_carry.size();
+        size_t take = std::min(len, std::max(m_delim.pattern().size(), static_cast<size_t>(512)));
+        m_carry.append(data, take);
+        ssize_t used = consume(m_carry.data(), m_carry.size());
+        if (used < 0) return false;
+        if (static_cast<size_t>(used) >= old) {
+            // 暂存的数据已经处理完，剩下的新数据回到直接处理的路径上
+            size_t from_data = used - old;
+            m_carry.clear();
+            data += from_data;
+            len -= from_data;
+        } else {
+            m_carry.erase(0, used);
+            data += take;
+            len -= take;
+        }
+        if (m_carry.size() > MAX_PART_HEADER + m_delim.pattern().size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MultipartParser::finish() {
+    return m_state == END;
+}
+
+ssize_t MultipartParser::consume(const char *data, size_t len) {
+    const char *p = data, *end = data + len;
+    while (p < end) {
+        size_t n = end - p;
+        if (m_state == PREAMBLE) {
+            size_t pos = m_first.find(p, n);
+            if (pos == n) {
+                // 只保留可能是分隔符前缀的部分
+                size_t keep = std::min(n, m_first.pattern().size() - 1);
+                p = end - keep;
+                break;
+            }
+            p += pos + m_first.pattern().size();
+            m_state = AFTER_BOUNDARY;
+        } else if (m_state == AFTER_BOUNDARY) {
+            if (n < 2) break;
+            if (p[0] == '-' && p[1] == '-') {
+                p += 2;
+                m_state = END;
+                continue;
+            }
+            // 分隔符之后可以有空白 (transport-padding)，然后是 CRLF
+            const char *q = p;
+            while (q < end && (*q == ' ' || *q == '\t')) ++q;
+            if (end - q < 2) break;
+            if (q[0] != '\r' || q[1] != '\n') return -1;
+            p = q + 2;
+            m_state = HEADERS;
+        } else if (m_state == HEADERS) {
+            const char *hdr_end = nullptr;
+            if (n >= 2 && p[0] == '\r' && p[1] == '\n') {
+                hdr_end = p;  // 没有头部
+            } else {
+                static const char CRLF2[] = "\r\n\r\n";
+                const char *q = std::search(p, end, CRLF2, CRLF2 + 4);
+                if (q == end) {
+                    if (n > MAX_PART_HEADER) return -1;
+                    break;
+                }
+                hdr_end = q + 2;
+            }
+            if (!parse_part_headers(p, hdr_end) || !m_handler->on_part_begin(m_part)) {
+                return -1;
+            }
+            p = hdr_end + 2;
+            m_state = DATA;
+        } else if (m_state == DATA) {
+            size_t delim_len = m_delim.pattern().size();
+            size_t pos = m_delim.find(p, n);
+            if (pos == n) {
+                // 末尾不足一个分隔符长度的部分可能是分隔符的开头，从其中的 CR 开始保留
+                size_t emit = n >= delim_len ? n - (delim_len - 1) : 0;
+                const char *cr = static_cast<const char *>(
+                    std::memchr(p + emit, '\r', n - emit));
+                if (cr) emit = cr - p; else emit = n;
+                if (emit > 0 && !m_handler->on_part_data(p, emit)) return -1;
+                p += emit;
+                break;
+            }
+            if (pos > 0 && !m_handler->on_part_data(p, pos)) return -1;
+            if (!m_handler->on_part_end()) return -1;
+            p += pos + delim_len;
+            m_state = AFTER_BOUNDARY;
+        } else {
+            // 结尾之后的内容全部忽略
+            p = end;
+        }
+    }
+    return p - data;
+}
+
+bool MultipartParser::parse_part_headers(const char *begin, const char *end) {
+    m_part.name.clear();
+    m_part.filename.clear();
+    m_part.content_type.clear();
+    bool has_disposition = false;
+    const char *line = begin;
+    while (line < end) {
+        static const char CRLF[] = "\r\n";
+        const char *line_end = std::search(line, end, CRLF, CRLF + 2);
+        const char *colon = std::find(line, line_end, ':');
+        if (colon == line_end) return false;
+        const char *val = colon + 1;
+        while (val < line_end && (*val == ' ' || *val == '\t')) ++val;
+        size_t name_len = colon - line;
+        if (str_case_equal(line, name_len, "content-disposition")) {
+            // Content-Disposition: form-data; name="field"; filename="a.png"
+            has_disposition = true;
+            find_param(val, line_end, "name", m_part.name);
+            find_param(val, line_end, "filename", m_part.filename);
+        } else if (str_case_equal(line, name_len, "content-type")) {
+            m_part.content_type.assign(val, line_end);
+        }
+        line = line_end == end ? end : line_end + 2;
+    }
+    return has_disposition;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file multipart.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for streaming multipart/form-data parser
+*/
+#ifndef MULTIPART_H
+#define MULTIPART_H
+
+#include <cstddef>
+#include <string>
+#include "httpbody.h"
+
+/**
+ * @brief Boyer-Moore-Horspool 子串查找
+ *
+ * 预处理模式串得到坏字符跳转表，失配时按窗口最后一个字符跳过多个位置，
+ * 边界串较长时平均每次比较能跳过接近模式串长度的字节
+*/
+class BMHSearcher {
+public:
+    BMHSearcher() : m_skip() {}
+
+    /**
+     * @brief 设置模式串并构建跳转表
+     * @param pattern 模式串，不能为空
+    */
+    void set_pattern(const std::string &pattern);
+
+    /**
+     * @brief 在文本中查找模式串
+     * @param text 文本的起始地址
+     * @param n 文本长度（单位为字节）
+     * @return 第一次出现的位置，找不到时返回 n
+    */
+    size_t find(const char *text, size_t n) const;
+
+    const std::string& pattern() const { return m_pattern; }
+
+private:
+    std::string m_pattern;
+    size_t m_skip[256];   // 坏字符跳转表
+};
+
+/**
+ * @brief multipart 中一个部分的描述信息，来自该部分的头部
+*/
+struct MultipartPart {
+    std::string name;           // Content-Disposition 中的 name
+    std::string filename;       // Content-Disposition 中的 filename，为空表示普通字段
+    std::string content_type;   // Content-Type
+};
+
+/**
+ * @brief multipart 解析结果的处理者，各个回调返回 false 时中止解析
+*/
+class MultipartHandler {
+public:
+    virtual ~MultipartHandler() = default;
+    virtual bool on_part_begin(const MultipartPart &part) = 0;
+    virtual bool on_part_data(const char *data, size_t len) = 0;
+    virtual bool on_part_end() = 0;
+};
+
+/**
+ * @brief `multipart/form-data` 的增量解析器
+ *
+ * 作为 BodySink 接收任意切分的请求体，用 BMH 算法在数据流中查找分隔符
+ * `CRLF--boundary`，各部分的数据一边到达一边交给 MultipartHandler，
+ * 只有可能是分隔符前缀的几个字节和不完整的部分头部会被暂存
+ * @code
+ * preamble --boundary CRLF headers CRLF CRLF data
+ *          CRLF--boundary CRLF headers CRLF CRLF data
+ *          CRLF--boundary-- epilogue
+ * @endcode
+*/
+class MultipartParser : public BodySink {
+public:
+    MultipartParser() : m_handler(nullptr), m_state(END) {}
+
+    /**
+     * @brief 从 Content-Type 中提取 boundary 参数
+     * @param content_type 请求头 Content-Type 的值
+     * @param boundary 提取结果
+     * @return 是否为带有合法 boundary 的 multipart/form-data
+    */
+    static bool get_boundary(const std::string &content_type, std::string &boundary);
+
+    /**
+     * @brief 开始解析一个新的请求体
+     * @param boundary 分隔符
+     * @param handler 处理者
+    */
+    void reset(const std::string &boundary, MultipartHandler *handler);
+
+    bool write(const char *data, size_t len) override;
+
+    /**
+     * @brief 请求体结束时调用，检查是否读到了结尾的分隔符
+    */
+    bool finish() override;
+
+private:
+    enum STATE {
+        PREAMBLE,         // 第一个分隔符之前的内容，忽略
+        AFTER_BOUNDARY,   // 分隔符之后：`--` 表示结束，CRLF 表示下一个部分
+        HEADERS,          // 部分的头部
+        DATA,             // 部分的数据
+        END               // 结尾的分隔符之后的内容，忽略
+    };
+
+    /**
+     * @brief 处理一段连续的数据
+     * @return 被消费的字节数，未消费的部分需要与之后的数据一起处理；出错返回 -1
+    */
+    ssize_t consume(const char *data, size_t len);
+
+    bool parse_part_headers(const char *begin, const char *end);
+
+    MultipartHandler *m_handler;
+    STATE m_state;
+    BMHSearcher m_delim;       // CRLF--boundary
+    BMHSearcher m_first;       // --boundary，请求体开头的分隔符前面没有 CRLF
+    std::string m_carry;       // 暂存的未处理数据
+    MultipartPart m_part;      // 当前部分的描述信息
+};
+
+#endif // MULTIPART_H
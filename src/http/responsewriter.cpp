@@ -0,0 +1,201 @@
+/**
+ * @file responsewriter.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for http response writer
+*/
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include "responsewriter.h"
+#include "../util/util.h"
+#include "../version.h"
+
+// 状态码到状态信息的映射表
+static const std::unordered_map<int, std::string> STATUS_TEXT {
+    {100, "Continue"},
+    {101, "Switching Protocols"},
+    {200, "OK"},
+    {303, "See Other"},
+    {304, "Not Modified"},
+    {400, "Bad Request"},
+    {403, "Forbidden"},
+    {404, "Not Found"},
+    {405, "Method Not Allowed"},
+    {408, "Request Timeout"},
+    {413, "Content Too Large"},
+    {414, "URI Too Long"},
+    {431, "Request Header Fields Too Large"},
+    {500, "Internal Server Error"},
+    {501, "Not Implemented"},
+    {503, "Service Unavailable"},
+    {505, "HTTP Version Not Supported"}
+};
+
+/**
+ * @todo 改为可配置的
+*/
+// 状态码到错误页面文件的映射表
+static const std::unordered_map<int, std::string> CODE_PATH {
+    {400, "/400.html"},
+    {403, "/403.html"},
+    {404, "/404.html"},
+    {500, "/500.html"}
+};
+
+static const int MAX_STATUS_CODE = 600;
+
+HttpDate::Slot HttpDate::s_slots[HttpDate::SLOTS];
+std::atomic<int> HttpDate::s_cur(0);
+std::atomic_flag HttpDate::s_updating = ATOMIC_FLAG_INIT;
+
+std::vector<std::string> ResponseTemplates::s_status_lines;
+std::vector<std::string> ResponseTemplates::s_error_tails;
+std::string ResponseTemplates::s_server_line;
+
+
+const char * HttpDate::now() {
+    time_t sec = time(nullptr);
+    int cur = s_cur.load(std::memory_order_acquire);
+    if (s_slots[cur].sec.load(std::memory_order_relaxed) == sec) {
+        return s_slots[cur].str;
+    }
+    if (s_updating.test_and_set(std::memory_order_acquire)) {
+        // 其他线程正在刷新，先使用旧值
+        return s_slots[cur].str;
+    }
+    cur = s_cur.load(std::memory_order_relaxed);
+    if (s_slots[cur].sec.load(std::memory_order_relaxed) != sec) {
+        int next = (cur + 1) % SLOTS;
+        http_gmt(s_slots[next].str, sizeof(s_slots[next].str), sec);
+        s_slots[next].sec.store(sec, std::memory_order_relaxed);
+        s_cur.store(next, std::memory_order_release);
+        cur = next;
+    }
+    s_updating.clear(std::memory_order_release);
+    return s_slots[cur].str;
+}
+
+/**
+ * @brief 内置的错误页面
+*/
+static std::string default_error_page(int code, const std::string &text) {
+    std::ostringstream content;
+    content << "<html>\n<head><title>"
+            << code << ' ' << text
+            << "</title></head>\n<body>\n<center><h1>"
+            << code << ' ' << text
+            << "</h1></center>\n<hr><center>"
+            << _VENDOR_NAME << "/" << _VERSION_STRING
+            << "</center>\n</body>\n</html>";
+    return content.str();
+}
+
+void ResponseTemplates::init(const std::string &src_dir) {
+    s_status_lines.assign(MAX_STATUS_CODE, std::string());
+    s_error_tails.assign(MAX_STATUS_CODE, std::string());
+    for (const auto &st : STATUS_TEXT) {
+        // Status-Line = HTTP-Version SP Status-Code SP Reason-Phrase CRLF
+        s_status_lines[st.first] = "HTTP/1.1 " + std::to_string(st.first) + " " +
+            st.second + "\r\n";
+        if (st.first < 400) continue;
+        std::string page;
+        const auto &path = CODE_PATH.find(st.first);
+        if (path != CODE_PATH.end()) {
+            std::ifstream fs(src_dir + path->second, std::ios::binary);
+            if (fs) {
+                std::ostringstream ss;
+                ss << fs.rdbuf();
+                page = ss.str();
+            }
+        }
+        if (page.empty()) {
+            page = default_error_page(st.first, st.second);
+        }
+        s_error_tails[st.first] = "Content-Type: text/html\r\nContent-Length: " +
+            std::to_string(page.size()) + "\r\n\r\n" + page;
+    }
+    s_server_line = "Server: " _VENDOR_NAME "/" _VERSION_STRING "\r\n";
+    HttpDate::now();
+}
+
+const char * ResponseTemplates::status_text(int code) {
+    const auto &it = STATUS_TEXT.find(code);
+    return it == STATUS_TEXT.end() ? nullptr : it->second.c_str();
+}
+
+const std::string& ResponseTemplates::status_line(int code) {
+    if (code < 0 || code >= MAX_STATUS_CODE || s_status_lines[code].empty()) {
+        return s_status_lines[500];
+    }
+    return s_status_lines[code];
+}
+
+const std::string& ResponseTemplates::server_line() {
+    return s_server_line;
+}
+
+const std::string* ResponseTemplates::error_tail(int code) {
+    if (code < 0 || code >= MAX_STATUS_CODE || s_error_tails[code].empty()) {
+        return nullptr;
+    }
+    return &s_error_tails[code];
+}
+
+const char * ResponseTemplates::error_page(int code, size_t &len) {
+    const std::string *tail = error_tail(code);
+    if (!tail) {
+        tail = &s_error_tails[500];
+    }
+    size_t pos = tail->find("\r\n\r\n") + 4;
+    len = tail->size() - pos;
+    return tail->data() + pos;
+}
+
+void ResponseWriter::status_line(int code) {
+    m_buf.append(ResponseTemplates::status_line(code));
+}
+
+void ResponseWriter::header(const char *name, const char *value, size_t len) {
+    size_t name_len = std::strlen(name);
+    m_buf.ensure_writable(name_len + len + 4);
+    m_buf.append(name, name_len);
+    m_buf.append(": ", 2);
+    m_buf.append(value, len);
+    m_buf.append("\r\n", 2);
+}
+
+void ResponseWriter::header(const char *name, const char *value) {
+    header(name, value, std::strlen(value));
+}
+
+void ResponseWriter::header(const char *name, uint64_t value) {
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    do {
+        *--p = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    header(name, p, digits + sizeof(digits) - p);
+}
+
+void ResponseWriter::date() {
+    header("Date", HttpDate::now(), HttpDate::LEN);
+}
+
+void ResponseWriter::keep_alive(int timeout, int max) {
+    char buf[48];
+    int len = max < 0 ? snprintf(buf, sizeof(buf), "timeout=%d", timeout) :
+        snprintf(buf, sizeof(buf), "timeout=%d, max=%d", timeout, max);
+    header("Keep-Alive", buf, len);
+}
+
+void ResponseWriter::server() {
+    m_buf.append(ResponseTemplates::server_line());
+}
+
+void ResponseWriter::end_headers() {
+    m_buf.append("\r\n", 2);
+}
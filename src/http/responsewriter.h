@@ -0,0 +1,118 @@
+/**
+ * @file responsewriter.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for http response writer
+*/
+#ifndef RESPONSE_WRITER_H
+#define RESPONSE_WRITER_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "../buffer/buffer.h"
+
+/**
+ * @brief 所有线程共享的 Date 字段值
+ *
+ * 秒数变化后由第一个调用者重新格式化（其他线程在此期间继续使用旧值），
+ * 因此每秒最多格式化一次。结果存放在若干个轮换的槽中，
+ * 读者拿到的字符串要在多次刷新之后才会被覆盖
+*/
+class HttpDate {
+public:
+    static const size_t LEN = 29;   // "Sun, 06 Nov 1994 08:49:37 GMT"
+
+    /**
+     * @brief 获取当前时间的 http 格式字符串
+     * @return 长度为 LEN、以 '\0' 结尾的字符串
+    */
+    static const char * now();
+
+private:
+    struct Slot {
+        std::atomic<time_t> sec;
+        char str[LEN + 3];
+    };
+    static const int SLOTS = 8;
+    static Slot s_slots[SLOTS];
+    static std::atomic<int> s_cur;           // 当前有效的槽
+    static std::atomic_flag s_updating;      // 是否有线程正在刷新
+};
+
+/**
+ * @brief 启动时预先生成的响应片段：各状态码的状态行、Server 字段和错误页面
+*/
+class ResponseTemplates {
+public:
+    /**
+     * @brief 生成所有的响应片段，必须在处理请求之前调用
+     * @param src_dir 静态资源根目录，错误页面从其中读取，不存在时使用默认页面
+     * @note 错误页面只在启动时读取一次，修改页面文件后需要重启服务器
+    */
+    static void init(const std::string &src_dir);
+
+    /**
+     * @brief 状态码对应的状态信息，未知的状态码返回 nullptr
+    */
+    static const char * status_text(int code);
+
+    /**
+     * @brief 状态行，例如 `HTTP/1.1 404 Not Found\r\n`，未知的状态码按 500 处理
+    */
+    static const std::string& status_line(int code);
+
+    /**
+     * @brief `Server: yawn/x.y.z\r\n`
+    */
+    static const std::string& server_line();
+
+    /**
+     * @brief 错误响应中固定不变的部分：Content-Type、Content-Length、空行和页面内容
+     * @param code 状态码（>= 400）
+     * @return 未生成时返回 nullptr
+    */
+    static const std::string* error_tail(int code);
+
+    /**
+     * @brief 错误页面的内容（不含头部），用于 HTTP/2 等自行编码头部的场合
+     * @param code 状态码（>= 400），未生成时按 500 处理
+     * @param len 页面的长度
+    */
+    static const char * error_page(int code, size_t &len);
+
+private:
+    static std::vector<std::string> s_status_lines;  // 状态码 -> 状态行
+    static std::vector<std::string> s_error_tails;   // 状态码 -> 错误响应的固定部分
+    static std::string s_server_line;
+};
+
+/**
+ * @brief 把响应的状态行和头部直接序列化到写缓冲区中，不经过中间的映射表和字符串
+*/
+class ResponseWriter {
+public:
+    explicit ResponseWriter(Buffer &buf) : m_buf(buf) {}
+
+    void status_line(int code);
+    void header(const char *name, const char *value, size_t len);
+    void header(const char *name, const char *value);
+    void header(const char *name, uint64_t value);
+    void date();
+
+    /**
+     * @brief `Keep-Alive: timeout=N, max=M`
+     * @param timeout 空闲超时（单位为秒）
+     * @param max 连接上还能处理的请求数目，小于 0 时省略
+    */
+    void keep_alive(int timeout, int max);
+    void server();
+    void end_headers();
+
+private:
+    Buffer &m_buf;
+};
+
+#endif // RESPONSE_WRITER_H
@@ -7,6 +7,7 @@
 #include <unistd.h>
 #include "log.h"
 #include "../util/util.h"
+#include "../affinity/affinity.h"
 
 
 std::string LogLevelToString(LogLevel lv) {
@@ -166,6 +167,16 @@ void AsyncLogger::CloseLogger() {
     m_closed = true;
 }
 
+bool AsyncLogger::BindWriter(const std::vector<int> &cpus) {
+    std::lock_guard<std::mutex> lck(m_mtx);
+    if (!m_write_thread) return false;
+    return bind_thread_to_cpus(m_write_thread->native_handle(), cpus);
+}
+
 LogLevel AsyncLogger::GetLogLevel() {
-    return m_log_level;
+    return m_log_level.load(std::memory_order_relaxed);
+}
+
+void AsyncLogger::SetLogLevel(LogLevel log_level) {
+    m_log_level.store(log_level, std::memory_order_relaxed);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef LOG_H
 #define LOG_H
 
+#include <atomic>
 #include <string>
 #include <thread>
 #include <mutex>
@@ -44,7 +45,7 @@ public:
     using pid_t = decltype(getpid());
     using tid_t = decltype(gettid());
 
-    LogEvent(LogLevel log_lv, const std::string &filename, int line_no, pid_t pid, tid_t tid)
+    LogEvent(LogLevel log_lv, const char *filename, int line_no, pid_t pid, tid_t tid)
     : m_lv(log_lv), m_filename(filename), m_line_no(line_no), m_pid(pid), m_tid(tid) {}
 
     LogLevel GetLogLevel() { return m_lv; }
@@ -57,7 +58,7 @@ public:
 
 private:
     LogLevel m_lv;           // 日志级别
-    std::string m_filename;  // 文件名
+    const char *m_filename;  // 文件名（__FILE__ 字面量，无需拷贝）
     int m_line_no;           // 行号
     pid_t m_pid;             // 进程 id
     tid_t m_tid;             // 线程 id
@@ -78,10 +79,22 @@ public:
 
     void CloseLogger();
 
+    /**
+     * @brief 将写日志线程绑定到一组 CPU 上，需在 Init 之后调用
+     * @param cpus CPU 列表
+     * @return 是否绑定成功
+    */
+    bool BindWriter(const std::vector<int> &cpus);
+
     bool Closed() const;
 
     LogLevel GetLogLevel();
 
+    /**
+     * @brief 修改日志级别，可以在运行时调用（例如重新加载配置时）
+    */
+    void SetLogLevel(LogLevel log_level);
+
 private:
     static constexpr uint8_t STDOUT_MASK = 1;
     static constexpr uint8_t FILE_MASK = 2;
@@ -98,7 +111,7 @@ private:
     //   - LOG_TYPE_FILE：只输出到日志文件
     //   - LOG_TYPE_STDOUT_FILE：输出到 STDOUT 和文件
     uint8_t m_type;
-    LogLevel m_log_level;    // 日志级别
+    std::atomic<LogLevel> m_log_level;    // 日志级别，每条日志都会读取，不加锁
     std::string m_filename;  // 日志文件名称
     int m_seq_no;            // 日志文件序号
     std::string m_logdir;    // 日志目录
@@ -113,6 +126,9 @@ private:
 
 template <typename... Args>
 void Log(LogEvent &&log_event, const char* fmt, Args&&... args) {
+    // 先检查日志级别，被过滤掉的日志不必格式化（也不会分配内存）
+    AsyncLogger &logger = AsyncLogger::GetInstance();
+    if (logger.Closed() || logger.GetLogLevel() > log_event.GetLogLevel()) return;
     std::string log_str;
     int msg_len = snprintf(nullptr, 0, fmt, args...);
     if (msg_len > 0) {
@@ -122,8 +138,6 @@ void Log(LogEvent &&log_event, const char* fmt, Args&&... args) {
     }
 
     log_str = log_event.ToString() + log_str + "\n";
-    AsyncLogger &logger = AsyncLogger::GetInstance();
-    if (logger.Closed() || logger.GetLogLevel() > log_event.GetLogLevel()) return;
     logger.PushLog(log_str);
 }
 
@@ -4,10 +4,41 @@
  * @date 2024-03-30
  * @brief the enter of this webserver project
 */
+#include <csignal>
 #include "server/webserver.h"
+#include "server/master.h"
 #include "log/log.h"
+#include "affinity/affinity.h"
 
 
+/**
+ * @brief 初始化日志
+ * @param suffix 加在日志文件名后面，多进程模式下每个工作进程写自己的文件
+*/
+static void init_logger(const Config &cfg, const string &suffix) {
+    if (!cfg.get_bool("open_log")) return;
+    AsyncLogger::GetInstance().Init(
+        cfg.get_integer("log_type"),
+        cfg.get_string("log_dir"),
+        cfg.get_string("log_filename") + suffix,
+        cfg.get_integer("log_max_file_size"),
+        StringToLogLevel(cfg.get_string("log_level")),
+        cfg.get_integer("log_queue_size")
+    );
+    auto logger_cpus = cfg.get_string("logger_cpus");
+    CpuList cpus;
+    if (!logger_cpus.empty()) {
+        if (parse_cpu_list(logger_cpus, cpus) &&
+            AsyncLogger::GetInstance().BindWriter(cpus)) {
+            LOG_INFO("Logger thread bound to CPUs %s",
+                cpu_list_to_string(cpus).c_str());
+        } else {
+            LOG_ERROR("Failed to bind logger thread to CPUs \"%s\"",
+                logger_cpus.c_str());
+        }
+    }
+}
+
 int main(int argc, char* argv[]) {
     string cfg_fp("./server.cfg");
     if (argc > 1) {
@@ -16,19 +47,25 @@ int main(int argc, char* argv[]) {
 
     Config cfg(cfg_fp);
 
-    // 初始化日志
-    if (cfg.get_bool("open_log")) {
-        AsyncLogger::GetInstance().Init(
-            cfg.get_integer("log_type"),
-            cfg.get_string("log_dir"),
-            cfg.get_string("log_filename"),
-            cfg.get_integer("log_max_file_size"),
-            StringToLogLevel(cfg.get_string("log_level")),
-            cfg.get_integer("log_queue_size")
-        );
+    // 对端关闭后的写入（包括 OpenSSL 经由 write 发送的记录）返回 EPIPE，而不是终止进程
+    signal(SIGPIPE, SIG_IGN);
+    // 重新加载配置、平滑退出和热升级的信号由 WebServer 通过 signalfd 读取。必须在创建任何线程之前屏蔽，
+    // 之后创建的线程继承这个屏蔽字，信号不会被投递给某个线程而终止进程
+    WebServer::block_signals();
+
+    if (cfg.get_integer("worker_processes", 0) > 0) {
+        // 多进程模式：主进程不创建任何线程，日志和服务器都在 fork 之后的工作进程中初始化
+        Master master(cfg, [&cfg](int idx, WorkerSlot *slot) {
+            init_logger(cfg, "_w" + std::to_string(idx));
+            WebServer server(cfg, slot);
+            server.start();
+            return EXIT_SUCCESS;
+        });
+        return master.run();
     }
 
+    init_logger(cfg, "");
     WebServer server(cfg);
-    
+    server.set_command_line(argc, argv);
     server.start();
 }
@@ -0,0 +1,459 @@
+/**
+ * @file asyncsqlpool.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for the non-blocking MySQL client driven by the event loop
+*/
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include "asyncsqlpool.h"
+#include "sqlconnpool.h"
+#include "../log/log.h"
+#include "../util/util.h"
+
+// 连接失败之后重新连接的间隔(毫秒)
+static const int RECONNECT_DELAY_MS = 1000;
+// 建立连接的超时时间(秒)，由客户端库计时
+static const unsigned int CONNECT_TIMEOUT_S = 5;
+
+AsyncSQLPool::AsyncSQLPool(Epoller &epoller_, TimeHeap &timers_, int timer_base_)
+: epoller(epoller_), timers(timers_), timer_base(timer_base_), notify_fd(-1), queries(0),
+  failures(0) {}
+
+AsyncSQLPool::~AsyncSQLPool() {
+    for (auto &c : conns) {
+        close_conn(c);
+    }
+    if (notify_fd >= 0) {
+        epoller.del_fd(notify_fd);
+        close(notify_fd);
+    }
+}
+
+std::string AsyncSQLPool::bind(MYSQL *conn, const std::string &sql,
+    const std::vector<std::string> &params
+) {
+    std::string out;
+    std::vector<char> buf;
+    size_t next = 0;
+    for (char ch : sql) {
+        if (ch != '?' || next >= params.size()) {
+            out.push_back(ch);
+            continue;
+        }
+        const std::string &p = params[next++];
+        buf.resize(p.size() * 2 + 1);
+        unsigned long len = mysql_real_escape_string(conn, buf.data(), p.data(), p.size());
+        out.push_back('\'');
+        out.append(buf.data(), len);
+        out.push_back('\'');
+    }
+    return out;
+}
+
+void AsyncSQLPool::query(std::string sql, std::vector<std::string> params, Callback cb) {
+    if (notify_fd < 0) {
+        // 没有初始化成功，不会有主线程处理这个查询
+        SQLResult r;
+        r.err = SQLResult::ERR_UNSUPPORTED;
+        r.error = "Async-SQL-Pool is not available";
+        cb(r);
+        return;
+    }
+    Request req;
+    req.sql = std::move(sql);
+    req.params = std::move(params);
+    req.cb = std::move(cb);
+    req.deadline = opts.query_timeout > 0 ? monotonic_ms() + opts.query_timeout : -1;
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        incoming.push_back(std::move(req));
+    }
+    uint64_t one = 1;
+    ssize_t n = write(notify_fd, &one, sizeof(one));
+    (void)n;
+}
+
+bool AsyncSQLPool::owns(int fd) const {
+    return fd == notify_fd || fd_conn.count(fd) > 0;
+}
+
+AsyncSQLPool::Stats AsyncSQLPool::get_stats() const {
+    Stats st{0, 0, pending.size(), queries, failures};
+    for (const auto &c : conns) {
+        if (c.state != DOWN && c.state != CONNECTING) ++st.connected;
+        if (c.state == QUERYING || c.state == STORING) ++st.busy;
+    }
+    return st;
+}
+
+void AsyncSQLPool::accept_incoming() {
+    std::vector<Request> reqs;
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        reqs.swap(incoming);
+    }
+    for (auto &req : reqs) {
+        if (pending.size() >= opts.max_pending) {
+            SQLResult r;
+            r.err = SQLResult::ERR_OVERLOAD;
+            r.error = "too many pending queries";
+            ++failures;
+            req.cb(r);
+            continue;
+        }
+        pending.push_back(std::move(req));
+    }
+}
+
+void AsyncSQLPool::expire_pending() {
+    int64_t now = monotonic_ms();
+    for (auto it = pending.begin(); it != pending.end(); ) {
+        if (it->deadline >= 0 && now >= it->deadline) {
+            Callback cb = std::move(it->cb);
+            it = pending.erase(it);
+            SQLResult r;
+            r.err = SQLResult::ERR_TIMEOUT;
+            r.error = "timed out waiting for a connection";
+            ++failures;
+            cb(r);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void AsyncSQLPool::arm_timer(Conn &c, int64_t when) {
+    int gen = ++c.timer_gen;
+    if (when < 0) return;
+    int delay = static_cast<int>(std::max<int64_t>(when - monotonic_ms(), 0));
+    timers.add(timer_id(c), delay, std::bind(&AsyncSQLPool::on_timer, this, c.idx, gen));
+}
+
+void AsyncSQLPool::close_conn(Conn &c) {
+    if (c.fd >= 0) {
+        epoller.del_fd(c.fd);
+        fd_conn.erase(c.fd);
+        // 先断开 socket，mysql_close 发送 COM_QUIT 时立即失败而不会阻塞主线程
+        shutdown(c.fd, SHUT_RDWR);
+        c.fd = -1;
+    }
+    if (c.mysql) {
+        mysql_close(c.mysql);
+        c.mysql = nullptr;
+    }
+    c.state = DOWN;
+    c.lib_deadline = -1;
+    ++c.timer_gen;
+}
+
+void AsyncSQLPool::schedule_reconnect(Conn &c) {
+    close_conn(c);
+    arm_timer(c, monotonic_ms() + RECONNECT_DELAY_MS);
+}
+
+void AsyncSQLPool::fail(Conn &c, unsigned int err, const std::string &msg) {
+    Callback cb = std::move(c.req.cb);
+    c.req = Request();
+    if (cb) {
+        SQLResult r;
+        r.err = err;
+        r.error = msg;
+        ++failures;
+        cb(r);
+    }
+    close_conn(c);
+    start_connect(c);
+}
+
+void AsyncSQLPool::finish(Conn &c, SQLResult &result) {
+    Callback cb = std::move(c.req.cb);
+    c.req = Request();
+    c.sql.clear();
+    c.state = IDLE;
+    // 空闲的连接只关心对端关闭（服务器重启、wait_timeout 等）
+    watch(c, EPOLLIN | EPOLLRDHUP);
+    arm_timer(c, -1);
+    ++queries;
+    if (!result.ok()) ++failures;
+    cb(result);
+}
+
+#ifdef MYSQL_WAIT_READ
+
+bool AsyncSQLPool::supported() {
+    return true;
+}
+
+bool AsyncSQLPool::init(const Options &opts_) {
+    opts = opts_;
+    notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notify_fd < 0 || !epoller.add_fd(notify_fd, EPOLLIN)) {
+        LOG_ERROR("Failed to create the eventfd for Async-SQL-Pool: %s", strerror(errno));
+        return false;
+    }
+    conns.resize(std::max(opts.conn_num, 1));
+    for (size_t i=0; i<conns.size(); ++i) {
+        Conn &c = conns[i];
+        c.idx = i;
+        c.mysql = nullptr;
+        c.fd = -1;
+        c.state = DOWN;
+        c.lib_deadline = -1;
+        c.timer_gen = 0;
+        start_connect(c);
+    }
+    return true;
+}
+
+void AsyncSQLPool::watch(Conn &c, uint32_t events) {
+    if (c.fd < 0) {
+        c.fd = mysql_get_socket(c.mysql);
+        fd_conn[c.fd] = c.idx;
+        epoller.add_fd(c.fd, events);
+    } else {
+        epoller.mod_fd(c.fd, events);
+    }
+}
+
+void AsyncSQLPool::start_connect(Conn &c) {
+    c.mysql = mysql_init(nullptr);
+    if (!c.mysql) {
+        LOG_ERROR("MySQL initialization error!");
+        schedule_reconnect(c);
+        return;
+    }
+    mysql_options(c.mysql, MYSQL_OPT_NONBLOCK, 0);
+    mysql_options(c.mysql, MYSQL_OPT_CONNECT_TIMEOUT, &CONNECT_TIMEOUT_S);
+    c.state = CONNECTING;
+    MYSQL *ret = nullptr;
+    int status = mysql_real_connect_start(&ret, c.mysql, opts.host.c_str(), opts.user.c_str(),
+        opts.passwd.c_str(), opts.db_name.c_str(), opts.port, nullptr, 0);
+    if (status) {
+        wait_for(c, status);
+    } else {
+        on_connected(c, ret);
+    }
+}
+
+void AsyncSQLPool::wait_for(Conn &c, int status) {
+    uint32_t events = 0;
+    if (status & MYSQL_WAIT_READ) events |= EPOLLIN;
+    if (status & MYSQL_WAIT_WRITE) events |= EPOLLOUT;
+    if (status & MYSQL_WAIT_EXCEPT) events |= EPOLLPRI;
+    watch(c, events);
+    c.lib_deadline = (status & MYSQL_WAIT_TIMEOUT) ?
+        monotonic_ms() + mysql_get_timeout_value_ms(c.mysql) : -1;
+    int64_t when = c.lib_deadline;
+    if (c.state != CONNECTING && c.req.deadline >= 0) {
+        when = when < 0 ? c.req.deadline : std::min(when, c.req.deadline);
+    }
+    arm_timer(c, when);
+}
+
+void AsyncSQLPool::resume(Conn &c, int status) {
+    switch (c.state) {
+        case CONNECTING: {
+            MYSQL *ret = nullptr;
+            status = mysql_real_connect_cont(&ret, c.mysql, status);
+            if (status) {
+                wait_for(c, status);
+            } else {
+                on_connected(c, ret);
+            }
+            break;
+        }
+        case QUERYING: {
+            int err = 0;
+            status = mysql_real_query_cont(&err, c.mysql, status);
+            if (status) {
+                wait_for(c, status);
+            } else {
+                on_queried(c, err);
+            }
+            break;
+        }
+        case STORING: {
+            MYSQL_RES *res = nullptr;
+            status = mysql_store_result_cont(&res, c.mysql, status);
+            if (status) {
+                wait_for(c, status);
+            } else {
+                on_stored(c, res);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void AsyncSQLPool::on_event(int fd, uint32_t events) {
+    if (fd == notify_fd) {
+        uint64_t cnt = 0;
+        ssize_t n = read(notify_fd, &cnt, sizeof(cnt));
+        (void)n;
+        accept_incoming();
+        dispatch();
+        return;
+    }
+    auto it = fd_conn.find(fd);
+    if (it == fd_conn.end()) return;
+    Conn &c = conns[it->second];
+    if (c.state == IDLE) {
+        // 空闲的连接上不应该有数据，只可能是服务器关闭了连接
+        LOG_WARN("Async-SQL connection %d closed by the server, reconnecting", c.idx);
+        close_conn(c);
+        start_connect(c);
+        return;
+    }
+    int status = 0;
+    if (events & EPOLLIN) status |= MYSQL_WAIT_READ;
+    if (events & EPOLLOUT) status |= MYSQL_WAIT_WRITE;
+    if (events & EPOLLPRI) status |= MYSQL_WAIT_EXCEPT;
+    if (events & (EPOLLHUP | EPOLLERR)) {
+        // 交给客户端库读写 socket，由它报告错误
+        status |= MYSQL_WAIT_READ | MYSQL_WAIT_WRITE;
+    }
+    resume(c, status);
+}
+
+void AsyncSQLPool::on_timer(int idx, int gen) {
+    Conn &c = conns[idx];
+    if (gen != c.timer_gen) return;
+    if (c.state == DOWN) {
+        expire_pending();
+        start_connect(c);
+        return;
+    }
+    int64_t now = monotonic_ms();
+    if (c.state != CONNECTING && c.req.deadline >= 0 && now >= c.req.deadline) {
+        // 非阻塞接口不能中途取消查询，只能放弃这个连接
+        LOG_WARN("Async-SQL query timed out after %d ms: %s", opts.query_timeout, c.sql.c_str());
+        fail(c, SQLResult::ERR_TIMEOUT, "query timeout");
+        dispatch();
+        return;
+    }
+    if (c.lib_deadline >= 0 && now >= c.lib_deadline) {
+        resume(c, MYSQL_WAIT_TIMEOUT);
+        return;
+    }
+    int64_t when = c.lib_deadline;
+    if (c.req.deadline >= 0) {
+        when = when < 0 ? c.req.deadline : std::min(when, c.req.deadline);
+    }
+    arm_timer(c, when);
+}
+
+void AsyncSQLPool::on_connected(Conn &c, MYSQL *ret) {
+    if (!ret) {
+        LOG_WARN("Async-SQL connection %d failed: %s", c.idx, mysql_error(c.mysql));
+        schedule_reconnect(c);
+        return;
+    }
+    LOG_DEBUG("Async-SQL connection %d established", c.idx);
+    c.state = IDLE;
+    watch(c, EPOLLIN | EPOLLRDHUP);
+    arm_timer(c, -1);
+    dispatch();
+}
+
+void AsyncSQLPool::dispatch() {
+    expire_pending();
+    for (auto &c : conns) {
+        if (pending.empty()) break;
+        if (c.state != IDLE) continue;
+        c.req = std::move(pending.front());
+        pending.pop_front();
+        c.sql = bind(c.mysql, c.req.sql, c.req.params);
+        c.state = QUERYING;
+        int err = 0;
+        int status = mysql_real_query_start(&err, c.mysql, c.sql.data(), c.sql.size());
+        if (status) {
+            wait_for(c, status);
+        } else {
+            on_queried(c, err);
+        }
+    }
+}
+
+void AsyncSQLPool::on_queried(Conn &c, int err) {
+    if (err) {
+        unsigned int code = mysql_errno(c.mysql);
+        if (code >= CLIENT_ERR_MIN) {
+            LOG_WARN("Async-SQL connection %d lost: %s", c.idx, mysql_error(c.mysql));
+            fail(c, code, mysql_error(c.mysql));
+            return;
+        }
+        // 语句本身出错（例如违反唯一键），连接仍然可用
+        SQLResult r;
+        r.err = code;
+        r.error = mysql_error(c.mysql);
+        finish(c, r);
+        return;
+    }
+    c.state = STORING;
+    MYSQL_RES *res = nullptr;
+    int status = mysql_store_result_start(&res, c.mysql);
+    if (status) {
+        wait_for(c, status);
+    } else {
+        on_stored(c, res);
+    }
+}
+
+void AsyncSQLPool::on_stored(Conn &c, MYSQL_RES *res) {
+    SQLResult r;
+    if (res) {
+        // 结果集已经全部读入内存，逐行读取不再需要网络
+        unsigned int fields = mysql_num_fields(res);
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res))) {
+            unsigned long *lens = mysql_fetch_lengths(res);
+            std::vector<std::string> cols(fields);
+            for (unsigned int i=0; i<fields; ++i) {
+                if (row[i]) cols[i].assign(row[i], lens[i]);
+            }
+            r.rows.push_back(std::move(cols));
+        }
+        mysql_free_result(res);
+    } else if (mysql_field_count(c.mysql) == 0) {
+        r.affected_rows = mysql_affected_rows(c.mysql);
+    } else {
+        fail(c, mysql_errno(c.mysql), mysql_error(c.mysql));
+        return;
+    }
+    finish(c, r);
+    dispatch();
+}
+
+#else // MYSQL_WAIT_READ
+
+// Oracle MySQL 的客户端库没有这组非阻塞接口，连接池不可用，由调用者退回同步的连接池
+
+bool AsyncSQLPool::supported() {
+    return false;
+}
+
+bool AsyncSQLPool::init(const Options &opts_) {
+    opts = opts_;
+    LOG_ERROR("Async-SQL-Pool requires the non-blocking API of MariaDB Connector/C");
+    return false;
+}
+
+void AsyncSQLPool::start_connect(Conn &) {}
+void AsyncSQLPool::watch(Conn &, uint32_t) {}
+void AsyncSQLPool::wait_for(Conn &, int) {}
+void AsyncSQLPool::resume(Conn &, int) {}
+void AsyncSQLPool::on_event(int, uint32_t) {}
+void AsyncSQLPool::on_timer(int, int) {}
+void AsyncSQLPool::on_connected(Conn &, MYSQL *) {}
+void AsyncSQLPool::dispatch() {}
+void AsyncSQLPool::on_queried(Conn &, int) {}
+void AsyncSQLPool::on_stored(Conn &, MYSQL_RES *) {}
+
+#endif // MYSQL_WAIT_READ
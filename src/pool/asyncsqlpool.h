@@ -0,0 +1,187 @@
+/**
+ * @file asyncsqlpool.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for the non-blocking MySQL client driven by the event loop
+*/
+#ifndef ASYNCSQLPOOL_H
+#define ASYNCSQLPOOL_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <mysql/mysql.h>
+#include "../epoller/epoller.h"
+#include "../timer/heap_timer.h"
+
+/**
+ * @brief 一次查询的结果
+*/
+struct SQLResult {
+    // 连接池自身的错误码，MySQL 服务器的错误码从 1000 开始，客户端库的从 2000 开始
+    enum {
+        ERR_TIMEOUT = 1,    // 查询超时
+        ERR_OVERLOAD = 2,   // 排队的查询过多
+        ERR_UNSUPPORTED = 3 // 客户端库不支持非阻塞接口
+    };
+
+    unsigned int err;     // 错误码，0 表示成功
+    std::string error;    // 错误信息
+    std::vector<std::vector<std::string>> rows;  // 结果集的所有行，NULL 列为空串
+    uint64_t affected_rows;  // 没有结果集的语句影响的行数
+
+    SQLResult() : err(0), affected_rows(0) {}
+    bool ok() const { return err == 0; }
+};
+
+/**
+ * @brief 非阻塞的 MySQL 连接池
+ *
+ * 基于 MariaDB Connector/C 的非阻塞接口（`mysql_real_query_start/_cont` 等），
+ * 连接的 socket 注册在主线程的 Epoller 中，查询等待网络的期间不占用任何线程。
+ * query() 可以在任意线程中调用，回调函数总是在主线程中调用；
+ * 其余的成员函数只能由主线程调用
+*/
+class AsyncSQLPool {
+public:
+    using Callback = std::function<void(const SQLResult&)>;
+
+    struct Options {
+        std::string host;
+        int port;
+        std::string user;
+        std::string passwd;
+        std::string db_name;
+        int conn_num;          // 连接数
+        int query_timeout;     // 一次查询从提交到完成的最长时间(毫秒)，0 表示不限制
+        size_t max_pending;    // 等待空闲连接的查询的最大数目，超出时立即失败
+
+        Options() : port(3306), conn_num(4), query_timeout(5000), max_pending(1024) {}
+    };
+
+    /**
+     * @param timer_base 连接使用的定时器编号为 timer_base, timer_base-1, ...，不能与其他定时器重复
+    */
+    AsyncSQLPool(Epoller &epoller, TimeHeap &timers, int timer_base);
+    ~AsyncSQLPool();
+
+    AsyncSQLPool(const AsyncSQLPool&) = delete;
+    AsyncSQLPool& operator=(const AsyncSQLPool&) = delete;
+
+    /**
+     * @brief 发起所有的连接，不等待连接完成
+     * @return 客户端库不支持非阻塞接口或者创建通知用的 eventfd 失败时返回 false
+    */
+    bool init(const Options &opts);
+
+    /**
+     * @brief 提交一个查询，线程安全
+     * @param sql 语句，其中的每个 `?` 依次替换为转义并加上引号的参数
+     * @param params 参数
+     * @param cb 查询完成（或失败）后在主线程中调用；连接池没有初始化成功时立即在当前线程中调用
+    */
+    void query(std::string sql, std::vector<std::string> params, Callback cb);
+
+    /**
+     * @brief fd 是否属于连接池（连接的 socket 或者通知用的 eventfd）
+    */
+    bool owns(int fd) const;
+
+    /**
+     * @brief 处理 owns() 为真的文件描述符上的事件
+    */
+    void on_event(int fd, uint32_t events);
+
+    /**
+     * @brief 把语句中的 `?` 依次替换为转义并加上引号的参数
+    */
+    static std::string bind(MYSQL *conn, const std::string &sql,
+        const std::vector<std::string> &params);
+
+    /**
+     * @brief 客户端库是否提供非阻塞接口（MariaDB Connector/C）
+    */
+    static bool supported();
+
+    struct Stats {
+        size_t connected;    // 已经建立的连接数
+        size_t busy;         // 正在执行查询的连接数
+        size_t pending;      // 等待空闲连接的查询数
+        uint64_t queries;    // 完成的查询数
+        uint64_t failures;   // 失败的查询数（包括超时和排队溢出）
+    };
+    Stats get_stats() const;
+
+private:
+    struct Request {
+        std::string sql;
+        std::vector<std::string> params;
+        Callback cb;
+        int64_t deadline;    // 截止时间，-1 表示不限制
+    };
+
+    enum CONN_STATE {
+        DOWN,         // 没有连接，等待重连
+        CONNECTING,   // 正在连接
+        IDLE,         // 空闲
+        QUERYING,     // 正在发送语句、等待结果
+        STORING       // 正在读取结果集
+    };
+
+    struct Conn {
+        int idx;
+        MYSQL *mysql;
+        int fd;              // 当前注册在 epoll 中的 socket，-1 表示没有
+        CONN_STATE state;
+        Request req;         // 正在执行的查询
+        std::string sql;     // 绑定了参数的语句，执行期间必须保持有效
+        int64_t lib_deadline;  // 客户端库要求的超时时间（连接超时等），-1 表示没有
+        int timer_gen;       // 定时器的代数，过期的定时器不再起作用
+    };
+
+    void start_connect(Conn &c);
+    /**
+     * @brief 按照当前的状态注册 socket 的事件，未注册时先注册
+    */
+    void watch(Conn &c, uint32_t events);
+    void arm_timer(Conn &c, int64_t when);
+    void close_conn(Conn &c);
+    void schedule_reconnect(Conn &c);
+    /**
+     * @brief 按客户端库返回的等待状态注册 socket 事件和超时
+    */
+    void wait_for(Conn &c, int status);
+    void resume(Conn &c, int status);
+    void on_connected(Conn &c, MYSQL *ret);
+    void on_queried(Conn &c, int err);
+    void on_stored(Conn &c, MYSQL_RES *res);
+    void on_timer(int idx, int gen);
+    void finish(Conn &c, SQLResult &result);
+    /**
+     * @brief 连接出错（客户端错误或者超时）：以错误结束正在执行的查询，然后重新连接
+    */
+    void fail(Conn &c, unsigned int err, const std::string &msg);
+    void accept_incoming();
+    void dispatch();
+    void expire_pending();
+    int timer_id(const Conn &c) const { return timer_base - c.idx; }
+
+    Epoller &epoller;
+    TimeHeap &timers;
+    int timer_base;
+    Options opts;
+    int notify_fd;                       // 其他线程提交查询后通知主线程的 eventfd
+    std::vector<Conn> conns;
+    std::unordered_map<int, int> fd_conn;   // socket -> 连接的序号
+    std::deque<Request> pending;         // 等待空闲连接的查询，仅由主线程访问
+    std::mutex mtx;
+    std::vector<Request> incoming;       // 其他线程提交的查询，由 mtx 保护
+    uint64_t queries;
+    uint64_t failures;
+};
+
+#endif // ASYNCSQLPOOL_H
@@ -0,0 +1,189 @@
+/**
+ * @file querycache.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for the cache of SQL query results
+*/
+#include <algorithm>
+#include <cstdint>
+#include "querycache.h"
+#include "threadpool.hpp"
+#include "../util/util.h"
+
+// 每个结果除了行和列的内容之外的开销：链表和哈希表的节点、Entry 本身
+static const size_t ENTRY_OVERHEAD = 128;
+
+QueryCache* QueryCache::get_instance() {
+    static QueryCache cache;
+    return &cache;
+}
+
+void QueryCache::init(const Options &opts_) {
+    opts = opts_;
+    table.reset(0);
+    if (!opts.enable) return;
+    opts.ttl = std::max(opts.ttl, 1);
+    size_t n = table.reset(std::max<size_t>(opts.shards, 1));
+    shard_budget = std::max<size_t>(opts.max_bytes / n, 1);
+}
+
+std::string QueryCache::make_key(Id id, const std::vector<std::string> &params) {
+    // 每个参数前加上长度，不同的参数划分不会得到相同的键
+    std::string key(reinterpret_cast<const char*>(&id), sizeof(id));
+    for (const auto &p : params) {
+        uint32_t len = p.size();
+        key.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        key.append(p);
+    }
+    return key;
+}
+
+size_t QueryCache::estimate(const std::string &key, const Rows &rows) {
+    size_t bytes = ENTRY_OVERHEAD + key.size() + sizeof(Rows);
+    for (const auto &row : rows) {
+        bytes += sizeof(Row);
+        for (const auto &col : row) {
+            bytes += sizeof(std::string) + col.size();
+        }
+    }
+    return bytes;
+}
+
+uint64_t QueryCache::gen_locked(const Shard &shard, Id id) {
+    auto it = shard.gens.find(id);
+    return it == shard.gens.end() ? 0 : it->second;
+}
+
+void QueryCache::erase_locked(Shard &shard, Table::iterator it) {
+    shard.bytes -= it->bytes;
+    shard.erase(it);
+}
+
+void QueryCache::insert_locked(Shard &shard, const std::string &key, Id id, Result rows,
+    int ttl
+) {
+    auto it = shard.find(key);
+    if (shard.found(it)) {
+        erase_locked(shard, it);
+    }
+    size_t bytes = estimate(key, *rows);
+    if (bytes > shard_budget) return;   // 太大的结果不缓存，以免清空整个分片
+    while (!shard.empty() && shard.bytes + bytes > shard_budget) {
+        erase_locked(shard, shard.oldest());
+        ++evicted;
+    }
+    shard.push_front({key, id, std::move(rows), monotonic_ms() + ttl, bytes});
+    shard.bytes += bytes;
+}
+
+QueryCache::Result QueryCache::get(Id id, const std::vector<std::string> &params, int ttl,
+    const Loader &loader, bool cache_empty
+) {
+    if (table.empty()) {
+        auto rows = std::make_shared<Rows>();
+        return loader(*rows) ? rows : nullptr;
+    }
+    std::string key = make_key(id, params);
+    Shard &shard = table.shard_of(key);
+    std::shared_ptr<Flight> flight;
+    uint64_t gen = 0;
+    {
+        std::unique_lock<std::mutex> lck(shard.mtx);
+        auto entry = shard.find(key);
+        if (shard.found(entry)) {
+            if (entry->expires > monotonic_ms()) {
+                shard.touch(entry);
+                ++hits;
+                return entry->rows;
+            }
+            erase_locked(shard, entry);
+        }
+        auto fit = shard.flights.find(key);
+        if (fit != shard.flights.end()) {
+            // 同一个查询正在执行，等待它的结果（查询失败时同样失败）
+            auto f = fit->second;
+            ++coalesced;
+            ThreadPool::BlockingScope blocking;
+            f->cond.wait(lck, [&f] { return f->done; });
+            return f->rows;
+        }
+        flight = std::make_shared<Flight>();
+        shard.flights.emplace(key, flight);
+        gen = gen_locked(shard, id);
+    }
+
+    ++misses;
+    auto rows = std::make_shared<Rows>();
+    bool ok = loader(*rows);
+    {
+        std::lock_guard<std::mutex> lck(shard.mtx);
+        shard.flights.erase(key);
+        flight->done = true;
+        if (ok) {
+            flight->rows = rows;
+            if (!flight->stale && gen == gen_locked(shard, id) &&
+                (cache_empty || !rows->empty())) {
+                insert_locked(shard, key, id, rows, ttl > 0 ? ttl : opts.ttl);
+            }
+        }
+    }
+    flight->cond.notify_all();
+    return ok ? rows : nullptr;
+}
+
+void QueryCache::invalidate(Id id, const std::vector<std::string> &params) {
+    if (table.empty()) return;
+    std::string key = make_key(id, params);
+    Shard &shard = table.shard_of(key);
+    std::lock_guard<std::mutex> lck(shard.mtx);
+    auto it = shard.find(key);
+    if (shard.found(it)) {
+        erase_locked(shard, it);
+        ++invalidated;
+    }
+    auto fit = shard.flights.find(key);
+    if (fit != shard.flights.end()) {
+        fit->second->stale = true;
+    }
+}
+
+void QueryCache::invalidate(Id id) {
+    for (auto &shard : table) {
+        std::lock_guard<std::mutex> lck(shard->mtx);
+        ++shard->gens[id];
+        for (auto it = shard->lru.begin(); it != shard->lru.end(); ) {
+            auto next = std::next(it);
+            if (it->id == id) {
+                erase_locked(*shard, it);
+                ++invalidated;
+            }
+            it = next;
+        }
+    }
+}
+
+void QueryCache::clear() {
+    for (auto &shard : table) {
+        std::lock_guard<std::mutex> lck(shard->mtx);
+        for (auto &f : shard->flights) {
+            f.second->stale = true;
+        }
+        shard->clear();
+        shard->bytes = 0;
+    }
+}
+
+QueryCache::Stats QueryCache::get_stats() const {
+    Stats st = {};
+    for (auto &shard : table) {
+        std::lock_guard<std::mutex> lck(shard->mtx);
+        st.entries += shard->size();
+        st.bytes += shard->bytes;
+    }
+    st.hits = hits;
+    st.misses = misses;
+    st.coalesced = coalesced;
+    st.evicted = evicted;
+    st.invalidated = invalidated;
+    return st;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file querycache.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for the cache of SQL query results
+*/
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../util/shardedlru.hpp"
+
+/**
+ * @brief 只读查询的结果缓存，键为语句编号和参数
+ *
+ * 结果在 ttl 毫秒内有效，有效期内相同的查询直接返回缓存的行，不借用数据库连接。
+ * 结果占用的内存按行和列的长度估算，预算平均分给各个分片，超出时丢弃最久没有被命中的结果。
+ * 同一个键同时未命中时只有一个线程执行查询，其余线程等待它的结果。修改数据的一方调用
+ * invalidate() 让相关的结果失效，正在执行的查询的结果不会再被缓存
+*/
+class QueryCache {
+public:
+    // 语句的编号，与 SQLStmt::Id 相同
+    using Id = int;
+    using Row = std::vector<std::string>;
+    using Rows = std::vector<Row>;
+    using Result = std::shared_ptr<const Rows>;
+    /**
+     * @brief 执行查询并把结果写入 rows
+     * @return 是否成功，失败的结果不缓存
+    */
+    using Loader = std::function<bool(Rows &rows)>;
+
+    struct Options {
+        bool enable;
+        size_t max_bytes;    // 缓存的结果占用的内存上限（估算值）
+        int ttl;             // 默认的有效期(毫秒)
+        size_t shards;       // 分片数，取整为 2 的幂
+
+        Options() : enable(false), max_bytes(64 << 20), ttl(30000), shards(16) {}
+    };
+
+    struct Stats {
+        size_t entries;          // 缓存的结果数
+        size_t bytes;            // 缓存的结果占用的内存（估算值）
+        uint64_t hits;
+        uint64_t misses;         // 执行了查询的请求
+        uint64_t coalesced;      // 等待其他线程执行同一个查询的请求
+        uint64_t evicted;        // 因为超出内存预算被淘汰的结果数
+        uint64_t invalidated;    // 被 invalidate() 删除或者作废的结果数
+    };
+
+    static QueryCache* get_instance();
+
+    /**
+     * @brief 设置参数并清空缓存，应在使用之前调用
+    */
+    void init(const Options &opts);
+    bool enabled() const { return opts.enable; }
+
+    /**
+     * @brief 取出有效的结果，没有时调用 loader 执行查询并缓存结果
+     * @param ttl 结果的有效期(毫秒)，不大于 0 时使用默认值
+     * @param cache_empty 是否缓存没有行的结果；“不存在”可能很快被其他进程改变时传入 false
+     * @return 查询失败时返回空指针；没有开启缓存时直接调用 loader
+     * @note loader 可能阻塞，在等待其他线程的查询时当前线程也会阻塞
+    */
+    Result get(Id id, const std::vector<std::string> &params, int ttl, const Loader &loader,
+        bool cache_empty = true);
+
+    /**
+     * @brief 让一个查询的结果失效
+    */
+    void invalidate(Id id, const std::vector<std::string> &params);
+    /**
+     * @brief 让一个语句的所有结果失效
+    */
+    void invalidate(Id id);
+    void clear();
+
+    Stats get_stats() const;
+
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+private:
+    QueryCache() {}
+
+    struct Entry {
+        std::string key;
+        Id id;
+        Result rows;
+        int64_t expires;     // 过期时间 (steady_clock 的毫秒数)
+        size_t bytes;
+    };
+
+    // 正在执行的查询，等待它的线程共享这个对象
+    struct Flight {
+        std::condition_variable cond;
+        bool done = false;
+        bool stale = false;  // 执行期间被 invalidate()，结果不缓存
+        Result rows;
+    };
+
+    // 每个分片上除了缓存的结果之外的状态，受分片的锁保护
+    struct ShardState {
+        std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+        // 语句的版本，每次 invalidate(id) 加一；查询开始之后版本改变时结果不缓存
+        std::unordered_map<Id, uint64_t> gens;
+        size_t bytes = 0;
+    };
+
+    using Table = ShardedLru<Entry, &Entry::key, ShardState>;
+    using Shard = Table::Shard;
+
+    static std::string make_key(Id id, const std::vector<std::string> &params);
+    static size_t estimate(const std::string &key, const Rows &rows);
+    static uint64_t gen_locked(const Shard &shard, Id id);
+    void erase_locked(Shard &shard, Table::iterator it);
+    /**
+     * @brief 插入结果，超出分片的内存预算时从 LRU 链表尾部淘汰；调用者持有分片的锁
+    */
+    void insert_locked(Shard &shard, const std::string &key, Id id, Result rows, int ttl);
+
+    Options opts;
+    size_t shard_budget = 0;   // 每个分片的内存预算
+    Table table;
+    std::atomic<uint64_t> hits{0}, misses{0}, coalesced{0}, evicted{0}, invalidated{0};
+};
+
+#endif // QUERYCACHE_H
@@ -10,23 +10,72 @@
 #include <cassert>
 #include "sqlconnpool.h"
 
+/**
+ * @brief 借出的数据库连接，只能移动不能复制，析构时归还给连接池
+*/
 class SQLConnRAII {
 public:
-    SQLConnRAII(MYSQL* &conn_, SQLConnPool *conn_pool_) {
+    SQLConnRAII() : conn_pool(nullptr), conn(nullptr), is_broken(false) {}
+
+    SQLConnRAII(MYSQL* &conn_, SQLConnPool *conn_pool_) : SQLConnRAII(conn_pool_) {
+        conn_ = conn;
+    }
+
+    /**
+     * @param timeout_ms 等待空闲连接的最长时间(毫秒)，负数表示使用连接池的设置
+    */
+    explicit SQLConnRAII(SQLConnPool *conn_pool_, int timeout_ms = -1)
+    : conn_pool(conn_pool_), conn(nullptr), is_broken(false) {
         assert(conn_pool_);
-        conn_ = conn_pool_->get_conn();
-        conn = conn_;
-        conn_pool = conn_pool_;
+        conn = conn_pool_->get_conn(timeout_ms);
+    }
+
+    SQLConnRAII(const SQLConnRAII&) = delete;
+    SQLConnRAII& operator=(const SQLConnRAII&) = delete;
+
+    SQLConnRAII(SQLConnRAII &&other) noexcept
+    : conn_pool(other.conn_pool), conn(other.conn), is_broken(other.is_broken) {
+        other.conn = nullptr;
+    }
+
+    SQLConnRAII& operator=(SQLConnRAII &&other) noexcept {
+        if (this != &other) {
+            release();
+            conn_pool = other.conn_pool;
+            conn = other.conn;
+            is_broken = other.is_broken;
+            other.conn = nullptr;
+        }
+        return *this;
     }
 
     ~SQLConnRAII() {
+        release();
+    }
+
+    MYSQL* get() const { return conn; }
+    SQLConnPool* pool() const { return conn_pool; }
+    explicit operator bool() const { return conn != nullptr; }
+
+    /**
+     * @brief 标记连接已经损坏（例如与服务器断开），归还时连接池关闭它并重新建立
+    */
+    void discard() { is_broken = true; }
+
+    /**
+     * @brief 提前归还连接
+    */
+    void release() {
         if (conn && conn_pool) {
-            conn_pool->free_conn(conn);
+            conn_pool->free_conn(conn, is_broken);
         }
+        conn = nullptr;
+        is_broken = false;
     }
 private:
     SQLConnPool * conn_pool;
     MYSQL * conn;
+    bool is_broken;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -4,36 +4,141 @@
  * @date 2024-03-28
  * @brief source file for SQL connection pool
 */
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <vector>
 #include "sqlconnpool.h"
+#include "threadpool.hpp"
 #include "../log/log.h"
+#include "../util/util.h"
 
+// 建立连接失败之后，这段时间(毫秒)内不再尝试，借用连接的线程直接失败而不是等待连接超时
+static const int RETRY_INTERVAL = 1000;
 
-MYSQL* SQLConnPool::get_conn() {
-    MYSQL * conn = nullptr;
-    if (conn_que.empty()) {
-        LOG_WARN("SQL-Connection-Pool busy!");
-        return nullptr;
+MYSQL* SQLConnPool::get_conn(int timeout_ms) {
+    if (timeout_ms < 0) timeout_ms = opts.acquire_timeout;
+    const int64_t start = monotonic_ms();
+    const auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(std::max(timeout_ms, 0));
+    std::unique_lock<std::mutex> lck(mtx);
+    while (!is_close) {
+        if (!idle_que.empty()) {
+            IdleConn ic = idle_que.back();
+            idle_que.pop_back();
+            ++busy;
+            if (opts.ping_interval > 0 && start - ic.checked >= opts.ping_interval) {
+                // 长时间没有使用的连接可能已经被服务器关闭，先检查再借出
+                lck.unlock();
+                bool alive = mysql_ping(ic.conn) == 0;
+                if (!alive) {
+                    LOG_WARN("SQL connection lost: %s", mysql_error(ic.conn));
+                    close_conn(ic.conn);
+                }
+                lck.lock();
+                if (!alive) {
+                    --busy;
+                    --total;
+                    ++broken;
+                    maint_cond.notify_one();
+                    continue;
+                }
+            }
+            record_wait(start);
+            return ic.conn;
+        }
+        if (total < static_cast<size_t>(opts.max_conn) &&
+            monotonic_ms() - last_failure >= RETRY_INTERVAL) {
+            ++total;
+            ++busy;
+            lck.unlock();
+            MYSQL *conn = nullptr;
+            {
+                ThreadPool::BlockingScope blocking;
+                conn = connect();
+            }
+            lck.lock();
+            if (conn) {
+                ++connects;
+                record_wait(start);
+                return conn;
+            }
+            --total;
+            --busy;
+            ++connect_failures;
+            last_failure = monotonic_ms();
+            // 等待的线程不必等到超时，重新判断是否还有连接可等
+            cond.notify_all();
+        }
+        if (busy == 0) {
+            // 没有借出的连接可以等待，服务器不可达
+            LOG_WARN("SQL-Connection-Pool: no connection available");
+            return nullptr;
+        }
+        bool timeout = false;
+        ++waiting;
+        {
+            // 等待期间弹性线程池可以补充线程，其他任务不被阻塞
+            ThreadPool::BlockingScope blocking;
+            if (timeout_ms < 0) {
+                cond.wait(lck);
+            } else {
+                timeout = cond.wait_until(lck, deadline) == std::cv_status::timeout;
+            }
+        }
+        --waiting;
+        if (timeout && idle_que.empty()) {
+            ++timeouts;
+            LOG_WARN("SQL-Connection-Pool busy: no connection in %d ms", timeout_ms);
+            return nullptr;
+        }
     }
-    sem_wait(&sem_id);
+    return nullptr;
+}
+
+void SQLConnPool::free_conn(MYSQL *conn, bool is_broken) {
+    assert(conn);
     {
         lock_guard lck(mtx);
-        conn = conn_que.front();
-        conn_que.pop();
+        --busy;
+        if (!is_broken && !is_close) {
+            int64_t now = monotonic_ms();
+            idle_que.push_back({conn, now, now});
+            cond.notify_one();
+            return;
+        }
+        --total;
+        if (is_broken) {
+            ++broken;
+            maint_cond.notify_one();
+        }
+        // 等待的线程可以新建连接
+        cond.notify_one();
     }
-    return conn;
+    close_conn(conn);
 }
 
-void SQLConnPool::free_conn(MYSQL * conn) {
-    assert(conn);
+int SQLConnPool::get_free_conn_count() {
     lock_guard lck(mtx);
-    conn_que.push(conn);
-    sem_post(&sem_id);
+    return idle_que.size();
 }
 
-int SQLConnPool::get_free_conn_count() {
+SQLConnPool::Stats SQLConnPool::get_stats() {
     lock_guard lck(mtx);
-    return conn_que.size();
+    Stats st;
+    st.total = total;
+    st.idle = idle_que.size();
+    st.busy = busy;
+    st.waiting = waiting;
+    st.peak_busy = peak_busy;
+    st.acquired = acquired;
+    st.timeouts = timeouts;
+    st.wait_ms = wait_ms;
+    st.max_wait_ms = max_wait_ms;
+    st.connects = connects;
+    st.connect_failures = connect_failures;
+    st.broken = broken;
+    return st;
 }
 
 SQLConnPool* SQLConnPool::get_instance() {
@@ -41,41 +146,241 @@ SQLConnPool* SQLConnPool::get_instance() {
     return &pool;
 }
 
+bool SQLConnPool::init(const Options &opts_) {
+    opts = opts_;
+    opts.min_conn = std::max(opts.min_conn, 0);
+    opts.max_conn = std::max(opts.max_conn, std::max(opts.min_conn, 1));
+    // 客户端库的全局初始化不是线程安全的，必须在并行建立连接之前完成
+    mysql_library_init(0, nullptr, nullptr);
+
+    int64_t start = monotonic_ms();
+    std::vector<MYSQL*> conns(opts.min_conn, nullptr);
+    std::vector<std::thread> threads;
+    for (int i=0; i<opts.min_conn; ++i) {
+        threads.emplace_back([this, &conns, i] {
+            conns[i] = connect();
+            mysql_thread_end();
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    int ok = 0;
+    {
+        lock_guard lck(mtx);
+        int64_t now = monotonic_ms();
+        for (MYSQL *conn : conns) {
+            if (!conn) continue;
+            idle_que.push_back({conn, now, now});
+            ++ok;
+        }
+        total = ok;
+        connects += ok;
+        connect_failures += opts.min_conn - ok;
+        if (ok < opts.min_conn) last_failure = now;
+        is_close = false;
+    }
+    maint_thread = std::thread(&SQLConnPool::maintain, this);
+    if (ok < opts.min_conn) {
+        LOG_ERROR("SQL-Connection-Pool: only %d of %d connections established, retrying "
+            "in the background", ok, opts.min_conn);
+    }
+    LOG_INFO("SQL-Connection-Pool: %d connections in %lld ms, up to %d; idle timeout %d ms, "
+        "ping after %d ms, acquire timeout %d ms", ok, static_cast<long long>(monotonic_ms() - start),
+        opts.max_conn, opts.idle_timeout, opts.ping_interval, opts.acquire_timeout);
+    return ok == opts.min_conn;
+}
+
 void SQLConnPool::init(const char *host, int port, const char *user,
 const char *passwd, const char *db_name, int conn_num) {
-    assert(conn_num > 0);
-    for (int i=0; i<conn_num; ++i) {
-        MYSQL * conn = nullptr;
-        conn = mysql_init(conn);
-        if (!conn) {
-            LOG_ERROR("MySQL initialization error!");
-            assert(conn);
+    Options opts_;
+    opts_.host = host;
+    opts_.port = port;
+    opts_.user = user;
+    opts_.passwd = passwd;
+    opts_.db_name = db_name;
+    opts_.min_conn = opts_.max_conn = conn_num;
+    init(opts_);
+}
+
+void SQLConnPool::close() {
+    {
+        lock_guard lck(mtx);
+        if (is_close) return;
+        is_close = true;
+    }
+    cond.notify_all();
+    maint_cond.notify_all();
+    if (maint_thread.joinable()) {
+        maint_thread.join();
+    }
+    lock_guard lck(mtx);
+    while (!idle_que.empty()) {
+        close_conn(idle_que.front().conn);
+        idle_que.pop_front();
+        --total;
+    }
+    mysql_library_end();
+}
+
+MYSQL* SQLConnPool::connect() {
+    MYSQL *conn = mysql_init(nullptr);
+    if (!conn) {
+        LOG_ERROR("MySQL initialization error!");
+        return nullptr;
+    }
+    unsigned int secs = std::max((opts.connect_timeout + 999) / 1000, 1);
+    mysql_options(conn, MYSQL_OPT_CONNECT_TIMEOUT, &secs);
+    if (opts.io_timeout > 0) {
+        secs = std::max((opts.io_timeout + 999) / 1000, 1);
+        mysql_options(conn, MYSQL_OPT_READ_TIMEOUT, &secs);
+        mysql_options(conn, MYSQL_OPT_WRITE_TIMEOUT, &secs);
+    }
+    if (!mysql_real_connect(conn, opts.host.c_str(), opts.user.c_str(), opts.passwd.c_str(),
+        opts.db_name.c_str(), opts.port, nullptr, 0)) {
+        LOG_ERROR("MySQL connection error: %s", mysql_error(conn));
+        mysql_close(conn);
+        return nullptr;
+    }
+    return conn;
+}
+
+void SQLConnPool::maintain() {
+    int interval = 1000;
+    for (int t : {opts.idle_timeout, opts.ping_interval}) {
+        if (t > 0) interval = std::min(interval, t / 2);
+    }
+    interval = std::max(interval, 100);
+    std::unique_lock<std::mutex> lck(mtx);
+    while (!is_close) {
+        // 连接不足时按重试间隔唤醒，连接损坏时立即唤醒
+        int wait = total < static_cast<size_t>(opts.min_conn) ?
+            std::min(interval, RETRY_INTERVAL) : interval;
+        maint_cond.wait_for(lck, std::chrono::milliseconds(wait));
+        if (is_close) break;
+        lck.unlock();
+        check_idle();
+        refill();
+        lck.lock();
+    }
+    lck.unlock();
+    mysql_thread_end();
+}
+
+void SQLConnPool::check_idle() {
+    std::vector<MYSQL*> expired;
+    std::vector<IdleConn> stale;
+    {
+        lock_guard lck(mtx);
+        int64_t now = monotonic_ms();
+        while (opts.idle_timeout > 0 && total > static_cast<size_t>(opts.min_conn) &&
+            !idle_que.empty() && now - idle_que.front().since >= opts.idle_timeout) {
+            expired.push_back(idle_que.front().conn);
+            idle_que.pop_front();
+            --total;
+        }
+        if (opts.ping_interval > 0) {
+            // 检查期间把连接算作借出，不影响连接总数
+            for (auto it=idle_que.begin(); it!=idle_que.end();) {
+                if (now - it->checked >= opts.ping_interval) {
+                    stale.push_back(*it);
+                    it = idle_que.erase(it);
+                    ++busy;
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+    for (MYSQL *conn : expired) {
+        close_conn(conn);
+    }
+    if (!expired.empty()) {
+        LOG_DEBUG("SQL-Connection-Pool: closed %zu idle connections", expired.size());
+    }
+    for (IdleConn &ic : stale) {
+        bool alive = mysql_ping(ic.conn) == 0;
+        if (!alive) {
+            LOG_WARN("SQL connection lost: %s", mysql_error(ic.conn));
+            close_conn(ic.conn);
         }
-        conn = mysql_real_connect(conn, host, user, passwd, db_name, port,
-            nullptr, 0);
+        lock_guard lck(mtx);
+        --busy;
+        if (alive) {
+            // 按放回池中的时间插入，保持头部的连接最旧
+            ic.checked = monotonic_ms();
+            auto pos = std::find_if(idle_que.rbegin(), idle_que.rend(),
+                [&ic](const IdleConn &other) { return other.since <= ic.since; });
+            idle_que.insert(pos.base(), ic);
+            cond.notify_one();
+        } else {
+            --total;
+            ++broken;
+            cond.notify_one();
+        }
+    }
+}
+
+void SQLConnPool::refill() {
+    int added = 0;
+    for (;;) {
+        {
+            lock_guard lck(mtx);
+            if (is_close || total >= static_cast<size_t>(opts.min_conn)) break;
+            ++total;
+        }
+        MYSQL *conn = connect();
+        lock_guard lck(mtx);
         if (!conn) {
-            LOG_ERROR("MySQL connection error!");
-            assert(conn);
+            --total;
+            ++connect_failures;
+            last_failure = monotonic_ms();
+            break;
         }
-        conn_que.push(conn);
+        ++connects;
+        ++added;
+        int64_t now = monotonic_ms();
+        idle_que.push_back({conn, now, now});
+        cond.notify_one();
+    }
+    if (added > 0) {
+        LOG_INFO("SQL-Connection-Pool: %d connections re-established", added);
     }
-    LOG_INFO("The SQL-Connection-Pool was successfully initialized, with a"
-        " total of eight connections in the pool.");
-    max_conn_num = conn_num;
-    sem_init(&sem_id, 0, max_conn_num);
 }
 
-void SQLConnPool::close() {
-    lock_guard lck(mtx);
-    while (!conn_que.empty()) {
-        auto conn = conn_que.front();
-        conn_que.pop();
-        mysql_close(conn);
+std::vector<MYSQL_STMT*>& SQLConnPool::stmt_cache(MYSQL *conn) {
+    lock_guard lck(stmt_mtx);
+    return stmts[conn];
+}
+
+void SQLConnPool::close_conn(MYSQL *conn) {
+    std::vector<MYSQL_STMT*> cached;
+    {
+        lock_guard lck(stmt_mtx);
+        auto it = stmts.find(conn);
+        if (it != stmts.end()) {
+            cached.swap(it->second);
+            stmts.erase(it);
+        }
     }
-    mysql_library_end();
+    for (MYSQL_STMT *stmt : cached) {
+        if (stmt) mysql_stmt_close(stmt);
+    }
+    mysql_close(conn);
+}
+
+void SQLConnPool::record_wait(int64_t start) {
+    uint64_t waited = monotonic_ms() - start;
+    ++acquired;
+    wait_ms += waited;
+    max_wait_ms = std::max(max_wait_ms, waited);
+    peak_busy = std::max(peak_busy, busy);
 }
 
-SQLConnPool::SQLConnPool(): used_count(0), free_count(0) {}
+SQLConnPool::SQLConnPool(): total(0), busy(0), waiting(0), peak_busy(0), acquired(0),
+timeouts(0), wait_ms(0), max_wait_ms(0), connects(0), connect_failures(0), broken(0),
+last_failure(INT64_MIN / 2), is_close(true) {}
 
 SQLConnPool::~SQLConnPool() {
     close();
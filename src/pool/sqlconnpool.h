@@ -7,21 +7,91 @@
 #ifndef SQLCONNPOOL_H
 #define SQLCONNPOOL_H
 
-#include <queue>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <mutex>
-#include <semaphore.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include <mysql/mysql.h>
 
+// 违反唯一键约束 (mysqld_error.h 中的 ER_DUP_ENTRY)
+static const unsigned int ERR_DUP_ENTRY = 1062;
+// 客户端库的错误码从这里开始 (errmsg.h 中的 CR_MIN_ERROR)，通常表示连接已经不可用
+static const unsigned int CLIENT_ERR_MIN = 2000;
 
+/**
+ * @brief 阻塞的 MySQL 连接池
+ *
+ * 连接数在 min_conn 和 max_conn 之间伸缩：没有空闲连接时按需新建，
+ * 多出的连接空闲 idle_timeout 之后关闭。后台线程定期检查空闲连接是否可用，
+ * 断开的连接被关闭并重新建立，数据库重启之后连接池可以自行恢复
+*/
 class SQLConnPool {
 public:
     using lock_guard = std::lock_guard<std::mutex>;
 
-    MYSQL* get_conn();
-    void free_conn(MYSQL * conn);
+    struct Options {
+        std::string host;
+        int port;
+        std::string user;
+        std::string passwd;
+        std::string db_name;
+        int min_conn;          // 保持的连接数，启动时并行建立
+        int max_conn;          // 连接数的上限
+        int idle_timeout;      // 多于 min_conn 的连接空闲这么久(毫秒)之后关闭
+        int ping_interval;     // 空闲超过这个时间(毫秒)的连接在使用前先检查，0 表示不检查
+        int acquire_timeout;   // 等待空闲连接的最长时间(毫秒)，-1 表示一直等待
+        int connect_timeout;   // 建立连接的超时时间(毫秒)
+        int io_timeout;        // 读写数据库的超时时间(毫秒)，客户端库读超时会重试，一次查询最多等待约 3 倍；0 表示使用客户端库的默认值
+
+        Options() : port(3306), min_conn(8), max_conn(8), idle_timeout(60000),
+            ping_interval(30000), acquire_timeout(3000), connect_timeout(3000),
+            io_timeout(10000) {}
+    };
+
+    struct Stats {
+        size_t total;          // 已经建立和正在建立的连接数
+        size_t idle;           // 空闲的连接数
+        size_t busy;           // 借出的连接数
+        size_t waiting;        // 等待连接的线程数
+        size_t peak_busy;      // 借出的连接数的峰值
+        uint64_t acquired;     // 借出连接的次数
+        uint64_t timeouts;     // 等待超时的次数
+        uint64_t wait_ms;      // 借出连接前等待的总时间(毫秒)
+        uint64_t max_wait_ms;  // 借出连接前等待的最长时间(毫秒)
+        uint64_t connects;     // 新建的连接数
+        uint64_t connect_failures;  // 建立连接失败的次数
+        uint64_t broken;       // 检查失败或者使用者报告损坏而关闭的连接数
+    };
+
+    /**
+     * @brief 借出一个连接，没有空闲连接且已经达到上限时等待
+     * @param timeout_ms 等待的最长时间(毫秒)，负数表示使用 acquire_timeout
+     * @return 超时、无法建立连接或者连接池已关闭时返回 nullptr
+    */
+    MYSQL* get_conn(int timeout_ms = -1);
+    /**
+     * @brief 归还连接
+     * @param is_broken 连接已经损坏（例如查询时与服务器断开），关闭它而不是放回池中
+    */
+    void free_conn(MYSQL *conn, bool is_broken = false);
     int get_free_conn_count();
+    Stats get_stats();
+    /**
+     * @brief 连接上已经准备好的语句，下标为 SQLStmt 的语句编号，连接关闭时一起释放
+     * @note 只能由借出该连接的线程使用
+    */
+    std::vector<MYSQL_STMT*>& stmt_cache(MYSQL *conn);
 
     static SQLConnPool* get_instance();
+    /**
+     * @brief 并行建立 min_conn 个连接并启动后台检查线程
+     * @return 是否建立了所有的连接；失败的连接由后台线程继续重试
+    */
+    bool init(const Options &opts);
     void init(const char *host, int port, const char *user, const char *passwd,
               const char *db_name, int conn_num = 8);
     void close();
@@ -29,12 +99,52 @@ private:
     SQLConnPool();
     ~SQLConnPool();
 
-    int max_conn_num;
-    int used_count;
-    int free_count;
-    std::queue<MYSQL*> conn_que;
+    struct IdleConn {
+        MYSQL *conn;
+        int64_t since;     // 放回池中的时间，多余的连接按它老化
+        int64_t checked;   // 最近一次确认连接可用的时间
+    };
+
+    /**
+     * @brief 建立一个新的连接，失败时返回 nullptr
+    */
+    MYSQL* connect();
+    /**
+     * @brief 释放连接上缓存的语句并关闭连接
+    */
+    void close_conn(MYSQL *conn);
+    void maintain();
+    /**
+     * @brief 关闭空闲太久的多余连接，检查长时间没有确认过的空闲连接是否可用
+    */
+    void check_idle();
+    /**
+     * @brief 连接数不足 min_conn 时补足
+    */
+    void refill();
+    void record_wait(int64_t start);
+
+    Options opts;
+    std::deque<IdleConn> idle_que;   // 从尾部借出，多余的连接在头部老化
+    size_t total;
+    size_t busy;
+    size_t waiting;
+    size_t peak_busy;
+    uint64_t acquired;
+    uint64_t timeouts;
+    uint64_t wait_ms;
+    uint64_t max_wait_ms;
+    uint64_t connects;
+    uint64_t connect_failures;
+    uint64_t broken;
+    int64_t last_failure;    // 最近一次建立连接失败的时间
+    bool is_close;
     std::mutex mtx;
-    sem_t sem_id;
+    std::condition_variable cond;         // 通知等待连接的线程
+    std::condition_variable maint_cond;   // 唤醒后台检查线程
+    std::thread maint_thread;
+    std::mutex stmt_mtx;
+    std::unordered_map<MYSQL*, std::vector<MYSQL_STMT*>> stmts;   // 由 stmt_mtx 保护
 };
 
-#endif
\ No newline at end of file
+#endif
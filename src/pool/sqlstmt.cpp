@@ -0,0 +1,244 @@
+/**
+ * @file sqlstmt.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for prepared statements cached on pooled SQL connections
+*/
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include "sqlstmt.h"
+#include "../log/log.h"
+
+// 服务器上已经没有这个语句 (mysqld_error.h 中的 ER_UNKNOWN_STMT_HANDLER)
+static const unsigned int ERR_UNKNOWN_STMT = 1243;
+// 语句引用的表已经改变，需要重新准备 (ER_NEED_REPREPARE)
+static const unsigned int ERR_NEED_REPREPARE = 1615;
+
+static std::mutex registry_mtx;
+
+static std::vector<std::string>& registry() {
+    static std::vector<std::string> stmts;
+    return stmts;
+}
+
+SQLStmt::Id SQLStmt::define(const std::string &sql) {
+    std::lock_guard<std::mutex> lck(registry_mtx);
+    registry().push_back(sql);
+    return registry().size() - 1;
+}
+
+SQLStmt::SQLStmt(SQLConnRAII &conn_, Id id_):
+conn(conn_), id(id_), stmt(nullptr), bound(0), has_result(false), err(0) {
+    if (!prepare()) return;
+    params.resize(mysql_stmt_param_count(stmt));
+    values.resize(params.size());
+}
+
+SQLStmt::~SQLStmt() {
+    if (stmt && has_result) {
+        mysql_stmt_free_result(stmt);
+    }
+}
+
+bool SQLStmt::prepare() {
+    assert(conn);
+    auto &cache = conn.pool()->stmt_cache(conn.get());
+    if (cache.size() <= static_cast<size_t>(id)) {
+        cache.resize(id + 1, nullptr);
+    }
+    if (!cache[id]) {
+        std::string sql;
+        {
+            std::lock_guard<std::mutex> lck(registry_mtx);
+            sql = registry().at(id);
+        }
+        MYSQL_STMT *s = mysql_stmt_init(conn.get());
+        if (!s) {
+            err = mysql_errno(conn.get());
+            err_msg = mysql_error(conn.get());
+            return false;
+        }
+        if (mysql_stmt_prepare(s, sql.data(), sql.size()) != 0) {
+            err = mysql_stmt_errno(s);
+            err_msg = mysql_stmt_error(s);
+            LOG_ERROR("Failed to prepare statement \"%s\": %s", sql.c_str(), err_msg.c_str());
+            mysql_stmt_close(s);
+            return false;
+        }
+        cache[id] = s;
+    }
+    stmt = cache[id];
+    return true;
+}
+
+void SQLStmt::evict() {
+    auto &cache = conn.pool()->stmt_cache(conn.get());
+    mysql_stmt_close(stmt);
+    cache[id] = nullptr;
+    stmt = nullptr;
+}
+
+MYSQL_BIND* SQLStmt::next_param() {
+    if (bound++ >= params.size()) return nullptr;
+    MYSQL_BIND *b = &params[bound-1];
+    memset(b, 0, sizeof(*b));
+    return b;
+}
+
+SQLStmt& SQLStmt::bind(const std::string &value) {
+    if (MYSQL_BIND *b = next_param()) {
+        Value &v = values[bound-1];
+        v.str = value;
+        b->buffer_type = MYSQL_TYPE_STRING;
+        b->buffer = const_cast<char*>(v.str.data());
+        b->buffer_length = v.str.size();
+        b->length_value = v.str.size();
+        b->length = &b->length_value;
+    }
+    return *this;
+}
+
+SQLStmt& SQLStmt::bind(int64_t value) {
+    if (MYSQL_BIND *b = next_param()) {
+        Value &v = values[bound-1];
+        v.num = value;
+        b->buffer_type = MYSQL_TYPE_LONGLONG;
+        b->buffer = &v.num;
+    }
+    return *this;
+}
+
+SQLStmt& SQLStmt::bind(double value) {
+    if (MYSQL_BIND *b = next_param()) {
+        Value &v = values[bound-1];
+        v.real = value;
+        b->buffer_type = MYSQL_TYPE_DOUBLE;
+        b->buffer = &v.real;
+    }
+    return *this;
+}
+
+SQLStmt& SQLStmt::bind_null() {
+    if (MYSQL_BIND *b = next_param()) {
+        b->buffer_type = MYSQL_TYPE_NULL;
+    }
+    return *this;
+}
+
+bool SQLStmt::execute() {
+    if (!stmt) return false;
+    if (bound != params.size()) {
+        err = ERR_PARAM_COUNT;
+        err_msg = "statement expects " + std::to_string(params.size()) + " parameters, got " +
+            std::to_string(bound);
+        return false;
+    }
+    if (has_result) {
+        mysql_stmt_free_result(stmt);
+        has_result = false;
+    }
+    for (int attempt=0; ; ++attempt) {
+        if ((params.empty() || mysql_stmt_bind_param(stmt, params.data()) == 0) &&
+            mysql_stmt_execute(stmt) == 0) {
+            break;
+        }
+        unsigned int code = mysql_stmt_errno(stmt);
+        if (attempt > 0 || (code != ERR_UNKNOWN_STMT && code != ERR_NEED_REPREPARE)) {
+            save_error();
+            return false;
+        }
+        LOG_WARN("Prepared statement %d was dropped by the server, preparing it again", id);
+        evict();
+        if (!prepare()) return false;
+    }
+
+    MYSQL_RES *meta = mysql_stmt_result_metadata(stmt);
+    if (!meta) return true;   // 没有结果集的语句
+    columns.assign(mysql_num_fields(meta), MYSQL_BIND());
+    mysql_free_result(meta);
+    for (auto &col : columns) {
+        memset(&col, 0, sizeof(col));
+        col.buffer_type = MYSQL_TYPE_STRING;
+        col.length = &col.length_value;
+        col.is_null = &col.is_null_value;
+    }
+    if (mysql_stmt_bind_result(stmt, columns.data()) != 0 || mysql_stmt_store_result(stmt) != 0) {
+        save_error();
+        return false;
+    }
+    has_result = true;
+    return true;
+}
+
+bool SQLStmt::fetch() {
+    if (!has_result) return false;
+    // 结果绑定的缓冲区长度为 0，非空的列总是报告截断，列的值由 get() 读取
+    int ret = mysql_stmt_fetch(stmt);
+    return ret == 0 || ret == MYSQL_DATA_TRUNCATED;
+}
+
+bool SQLStmt::get(unsigned int col, std::string &value) {
+    if (!has_result || col >= columns.size() || columns[col].is_null_value) return false;
+    value.resize(columns[col].length_value);
+    if (value.empty()) return true;
+    MYSQL_BIND b;
+    memset(&b, 0, sizeof(b));
+    b.buffer_type = MYSQL_TYPE_STRING;
+    b.buffer = &value[0];
+    b.buffer_length = value.size();
+    b.length = &b.length_value;
+    return mysql_stmt_fetch_column(stmt, &b, col, 0) == 0;
+}
+
+bool SQLStmt::get(unsigned int col, int64_t &value) {
+    if (!has_result || col >= columns.size() || columns[col].is_null_value) return false;
+    long long num = 0;
+    MYSQL_BIND b;
+    memset(&b, 0, sizeof(b));
+    b.buffer_type = MYSQL_TYPE_LONGLONG;
+    b.buffer = &num;
+    if (mysql_stmt_fetch_column(stmt, &b, col, 0) != 0) return false;
+    value = num;
+    return true;
+}
+
+bool SQLStmt::fetch_all(QueryCache::Rows &rows) {
+    while (fetch()) {
+        QueryCache::Row row(columns.size());
+        for (unsigned int i=0; i<columns.size(); ++i) {
+            if (!get(i, row[i]) && !columns[i].is_null_value) {
+                save_error();
+                return false;
+            }
+        }
+        rows.push_back(std::move(row));
+    }
+    return true;
+}
+
+QueryCache::Result SQLStmt::query(SQLConnPool *pool, Id id,
+    const std::vector<std::string> &params, int ttl, bool cache_empty
+) {
+    return QueryCache::get_instance()->get(id, params, ttl, [&](QueryCache::Rows &rows) {
+        SQLConnRAII guard(pool);
+        if (!guard) return false;
+        SQLStmt stmt(guard, id);
+        for (const auto &p : params) stmt.bind(p);
+        if (!stmt || !stmt.execute() || !stmt.fetch_all(rows)) {
+            LOG_ERROR("Failed to execute statement %d: %s", id, stmt.error().c_str());
+            if (stmt.error_code() >= CLIENT_ERR_MIN) guard.discard();
+            return false;
+        }
+        return true;
+    }, cache_empty);
+}
+
+uint64_t SQLStmt::affected_rows() const {
+    return stmt ? mysql_stmt_affected_rows(stmt) : 0;
+}
+
+void SQLStmt::save_error() {
+    err = mysql_stmt_errno(stmt);
+    err_msg = mysql_stmt_error(stmt);
+}
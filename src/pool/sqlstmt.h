@@ -0,0 +1,133 @@
+/**
+ * @file sqlstmt.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for prepared statements cached on pooled SQL connections
+*/
+#ifndef SQLSTMT_H
+#define SQLSTMT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mysql/mysql.h>
+#include "sqlconnRAII.hpp"
+#include "querycache.h"
+
+/**
+ * @brief 缓存在连接池的连接上的预处理语句
+ *
+ * 语句先用 define() 注册得到编号。每个连接第一次执行某个编号的语句时在服务器上准备它，
+ * 之后在这个连接上重复使用，不再发送、解析语句的文本，参数也不需要转义。
+ * 连接断开重建之后，新连接上的语句在第一次使用时重新准备；
+ * 服务器丢弃了语句（例如表结构改变）时执行失败，重新准备之后再执行一次
+*/
+class SQLStmt {
+public:
+    using Id = int;
+
+    // 参数的数目与语句不符
+    static const unsigned int ERR_PARAM_COUNT = 1;
+
+    /**
+     * @brief 注册一个语句，参数用 `?` 表示，线程安全
+     * @return 语句的编号，通常在静态初始化时注册并保存下来
+    */
+    static Id define(const std::string &sql);
+
+    /**
+     * @brief 取出连接上缓存的语句，没有时准备它
+     * @param conn 借出的连接，必须有效并且比 SQLStmt 的生命期更长
+    */
+    SQLStmt(SQLConnRAII &conn, Id id);
+    ~SQLStmt();
+
+    SQLStmt(const SQLStmt&) = delete;
+    SQLStmt& operator=(const SQLStmt&) = delete;
+
+    /**
+     * @brief 语句是否已经准备好
+    */
+    explicit operator bool() const { return stmt != nullptr; }
+
+    /**
+     * @brief 按顺序绑定下一个参数
+    */
+    SQLStmt& bind(const std::string &value);
+    SQLStmt& bind(int64_t value);
+    SQLStmt& bind(int value) { return bind(static_cast<int64_t>(value)); }
+    SQLStmt& bind(double value);
+    SQLStmt& bind_null();
+
+    /**
+     * @brief 执行语句，有结果集时把结果全部读到客户端
+    */
+    bool execute();
+
+    /**
+     * @brief 移到结果集的下一行
+     * @return 没有更多的行或者出错时返回 false
+    */
+    bool fetch();
+
+    /**
+     * @brief 读取当前行的一列
+     * @return 列为 NULL 或者读取失败时返回 false
+    */
+    bool get(unsigned int col, std::string &value);
+    bool get(unsigned int col, int64_t &value);
+
+    /**
+     * @brief 读取结果集中余下的所有行，NULL 读为空串
+    */
+    bool fetch_all(QueryCache::Rows &rows);
+
+    /**
+     * @brief 执行只读的查询，结果按语句编号和参数缓存在 QueryCache 中
+     *
+     * 缓存中有有效的结果时不借出连接；没有开启缓存时每次都执行查询
+     * @param ttl 结果的有效期(毫秒)，不大于 0 时使用缓存的默认值
+     * @param cache_empty 是否缓存没有行的结果
+     * @return 查询失败时返回空指针
+    */
+    static QueryCache::Result query(SQLConnPool *pool, Id id,
+        const std::vector<std::string> &params, int ttl = 0, bool cache_empty = true);
+
+    uint64_t affected_rows() const;
+    /**
+     * @brief 最近一次失败的错误码：MySQL 的错误码，或者 ERR_PARAM_COUNT
+    */
+    unsigned int error_code() const { return err; }
+    const std::string& error() const { return err_msg; }
+
+private:
+    struct Value {
+        std::string str;
+        long long num;
+        double real;
+    };
+
+    /**
+     * @brief 从连接的缓存中取出语句，没有时准备它并放入缓存
+    */
+    bool prepare();
+    /**
+     * @brief 关闭语句并从缓存中移除
+    */
+    void evict();
+    MYSQL_BIND* next_param();
+    void save_error();
+
+    SQLConnRAII &conn;
+    Id id;
+    MYSQL_STMT *stmt;
+    std::vector<MYSQL_BIND> params;
+    std::vector<Value> values;     // 参数的值，与 params 一一对应
+    size_t bound;                  // 已经绑定的参数数目
+    std::vector<MYSQL_BIND> columns;  // 只取长度和是否为 NULL，列的值由 get() 按需读取
+    bool has_result;
+    unsigned int err;
+    std::string err_msg;
+};
+
+#endif // SQLSTMT_H
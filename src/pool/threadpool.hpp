@@ -7,42 +7,98 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
 #include <functional>
 #include <memory>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 #include <cassert>
 
 class ThreadPool {
+    struct Pool;
 public:
-    explicit ThreadPool(int thread_count_=8)
-    : pool(std::make_shared<Pool>()), thread_count(thread_count_) {
-        assert(thread_count > 0);
-        for (decltype(thread_count) i=0; i<thread_count; ++i) {
-            std::thread([pool_ = pool] {
-                std::unique_lock<std::mutex> lck(pool_->mtx);
-                while (true) {
-                    if (!pool_->tasks.empty()) {
-                        auto task = std::move(pool_->tasks.front());
-                        pool_->tasks.pop();
-                        lck.unlock();
-                        task();
-                        lck.lock();
-                    } else if (pool_->is_closed) {
-                        break;
-                    } else {
-                        pool_->cond.wait(lck);
-                    }
-                }
-            }).detach();
+    // 工作线程启动时（取任务之前）在该线程中调用的初始化函数，参数为线程序号
+    using ThreadInit = std::function<void(size_t)>;
+    // 队列中的任务数降到低水位时在工作线程中调用的通知函数
+    using DrainCallback = std::function<void()>;
+
+    /**
+     * @brief 弹性线程池的参数，min_threads 与 max_threads 相等时线程数固定
+    */
+    struct Options {
+        size_t min_threads;     // 常驻的线程数
+        size_t max_threads;     // 线程数的上限
+        int wait_target_ms;     // 任务在队列中等待超过这个时间且没有空闲线程时增加线程
+        int idle_timeout_ms;    // 多于 min_threads 的线程空闲这么久之后退出
+
+        Options(size_t min_ = 8, size_t max_ = 8, int wait_target = 10, int idle_timeout = 60000)
+        : min_threads(min_), max_threads(max_), wait_target_ms(wait_target),
+          idle_timeout_ms(idle_timeout) {}
+    };
+
+    /**
+     * @brief 线程池的运行状态
+    */
+    struct Stats {
+        size_t threads;    // 当前的线程数
+        size_t idle;       // 等待任务的线程数
+        size_t blocked;    // 在 BlockingScope 中阻塞的线程数
+        size_t peak;       // 线程数的峰值
+        uint64_t spawned;  // 启动之后新增的线程数
+        uint64_t retired;  // 因为空闲而退出的线程数
+    };
+
+    /**
+     * @brief 在作用域内声明当前的工作线程即将阻塞（例如等待数据库连接）
+     *
+     * 队列中还有任务而没有空闲线程时，弹性线程池立即补充一个线程，
+     * 不必等到任务的等待时间超过目标。不在工作线程中使用时没有作用
+    */
+    class BlockingScope {
+    public:
+        BlockingScope() : pool(current()) {
+            if (pool) pool->begin_blocking();
+        }
+        ~BlockingScope() {
+            if (pool) pool->end_blocking();
+        }
+        BlockingScope(const BlockingScope&) = delete;
+        BlockingScope& operator=(const BlockingScope&) = delete;
+    private:
+        Pool *pool;
+    };
+
+    explicit ThreadPool(int thread_count_=8, ThreadInit thread_init=nullptr)
+    : ThreadPool(Options(thread_count_, thread_count_), std::move(thread_init)) {}
+
+    ThreadPool(const Options &opts, ThreadInit thread_init=nullptr)
+    : pool(std::make_shared<Pool>()) {
+        assert(opts.min_threads > 0 && opts.min_threads <= opts.max_threads);
+        pool->opts = opts;
+        pool->thread_init = std::move(thread_init);
+        std::lock_guard<std::mutex> lck(pool->mtx);
+        for (size_t i=0; i<opts.min_threads; ++i) {
+            pool->spawn();
+        }
+        pool->spawned = 0;
+        if (opts.max_threads > opts.min_threads) {
+            // 所有的线程都卡在长任务中时没有人取任务，由监视线程定期检查排队时间
+            pool->monitor = std::thread(&Pool::watch, pool.get());
         }
     }
 
     ThreadPool() = default;
     ThreadPool(ThreadPool &&) = default;
-    
+
+    /**
+     * @brief 执行完队列中剩余的任务，等待所有的线程退出
+    */
     ~ThreadPool() {
         if (static_cast<bool>(pool)) {
             {
@@ -50,6 +106,21 @@ public:
                 pool->is_closed = true;
             }
             pool->cond.notify_all();
+            pool->monitor_cond.notify_all();
+            if (pool->monitor.joinable()) {
+                pool->monitor.join();
+            }
+            // 退出的线程不再修改线程表，逐个等待直到表为空
+            while (true) {
+                std::unique_lock<std::mutex> lck(pool->mtx);
+                pool->reap();
+                if (pool->threads.empty()) break;
+                auto it = pool->threads.begin();
+                std::thread t = std::move(it->second);
+                pool->threads.erase(it);
+                lck.unlock();
+                t.join();
+            }
         }
     }
 
@@ -57,21 +128,228 @@ public:
     void add_task(F &&task) {
         {
             std::lock_guard<std::mutex> lck(pool->mtx);
-            pool->tasks.emplace(std::forward<F>(task));
+            pool->tasks.emplace(std::forward<F>(task), Clock::now());
+            pool->depth = pool->tasks.size();
+            if (pool->idle == 0) {
+                pool->maybe_grow();
+            }
         }
         pool->cond.notify_one();
     }
 
-    size_t get_thread_count() { return thread_count; }
+    /**
+     * @brief 队列中等待执行的任务数（不包括正在执行的任务）
+    */
+    size_t queue_size() const { return pool->depth.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 登记一次性的通知：队列中的任务数降到 low_water 时，由取走任务的工作线程调用 cb
+     * @return 是否登记成功，队列的长度已经不超过 low_water 时不登记，返回 false
+    */
+    bool notify_when_drained(size_t low_water, DrainCallback cb) {
+        std::lock_guard<std::mutex> lck(pool->mtx);
+        if (pool->tasks.size() <= low_water) {
+            return false;
+        }
+        pool->low_water = low_water;
+        pool->on_drain = std::move(cb);
+        return true;
+    }
+
+    size_t get_thread_count() {
+        std::lock_guard<std::mutex> lck(pool->mtx);
+        return pool->threads.size() - pool->exited.size();
+    }
+
+    Stats get_stats() {
+        std::lock_guard<std::mutex> lck(pool->mtx);
+        return Stats{pool->threads.size() - pool->exited.size(), pool->idle, pool->blocked,
+            pool->peak, pool->spawned, pool->retired};
+    }
+
+    const Options& get_options() const { return pool->opts; }
 private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Task {
+        std::function<void()> fn;
+        Clock::time_point enqueued;   // 入队的时间，用于计算排队时间
+
+        Task() = default;
+        template <typename F>
+        Task(F &&f, Clock::time_point t) : fn(std::forward<F>(f)), enqueued(t) {}
+    };
+
+    /**
+     * @brief 任务的环形队列，容量只增不减；std::queue 底层的 deque 每隔十几个任务就要分配或者释放一个节点，
+     *        这里在容量足够时入队和出队都不分配内存
+    */
+    class TaskRing {
+    public:
+        bool empty() const { return cnt == 0; }
+        size_t size() const { return cnt; }
+        Task& front() { return slots[head]; }
+
+        template <typename... Args>
+        void emplace(Args&&... args) {
+            if (cnt == slots.size()) grow();
+            slots[(head + cnt) & (slots.size() - 1)] = Task(std::forward<Args>(args)...);
+            ++cnt;
+        }
+
+        void pop() {
+            slots[head].fn = nullptr;  // 释放任务持有的资源
+            head = (head + 1) & (slots.size() - 1);
+            --cnt;
+        }
+    private:
+        // 容量保持为 2 的幂，按位与取下标
+        void grow() {
+            std::vector<Task> bigger(std::max<size_t>(slots.size() * 2, 64));
+            for (size_t i = 0; i < cnt; ++i) {
+                bigger[i] = std::move(slots[(head + i) & (slots.size() - 1)]);
+            }
+            slots.swap(bigger);
+            head = 0;
+        }
+
+        std::vector<Task> slots;
+        size_t head = 0;
+        size_t cnt = 0;
+    };
+
     struct Pool {
         std::mutex mtx;
         std::condition_variable cond;
         bool is_closed;
-        std::queue<std::function<void()>> tasks;
+        TaskRing tasks;
+        std::atomic<size_t> depth;   // tasks 的长度，供其他线程无锁读取
+        size_t low_water;            // 调用 on_drain 的队列长度
+        DrainCallback on_drain;      // 登记的排空通知，调用后清空
+        Options opts;
+        ThreadInit thread_init;
+        std::unordered_map<size_t, std::thread> threads;  // 线程序号 -> 线程
+        std::thread monitor;         // 弹性模式下检查排队时间的线程
+        std::condition_variable monitor_cond;
+        std::vector<size_t> exited;  // 已经退出、等待回收的线程序号
+        size_t next_idx;             // 下一个线程的序号
+        size_t idle;
+        size_t blocked;
+        size_t peak;
+        uint64_t spawned;
+        uint64_t retired;
+
+        // 调用者持有 mtx
+        void spawn() {
+            reap();
+            size_t idx = next_idx++;
+            threads.emplace(idx, std::thread(&Pool::run, this, idx));
+            ++spawned;
+            peak = std::max(peak, threads.size());
+        }
+
+        // 回收已经退出的线程，调用者持有 mtx；线程在退出前最后一次持锁时登记，join 不会等待太久
+        void reap() {
+            for (size_t idx : exited) {
+                auto it = threads.find(idx);
+                if (it != threads.end()) {
+                    it->second.join();
+                    threads.erase(it);
+                }
+            }
+            exited.clear();
+        }
+
+        // 没有空闲线程时按需增加线程，调用者持有 mtx
+        void maybe_grow() {
+            size_t live = threads.size() - exited.size();
+            if (is_closed || tasks.empty() || live >= opts.max_threads) return;
+            auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+                Clock::now() - tasks.front().enqueued).count();
+            if (blocked > 0 || waited >= opts.wait_target_ms) {
+                spawn();
+            }
+        }
+
+        void watch() {
+            std::unique_lock<std::mutex> lck(mtx);
+            while (!is_closed) {
+                monitor_cond.wait_for(lck, std::chrono::milliseconds(std::max(opts.wait_target_ms, 1)));
+                if (idle == 0) {
+                    maybe_grow();
+                }
+            }
+        }
+
+        void begin_blocking() {
+            std::lock_guard<std::mutex> lck(mtx);
+            ++blocked;
+            if (idle == 0) {
+                maybe_grow();
+            }
+        }
+
+        void end_blocking() {
+            std::lock_guard<std::mutex> lck(mtx);
+            --blocked;
+        }
+
+        void run(size_t idx) {
+            current() = this;
+            if (thread_init) {
+                thread_init(idx);
+            }
+            const bool elastic = opts.max_threads > opts.min_threads;
+            std::unique_lock<std::mutex> lck(mtx);
+            while (true) {
+                if (!tasks.empty()) {
+                    auto task = std::move(tasks.front());
+                    tasks.pop();
+                    depth = tasks.size();
+                    DrainCallback drained;
+                    if (on_drain && tasks.size() <= low_water) {
+                        drained = std::move(on_drain);
+                        on_drain = nullptr;
+                    }
+                    if (elastic && idle == 0) {
+                        // 后面的任务也已经等待了太久
+                        maybe_grow();
+                    }
+                    lck.unlock();
+                    if (drained) {
+                        drained();
+                    }
+                    task.fn();
+                    lck.lock();
+                } else if (is_closed) {
+                    break;
+                } else if (elastic && threads.size() - exited.size() > opts.min_threads) {
+                    ++idle;
+                    bool woken = cond.wait_for(lck, std::chrono::milliseconds(opts.idle_timeout_ms),
+                        [this] { return !tasks.empty() || is_closed; });
+                    --idle;
+                    if (!woken && threads.size() - exited.size() > opts.min_threads) {
+                        // 空闲超时，退出并等待下一次增加线程或者析构时被回收
+                        exited.push_back(idx);
+                        ++retired;
+                        return;
+                    }
+                } else {
+                    ++idle;
+                    cond.wait(lck);
+                    --idle;
+                }
+            }
+        }
     };
+
+    // 当前线程所属的线程池，不是工作线程时为空
+    static Pool *& current() {
+        static thread_local Pool *p = nullptr;
+        return p;
+    }
+
     std::shared_ptr<Pool> pool;
-    size_t thread_count;
 };
 
-#endif
\ No newline at end of file
+#endif
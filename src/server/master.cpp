@@ -0,0 +1,278 @@
+/**
+ * @file master.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for the master process of the multi-process mode
+*/
+#include "master.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include "webserver.h"
+#include "../util/util.h"
+
+// 工作进程启动后这么短的时间(毫秒)内就退出时，推迟重启，避免反复崩溃时占满 CPU
+static const int MIN_LIFETIME = 1000;
+// 推迟重启的时间(毫秒)
+static const int RESPAWN_DELAY = 1000;
+// 平滑退出的期限之后再等待这么久(毫秒)，仍未退出的工作进程被强制结束
+static const int KILL_GRACE = 5000;
+
+/**
+ * @brief 主进程的日志，格式与异步日志相同，写到标准错误
+*/
+static void master_log(const char *level, const char *fmt, ...) {
+    char tm_buf[32];
+    time_t t = time(nullptr);
+    tm now_tm;
+    localtime_r(&t, &now_tm);
+    strftime(tm_buf, sizeof(tm_buf), "%Y-%m-%d %H:%M:%S", &now_tm);
+    char msg[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+    fprintf(stderr, "[%-5s] [%s] [master %d] %s\n", level, tm_buf, getpid(), msg);
+}
+
+Master::Master(const Config &cfg, WorkerMain worker_main_):
+worker_main(std::move(worker_main_)), ip(cfg.get_string("listen_ip")),
+open_linger(cfg.get_bool("open_linger")),
+stats_interval(std::max(cfg.get_integer("stats_interval", 60000), 0)),
+shutdown_timeout(std::max(cfg.get_integer("shutdown_timeout", 10000), 0)),
+sessions(cfg.get_bool("session")),
+sock_opts(SocketOptions::from_config(cfg)), slots(nullptr), restarts(0), stopping(false),
+stop_deadline(0) {
+    ports.push_back(cfg.get_integer("listen_port"));
+    if (cfg.get_integer("tls_port", 0) > 0) {
+        ports.push_back(cfg.get_integer("tls_port"));
+    }
+    // 每个工作进程绑定自己的监听 socket，由内核在它们之间分配连接
+    sock_opts.reuse_port = true;
+    size_t n = std::max(cfg.get_integer("worker_processes", 1), 1);
+    workers.resize(n, Worker{-1, 0, -1, {}});
+}
+
+Master::~Master() {
+    for (auto &w : workers) {
+        for (int fd : w.fds) {
+            close(fd);
+        }
+    }
+    if (slots) {
+        munmap(slots, workers.size() * sizeof(WorkerSlot));
+    }
+}
+
+bool Master::init_listeners() {
+    void *mem = mmap(nullptr, workers.size() * sizeof(WorkerSlot), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        master_log("ERROR", "Failed to map shared memory: %s", strerror(errno));
+        return false;
+    }
+    slots = static_cast<WorkerSlot*>(mem);
+    for (size_t i=0; i<workers.size(); ++i) {
+        new (&slots[i]) WorkerSlot();
+        slots[i].idx = i;
+        for (int port : ports) {
+            int fd = WebServer::open_listener(ip, port, open_linger, sock_opts);
+            if (fd < 0) {
+                master_log("ERROR", "Failed to listen on %s:%d: %s", ip.c_str(), port,
+                    strerror(errno));
+                return false;
+            }
+            workers[i].fds.push_back(fd);
+        }
+    }
+    return true;
+}
+
+bool Master::spawn(int idx) {
+    Worker &w = workers[idx];
+    pid_t master_pid = getpid();
+    pid_t pid = fork();
+    if (pid < 0) {
+        master_log("ERROR", "Failed to fork worker %d: %s", idx, strerror(errno));
+        w.respawn_at = monotonic_ms() + RESPAWN_DELAY;
+        return false;
+    }
+    if (pid == 0) {
+        // 主进程意外退出时工作进程收到 SIGTERM，平滑退出（信号已被屏蔽，由 signalfd 读取）
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid() != master_pid) {
+            _exit(EXIT_FAILURE);
+        }
+        // 只保留自己的监听 socket
+        for (size_t i=0; i<workers.size(); ++i) {
+            if (static_cast<int>(i) == idx) continue;
+            for (int fd : workers[i].fds) {
+                close(fd);
+            }
+        }
+        WebServer::hand_over_listeners(w.fds);
+        slots[idx].pid = getpid();
+        exit(worker_main(idx, &slots[idx]));
+    }
+    w.pid = pid;
+    w.started = monotonic_ms();
+    w.respawn_at = -1;
+    slots[idx].pid = pid;
+    master_log("INFO", "Started worker %d (pid %d)", idx, pid);
+    return true;
+}
+
+void Master::reap() {
+    int status = 0;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        auto it = std::find_if(workers.begin(), workers.end(), [pid](const Worker &w) {
+            return w.pid == pid;
+        });
+        if (it == workers.end()) continue;
+        int idx = it - workers.begin();
+        it->pid = -1;
+        slots[idx].pid = 0;
+        slots[idx].active = 0;
+        bool crashed = WIFSIGNALED(status);
+        int code = crashed ? WTERMSIG(status) : WEXITSTATUS(status);
+        if (stopping) {
+            master_log("INFO", "Worker %d (pid %d) exited with %s %d", idx, pid,
+                crashed ? "signal" : "status", code);
+            continue;
+        }
+        int64_t now = monotonic_ms();
+        bool too_soon = now - it->started < MIN_LIFETIME;
+        it->respawn_at = too_soon ? now + RESPAWN_DELAY : now;
+        ++restarts;
+        master_log("ERROR", "Worker %d (pid %d) exited with %s %d, restarting%s", idx, pid,
+            crashed ? "signal" : "status", code, too_soon ? " after a delay" : "");
+    }
+}
+
+void Master::signal_workers(int sig) {
+    for (auto &w : workers) {
+        if (w.pid > 0) {
+            kill(w.pid, sig);
+        }
+    }
+}
+
+int Master::alive() const {
+    return std::count_if(workers.begin(), workers.end(), [](const Worker &w) {
+        return w.pid > 0;
+    });
+}
+
+void Master::report() {
+    uint64_t accepted = 0;
+    int active = 0;
+    for (size_t i=0; i<workers.size(); ++i) {
+        accepted += slots[i].accepted.load(std::memory_order_relaxed);
+        active += slots[i].active.load(std::memory_order_relaxed);
+    }
+    master_log("INFO", "Workers: %d of %zu alive, %llu restarts; connections: %llu accepted, "
+        "%d active", alive(), workers.size(), static_cast<unsigned long long>(restarts),
+        static_cast<unsigned long long>(accepted), active);
+    for (size_t i=0; i<workers.size(); ++i) {
+        master_log("INFO", "  worker %zu (pid %d): %llu accepted, %d active", i,
+            slots[i].pid.load(), static_cast<unsigned long long>(slots[i].accepted.load()),
+            slots[i].active.load());
+    }
+}
+
+int Master::run() {
+    if (sessions && workers.size() > 1) {
+        // 会话表在各个工作进程自己的堆中，登录之后的请求可能被内核分给另一个工作进程
+        master_log("ERROR", "session = true requires worker_processes = 1: sessions are kept per "
+            "worker, so a login on one worker is unknown to the others");
+        return EXIT_FAILURE;
+    }
+    if (!init_listeners()) {
+        return EXIT_FAILURE;
+    }
+    master_log("INFO", "Master process %d, %zu workers on %s:%d", getpid(), workers.size(),
+        ip.c_str(), ports[0]);
+    for (size_t i=0; i<workers.size(); ++i) {
+        spawn(i);
+    }
+
+    // 这些信号已经在 main() 中屏蔽，主进程只有一个线程，直接同步地等待
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int sig : {SIGHUP, SIGTERM, SIGINT, SIGQUIT, SIGUSR2, SIGCHLD}) {
+        sigaddset(&mask, sig);
+    }
+    int64_t next_report = stats_interval > 0 ? monotonic_ms() + stats_interval : -1;
+    while (!stopping || alive() > 0) {
+        int64_t now = monotonic_ms();
+        int64_t wake = now + 60000;
+        if (next_report >= 0) wake = std::min(wake, next_report);
+        if (stopping) wake = std::min(wake, stop_deadline);
+        for (auto &w : workers) {
+            if (w.respawn_at >= 0) wake = std::min(wake, w.respawn_at);
+        }
+        int64_t wait = std::max<int64_t>(wake - now, 0);
+        timespec ts = {static_cast<time_t>(wait / 1000), static_cast<long>(wait % 1000) * 1000000};
+        siginfo_t info;
+        int sig = sigtimedwait(&mask, &info, &ts);
+        switch (sig) {
+            case SIGCHLD:
+                reap();
+                break;
+            case SIGTERM:
+            case SIGINT:
+            case SIGQUIT:
+                if (!stopping) {
+                    master_log("INFO", "%s: stopping %d workers", strsignal(sig), alive());
+                    stopping = true;
+                    stop_deadline = monotonic_ms() + shutdown_timeout + KILL_GRACE;
+                    for (auto &w : workers) {
+                        w.respawn_at = -1;
+                    }
+                }
+                // 工作进程各自平滑退出，再次收到 SIGTERM/SIGINT 时立即关闭剩余的连接
+                signal_workers(sig);
+                break;
+            case SIGHUP:
+                master_log("INFO", "Reloading configuration in %d workers", alive());
+                signal_workers(SIGHUP);
+                break;
+            case SIGUSR2:
+                master_log("WARN", "Binary upgrade is not supported in multi-process mode");
+                break;
+        }
+
+        now = monotonic_ms();
+        if (stopping) {
+            if (now >= stop_deadline && alive() > 0) {
+                master_log("WARN", "Killing %d workers that did not exit in time", alive());
+                signal_workers(SIGKILL);
+                stop_deadline = INT64_MAX;
+            }
+            continue;
+        }
+        for (size_t i=0; i<workers.size(); ++i) {
+            if (workers[i].respawn_at >= 0 && workers[i].respawn_at <= now) {
+                spawn(i);
+            }
+        }
+        if (next_report >= 0 && now >= next_report) {
+            report();
+            next_report = now + stats_interval;
+        }
+    }
+    master_log("INFO", "All workers exited, master process %d quits", getpid());
+    return EXIT_SUCCESS;
+}
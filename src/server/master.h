@@ -0,0 +1,82 @@
+/**
+ * @file master.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for the master process of the multi-process mode
+*/
+#ifndef MASTER_H
+#define MASTER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "workerslot.h"
+#include "../config/config.h"
+#include "../socket/sockopts.h"
+
+/**
+ * @brief 多进程模式的主进程：绑定监听 socket，创建并看护工作进程
+ *
+ * 每个工作进程有自己的一组 SO_REUSEPORT 监听 socket，由内核在它们之间分配连接，
+ * 工作进程之间不共享堆、锁和 accept 队列；一个工作进程崩溃只影响它自己的连接，
+ * 主进程随后用同样的监听 socket 重新创建它。主进程不创建线程，不使用异步日志，
+ * 自己的日志写到标准错误
+*/
+class Master {
+public:
+    /**
+     * @brief 工作进程的入口，在 fork 得到的子进程中调用
+     * @param idx 工作进程的编号
+     * @param slot 工作进程在共享内存中的统计
+     * @return 进程的退出码
+    */
+    using WorkerMain = std::function<int(int idx, WorkerSlot *slot)>;
+
+    Master(const Config &cfg, WorkerMain worker_main);
+    ~Master();
+
+    Master(const Master&) = delete;
+    Master& operator=(const Master&) = delete;
+
+    /**
+     * @brief 运行主进程的循环，所有工作进程退出后返回
+     * @return 进程的退出码
+    */
+    int run();
+
+private:
+    struct Worker {
+        pid_t pid;               // 没有运行时为 -1
+        int64_t started;         // 启动的时间
+        int64_t respawn_at;      // 等待重启时的重启时间，-1 表示不需要重启
+        std::vector<int> fds;    // 交给这个工作进程的监听 socket
+    };
+
+    bool init_listeners();
+    bool spawn(int idx);
+    /**
+     * @brief 回收退出的工作进程，没有在退出时安排重启
+    */
+    void reap();
+    void signal_workers(int sig);
+    void report();
+    int alive() const;
+
+    WorkerMain worker_main;
+    std::string ip;
+    std::vector<int> ports;
+    bool open_linger;
+    int stats_interval;        // 输出统计的间隔(毫秒)，0 表示不输出
+    int shutdown_timeout;      // 工作进程平滑退出的期限(毫秒)
+    bool sessions;             // 是否开启了会话，会话表不能在工作进程之间共享
+    SocketOptions sock_opts;
+    std::vector<Worker> workers;
+    WorkerSlot *slots;         // 共享内存中每个工作进程的统计
+    uint64_t restarts;
+    bool stopping;
+    int64_t stop_deadline;     // 超过这个时间仍未退出的工作进程被强制结束
+};
+
+#endif // MASTER_H
@@ -5,25 +5,131 @@
  * @brief source files for webserver
 */
 #include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
 #include <fcntl.h>
+#include <csignal>
+#include <algorithm>
+#include <cctype>
+#include <climits>
 #include <cstring>
 #include "webserver.h"
 
+// 定时器的编号与连接的文件描述符相同，统计输出的定时器使用文件描述符不可能取到的编号
+static const int STATS_TIMER_ID = INT_MAX;
+// 清理过期会话的定时器
+static const int SESSION_TIMER_ID = INT_MAX - 1;
+// 平滑退出期间检查剩余连接的定时器
+static const int DRAIN_TIMER_ID = INT_MAX - 2;
+// 释放旧配置快照的定时器
+static const int RCU_TIMER_ID = INT_MAX - 3;
+// 非阻塞数据库连接使用的定时器编号从这里向下分配
+static const int ASYNC_SQL_TIMER_BASE = INT_MAX - 4;
+// 清理过期会话的间隔(毫秒)
+static const int SESSION_SWEEP_INTERVAL = 1000;
+// 平滑退出期间检查剩余连接的间隔(毫秒)
+static const int DRAIN_CHECK_INTERVAL = 100;
+// 检查旧配置快照能否释放的间隔(毫秒)
+static const int RCU_RECLAIM_INTERVAL = 100;
 
-void WebServer::init_db_pool(
-    const char *sql_host, int sql_port,
-    const char *sql_username, const char *sql_passwd,
-    const char *db_name, int conn_pool_num
-) {
-    SQLConnPool::get_instance()->init(sql_host, sql_port, sql_username,
-        sql_passwd, db_name, conn_pool_num);
-    LOG_INFO("Number of connections in SQL-Pool: %d", conn_pool_num);
+// 热升级时通过环境变量告诉新进程：继承的监听 socket，以及接管之后需要通知退出的旧进程
+static const char *LISTEN_FDS_ENV = "YAWN_LISTEN_FDS";
+static const char *PARENT_PID_ENV = "YAWN_PARENT_PID";
+
+// 数据库的访问可能阻塞很久，计算密集的任务会占满 CPU，都不应拖慢静态资源的响应
+static const struct {
+    HttpConn::WORK_CLASS cls;
+    const char *prefix;
+    const char *name;
+} CLASS_POOLS[] = {
+    {HttpConn::WORK_DB, "db_pool", "DB-Pool"},
+    {HttpConn::WORK_CPU, "cpu_pool", "CPU-Pool"}
+};
+static const char *POLICY_NAMES[] = {"off", "cheap", "all"};
+
+// 逗号或空白分隔的列表
+static std::vector<string> split_list(const string &str) {
+    std::vector<string> items;
+    string item;
+    for (char ch : str) {
+        if (ch == ',' || std::isspace(static_cast<unsigned char>(ch))) {
+            if (!item.empty()) items.push_back(std::move(item));
+            item.clear();
+        } else {
+            item.push_back(ch);
+        }
+    }
+    if (!item.empty()) items.push_back(std::move(item));
+    return items;
 }
 
-WebServer::WebServer(const Config &cfg):
-m_is_close(false), m_tm_heap(new TimeHeap()) {
+// 由事件循环通过 signalfd 处理的信号
+static void handled_signals(sigset_t *mask) {
+    sigemptyset(mask);
+    for (int sig : {SIGHUP, SIGTERM, SIGINT, SIGQUIT, SIGUSR2, SIGCHLD}) {
+        sigaddset(mask, sig);
+    }
+}
+
+/**
+ * @brief 从环境变量中取出旧进程交给本进程的监听 socket，并清除环境变量以免再传给其他进程
+*/
+static std::vector<int> inherited_listeners() {
+    std::vector<int> fds;
+    const char *env = getenv(LISTEN_FDS_ENV);
+    if (!env) return fds;
+    for (const auto &item : split_list(env)) {
+        int fd = atoi(item.c_str());
+        if (fd > STDERR_FILENO && fcntl(fd, F_GETFD) >= 0) {
+            fds.push_back(fd);
+        }
+    }
+    unsetenv(LISTEN_FDS_ENV);
+    return fds;
+}
+
+static pid_t upgrade_parent() {
+    const char *env = getenv(PARENT_PID_ENV);
+    if (!env) return -1;
+    pid_t pid = atoi(env);
+    unsetenv(PARENT_PID_ENV);
+    // 旧进程已经退出时本进程被其他进程收养，不能再向这个 pid 发送信号
+    return pid > 0 && getppid() == pid ? pid : -1;
+}
+
+void WebServer::init_db_pool(const Config &cfg) {
+    SQLConnPool::Options opts;
+    opts.host = cfg.get_string("sql_host");
+    opts.port = cfg.get_integer("sql_port", 3306);
+    opts.user = cfg.get_string("sql_username");
+    opts.passwd = cfg.get_string("sql_passwd");
+    opts.db_name = cfg.get_string("db_name");
+    opts.min_conn = std::max(cfg.get_integer("conn_pool_num", 8), 1);
+    opts.max_conn = std::max(cfg.get_integer("conn_pool_max", opts.min_conn), opts.min_conn);
+    opts.idle_timeout = std::max(cfg.get_integer("conn_pool_idle_timeout", 60000), 0);
+    opts.ping_interval = std::max(cfg.get_integer("sql_ping_interval", 30000), 0);
+    opts.acquire_timeout = cfg.get_integer("sql_acquire_timeout", 3000);
+    opts.connect_timeout = std::max(cfg.get_integer("sql_connect_timeout", 3000), 1);
+    opts.io_timeout = std::max(cfg.get_integer("sql_io_timeout", 10000), 0);
+    // 连接失败时不退出，连接池在后台重试，期间数据库请求返回 503
+    SQLConnPool::get_instance()->init(opts);
+}
+
+WebServer::WebServer(const Config &cfg, WorkerSlot *slot):
+m_listen_fd(-1), m_tls_port(0), m_tls_listen_fd(-1),
+m_is_close(false), m_sock_opts(SocketOptions::from_config(cfg)),
+m_live(load_live_settings(cfg)), m_config(new Config(cfg)), m_signal_fd(-1),
+m_draining(false), m_drain_deadline(0), m_upgrade_pid(-1), m_parent_pid(upgrade_parent()),
+m_inherited_fds(inherited_listeners()), m_worker_slot(slot),
+m_stats_interval(0), m_stats(), m_last_stats(), m_queue_limit(0), m_queue_low(0),
+m_throttle_accept(true), m_drain_fd(-1), m_throttle_start(-1), m_tm_heap(new TimeHeap()),
+m_class_routed(), m_class_shed(), m_snapshot_interval(0), m_last_snapshot(0), m_post_fd(-1) {
     LOG_INFO("====== Server initialization ======");
 
+    // 先固定 reactor 线程，之后创建的 epoll 事件数组、连接对象等都分配在本地节点
+    init_affinity(cfg.get_string("reactor_cpus"), cfg.get_string("worker_cpus"));
+
     int max_num_fds = cfg.get_integer("max_num_fds", 1024);
     if (max_num_fds < 2) {
         LOG_ERROR("max_num_fds must be greater than 1");
@@ -37,33 +143,79 @@ m_is_close(false), m_tm_heap(new TimeHeap()) {
     if (!init_socket(
         cfg.get_string("listen_ip"),
         cfg.get_integer("listen_port"),
-        cfg.get_integer("timeout"),
         cfg.get_bool("open_linger"),
         cfg.get_integer("trig_mode")
     )) {
         m_is_close = true;
     }
 
+    // 低延迟模式：事件循环在阻塞之前忙轮询，连接 socket 开启 SO_BUSY_POLL
+    if (m_sock_opts.busy_poll_us > 0) {
+        m_epoller->set_busy_poll(m_sock_opts.busy_poll_us);
+        LOG_INFO("Busy-poll mode: spin %d us before blocking", m_sock_opts.busy_poll_us);
+    }
+
     m_src_dir = cfg.get_string("src_dir");
     LOG_INFO("Resource directory: %s", m_src_dir.c_str());
     auto thread_count = cfg.get_integer("thread_pool_num");
-    m_thread_pool.reset(new ThreadPool(thread_count));
-    LOG_INFO("Number of threads in Thread-Pool: %d", thread_count);
+    ThreadPool::ThreadInit worker_init;
+    if (!m_worker_cpus.empty()) {
+        CpuList cpus = m_worker_cpus;
+        worker_init = [cpus](size_t idx) {
+            if (!place_current_thread(cpus)) {
+                LOG_WARN("Failed to bind worker thread %zu to CPUs %s", idx,
+                    cpu_list_to_string(cpus).c_str());
+            }
+        };
+    }
+    // thread_pool_max 大于 thread_pool_num 时线程池按负载伸缩
+    ThreadPool::Options pool_opts(thread_count,
+        std::max(cfg.get_integer("thread_pool_max", thread_count), thread_count),
+        cfg.get_integer("thread_pool_wait_target", 10),
+        cfg.get_integer("thread_pool_idle_timeout", 60000));
+    m_pools[HttpConn::WORK_STATIC].reset(new ThreadPool(pool_opts, worker_init));
+    if (pool_opts.max_threads > pool_opts.min_threads) {
+        LOG_INFO("Number of threads in Thread-Pool: %zu-%zu, grow when a task waits %d ms, "
+            "retire after %d ms idle", pool_opts.min_threads, pool_opts.max_threads,
+            pool_opts.wait_target_ms, pool_opts.idle_timeout_ms);
+    } else {
+        LOG_INFO("Number of threads in Thread-Pool: %d", thread_count);
+    }
+    init_class_pools(cfg, pool_opts, worker_init);
+    init_dispatch(cfg);
 
     HttpConn::conn_count = 0;
+    HttpConn::use_cork = m_sock_opts.cork;
+    HttpConn::enable_db = cfg.get_bool("enable_db");
     HttpConn::src_dir = m_src_dir;
+    if (!init_bundle(cfg)) {
+        m_is_close = true;
+    }
+    ResponseTemplates::init(m_src_dir);
+    init_limits(cfg);
+    if (!m_is_close && !init_tls(cfg)) {
+        m_is_close = true;
+    }
 
     // 初始化数据库连接池
     m_enable_db = cfg.get_bool("enable_db");
+    if (m_enable_db && !init_async_db(cfg)) {
+        init_db_pool(cfg);
+        init_reg_batcher(cfg);
+    } else if (m_async_sql && cfg.get_bool("reg_batch")) {
+        LOG_WARN("reg_batch is ignored: registrations already use the Async-SQL-Pool");
+    }
     if (m_enable_db) {
-        init_db_pool(
-            cfg.get_string("sql_host").c_str(),
-            cfg.get_integer("sql_port"),
-            cfg.get_string("sql_username").c_str(),
-            cfg.get_string("sql_passwd").c_str(),
-            cfg.get_string("db_name").c_str(),
-            cfg.get_integer("conn_pool_num"));
+        init_query_cache(cfg);
     }
+    init_sessions(cfg);
+    init_signals();
+    for (int fd : m_inherited_fds) {
+        // 旧进程的监听端口在新的配置中已经不存在
+        LOG_WARN("Closing inherited listen socket %d, no listener uses its port", fd);
+        close(fd);
+    }
+    m_inherited_fds.clear();
 
     if (m_is_close) {
         LOG_ERROR("Server initialization error");
@@ -71,29 +223,78 @@ m_is_close(false), m_tm_heap(new TimeHeap()) {
 }
 
 WebServer::~WebServer() {
-    close(m_listen_fd);
+    // 先等待工作线程执行完剩余的任务，任务中会用到 epoll 和连接对象；
+    // 静态资源线程池中的任务可能把请求交给其他类别的线程池，所以最先析构它
+    for (auto &pool : m_pools) {
+        pool.reset();
+    }
+    m_async_sql.reset();
+    // 写完排队的注册，它使用同步的连接池，必须在连接池关闭之前析构；
+    // 这时交给主线程的结果不再执行，随连接对象一起释放
+    m_reg_batcher.reset();
+    if (m_post_fd >= 0) {
+        close(m_post_fd);
+    }
+    HttpConn::bundle = nullptr;
+    if (m_listen_fd >= 0) {
+        close(m_listen_fd);
+    }
+    if (m_tls_listen_fd >= 0) {
+        close(m_tls_listen_fd);
+    }
+    if (m_drain_fd >= 0) {
+        close(m_drain_fd);
+    }
+    if (m_signal_fd >= 0) {
+        close(m_signal_fd);
+    }
     m_is_close = true;
-    if (m_enable_db) {
+    if (m_enable_db && !m_async_sql) {
         SQLConnPool::get_instance()->close();
     }
+    if (SessionStore::get_instance()->enabled()) {
+        SessionStore::get_instance()->save();
+    }
     LOG_INFO("====== Server closed ======");
 }
 
 void WebServer::start() {
     if (m_is_close) return;
     LOG_INFO("====== Server start ======");
+    if (m_parent_pid > 0) {
+        // 监听 socket 已经在事件循环中，旧进程可以停止接受连接了
+        LOG_INFO("Took over listen sockets, asking the previous process %d to drain",
+            m_parent_pid);
+        kill(m_parent_pid, SIGQUIT);
+        m_parent_pid = -1;
+    }
+    if (m_stats_interval > 0) {
+        m_tm_heap->add(STATS_TIMER_ID, m_stats_interval, std::bind(&WebServer::report_stats, this));
+    }
+    if (SessionStore::get_instance()->enabled()) {
+        m_last_snapshot = HttpConn::now_ms();
+        m_tm_heap->add(SESSION_TIMER_ID, SESSION_SWEEP_INTERVAL,
+            std::bind(&WebServer::sweep_sessions, this));
+    }
     int wait_tm = -1;
     while (!m_is_close) {
-        if (m_timeout > 0) {
-            // 处理定时事件
-            wait_tm = m_tm_heap->get_next_tick();
-        }
+        // 处理定时事件，没有定时器时一直等待
+        wait_tm = m_tm_heap->get_next_tick();
+        if (m_is_close) break;   // 定时器结束了平滑退出
         int event_cnt = m_epoller->wait(wait_tm);
         for (int i=0; i<event_cnt; ++i) {
             int fd = m_epoller->get_event_fd(i);
             uint32_t events = m_epoller->get_events(i);
-            if (fd == m_listen_fd) {
-                deal_listen();
+            if (fd == m_listen_fd || fd == m_tls_listen_fd) {
+                deal_listen(fd);
+            } else if (fd == m_drain_fd) {
+                resume_reads();
+            } else if (fd == m_post_fd) {
+                run_posted();
+            } else if (fd == m_signal_fd) {
+                deal_signal();
+            } else if (m_async_sql && m_async_sql->owns(fd)) {
+                m_async_sql->on_event(fd, events);
             } else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
                 if (m_clients.count(fd)) {
                     close_conn(m_clients[fd]);
@@ -114,82 +315,115 @@ void WebServer::start() {
 }
 
 bool WebServer::init_socket(
-    const string &ip, int listen_port, int timeout,
+    const string &ip, int listen_port,
     bool open_linger, int trig_mode
 ) {
     m_ip = ip;
     m_listen_port = listen_port;
-    m_timeout = timeout;
     m_open_linger = open_linger;
     init_event_mode(trig_mode);
 
+    m_listen_fd = create_listener(m_listen_port);
+    if (m_listen_fd < 0) {
+        return false;
+    }
+
+    LOG_INFO("Listen on %s:%d, open-linger: %s", m_ip.c_str(), m_listen_port,
+            (m_open_linger ? "true" : "false"));
+    LOG_INFO("Socket options: backlog %d, defer-accept %ds, fastopen %d, nodelay %s, "
+        "cork %s, sndbuf %d, rcvbuf %d", m_sock_opts.backlog,
+        m_sock_opts.defer_accept, m_sock_opts.fastopen,
+        (m_sock_opts.nodelay ? "true" : "false"), (m_sock_opts.cork ? "true" : "false"),
+        m_sock_opts.sndbuf, m_sock_opts.rcvbuf);
+    LOG_INFO("Listen mode: %s, Open connection mode: %s",
+        ((m_listen_event & EPOLLET) ? "ET" : "LT"),
+        ((m_conn_event & EPOLLET) ? "ET" : "LT"));
+    return true;
+}
+
+int WebServer::create_listener(int port) {
+    int listen_fd = take_inherited_listener(port);
+    if (listen_fd >= 0) {
+        // socket 选项和 backlog 沿用旧进程（或主进程）的设置，新的值需要完整重启才能生效
+        LOG_INFO("Using listen socket %d inherited from the parent process for port %d",
+            listen_fd, port);
+    } else {
+        listen_fd = open_listener(m_ip, port, m_open_linger, m_sock_opts);
+        if (listen_fd < 0) {
+            return -1;
+        }
+    }
+
+    if (!m_epoller->add_fd(listen_fd, m_listen_event | EPOLLIN)) {
+        close(listen_fd);
+        LOG_ERROR("Add listen events error!");
+        return -1;
+    }
+
+    return listen_fd;
+}
+
+int WebServer::open_listener(const string &ip, int port, bool open_linger,
+    const SocketOptions &opts
+) {
     int ret;
     
     struct sockaddr_in addr;
-    if (m_listen_port > 65535 || m_listen_port < 1024) {
-        LOG_ERROR("Invalid port number: %d (1024 <= port <= 65535)", m_listen_port);
-        return false;
+    if (port > 65535 || port < 1024) {
+        LOG_ERROR("Invalid port number: %d (1024 <= port <= 65535)", port);
+        return -1;
     }
     addr.sin_family = AF_INET;
-    inet_pton(AF_INET, m_ip.c_str(), &addr.sin_addr);
-    addr.sin_port = htons(m_listen_port);
+    inet_pton(AF_INET, ip.c_str(), &addr.sin_addr);
+    addr.sin_port = htons(port);
 
-    m_listen_fd = socket(PF_INET, SOCK_STREAM, 0);
-    if (m_listen_fd < 0) {
+    int listen_fd = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
         LOG_ERROR("Create socket error!");
-        return false;
+        return -1;
     }
     struct linger opt_linger = {0, 0};
-    if (m_open_linger) {
+    if (open_linger) {
         // 开启linger选项：如有数据待发送，则延迟关闭
         opt_linger.l_onoff = 1;
         opt_linger.l_linger = 1;
     }
-    ret = setsockopt(m_listen_fd, SOL_SOCKET, SO_LINGER, &opt_linger,
+    ret = setsockopt(listen_fd, SOL_SOCKET, SO_LINGER, &opt_linger,
         sizeof(opt_linger));
     if (ret < 0) {
-        close(m_listen_fd);
+        close(listen_fd);
         LOG_ERROR("Set linger error!");
-        return false;
+        return -1;
     }
     int optval = 1;
     // 设置地址重用
-    ret = setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &optval,
+    ret = setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &optval,
         sizeof(optval));
     if (ret < 0) {
-        close(m_listen_fd);
+        close(listen_fd);
         LOG_ERROR("Set reuse-address error!");
-        return false;
+        return -1;
     }
 
-    ret = bind(m_listen_fd, (sockaddr *)&addr, sizeof(addr));
-    if (ret < 0) {
-        close(m_listen_fd);
-        LOG_ERROR("Bind %s:%d error!", m_ip, m_listen_port);
-        return false;
+    // TCP_NODELAY、缓冲区大小等选项会被连接 socket 继承
+    if (!opts.apply_to_listener(listen_fd)) {
+        LOG_WARN("Set some socket options on listen socket failed: %s", strerror(errno));
     }
 
-    ret = listen(m_listen_fd, 6);
+    ret = bind(listen_fd, (sockaddr *)&addr, sizeof(addr));
     if (ret < 0) {
-        close(m_listen_fd);
-        LOG_ERROR("Listen %s:%d error!", m_ip, m_listen_port);
-        return false;
+        close(listen_fd);
+        LOG_ERROR("Bind %s:%d error!", ip.c_str(), port);
+        return -1;
     }
 
-    ret = m_epoller->add_fd(m_listen_fd, m_listen_event | EPOLLIN);
+    ret = listen(listen_fd, opts.backlog);
     if (ret < 0) {
-        close(m_listen_fd);
-        LOG_ERROR("Add listen events error!");
-        return false;
+        close(listen_fd);
+        LOG_ERROR("Listen %s:%d error!", ip.c_str(), port);
+        return -1;
     }
-
-    set_nonblocking(m_listen_fd);
-    LOG_INFO("Listen on %s:%d, open-linger: %s", m_ip.c_str(), m_listen_port,
-            (m_open_linger ? "true" : "false"));
-    LOG_INFO("Listen mode: %s, Open connection mode: %s",
-        ((m_listen_event & EPOLLET) ? "ET" : "LT"),
-        ((m_conn_event & EPOLLET) ? "ET" : "LT"));
-    return true;
+    return listen_fd;
 }
 
 void WebServer::init_event_mode(int trig_mode) {
@@ -215,40 +449,946 @@ void WebServer::init_event_mode(int trig_mode) {
     HttpConn::is_ET = (m_conn_event & EPOLLET);
 }
 
-/**
- * @brief 将指定文件描述符设为非阻塞的
- * @param fd 文件描述符
- * @return 原来的文件状态标志
-*/
-int WebServer::set_nonblocking(int fd) {
-    int old_option = fcntl(fd, F_GETFL);
-    int new_option = old_option | O_NONBLOCK;
-    fcntl(fd, F_SETFL, new_option);
-    return old_option;
+std::unique_ptr<WebServer::LiveSettings> WebServer::load_live_settings(const Config &cfg) {
+    std::unique_ptr<LiveSettings> live(new LiveSettings());
+    live->timeout = cfg.get_integer("timeout");
+    const std::string policy = cfg.get_string("inline_policy");
+    if (policy == "off") {
+        live->inline_policy = INLINE_OFF;
+    } else if (policy == "all") {
+        live->inline_policy = INLINE_ALL;
+    } else {
+        if (!policy.empty() && policy != "cheap") {
+            LOG_WARN("Unknown inline_policy \"%s\", using \"cheap\"", policy.c_str());
+        }
+        live->inline_policy = INLINE_CHEAP;
+    }
+    live->inline_max_bytes = std::max(cfg.get_integer("inline_max_bytes", 32768), 0);
+    live->shutdown_timeout = std::max(cfg.get_integer("shutdown_timeout", 10000), 0);
+    for (const auto &c : CLASS_POOLS) {
+        live->class_queue_limit[c.cls] =
+            std::max(cfg.get_integer(std::string(c.prefix) + "_queue_limit", 0), 0);
+    }
+    return live;
+}
+
+void WebServer::init_dispatch(const Config &cfg) {
+    m_stats_interval = std::max(cfg.get_integer("stats_interval", 60000), 0);
+    LOG_INFO("Inline processing on the reactor: %s, max file size %zu bytes",
+        POLICY_NAMES[m_live->inline_policy], m_live->inline_max_bytes);
+
+    m_queue_limit = std::max(cfg.get_integer("pool_queue_limit", 0), 0);
+    if (m_queue_limit == 0) return;
+    int low = cfg.get_integer("pool_queue_low", 0);
+    m_queue_low = low > 0 ? std::min<size_t>(low, m_queue_limit - 1) : m_queue_limit / 2;
+    m_throttle_accept = cfg.get_bool("throttle_accept", true);
+    m_drain_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_drain_fd < 0 || !m_epoller->add_fd(m_drain_fd, EPOLLIN)) {
+        LOG_ERROR("Failed to create the eventfd for pool backpressure: %s", strerror(errno));
+        m_queue_limit = 0;
+        return;
+    }
+    LOG_INFO("Thread-Pool queue limit %zu, resume below %zu, pause accept: %s",
+        m_queue_limit, m_queue_low, (m_throttle_accept ? "true" : "false"));
+}
+
+void WebServer::init_class_pools(const Config &cfg, const ThreadPool::Options &base,
+    const ThreadPool::ThreadInit &worker_init
+) {
+    for (const auto &c : CLASS_POOLS) {
+        const std::string prefix(c.prefix);
+        int threads = std::max(cfg.get_integer(prefix + "_threads", 0), 0);
+        if (threads == 0) {
+            LOG_INFO("%s shares the Thread-Pool", c.name);
+            continue;
+        }
+        ThreadPool::Options opts(threads,
+            std::max(cfg.get_integer(prefix + "_max", threads), threads),
+            base.wait_target_ms, base.idle_timeout_ms);
+        m_pools[c.cls].reset(new ThreadPool(opts, worker_init));
+        LOG_INFO("Number of threads in %s: %zu-%zu, queue limit %zu", c.name, opts.min_threads,
+            opts.max_threads, m_live->class_queue_limit[c.cls]);
+    }
 }
 
-void WebServer::add_client(int fd, const sockaddr_in &addr) {
+void WebServer::init_sessions(const Config &cfg) {
+    SessionStore::Options opts;
+    opts.enable = cfg.get_bool("session");
+    if (!opts.enable) return;
+    opts.ttl = std::max(cfg.get_integer("session_ttl", 1800000), 1000);
+    opts.max_sessions = std::max(cfg.get_integer("session_max", 100000), 1);
+    opts.shards = std::max(cfg.get_integer("session_shards", 16), 1);
+    opts.cookie_name = cfg.get_string("session_cookie", "sid");
+    opts.cookie_secure = cfg.get_bool("session_cookie_secure");
+    opts.protected_paths = split_list(cfg.get_string("session_pages"));
+    opts.snapshot_path = cfg.get_string("session_snapshot");
+    if (m_worker_slot && !opts.snapshot_path.empty()) {
+        // 会话表属于各个工作进程，快照也各自保存
+        opts.snapshot_path += "." + std::to_string(m_worker_slot->idx);
+    }
+    m_snapshot_interval = std::max(cfg.get_integer("session_snapshot_interval", 60000), 0);
+    SessionStore::get_instance()->init(opts);
+    LOG_INFO("Sessions: ttl %d ms, at most %zu, %zu protected pages, snapshot %s",
+        opts.ttl, opts.max_sessions, opts.protected_paths.size(),
+        opts.snapshot_path.empty() ? "off" : opts.snapshot_path.c_str());
+}
+
+void WebServer::sweep_sessions() {
+    SessionStore *sessions = SessionStore::get_instance();
+    size_t n = sessions->expire();
+    if (n > 0) {
+        LOG_DEBUG("Sessions: %zu expired", n);
+    }
+    int64_t now = HttpConn::now_ms();
+    if (m_snapshot_interval > 0 && now - m_last_snapshot >= m_snapshot_interval) {
+        sessions->save();
+        m_last_snapshot = now;
+    }
+    m_tm_heap->add(SESSION_TIMER_ID, SESSION_SWEEP_INTERVAL,
+        std::bind(&WebServer::sweep_sessions, this));
+}
+
+bool WebServer::init_async_db(const Config &cfg) {
+    if (!cfg.get_bool("sql_async")) return false;
+    AsyncSQLPool::Options opts;
+    opts.host = cfg.get_string("sql_host");
+    opts.port = cfg.get_integer("sql_port", 3306);
+    opts.user = cfg.get_string("sql_username");
+    opts.passwd = cfg.get_string("sql_passwd");
+    opts.db_name = cfg.get_string("db_name");
+    opts.conn_num = std::max(cfg.get_integer("conn_pool_num", 4), 1);
+    opts.query_timeout = std::max(cfg.get_integer("sql_async_timeout", 5000), 0);
+    opts.max_pending = std::max(cfg.get_integer("sql_async_max_pending", 1024), 1);
+    m_async_sql.reset(new AsyncSQLPool(*m_epoller, *m_tm_heap, ASYNC_SQL_TIMER_BASE));
+    if (!m_async_sql->init(opts)) {
+        LOG_WARN("Falling back to the blocking SQL-Pool");
+        m_async_sql.reset();
+        return false;
+    }
+    LOG_INFO("Async-SQL-Pool: %d connections, query timeout %d ms, at most %zu pending",
+        opts.conn_num, opts.query_timeout, opts.max_pending);
+    return true;
+}
+
+void WebServer::init_reg_batcher(const Config &cfg) {
+    if (!cfg.get_bool("reg_batch")) return;
+    RegistrationBatcher::Options opts;
+    opts.batch_size = std::max(cfg.get_integer("reg_batch_size", 64), 1);
+    opts.max_delay = std::max(cfg.get_integer("reg_batch_delay", 5), 0);
+    opts.max_pending = std::max(cfg.get_integer("reg_batch_max_pending", 4096), 1);
+    opts.bloom_bits = std::max(cfg.get_integer("reg_bloom_bits", 1 << 23), 64);
+    opts.bloom_hashes = std::max(cfg.get_integer("reg_bloom_hashes", 7), 1);
+    m_post_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_post_fd < 0 || !m_epoller->add_fd(m_post_fd, EPOLLIN)) {
+        LOG_ERROR("Failed to create the eventfd for the registration batcher: %s",
+            strerror(errno));
+        if (m_post_fd >= 0) {
+            close(m_post_fd);
+            m_post_fd = -1;
+        }
+        return;
+    }
+    m_reg_batcher.reset(new RegistrationBatcher(SQLConnPool::get_instance(), opts));
+    LOG_INFO("Registration batcher: %zu per batch, delay %d ms, at most %zu pending, "
+        "bloom filter %zu bits x %d", opts.batch_size, opts.max_delay, opts.max_pending,
+        opts.bloom_bits, opts.bloom_hashes);
+}
+
+void WebServer::init_query_cache(const Config &cfg) {
+    QueryCache::Options opts;
+    opts.enable = cfg.get_bool("query_cache");
+    if (!opts.enable) return;
+    opts.max_bytes = static_cast<size_t>(std::max(cfg.get_integer("query_cache_mb", 64), 1)) << 20;
+    opts.ttl = std::max(cfg.get_integer("query_cache_ttl", 30000), 1);
+    opts.shards = std::max(cfg.get_integer("query_cache_shards", 16), 1);
+    QueryCache::get_instance()->init(opts);
+    LOG_INFO("Query cache: %zu MB, ttl %d ms, %zu shards%s", opts.max_bytes >> 20, opts.ttl,
+        opts.shards, m_async_sql ? " (not used by the Async-SQL-Pool)" : "");
+}
+
+void WebServer::route(std::shared_ptr<HttpConn> client) {
+    auto cls = client->pending_work();
+    if (m_reg_batcher && client->is_registration()) {
+        // 注册由写入线程攒成一批插入，提交之后在写入线程中生成响应
+        ++m_class_routed[cls];
+        client->queue_registration(*m_reg_batcher, [this, client](UserStore::RESULT res) {
+            // 在写入线程中调用，连接可能已经被主线程关闭，fd 也可能已经分给了新的连接，
+            // 回到主线程确认 fd 仍然属于这个连接对象之后再生成响应
+            post([this, client, res] {
+                auto it = m_clients.find(client->get_fd());
+                if (client->is_closed() || it == m_clients.end() || it->second != client) {
+                    return;
+                }
+                client->finish_user_form(res);
+                rearm(client, m_conn_event | EPOLLOUT);
+            });
+        });
+        return;
+    }
+    if (cls == HttpConn::WORK_DB && m_async_sql) {
+        // 查询由主线程驱动，不占用数据库线程池；结果回调在主线程中生成响应
+        ++m_class_routed[cls];
+        client->query_user_form(*m_async_sql, [this, client] {
+            rearm(client, m_conn_event | EPOLLOUT);
+        });
+        return;
+    }
+    ThreadPool *pool = m_pools[cls] ? m_pools[cls].get() : m_pools[HttpConn::WORK_STATIC].get();
+    // 共用 Thread-Pool 的类别不单独限制队列长度
+    size_t limit = m_pools[cls] ? m_live->class_queue_limit[cls] : 0;
+    if (limit > 0 && pool->queue_size() >= limit) {
+        // 过载的依赖只拒绝依赖它的请求，连接仍然可以继续发送其他请求
+        ++m_class_shed[cls];
+        client->reject(503);
+        rearm(client, m_conn_event | EPOLLOUT);
+        return;
+    }
+    ++m_class_routed[cls];
+    pool->add_task(make_task<&WebServer::on_process>(client));
+}
+
+void WebServer::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lck(m_post_mtx);
+        m_posted.push_back(std::move(task));
+    }
+    uint64_t one = 1;
+    ssize_t n = write(m_post_fd, &one, sizeof(one));
+    (void)n;
+}
+
+void WebServer::run_posted() {
+    uint64_t cnt = 0;
+    ssize_t n = read(m_post_fd, &cnt, sizeof(cnt));
+    (void)n;
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lck(m_post_mtx);
+        tasks.swap(m_posted);
+    }
+    for (auto &task : tasks) {
+        task();
+    }
+}
+
+void WebServer::submit(std::function<void()> task) {
+    auto &pool = m_pools[HttpConn::WORK_STATIC];
+    pool->add_task(std::move(task));
+    m_stats.max_queue_depth = std::max(m_stats.max_queue_depth, pool->queue_size());
+}
+
+bool WebServer::is_throttled() {
+    if (m_throttle_start >= 0) return true;
+    if (m_queue_limit == 0 || m_pools[HttpConn::WORK_STATIC]->queue_size() < m_queue_limit) return false;
+    if (!notify_when_drained()) {
+        // 登记之前工作线程已经把队列取到了低水位以下
+        return false;
+    }
+    m_throttle_start = HttpConn::now_ms();
+    ++m_stats.throttles;
+    if (m_throttle_accept) {
+        // 保留注册但去掉 EPOLLIN，新连接留在内核的全连接队列中
+        if (m_listen_fd >= 0) {
+            m_epoller->mod_fd(m_listen_fd, m_listen_event);
+        }
+        if (m_tls_listen_fd >= 0) {
+            m_epoller->mod_fd(m_tls_listen_fd, m_listen_event);
+        }
+    }
+    LOG_DEBUG("Thread-Pool queue is full (%zu tasks), pausing reads", m_pools[HttpConn::WORK_STATIC]->queue_size());
+    return true;
+}
+
+void WebServer::resume_reads() {
+    uint64_t cnt = 0;
+    ssize_t n = read(m_drain_fd, &cnt, sizeof(cnt));
+    (void)n;
+    if (m_throttle_start < 0) return;
+    // 按暂停的先后顺序直接分派，数据一直留在 socket 中，不必再经过一次 epoll；
+    // 只补足队列的空位，其余的连接继续等待下一次通知，避免刚恢复就再次被暂停
+    size_t resumed = 0;
+    while (!m_parked.empty()) {
+        if (m_pools[HttpConn::WORK_STATIC]->queue_size() >= m_queue_limit) {
+            if (notify_when_drained()) {
+                LOG_DEBUG("Thread-Pool queue refilled, resumed %zu connections, %zu waiting",
+                    resumed, m_parked.size());
+                return;
+            }
+            continue;
+        }
+        auto client = std::move(m_parked.front());
+        m_parked.pop_front();
+        if (!client->is_closed()) {
+            dispatch_read(client);
+            ++resumed;
+        }
+    }
+    int64_t elapsed = HttpConn::now_ms() - m_throttle_start;
+    m_stats.throttled_ms += elapsed;
+    m_throttle_start = -1;
+    if (m_throttle_accept) {
+        if (m_listen_fd >= 0) {
+            m_epoller->mod_fd(m_listen_fd, m_listen_event | EPOLLIN);
+        }
+        if (m_tls_listen_fd >= 0) {
+            m_epoller->mod_fd(m_tls_listen_fd, m_listen_event | EPOLLIN);
+        }
+    }
+    LOG_DEBUG("Thread-Pool queue drained after %lld ms, resumed %zu connections",
+        static_cast<long long>(elapsed), resumed);
+}
+
+bool WebServer::notify_when_drained() {
+    int fd = m_drain_fd;
+    return m_pools[HttpConn::WORK_STATIC]->notify_when_drained(m_queue_low, [fd] {
+        uint64_t one = 1;
+        ssize_t n = write(fd, &one, sizeof(one));
+        (void)n;
+    });
+}
+
+void WebServer::hand_over_listeners(const std::vector<int> &fds) {
+    string fd_list;
+    for (int fd : fds) {
+        if (!fd_list.empty()) fd_list.push_back(',');
+        fd_list.append(std::to_string(fd));
+    }
+    setenv(LISTEN_FDS_ENV, fd_list.c_str(), 1);
+}
+
+bool WebServer::block_signals() {
+    sigset_t mask;
+    handled_signals(&mask);
+    return pthread_sigmask(SIG_BLOCK, &mask, nullptr) == 0;
+}
+
+void WebServer::set_command_line(int argc, char *argv[]) {
+    m_argv.assign(argv, argv + argc);
+    // 启动时解析出可执行文件的绝对路径；升级时这个路径上已经是新的文件
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len > 0 && !m_argv.empty()) {
+        path[len] = '\0';
+        m_argv[0] = path;
+    }
+}
+
+bool WebServer::init_signals() {
+    // 这些信号已经在 main() 中被所有线程屏蔽，这里通过 signalfd 在事件循环中读取
+    sigset_t mask;
+    handled_signals(&mask);
+    m_signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (m_signal_fd < 0 || !m_epoller->add_fd(m_signal_fd, EPOLLIN)) {
+        LOG_ERROR("Failed to create the signalfd, reload and graceful shutdown disabled: %s",
+            strerror(errno));
+        if (m_signal_fd >= 0) {
+            close(m_signal_fd);
+            m_signal_fd = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+void WebServer::deal_signal() {
+    signalfd_siginfo info;
+    bool reload = false;
+    while (read(m_signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        int sig = info.ssi_signo;
+        switch (sig) {
+            case SIGHUP:
+                reload = true;
+                break;
+            case SIGTERM:
+            case SIGINT:
+            case SIGQUIT:
+                if (!m_draining) {
+                    start_drain(strsignal(sig));
+                } else if (sig != SIGQUIT) {
+                    // 平滑退出期间再次要求退出，不再等待剩余的连接
+                    m_drain_deadline = 0;
+                    check_drain();
+                }
+                break;
+            case SIGUSR2:
+                upgrade();
+                break;
+            case SIGCHLD:
+                reap_children();
+                break;
+        }
+    }
+    // 连续收到的多个 SIGHUP 只需要重新加载一次
+    if (reload && !m_draining) reload_config();
+}
+
+void WebServer::start_drain(const char *reason) {
+    m_draining = true;
+    HttpConn::draining = true;
+    m_drain_deadline = HttpConn::now_ms() + m_live->shutdown_timeout;
+    // 监听 socket 已经交给新进程时，它继续接受连接，这里只关闭自己的文件描述符
+    for (int *fd : {&m_listen_fd, &m_tls_listen_fd}) {
+        if (*fd >= 0) {
+            m_epoller->del_fd(*fd);
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    size_t closed = close_idle_conns();
+    LOG_INFO("%s: stopped accepting, closed %zu idle connections, waiting up to %d ms for %d "
+        "connections", reason, closed, m_live->shutdown_timeout, HttpConn::conn_count.load());
+    check_drain();
+}
+
+void WebServer::check_drain() {
+    int remaining = HttpConn::conn_count;
+    if (remaining > 0 && HttpConn::now_ms() >= m_drain_deadline) {
+        LOG_WARN("Shutdown timeout, closing %d remaining connections", remaining);
+        for (auto &kv : m_clients) {
+            auto &client = kv.second;
+            if (!client || client->is_closed()) continue;
+            if (client->is_worker_owned()) {
+                // 工作线程还在使用连接对象，让它的读写立即失败，由它自己关闭；
+                // 析构时先等待线程池执行完剩余的任务
+                shutdown(client->get_fd(), SHUT_RDWR);
+            } else {
+                close_conn(client);
+            }
+        }
+        remaining = 0;
+    }
+    if (remaining == 0) {
+        LOG_INFO("All connections closed, shutting down");
+        m_is_close = true;
+        return;
+    }
+    // 响应之后连接不再保持；开始退出时正在处理请求、之后才变为空闲的连接在这里关闭
+    close_idle_conns();
+    m_tm_heap->add(DRAIN_TIMER_ID, DRAIN_CHECK_INTERVAL, std::bind(&WebServer::check_drain, this));
+}
+
+size_t WebServer::close_idle_conns() {
+    size_t closed = 0;
+    for (auto &kv : m_clients) {
+        auto &client = kv.second;
+        // HTTP/2 连接上可能有多个流在进行，等它们在期限内结束
+        // 工作线程在重新注册事件之前就把阶段设成了 IDLE，只关闭主线程持有的连接
+        if (!client || client->is_closed() || client->is_http2() || client->is_worker_owned() ||
+            client->get_phase() != HttpConn::IDLE) {
+            continue;
+        }
+        // 数据已经到达但还没有被读取（例如被限流暂停）的连接上有新的请求
+        char ch;
+        if (recv(client->get_fd(), &ch, 1, MSG_PEEK | MSG_DONTWAIT) > 0) continue;
+        close_conn(client);
+        ++closed;
+    }
+    return closed;
+}
+
+void WebServer::upgrade() {
+    if (m_draining) {
+        LOG_WARN("Ignoring upgrade request while shutting down");
+        return;
+    }
+    if (m_upgrade_pid > 0) {
+        LOG_WARN("Ignoring upgrade request, new binary (pid %d) is still starting",
+            m_upgrade_pid);
+        return;
+    }
+    if (m_argv.empty()) {
+        LOG_ERROR("Upgrade unavailable: command line unknown");
+        return;
+    }
+    std::vector<int> fds;
+    string fd_list;
+    for (int fd : {m_listen_fd, m_tls_listen_fd}) {
+        if (fd < 0) continue;
+        fds.push_back(fd);
+        if (!fd_list.empty()) fd_list.push_back(',');
+        fd_list.append(std::to_string(fd));
+    }
+    // fork 之后的子进程只能调用 async-signal-safe 的函数，参数和环境变量在 fork 之前准备好
+    std::vector<string> env;
+    for (char **e = environ; *e; ++e) {
+        if (strncmp(*e, LISTEN_FDS_ENV, strlen(LISTEN_FDS_ENV)) == 0 ||
+            strncmp(*e, PARENT_PID_ENV, strlen(PARENT_PID_ENV)) == 0) {
+            continue;
+        }
+        env.push_back(*e);
+    }
+    env.push_back(string(LISTEN_FDS_ENV) + "=" + fd_list);
+    env.push_back(string(PARENT_PID_ENV) + "=" + std::to_string(getpid()));
+    std::vector<char*> argv, envp;
+    for (auto &arg : m_argv) argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+    for (auto &var : env) envp.push_back(&var[0]);
+    envp.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        LOG_ERROR("Upgrade failed, fork error: %s", strerror(errno));
+        return;
+    }
+    if (pid == 0) {
+        // 只为监听 socket 清除 FD_CLOEXEC，其余的文件描述符在 exec 时关闭；
+        // 信号屏蔽字保持不变，新进程创建 signalfd 之前收到的信号留待它处理
+        for (int fd : fds) {
+            fcntl(fd, F_SETFD, 0);
+        }
+        execve(argv[0], argv.data(), envp.data());
+        _exit(127);
+    }
+    m_upgrade_pid = pid;
+    LOG_INFO("Upgrade: started %s (pid %d) with listen sockets %s", m_argv[0].c_str(), pid,
+        fd_list.c_str());
+}
+
+void WebServer::reap_children() {
+    int status = 0;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        if (pid != m_upgrade_pid) continue;
+        m_upgrade_pid = -1;
+        if (!m_draining) {
+            // 新进程在接管之前退出（例如配置错误或者可执行文件无法运行），本进程继续服务
+            LOG_ERROR("Upgrade failed, new binary (pid %d) exited with %s %d", pid,
+                WIFSIGNALED(status) ? "signal" : "status",
+                WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+        }
+    }
+}
+
+int WebServer::take_inherited_listener(int port) {
+    for (auto it = m_inherited_fds.begin(); it != m_inherited_fds.end(); ++it) {
+        sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        if (getsockname(*it, (sockaddr*)&addr, &len) < 0 || addr.sin_family != AF_INET ||
+            ntohs(addr.sin_port) != port) {
+            continue;
+        }
+        int fd = *it;
+        m_inherited_fds.erase(it);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        return fd;
+    }
+    return -1;
+}
+
+void WebServer::reload_config() {
+    // 可以在运行时生效的配置项，其余的配置项改变时只记录警告
+    static const char *LIVE_KEYS[] = {
+        "timeout", "inline_policy", "inline_max_bytes", "db_pool_queue_limit",
+        "cpu_pool_queue_limit", "header_timeout", "body_timeout", "send_timeout",
+        "process_timeout",
+        "min_recv_rate", "min_send_rate", "rate_grace", "max_request_line", "max_header_size",
+        "max_body_size", "body_buffer_size", "keepalive_timeout", "keepalive_requests",
+        "log_level", "stats_interval", "shutdown_timeout"
+    };
+    std::unique_ptr<Config> next(new Config(m_config->get_filename()));
+    if (!next->loaded()) {
+        LOG_ERROR("Failed to reload %s, keeping the current configuration",
+            m_config->get_filename().c_str());
+        return;
+    }
+    auto changed = next->diff(*m_config);
+    if (changed.empty()) {
+        LOG_INFO("Configuration reloaded from %s, nothing changed",
+            next->get_filename().c_str());
+        return;
+    }
+
+    // 已经取得旧快照的请求继续使用它，之后的请求使用新的设置
+    m_live.publish(load_live_settings(*next));
+    HttpConn::limits.publish(load_conn_limits(*next));
+    m_tm_heap->add(RCU_TIMER_ID, RCU_RECLAIM_INTERVAL, std::bind(&WebServer::reclaim_snapshots, this));
+    if (m_config->get_bool("open_log")) {
+        AsyncLogger::GetInstance().SetLogLevel(StringToLogLevel(next->get_string("log_level")));
+    }
+    int interval = std::max(next->get_integer("stats_interval", 60000), 0);
+    if (m_stats_interval == 0 && interval > 0) {
+        m_tm_heap->add(STATS_TIMER_ID, interval, std::bind(&WebServer::report_stats, this));
+    }
+    m_stats_interval = interval;
+
+    std::string applied, ignored;
+    for (const auto &key : changed) {
+        bool live = std::find_if(std::begin(LIVE_KEYS), std::end(LIVE_KEYS),
+            [&key](const char *k) { return key == k; }) != std::end(LIVE_KEYS);
+        std::string &list = live ? applied : ignored;
+        if (!list.empty()) list.append(", ");
+        list.append(key);
+    }
+    if (!ignored.empty()) {
+        LOG_WARN("Configuration changes that require a restart: %s", ignored.c_str());
+    }
+    m_config = std::move(next);
+    LOG_INFO("Configuration reloaded from %s, applied: %s", m_config->get_filename().c_str(),
+        applied.empty() ? "none" : applied.c_str());
+}
+
+void WebServer::reclaim_snapshots() {
+    // 两个快照共用纪元，任何一个还有旧版本就继续推进
+    bool pending = m_live.reclaim();
+    pending = HttpConn::limits.reclaim() || pending;
+    if (pending) {
+        m_tm_heap->add(RCU_TIMER_ID, RCU_RECLAIM_INTERVAL,
+            std::bind(&WebServer::reclaim_snapshots, this));
+    }
+}
+
+void WebServer::report_stats() {
+    DispatchStats &cur = m_stats, &last = m_last_stats;
+    uint64_t inlined = (cur.inline_reads - last.inline_reads) +
+        (cur.inline_writes - last.inline_writes);
+    uint64_t pooled = (cur.deferred_reads - last.deferred_reads) +
+        (cur.pooled_reads - last.pooled_reads) + (cur.pooled_writes - last.pooled_writes);
+    if (m_stats_interval > 0) {
+        m_tm_heap->add(STATS_TIMER_ID, m_stats_interval,
+            std::bind(&WebServer::report_stats, this));
+    }
+    if (inlined + pooled == 0 && m_throttle_start < 0) return;   // 空闲期间不输出
+    LOG_INFO("Dispatch: reads inline %llu, deferred %llu, pooled %llu; "
+        "writes inline %llu, pooled %llu; %.1f%% inline in the last %d ms",
+        static_cast<unsigned long long>(cur.inline_reads),
+        static_cast<unsigned long long>(cur.deferred_reads),
+        static_cast<unsigned long long>(cur.pooled_reads),
+        static_cast<unsigned long long>(cur.inline_writes),
+        static_cast<unsigned long long>(cur.pooled_writes),
+        (inlined + pooled) ? 100.0 * inlined / (inlined + pooled) : 0.0, m_stats_interval);
+    // 正在进行的限流也计入总时间
+    int64_t throttled_ms = cur.throttled_ms +
+        (m_throttle_start >= 0 ? HttpConn::now_ms() - m_throttle_start : 0);
+    LOG_INFO("Thread-Pool queue: depth %zu, max %zu in the last %d ms; throttled %llu times "
+        "for %lld ms in total, %llu reads parked", m_pools[HttpConn::WORK_STATIC]->queue_size(),
+        cur.max_queue_depth, m_stats_interval, static_cast<unsigned long long>(cur.throttles),
+        static_cast<long long>(throttled_ms), static_cast<unsigned long long>(cur.parked_reads));
+    auto pool = m_pools[HttpConn::WORK_STATIC]->get_stats();
+    LOG_INFO("Thread-Pool threads: %zu (idle %zu, blocked %zu), peak %zu, spawned %llu, "
+        "retired %llu", pool.threads, pool.idle, pool.blocked, pool.peak,
+        static_cast<unsigned long long>(pool.spawned),
+        static_cast<unsigned long long>(pool.retired));
+    static const char *CLASS_NAMES[] = {"Thread-Pool", "DB-Pool", "CPU-Pool"};
+    for (int i=HttpConn::WORK_STATIC+1; i<HttpConn::WORK_CLASS_NUM; ++i) {
+        uint64_t routed = m_class_routed[i], shed = m_class_shed[i];
+        if (routed + shed == 0) continue;
+        if (!m_pools[i]) {
+            LOG_INFO("%s (shared): %llu requests", CLASS_NAMES[i],
+                static_cast<unsigned long long>(routed));
+            continue;
+        }
+        auto st = m_pools[i]->get_stats();
+        LOG_INFO("%s: %llu requests, %llu rejected; depth %zu, threads %zu (idle %zu, "
+            "blocked %zu), peak %zu", CLASS_NAMES[i], static_cast<unsigned long long>(routed),
+            static_cast<unsigned long long>(shed), m_pools[i]->queue_size(), st.threads, st.idle,
+            st.blocked, st.peak);
+    }
+    if (m_enable_db && !m_async_sql) {
+        auto st = SQLConnPool::get_instance()->get_stats();
+        LOG_INFO("SQL-Pool: %zu connections (idle %zu, busy %zu, peak %zu), %zu waiting; "
+            "%llu acquired, avg wait %.1f ms, max %llu ms, %llu timed out; %llu connected, "
+            "%llu failed, %llu broken", st.total, st.idle, st.busy, st.peak_busy, st.waiting,
+            static_cast<unsigned long long>(st.acquired),
+            st.acquired ? static_cast<double>(st.wait_ms) / st.acquired : 0.0,
+            static_cast<unsigned long long>(st.max_wait_ms),
+            static_cast<unsigned long long>(st.timeouts),
+            static_cast<unsigned long long>(st.connects),
+            static_cast<unsigned long long>(st.connect_failures),
+            static_cast<unsigned long long>(st.broken));
+    }
+    if (SessionStore::get_instance()->enabled()) {
+        auto st = SessionStore::get_instance()->get_stats();
+        LOG_INFO("Sessions: %zu active; %llu created, %llu hits, %llu misses, %llu expired, "
+            "%llu evicted", st.sessions, static_cast<unsigned long long>(st.created),
+            static_cast<unsigned long long>(st.hits), static_cast<unsigned long long>(st.misses),
+            static_cast<unsigned long long>(st.expired),
+            static_cast<unsigned long long>(st.evicted));
+    }
+    if (QueryCache::get_instance()->enabled()) {
+        auto st = QueryCache::get_instance()->get_stats();
+        LOG_INFO("Query cache: %zu entries, %zu KB; %llu hits, %llu misses, %llu coalesced, "
+            "%llu evicted, %llu invalidated", st.entries, st.bytes >> 10,
+            static_cast<unsigned long long>(st.hits), static_cast<unsigned long long>(st.misses),
+            static_cast<unsigned long long>(st.coalesced),
+            static_cast<unsigned long long>(st.evicted),
+            static_cast<unsigned long long>(st.invalidated));
+    }
+    if (m_reg_batcher) {
+        auto st = m_reg_batcher->get_stats();
+        LOG_INFO("Registration batcher: %zu pending; %llu batches, %llu inserted, "
+            "%llu duplicates, %llu failed; %llu bloom skips, %llu fallbacks, %zu indexed",
+            st.pending, static_cast<unsigned long long>(st.batches),
+            static_cast<unsigned long long>(st.inserted),
+            static_cast<unsigned long long>(st.duplicates),
+            static_cast<unsigned long long>(st.failures),
+            static_cast<unsigned long long>(st.bloom_skips),
+            static_cast<unsigned long long>(st.fallbacks), st.indexed);
+    }
+    if (m_async_sql) {
+        auto st = m_async_sql->get_stats();
+        LOG_INFO("Async-SQL-Pool: %zu connected, %zu busy, %zu pending; %llu queries, "
+            "%llu failed", st.connected, st.busy, st.pending,
+            static_cast<unsigned long long>(st.queries),
+            static_cast<unsigned long long>(st.failures));
+    }
+    cur.max_queue_depth = m_pools[HttpConn::WORK_STATIC]->queue_size();
+    last = cur;
+}
+
+void WebServer::init_affinity(const string &reactor_cpus, const string &worker_cpus) {
+    const auto &topo = NumaTopology::get_instance();
+    LOG_INFO("NUMA topology: %d node(s), %s", topo.node_count(), topo.to_string().c_str());
+
+    CpuList cpus;
+    int reactor_node = -1;
+    if (!reactor_cpus.empty()) {
+        if (!parse_cpu_list(reactor_cpus, cpus)) {
+            LOG_ERROR("Invalid reactor_cpus: \"%s\"", reactor_cpus.c_str());
+        } else if (!place_current_thread(cpus)) {
+            LOG_ERROR("Failed to bind reactor thread to CPUs %s",
+                cpu_list_to_string(cpus).c_str());
+        } else {
+            reactor_node = topo.node_of_cpus(cpus);
+            LOG_INFO("Reactor thread bound to CPUs %s (node %d)",
+                cpu_list_to_string(cpus).c_str(), reactor_node);
+        }
+    }
+
+    if (!worker_cpus.empty()) {
+        if (!parse_cpu_list(worker_cpus, m_worker_cpus)) {
+            LOG_ERROR("Invalid worker_cpus: \"%s\"", worker_cpus.c_str());
+            m_worker_cpus.clear();
+            return;
+        }
+        int worker_node = topo.node_of_cpus(m_worker_cpus);
+        LOG_INFO("Worker threads bound to CPUs %s (node %d)",
+            cpu_list_to_string(m_worker_cpus).c_str(), worker_node);
+        if (worker_node < 0 || (reactor_node >= 0 && worker_node != reactor_node)) {
+            // 连接对象由 reactor 创建，工作线程跨节点访问它们会产生远端内存访问
+            LOG_WARN("Worker CPUs are not on the reactor's NUMA node, "
+                "connection state will be accessed across nodes");
+        }
+    }
+}
+
+std::unique_ptr<ConnLimits> WebServer::load_conn_limits(const Config &cfg) {
+    std::unique_ptr<ConnLimits> limits(new ConnLimits());
+    limits->header_timeout = cfg.get_integer("header_timeout", 10000);
+    limits->body_timeout = cfg.get_integer("body_timeout", 60000);
+    limits->send_timeout = cfg.get_integer("send_timeout", 60000);
+    limits->process_timeout = cfg.get_integer("process_timeout", 30000);
+    limits->min_recv_rate = cfg.get_integer("min_recv_rate", 1024);
+    limits->min_send_rate = cfg.get_integer("min_send_rate", 1024);
+    limits->rate_grace = cfg.get_integer("rate_grace", 5000);
+    limits->max_request_line = cfg.get_integer("max_request_line", 8192);
+    limits->max_header_size = cfg.get_integer("max_header_size", 16384);
+    limits->max_body_size = cfg.get_integer("max_body_size", 1073741824);
+    limits->body_buffer_size = cfg.get_integer("body_buffer_size", 65536);
+    limits->keepalive_timeout = cfg.get_integer("keepalive_timeout", 15000);
+    limits->keepalive_requests = cfg.get_integer("keepalive_requests", 1000);
+    return limits;
+}
+
+void WebServer::init_limits(const Config &cfg) {
+    HttpConn::limits.publish(load_conn_limits(cfg));
+    const ConnLimits &limits = *HttpConn::limits;
+    HttpConn::spool_dir = cfg.get_string("body_spool_dir");
+    if (HttpConn::spool_dir.empty()) {
+        HttpConn::spool_dir = "/tmp";
+    }
+    LOG_INFO("Timeouts(ms): header %d, body %d, send %d, process %d; min rate(B/s): recv %d, "
+        "send %d", limits.header_timeout, limits.body_timeout, limits.send_timeout,
+        limits.process_timeout, limits.min_recv_rate, limits.min_send_rate);
+    LOG_INFO("Size limits: request line %zu, header %zu, body %zu",
+        limits.max_request_line, limits.max_header_size, limits.max_body_size);
+    LOG_INFO("Request bodies larger than %zu bytes are spooled to %s",
+        limits.body_buffer_size, HttpConn::spool_dir.c_str());
+    LOG_INFO("Keep-alive: idle timeout %d ms, max %d requests per connection",
+        limits.keepalive_timeout, limits.keepalive_requests);
+
+    HttpConn::enable_h2 = cfg.get_bool("http2", true);
+    auto &h2 = Http2Session::limits;
+    h2.max_concurrent_streams = cfg.get_integer("h2_max_concurrent_streams", 100);
+    h2.initial_window_size = std::max(cfg.get_integer("h2_initial_window_size", 65535), 1);
+    // 帧负载长度的取值范围为 [2^14, 2^24-1] (RFC 7540 6.5.2)
+    h2.max_frame_size = std::min(std::max(cfg.get_integer("h2_max_frame_size", 16384), 16384),
+        16777215);
+    h2.max_header_list_size = limits.max_header_size;
+    if (HttpConn::enable_h2) {
+        LOG_INFO("HTTP/2 (h2c): max %u concurrent streams, initial window %u, max frame %u",
+            h2.max_concurrent_streams, h2.initial_window_size, h2.max_frame_size);
+    }
+}
+
+bool WebServer::init_tls(const Config &cfg) {
+    m_tls_port = cfg.get_integer("tls_port", 0);
+    if (m_tls_port <= 0) return true;
+    TlsOptions opts = TlsOptions::from_config(cfg);
+    opts.h2 = HttpConn::enable_h2;
+    m_tls_ctx.reset(new TlsContext());
+    if (!m_tls_ctx->init(opts)) {
+        LOG_ERROR("Failed to initialize TLS (cert %s, key %s): %s", opts.cert_file.c_str(),
+            opts.key_file.c_str(), TlsContext::last_error().c_str());
+        return false;
+    }
+    m_tls_listen_fd = create_listener(m_tls_port);
+    if (m_tls_listen_fd < 0) {
+        return false;
+    }
+    LOG_INFO("TLS listen on %s:%d, cert %s, ALPN %s", m_ip.c_str(), m_tls_port,
+        opts.cert_file.c_str(), (opts.h2 ? "h2,http/1.1" : "http/1.1"));
+    LOG_INFO("TLS session resumption: cache %ld entries, tickets %s, lifetime %lds",
+        opts.session_cache, (opts.tickets ? "on" : "off"), opts.session_timeout);
+    if (opts.ktls && !TlsContext::kernel_has_ktls()) {
+        LOG_WARN("kTLS requested but the kernel tls module is not loaded, "
+            "records will be encrypted in user space");
+    } else {
+        LOG_INFO("kTLS: %s", (opts.ktls ? "enabled" : "disabled"));
+    }
+    return true;
+}
+
+bool WebServer::init_bundle(const Config &cfg) {
+    std::string filename = cfg.get_string("static_bundle");
+    if (filename.empty()) return true;
+    m_bundle.reset(new StaticBundle());
+    if (!m_bundle->open(filename)) {
+        LOG_ERROR("Failed to load the static bundle: %s", m_bundle->error().c_str());
+        m_bundle.reset();
+        return false;
+    }
+    HttpConn::bundle = m_bundle.get();
+    size_t variants = 0;
+    for (const auto &f : m_bundle->get_files()) {
+        variants += f.has_variants();
+    }
+    LOG_INFO("Static bundle: %s, %zu files (%zu precompressed), %zu bytes mapped; "
+        "other paths are served from %s", filename.c_str(), m_bundle->file_count(), variants,
+        m_bundle->mapped_bytes(), m_src_dir.c_str());
+    return true;
+}
+
+void WebServer::add_client(int fd, const sockaddr_in &addr, bool is_tls) {
     if (fd < 0) return;
     m_clients[fd] = std::make_shared<HttpConn>();
-    m_clients[fd]->init(fd, addr);
-    if (m_timeout > 0) {
-        m_tm_heap->add(fd, m_timeout,
-            std::bind(&WebServer::close_conn, this, m_clients[fd]));
+    m_clients[fd]->init(fd, addr, is_tls ? m_tls_ctx.get() : nullptr);
+    int timeout = m_live->timeout;
+    if (timeout > 0) {
+        m_clients[fd]->last_active = HttpConn::now_ms();
+        m_tm_heap->add(fd, timeout,
+            std::bind(&WebServer::on_timeout, this, m_clients[fd]));
+    }
+    // 连接 socket 由 accept4 创建时已经是非阻塞的
+    if (!m_sock_opts.apply_to_conn(fd)) {
+        LOG_DEBUG("Failed to set socket options on <client %d>: %s", fd, strerror(errno));
     }
     m_epoller->add_fd(fd, m_conn_event | EPOLLIN);
-    set_nonblocking(fd);
+    if (m_worker_slot) {
+        ++m_worker_slot->accepted;
+        m_worker_slot->active.store(HttpConn::conn_count, std::memory_order_relaxed);
+    }
+}
+
+void WebServer::rearm(const std::shared_ptr<HttpConn> &client, uint32_t events) {
+    // 先交还所有权再注册事件，事件到达时主线程看到的是自己持有的连接
+    client->release_to_reactor();
+    m_epoller->mod_fd(client->get_fd(), events);
 }
 
 void WebServer::close_conn(std::shared_ptr<HttpConn> client) {
     if (!client) return;
     m_epoller->del_fd(client->get_fd());
     client->close_conn();
+    if (m_worker_slot) {
+        m_worker_slot->active.store(HttpConn::conn_count, std::memory_order_relaxed);
+    }
+}
+
+int64_t WebServer::get_deadline(std::shared_ptr<HttpConn> client) const {
+    int64_t deadline = client->get_deadline();
+    return deadline < 0 ? client->last_active + m_live->timeout : deadline;
+}
+
+void WebServer::on_timeout(std::shared_ptr<HttpConn> client) {
+    if (!client || client->is_closed()) return;
+    if (client->get_phase() == HttpConn::PROCESS && client->get_deadline() < 0) {
+        // 不限制生成响应的时间 (process_timeout = 0)，响应开始发送时 extend_time() 按发送阶段重新设置定时器
+        m_tm_heap->add(client->get_fd(), std::max(m_live->timeout, 1),
+            std::bind(&WebServer::on_timeout, this, client));
+        return;
+    }
+    int64_t now = HttpConn::now_ms();
+    int64_t deadline = get_deadline(client);
+    if (now < deadline) {
+        // 定时器只是截止时间的上界，连接已经进入了期限更长的阶段（例如空闲）
+        m_tm_heap->add(client->get_fd(), deadline - now,
+            std::bind(&WebServer::on_timeout, this, client));
+        return;
+    }
+    auto phase = client->get_phase();
+    if (client->is_worker_owned()) {
+        // 工作线程还在使用连接对象，这里不能关闭，也不能写入 408；
+        // shutdown 之后它的读写立即失败，由它关闭连接，或者在它重新注册事件之后由主线程关闭
+        LOG_WARN("<client %d, %s:%d> %s timeout, shutting down", client->get_fd(),
+            client->get_ip(), client->get_port(), phase == HttpConn::PROCESS ? "process" : "I/O");
+        shutdown(client->get_fd(), SHUT_RDWR);
+        return;
+    }
+    if (client->is_http2()) {
+        // HTTP/2 连接上没有可以回复 408 的单个请求，直接关闭
+        LOG_WARN("<client %d, %s:%d> HTTP/2 connection timeout", client->get_fd(),
+            client->get_ip(), client->get_port());
+    } else if (client->is_tls() &&
+        (phase == HttpConn::RECV_HEADER || phase == HttpConn::RECV_BODY)) {
+        // TLS 连接的记录层属于工作线程，主线程不能写入明文的 408，直接关闭
+        LOG_WARN("<client %d, %s:%d> TLS request timeout", client->get_fd(),
+            client->get_ip(), client->get_port());
+    } else if (phase == HttpConn::RECV_HEADER || phase == HttpConn::RECV_BODY) {
+        const auto &resp = HttpConn::timeout_response();
+        send(client->get_fd(), resp.data(), resp.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        LOG_WARN("<client %d, %s:%d> request timeout (%s)", client->get_fd(),
+            client->get_ip(), client->get_port(),
+            phase == HttpConn::RECV_HEADER ? "header" : "body");
+    } else if (phase == HttpConn::PROCESS) {
+        // 请求交给了写入线程或者非阻塞的数据库连接，它们的回调会检查连接是否已经关闭
+        LOG_WARN("<client %d, %s:%d> process timeout", client->get_fd(),
+            client->get_ip(), client->get_port());
+    } else if (phase == HttpConn::SEND) {
+        // 以 RST 中止连接，让内核立即丢弃发送缓冲区中积压的数据
+        struct linger lg = {1, 0};
+        setsockopt(client->get_fd(), SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        LOG_WARN("<client %d, %s:%d> send timeout", client->get_fd(),
+            client->get_ip(), client->get_port());
+    }
+    close_conn(client);
 }
 
-void WebServer::extend_time(std::shared_ptr<HttpConn> client) {
-    if (m_timeout > 0) {
-        m_tm_heap->adjust(client->get_fd(), m_timeout);
+bool WebServer::extend_time(std::shared_ptr<HttpConn> client, bool reading) {
+    if (m_live->timeout <= 0) return true;
+    int64_t now = HttpConn::now_ms();
+    client->last_active = now;
+    int64_t deadline = -1;
+    if (reading && client->get_phase() == HttpConn::IDLE &&
+        HttpConn::limits->header_timeout > 0) {
+        // 空闲连接上有数据到达，说明一个新请求开始了，此后只能在请求头的期限内等待；
+        // 工作线程之后才会切换阶段，这里先按请求头的期限设置定时器
+        deadline = now + HttpConn::limits->header_timeout;
+    } else {
+        deadline = get_deadline(client);
     }
+    if (deadline <= now) {
+        // 阶段的期限已过（例如慢速发送的请求头），不再交给工作线程
+        on_timeout(client);
+        return false;
+    }
+    int64_t expire = deadline;
+    if (!reading && HttpConn::limits->keepalive_timeout > 0) {
+        // 响应发送完后工作线程会把连接切换为空闲，主线程无从得知；
+        // 定时器最晚在一个 keepalive_timeout 后触发，届时按连接的实际阶段重新计算
+        expire = std::min<int64_t>(expire, now + HttpConn::limits->keepalive_timeout);
+    }
+    m_tm_heap->adjust(client->get_fd(), expire - now);
+    return true;
 }
 
 void WebServer::send_error_msg(int fd, const char *msg) {
@@ -260,26 +1400,61 @@ void WebServer::send_error_msg(int fd, const char *msg) {
     close(fd);
 }
 
-void WebServer::deal_listen() {
+void WebServer::deal_listen(int listen_fd) {
     struct sockaddr_in addr;
     socklen_t addr_len = sizeof(addr);
+    bool is_tls = listen_fd == m_tls_listen_fd;
     do {
-        int fd = accept(m_listen_fd, (sockaddr*)&addr, &addr_len);
+        // 直接得到非阻塞的连接 socket，省去两次 fcntl 调用
+        int fd = accept4(listen_fd, (sockaddr*)&addr, &addr_len,
+            SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (fd < 0) {
             break;
         } else if (HttpConn::conn_count >= max_num_conn) {
-            send_error_msg(fd, "Server busy!");
+            if (is_tls) {
+                close(fd);
+            } else {
+                send_error_msg(fd, "Server busy!");
+            }
             LOG_WARN("Clients are full!");
             break;
         }
-        add_client(fd, addr);
+        add_client(fd, addr, is_tls);
     } while (m_listen_event & EPOLLET);
 }
 
 void WebServer::deal_read(std::shared_ptr<HttpConn> client) {
-    if (!client) return;
-    extend_time(client);
-    m_thread_pool->add_task(std::bind(&WebServer::on_read, this, client));
+    if (!client || !extend_time(client, true)) return;
+    if (is_throttled()) {
+        // EPOLLONESHOT 已经解除了注册，不再注册 EPOLLIN，请求留在 socket 的接收缓冲区中
+        ++m_stats.parked_reads;
+        m_parked.push_back(client);
+        return;
+    }
+    dispatch_read(client);
+}
+
+void WebServer::dispatch_read(std::shared_ptr<HttpConn> client) {
+    const INLINE_POLICY policy = m_live->inline_policy;
+    if (policy == INLINE_ALL) {
+        ++m_stats.inline_reads;
+        on_read(client);
+        return;
+    }
+    if (policy == INLINE_CHEAP && client->can_read_inline()) {
+        // 从 socket 读取不会阻塞，读完之后再判断请求是否足够简单
+        int ret = -1, read_errno = 0;
+        ret = client->read(&read_errno);
+        if (ret <= 0 && read_errno != EAGAIN) {
+            ++m_stats.inline_reads;
+            close_conn(client);
+            return;
+        }
+        process_inline(client, false);
+        return;
+    }
+    ++m_stats.pooled_reads;
+    submit(make_task<&WebServer::on_read>(client));
 }
 
 void WebServer::on_read(std::shared_ptr<HttpConn> client) {
@@ -295,16 +1470,29 @@ void WebServer::on_read(std::shared_ptr<HttpConn> client) {
 
 void WebServer::on_process(std::shared_ptr<HttpConn> client) {
     if (client->process()) {
-        m_epoller->mod_fd(client->get_fd(), m_conn_event | EPOLLOUT);
+        rearm(client, m_conn_event | EPOLLOUT);
+    } else if (client->pending_work() != HttpConn::WORK_STATIC) {
+        route(client);
     } else {
-        m_epoller->mod_fd(client->get_fd(), m_conn_event | EPOLLIN);
+        rearm(client, m_conn_event | EPOLLIN);
     }
 }
 
 void WebServer::deal_write(std::shared_ptr<HttpConn> client) {
-    if (!client) return;
-    extend_time(client);
-    m_thread_pool->add_task(std::bind(&WebServer::on_write, this, client));
+    if (!client || !extend_time(client, false)) return;
+    const LiveSettings *live = m_live.get();
+    if (live->inline_policy == INLINE_ALL) {
+        ++m_stats.inline_writes;
+        on_write(client);
+        return;
+    }
+    if (live->inline_policy == INLINE_CHEAP && client->can_write_inline(live->inline_max_bytes)) {
+        ++m_stats.inline_writes;
+        process_inline(client, true);
+        return;
+    }
+    ++m_stats.pooled_writes;
+    submit(make_task<&WebServer::on_write>(client));
 }
 
 void WebServer::on_write(std::shared_ptr<HttpConn> client) {
@@ -318,9 +1506,49 @@ void WebServer::on_write(std::shared_ptr<HttpConn> client) {
         }
     } else if (ret < 0) {
         if (write_errno == EAGAIN) {
-            m_epoller->mod_fd(client->get_fd(), m_conn_event | EPOLLOUT);
+            rearm(client, m_conn_event | EPOLLOUT);
             return;
         }
     }
     close_conn(client);
-}
\ No newline at end of file
+}
+
+void WebServer::process_inline(std::shared_ptr<HttpConn> client, bool write_first) {
+    // 用循环而不是递归处理同一个连接上流水线化的多个请求；
+    // 读事件按最终的去向计数：交给了线程池算作 deferred，否则算作 inline
+    const bool is_read = !write_first;
+    while (true) {
+        if (!write_first) {
+            auto res = client->process_inline(m_live->inline_max_bytes);
+            if (res == HttpConn::INLINE_DEFER) {
+                if (is_read) ++m_stats.deferred_reads;
+                if (client->pending_work() != HttpConn::WORK_STATIC) {
+                    route(client);
+                } else {
+                    submit(make_task<&WebServer::on_process>(client));
+                }
+                return;
+            }
+            if (res == HttpConn::INLINE_READ) {
+                if (is_read) ++m_stats.inline_reads;
+                rearm(client, m_conn_event | EPOLLIN);
+                return;
+            }
+        }
+        write_first = false;
+        int ret = -1, write_errno = 0;
+        ret = client->write(&write_errno);
+        if (client->to_write_bytes() == 0) {
+            if (client->is_keep_alive()) {
+                continue;
+            }
+        } else if (ret < 0 && write_errno == EAGAIN) {
+            if (is_read) ++m_stats.inline_reads;
+            rearm(client, m_conn_event | EPOLLOUT);
+            return;
+        }
+        if (is_read) ++m_stats.inline_reads;
+        close_conn(client);
+        return;
+    }
+}
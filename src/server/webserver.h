@@ -7,59 +7,322 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
+#include <sys/types.h>
 #include "../timer/heap_timer.h"
 #include "../pool/threadpool.hpp"
 #include "../epoller/epoller.h"
 #include "../http/httpconn.h"
+#include "../http/responsewriter.h"
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
+#include "../pool/asyncsqlpool.h"
+#include "../pool/querycache.h"
+#include "../user/regbatcher.h"
 #include "../config/config.h"
+#include "../config/rcuptr.hpp"
+#include "../affinity/affinity.h"
+#include "../socket/sockopts.h"
+#include "../tls/tlsconn.h"
+#include "workerslot.h"
 
 
 class WebServer {
 public:
-    WebServer(const Config &cfg);
+    /**
+     * @param slot 多进程模式下本进程在共享内存中的统计，单进程时为空
+    */
+    WebServer(const Config &cfg, WorkerSlot *slot = nullptr);
     
     ~WebServer();
 
     void start();
+    /**
+     * @brief 记录启动时的命令行，热升级时以同样的参数启动新的可执行文件
+    */
+    void set_command_line(int argc, char *argv[]);
+    /**
+     * @brief 在所有线程中屏蔽由事件循环处理的信号，必须在创建任何线程之前调用
+    */
+    static bool block_signals();
+    /**
+     * @brief 创建、绑定并开始监听 socket，不注册到 epoll
+     * @return 监听 socket 的文件描述符，失败时返回 -1
+    */
+    static int open_listener(const string &ip, int port, bool open_linger,
+        const SocketOptions &opts);
+    /**
+     * @brief 把已经在监听的 socket 交给之后在本进程（或 exec 的新进程）中创建的 WebServer，
+     *        按绑定的端口取代新建的监听 socket
+    */
+    static void hand_over_listeners(const std::vector<int> &fds);
 private:
-    void init_db_pool(const char *sql_host, int sql_port,
-        const char *sql_username, const char *sql_passwd,
-        const char *db_name, int conn_pool_num);
-    bool init_socket(const string &ip, int listen_port,
-        int timeout, bool open_linger, int trig_mode);
+    /**
+     * @brief 创建阻塞的数据库连接池，连接数在 conn_pool_num 和 conn_pool_max 之间伸缩
+    */
+    void init_db_pool(const Config &cfg);
+    /**
+     * @brief 创建非阻塞的数据库连接池
+     * @return 是否成功，失败时使用同步的连接池
+    */
+    bool init_async_db(const Config &cfg);
+    /**
+     * @brief 创建批量插入注册的写入线程，只在使用同步的连接池时可用
+    */
+    void init_reg_batcher(const Config &cfg);
+    /**
+     * @brief 设置只读查询的结果缓存
+    */
+    void init_query_cache(const Config &cfg);
+    bool init_socket(const string &ip, int listen_port, bool open_linger, int trig_mode);
+    /**
+     * @brief 创建监听 socket 并注册到 epoll
+     * @return 监听 socket 的文件描述符，失败时返回 -1
+    */
+    int create_listener(int port);
+    bool init_tls(const Config &cfg);
+    /**
+     * @brief 映射 static_bundle 指定的打包文件，没有配置时直接返回
+    */
+    bool init_bundle(const Config &cfg);
     void init_event_mode(int trig_mode);
+    void init_affinity(const string &reactor_cpus, const string &worker_cpus);
+    void init_limits(const Config &cfg);
+    /**
+     * @brief 通过 signalfd 在事件循环中读取信号：SIGHUP 重新加载配置，SIGTERM/SIGQUIT/SIGINT
+     *        平滑退出，SIGUSR2 热升级
+    */
+    bool init_signals();
+    void deal_signal();
+    /**
+     * @brief 重新读取配置文件，发布新的 LiveSettings 和 ConnLimits，调整日志级别；
+     *        其余的配置需要重启才能生效，变化时记录警告
+    */
+    void reload_config();
+    /**
+     * @brief 定时推进 RCU 的纪元，释放工作线程不再引用的旧快照，直到全部释放
+    */
+    void reclaim_snapshots();
+    /**
+     * @brief 开始平滑退出：停止接受新的连接，关闭空闲的连接，其余的连接发送完当前的响应后关闭；
+     *        所有连接都关闭或者超过 shutdown_timeout 之后退出事件循环
+    */
+    void start_drain(const char *reason);
+    /**
+     * @brief 平滑退出期间定时检查剩余的连接，超过期限时关闭所有连接
+    */
+    void check_drain();
+    /**
+     * @brief 关闭没有请求在处理、接收缓冲区中也没有数据的 HTTP/1 连接
+     * @return 关闭的连接数
+    */
+    size_t close_idle_conns();
+    /**
+     * @brief 热升级：启动新的可执行文件，监听 socket 通过文件描述符的继承交给它；
+     *        新进程开始服务后向本进程发送 SIGQUIT，本进程随即平滑退出
+    */
+    void upgrade();
+    /**
+     * @brief 回收退出的子进程，热升级的新进程在接管之前退出时继续服务
+    */
+    void reap_children();
+    /**
+     * @brief 取出从旧进程继承的、绑定在 port 上的监听 socket
+     * @return 文件描述符，没有时返回 -1
+    */
+    int take_inherited_listener(int port);
 
-    void add_client(int fd, const sockaddr_in &addr);
+    void add_client(int fd, const sockaddr_in &addr, bool is_tls);
+    /**
+     * @brief 把连接交还给主线程并重新注册它的事件（EPOLLONESHOT）
+    */
+    void rearm(const std::shared_ptr<HttpConn> &client, uint32_t events);
     void close_conn(std::shared_ptr<HttpConn> client);
-    void extend_time(std::shared_ptr<HttpConn> client);
+    /**
+     * @brief 在连接上发生 I/O 事件时重新设置它的定时器
+     * @param client 连接对象
+     * @param reading 是否为读事件
+     * @return 连接是否仍在期限内，否则连接已被关闭
+    */
+    bool extend_time(std::shared_ptr<HttpConn> client, bool reading);
+    int64_t get_deadline(std::shared_ptr<HttpConn> client) const;
+    void on_timeout(std::shared_ptr<HttpConn> client);
     void send_error_msg(int fd, const char *msg);
-    void deal_listen();
+    void deal_listen(int listen_fd);
     void deal_read(std::shared_ptr<HttpConn> client);
+    /**
+     * @brief 按照就地处理的策略处理读事件：在主线程上处理或者交给线程池
+    */
+    void dispatch_read(std::shared_ptr<HttpConn> client);
     void on_read(std::shared_ptr<HttpConn> client);
     void deal_write(std::shared_ptr<HttpConn> client);
     void on_write(std::shared_ptr<HttpConn> client);
     void on_process(std::shared_ptr<HttpConn> client);
+    /**
+     * @brief 在主线程上处理连接上的请求，直到需要等待 I/O 或者交给工作线程
+     * @param write_first 是否先发送已经生成的响应
+    */
+    void process_inline(std::shared_ptr<HttpConn> client, bool write_first);
+    void init_dispatch(const Config &cfg);
+    /**
+     * @brief 创建数据库和计算两类工作的线程池，线程数为 0 的类别与静态资源共用线程池
+    */
+    void init_class_pools(const Config &cfg, const ThreadPool::Options &base,
+        const ThreadPool::ThreadInit &worker_init);
+    /**
+     * @brief 把已经解析的请求交给其工作类别的线程池，队列已满时直接返回 503
+     * @note 可能在主线程或者工作线程中调用
+    */
+    void route(std::shared_ptr<HttpConn> client);
+    /**
+     * @brief 把任务交给主线程执行，线程安全；用于其他线程完成的工作需要修改连接或者 epoll 的情况
+    */
+    void post(std::function<void()> task);
+    /**
+     * @brief 在主线程中执行其他线程交来的任务
+    */
+    void run_posted();
+    void report_stats();
+    /**
+     * @brief 创建会话表，从快照中恢复会话
+    */
+    void init_sessions(const Config &cfg);
+    /**
+     * @brief 定时删除过期的会话，按间隔保存会话的快照
+    */
+    void sweep_sessions();
+    using ConnHandler = void (WebServer::*)(std::shared_ptr<HttpConn>);
+    /**
+     * @brief 交给线程池的连接任务，只有两个指针，可以放进 std::function 的内部缓冲区而不分配内存；
+     *        连接对象在排队期间由它的任务槽持有
+    */
+    template <ConnHandler Op>
+    struct ConnTask {
+        WebServer *server;
+        HttpConn *conn;
+        void operator()() const {
+            RcuReadGuard guard;   // 任务期间读取的配置快照不会被释放
+            (server->*Op)(conn->take_task());
+        }
+    };
+    template <ConnHandler Op>
+    ConnTask<Op> make_task(const std::shared_ptr<HttpConn> &client) {
+        client->pin_task(client);
+        return ConnTask<Op>{this, client.get()};
+    }
+    /**
+     * @brief 把任务交给线程池，并记录队列的最大长度
+    */
+    void submit(std::function<void()> task);
+    /**
+     * @brief 线程池的队列是否已满，需要暂停读取新的请求；队列刚刚填满时开始限流
+    */
+    bool is_throttled();
+    /**
+     * @brief 队列降到低水位后分派暂停的连接，全部分派完后结束限流并恢复监听 socket
+    */
+    void resume_reads();
+    /**
+     * @brief 请线程池在队列降到低水位时通过 eventfd 通知主线程
+    */
+    bool notify_when_drained();
+
+    /**
+     * @brief I/O 事件在主线程和线程池之间的分配情况，仅由主线程读写
+    */
+    struct DispatchStats {
+        uint64_t inline_reads;     // 完全在主线程上处理的读事件
+        uint64_t deferred_reads;   // 主线程读取（和解析）之后交给线程池的读事件
+        uint64_t pooled_reads;     // 直接交给线程池的读事件
+        uint64_t inline_writes;    // 在主线程上处理的写事件
+        uint64_t pooled_writes;    // 交给线程池的写事件
+        uint64_t parked_reads;     // 限流期间暂停的读事件
+        uint64_t throttles;        // 进入限流状态的次数
+        int64_t throttled_ms;      // 处于限流状态的总时间
+        size_t max_queue_depth;    // 统计周期内线程池队列的最大长度
+    };
+
+    enum INLINE_POLICY {
+        INLINE_OFF,    // 所有的读写事件都交给线程池
+        INLINE_CHEAP,  // 小文件的简单请求在主线程上处理，其余交给线程池
+        INLINE_ALL     // 所有的读写事件都在主线程上处理
+    };
+
+    /**
+     * @brief 可以在运行时重新加载的设置
+     *
+     * 每次加载生成一个新的对象，通过 RcuPtr 整体替换；处理请求时无锁地读取当前版本，
+     * 新的设置从下一个事件开始生效
+    */
+    struct LiveSettings {
+        int timeout;                      // 连接的空闲超时(毫秒)
+        INLINE_POLICY inline_policy;      // 哪些事件在主线程上就地处理
+        size_t inline_max_bytes;          // 就地处理的请求的目标文件（写事件的待发送文件）的最大长度
+        size_t class_queue_limit[HttpConn::WORK_CLASS_NUM];  // 非静态类别的队列容量，0 表示不限制
+        int shutdown_timeout;             // 平滑退出时等待连接关闭的最长时间(毫秒)
+    };
+
+    static std::unique_ptr<LiveSettings> load_live_settings(const Config &cfg);
+    static std::unique_ptr<ConnLimits> load_conn_limits(const Config &cfg);
 
-    static int set_nonblocking(int fd);
     
     int max_num_conn;    // 最大连接数量
     std::string m_ip;    // 监听的 IP 地址
     int m_listen_port;   // 监听的端口号
     int m_listen_fd;     // 标识监听 socket 的文件描述符
+    int m_tls_port;      // TLS 监听端口，0 表示不开启
+    int m_tls_listen_fd; // TLS 监听 socket 的文件描述符，不开启时为 -1
     bool m_open_linger;  // 是否开启 linger
-    int m_timeout;       // 超时时间，单位为毫秒
     bool m_is_close;     // 服务器是否关闭
     bool m_enable_db;  // 是否启用数据库连接池
+    SocketOptions m_sock_opts;  // socket 调优参数
     std::string m_src_dir;   // 静态资源的根目录
+    std::unique_ptr<StaticBundle> m_bundle;  // 打包的静态资源，没有配置时为空
     uint32_t m_listen_event;  // 与监听socket相关联的事件
     uint32_t m_conn_event;    // 与连接socket相关联的事件
+    CpuList m_worker_cpus;    // 工作线程绑定的 CPU 集合，为空表示不绑定
+    RcuPtr<LiveSettings> m_live;    // 可以重新加载的设置
+    std::unique_ptr<Config> m_config;  // 当前生效的配置，重新加载时用来比较哪些配置项改变了
+    int m_signal_fd;                // 读取信号的 signalfd
+    bool m_draining;                // 是否正在平滑退出
+    int64_t m_drain_deadline;       // 平滑退出的截止时间，之后关闭所有剩余的连接
+    std::vector<std::string> m_argv;   // 启动时的命令行，第一项为可执行文件的绝对路径
+    pid_t m_upgrade_pid;            // 热升级启动的新进程，没有时为 -1
+    pid_t m_parent_pid;             // 热升级时启动本进程的旧进程，开始服务后通知它退出；没有时为 -1
+    std::vector<int> m_inherited_fds;  // 从旧进程继承的、尚未使用的监听 socket
+    WorkerSlot *m_worker_slot;      // 多进程模式下本进程在共享内存中的统计，单进程时为空
+    int m_stats_interval;           // 输出事件分配统计的间隔（毫秒），0 表示不输出
+    DispatchStats m_stats;          // 累计的事件分配统计
+    DispatchStats m_last_stats;     // 上一次输出时的统计
+    size_t m_queue_limit;       // 线程池队列的容量，达到后暂停读取新的请求，0 表示不限制
+    size_t m_queue_low;         // 限流后队列降到这个长度时恢复读取
+    bool m_throttle_accept;     // 限流期间是否同时暂停接受新的连接
+    int m_drain_fd;             // 工作线程通知主线程队列已经排空的 eventfd
+    int64_t m_throttle_start;   // 本次限流开始的时间，-1 表示没有限流
+    std::deque<std::shared_ptr<HttpConn>> m_parked;  // 限流期间暂停读取的连接，按暂停的顺序排列
     std::unique_ptr<TimeHeap> m_tm_heap; // 时间堆
-    std::unique_ptr<ThreadPool> m_thread_pool; // 线程池，存放工作线程
+    // 各个工作类别的线程池，WORK_STATIC 的线程池总是存在，其余为空时共用它
+    std::unique_ptr<ThreadPool> m_pools[HttpConn::WORK_CLASS_NUM];
+    std::atomic<uint64_t> m_class_routed[HttpConn::WORK_CLASS_NUM];  // 交给各类别线程池的请求数
+    std::atomic<uint64_t> m_class_shed[HttpConn::WORK_CLASS_NUM];    // 因为队列已满返回 503 的请求数
+    int m_snapshot_interval;   // 保存会话快照的间隔(毫秒)，0 表示只在关闭时保存
+    int64_t m_last_snapshot;   // 上次保存会话快照的时间
     std::unique_ptr<Epoller> m_epoller;
+    // 非阻塞的数据库连接池，为空时数据库工作由线程池通过同步的连接池完成；
+    // 引用了 m_epoller 和 m_tm_heap，必须在它们之后声明
+    std::unique_ptr<AsyncSQLPool> m_async_sql;
+    // 批量插入注册的写入线程，为空时注册与登录一样交给数据库线程池
+    std::unique_ptr<RegistrationBatcher> m_reg_batcher;
+    int m_post_fd;              // 其他线程交来任务后通知主线程的 eventfd，没有使用时为 -1
+    std::mutex m_post_mtx;
+    std::vector<std::function<void()>> m_posted;  // 等待主线程执行的任务，由 m_post_mtx 保护
+    std::unique_ptr<TlsContext> m_tls_ctx;  // TLS 连接共享的上下文
     // 已连接socket的文件描述符 -> 连接对象
     std::unordered_map<int,std::shared_ptr<HttpConn>> m_clients;
 };
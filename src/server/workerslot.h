@@ -0,0 +1,32 @@
+/**
+ * @file workerslot.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief counters shared between the master and a worker process
+*/
+#ifndef WORKERSLOT_H
+#define WORKERSLOT_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief 多进程模式下一个工作进程的统计，位于主进程 fork 之前映射的匿名共享内存中
+ *
+ * 工作进程写入自己的槽位，主进程只读取；每个槽位独占缓存行，工作进程之间不会伪共享。
+ * 工作进程重启后沿用原来的槽位，累计值继续增加
+*/
+struct alignas(64) WorkerSlot {
+    int idx;                          // 工作进程的编号，由主进程在 fork 之前设置
+    std::atomic<int> pid;             // 当前占用槽位的工作进程，没有时为 0
+    std::atomic<int> active;          // 当前的连接数
+    std::atomic<uint64_t> accepted;   // 接受的连接总数
+
+    WorkerSlot() : idx(0), pid(0), active(0), accepted(0) {}
+};
+
+// 共享内存中的原子变量必须是无锁的，否则进程之间的操作不是原子的
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+    "counters in shared memory must be lock-free");
+
+#endif // WORKERSLOT_H
@@ -0,0 +1,81 @@
+/**
+ * @file sockopts.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for socket options
+*/
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "sockopts.h"
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69  // Linux 5.11
+#endif
+
+
+SocketOptions::SocketOptions()
+: backlog(1024), defer_accept(0), fastopen(0), nodelay(true), cork(true),
+sndbuf(0), rcvbuf(0), busy_poll_us(0), reuse_port(false) {}
+
+SocketOptions SocketOptions::from_config(const Config &cfg) {
+    SocketOptions opts;
+    opts.backlog = cfg.get_integer("listen_backlog", opts.backlog);
+    opts.defer_accept = cfg.get_integer("tcp_defer_accept", opts.defer_accept);
+    opts.fastopen = cfg.get_integer("tcp_fastopen", opts.fastopen);
+    opts.nodelay = cfg.get_bool("tcp_nodelay", opts.nodelay);
+    opts.cork = cfg.get_bool("tcp_cork", opts.cork);
+    opts.sndbuf = cfg.get_integer("sock_sndbuf", opts.sndbuf);
+    opts.rcvbuf = cfg.get_integer("sock_rcvbuf", opts.rcvbuf);
+    opts.busy_poll_us = cfg.get_integer("busy_poll_us", opts.busy_poll_us);
+    opts.reuse_port = cfg.get_bool("reuse_port", opts.reuse_port);
+    if (opts.backlog <= 0) opts.backlog = SOMAXCONN;
+    if (opts.busy_poll_us < 0) opts.busy_poll_us = 0;
+    return opts;
+}
+
+bool SocketOptions::apply_to_listener(int fd) const {
+    bool ok = true;
+    int optval = 1;
+    if (reuse_port) {
+        ok &= setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) == 0;
+    }
+    if (nodelay) {
+        ok &= setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval)) == 0;
+    }
+    if (defer_accept > 0) {
+        ok &= setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_accept,
+            sizeof(defer_accept)) == 0;
+    }
+    if (fastopen > 0) {
+        ok &= setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &fastopen,
+            sizeof(fastopen)) == 0;
+    }
+    // 接收缓冲区需要在 listen 之前设置，才能影响 SYN 中通告的窗口扩大因子
+    if (sndbuf > 0) {
+        ok &= setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) == 0;
+    }
+    if (rcvbuf > 0) {
+        ok &= setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) == 0;
+    }
+    return ok;
+}
+
+bool SocketOptions::apply_to_conn(int fd) const {
+    if (busy_poll_us <= 0) {
+        return true;
+    }
+    // 读取时在设备队列上空转等待数据，而不是立即睡眠；
+    // 超过 net.core.busy_read 需要 CAP_NET_ADMIN 权限
+    bool ok = setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us,
+        sizeof(busy_poll_us)) == 0;
+    int prefer = 1;
+    // 旧内核不支持 SO_PREFER_BUSY_POLL，忽略其错误
+    setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer));
+    return ok;
+}
+
+bool set_tcp_cork(int fd, bool on) {
+    int optval = on ? 1 : 0;
+    return setsockopt(fd, IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval)) == 0;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file sockopts.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for socket options
+*/
+#ifndef SOCKOPTS_H
+#define SOCKOPTS_H
+
+#include "../config/config.h"
+
+/**
+ * @brief 监听 socket 和连接 socket 的调优参数，从配置文件中读取
+*/
+struct SocketOptions {
+    int backlog;        // 监听队列(accept queue)的长度，实际受限于 net.core.somaxconn
+    int defer_accept;   // TCP_DEFER_ACCEPT：连接上有数据到达才唤醒 accept，单位为秒，0 表示关闭
+    int fastopen;       // TCP_FASTOPEN：TFO 请求队列的长度，0 表示关闭
+    bool nodelay;       // TCP_NODELAY：关闭 Nagle 算法
+    bool cork;          // 发送“响应头 + 文件”时使用 TCP_CORK，只发送满载的报文段
+    int sndbuf;         // SO_SNDBUF，单位为字节，0 表示使用系统默认值
+    int rcvbuf;         // SO_RCVBUF，单位为字节，0 表示使用系统默认值
+    int busy_poll_us;   // SO_BUSY_POLL，单位为微秒，0 表示关闭
+    bool reuse_port;    // SO_REUSEPORT：多个监听 socket 绑定同一个端口，由内核按连接的四元组分配
+
+    SocketOptions();
+
+    /**
+     * @brief 从配置中读取调优参数，未配置的项使用默认值
+     * @param cfg 配置对象
+     * @return 调优参数
+    */
+    static SocketOptions from_config(const Config &cfg);
+
+    /**
+     * @brief 在 listen 之前设置监听 socket 的选项
+     * 
+     * 缓冲区大小和 TCP_NODELAY 会被 accept 得到的连接 socket 继承，
+     * 在监听 socket 上设置一次即可，不需要每个连接都调用一次 setsockopt
+     * @param fd 监听 socket 的文件描述符
+     * @return 是否全部设置成功
+    */
+    bool apply_to_listener(int fd) const;
+
+    /**
+     * @brief 设置连接 socket 上无法从监听 socket 继承的选项
+     * @param fd 连接 socket 的文件描述符
+     * @return 是否全部设置成功
+    */
+    bool apply_to_conn(int fd) const;
+};
+
+/**
+ * @brief 开启或关闭 TCP_CORK
+ * @param fd socket 的文件描述符
+ * @param on 是否开启，关闭时会立即发出积攒的数据
+ * @return 是否设置成功
+*/
+bool set_tcp_cork(int fd, bool on);
+
+#endif // SOCKOPTS_H
@@ -37,8 +37,11 @@ void TimeHeap::adjust(int id, int timeout) {
     if(empty() || ref.count(id) <= 0) {
         return;
     }
-    heap[ref[id]].expire = Clock::now() + MSec(timeout);
-    sift_down(ref[id], heap.size());
+    size_type idx = ref[id];
+    heap[idx].expire = Clock::now() + MSec(timeout);
+    if (!sift_down(idx, heap.size())) {
+        sift_up(idx);
+    }
 }
 
 void TimeHeap::clear() {
@@ -51,12 +54,14 @@ void TimeHeap::tick() {
         return;
     }
     while (!heap.empty()) {
-        Timer tm = heap.front();
-        if (std::chrono::duration_cast<MSec>(tm.expire-Clock::now()).count() > 0) {
+        // 先检查是否超时，只有需要触发时才拷贝定时器（拷贝回调函数会分配内存）
+        if (std::chrono::duration_cast<MSec>(heap.front().expire-Clock::now()).count() > 0) {
             break;
         }
-        tm.cb();
+        // 先出堆再执行回调，回调函数可以为同一个 id 重新添加定时器
+        Timer tm = heap.front();
         pop();
+        tm.cb();
     }
 }
 
@@ -61,9 +61,9 @@ public:
     void pop();
 
     /**
-     * @brief 给指定定时器延长超时时间
+     * @brief 重新设置指定定时器的超时时间（可以延长也可以缩短）
      * @param id 定时器的唯一标识
-     * @param timeout 需要延长的时间（单位为毫秒）
+     * @param timeout 从现在开始计算的超时时间（单位为毫秒）
      */
     void adjust(int id, int timeout);
 
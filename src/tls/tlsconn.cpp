@@ -0,0 +1,267 @@
+/**
+ * @file tlsconn.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for TLS termination (OpenSSL) with kernel TLS offload
+*/
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <fstream>
+#include <openssl/err.h>
+#include "tlsconn.h"
+
+// 一个 TLS 记录的最大明文长度，每次读取至少留出这么多空间，
+// 使 SSL_read 总能取走整个记录，不在 OpenSSL 内部残留 epoll 看不到的数据
+static const size_t TLS_RECORD_SIZE = 16384;
+// 服务器端会话缓存的会话标识上下文
+static const unsigned char SESSION_ID_CONTEXT[] = "yawn";
+
+TlsOptions::TlsOptions()
+: session_cache(20480), session_timeout(300), tickets(true), ktls(true), h2(false) {}
+
+TlsOptions TlsOptions::from_config(const Config &cfg) {
+    TlsOptions opts;
+    opts.cert_file = cfg.get_string("tls_cert");
+    opts.key_file = cfg.get_string("tls_key");
+    opts.ciphers = cfg.get_string("tls_ciphers");
+    opts.session_cache = cfg.get_integer("tls_session_cache", opts.session_cache);
+    opts.session_timeout = cfg.get_integer("tls_session_timeout", opts.session_timeout);
+    opts.tickets = cfg.get_bool("tls_tickets", opts.tickets);
+    opts.ktls = cfg.get_bool("ktls", opts.ktls);
+    if (opts.session_cache < 0) opts.session_cache = 0;
+    if (opts.session_timeout <= 0) opts.session_timeout = 300;
+    return opts;
+}
+
+TlsContext::TlsContext() : m_ctx(nullptr) {}
+
+TlsContext::~TlsContext() {
+    SSL_CTX_free(m_ctx);
+}
+
+bool TlsContext::init(const TlsOptions &opts) {
+    m_opts = opts;
+    m_ctx = SSL_CTX_new(TLS_server_method());
+    if (!m_ctx) return false;
+    SSL_CTX_set_min_proto_version(m_ctx, TLS1_2_VERSION);
+
+    uint64_t options = SSL_OP_NO_COMPRESSION | SSL_OP_NO_RENEGOTIATION |
+        SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_IGNORE_UNEXPECTED_EOF;
+    if (!opts.tickets) {
+        options |= SSL_OP_NO_TICKET;
+    }
+#ifdef SSL_OP_ENABLE_KTLS
+    if (opts.ktls) {
+        options |= SSL_OP_ENABLE_KTLS;
+    }
+#endif
+    SSL_CTX_set_options(m_ctx, options);
+    // 非阻塞写：允许部分写入，重试时缓冲区的地址可以变化（写缓冲区会被回收和扩容）；
+    // 空闲的长连接释放 OpenSSL 的读写缓冲区
+    SSL_CTX_set_mode(m_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+        SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+
+    if (SSL_CTX_use_certificate_chain_file(m_ctx, opts.cert_file.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(m_ctx, opts.key_file.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(m_ctx) != 1) {
+        return false;
+    }
+    if (!opts.ciphers.empty() && SSL_CTX_set_cipher_list(m_ctx, opts.ciphers.c_str()) != 1) {
+        return false;
+    }
+
+    // 会话恢复：有状态的会话缓存（会话 ID）和无状态的会话票据，
+    // 票据密钥由 OpenSSL 随机生成并定期轮换，只在本进程内有效
+    SSL_CTX_set_session_id_context(m_ctx, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1);
+    if (opts.session_cache > 0) {
+        SSL_CTX_set_session_cache_mode(m_ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(m_ctx, opts.session_cache);
+    } else {
+        SSL_CTX_set_session_cache_mode(m_ctx, SSL_SESS_CACHE_OFF);
+        if (!opts.tickets) {
+            SSL_CTX_set_num_tickets(m_ctx, 0);
+        }
+    }
+    SSL_CTX_set_timeout(m_ctx, opts.session_timeout);
+
+    m_alpn.clear();
+    if (opts.h2) {
+        m_alpn.append("\x02h2", 3);
+    }
+    m_alpn.append("\x08http/1.1", 9);
+    SSL_CTX_set_alpn_select_cb(m_ctx, select_alpn, this);
+    return true;
+}
+
+int TlsContext::select_alpn(SSL *, const unsigned char **out, unsigned char *outlen,
+    const unsigned char *in, unsigned int inlen, void *arg) {
+    const auto *ctx = static_cast<const TlsContext*>(arg);
+    unsigned char *selected = nullptr;
+    int ret = SSL_select_next_proto(&selected, outlen,
+        reinterpret_cast<const unsigned char*>(ctx->m_alpn.data()), ctx->m_alpn.size(),
+        in, inlen);
+    if (ret != OPENSSL_NPN_NEGOTIATED) {
+        // 没有共同支持的协议时不选择，按 HTTP/1.1 处理
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+std::string TlsContext::last_error() {
+    std::string msg;
+    unsigned long err;
+    while ((err = ERR_get_error()) != 0) {
+        char buf[256];
+        ERR_error_string_n(err, buf, sizeof(buf));
+        msg = buf;
+    }
+    return msg.empty() ? "unknown error" : msg;
+}
+
+bool TlsContext::kernel_has_ktls() {
+    std::ifstream fs("/proc/sys/net/ipv4/tcp_available_ulp");
+    std::string ulp;
+    while (fs >> ulp) {
+        if (ulp == "tls") return true;
+    }
+    return false;
+}
+
+TlsConn::TlsConn(const TlsContext &ctx, int fd)
+: m_ssl(SSL_new(ctx.get())), m_fd(fd), m_established(false), m_want_write(false),
+m_ktls_send(false), m_ktls_recv(false) {
+    if (m_ssl) {
+        SSL_set_fd(m_ssl, fd);
+        SSL_set_accept_state(m_ssl);
+    }
+}
+
+TlsConn::~TlsConn() {
+    if (m_ssl && m_established) {
+        // 没有完成关闭流程就释放的会话会被移出缓存；连接经常由对端或超时关闭，
+        // 这里不发送任何数据，只标记为正常关闭，使会话仍然可以恢复
+        SSL_set_quiet_shutdown(m_ssl, 1);
+        SSL_shutdown(m_ssl);
+        ERR_clear_error();
+    }
+    SSL_free(m_ssl);
+}
+
+TlsConn::HANDSHAKE_RESULT TlsConn::handshake() {
+    if (m_established) return DONE;
+    if (!m_ssl) return FAILED;
+    ERR_clear_error();
+    int ret = SSL_do_handshake(m_ssl);
+    m_want_write = false;
+    if (ret == 1) {
+        m_established = true;
+#ifndef OPENSSL_NO_KTLS
+        m_ktls_send = BIO_get_ktls_send(SSL_get_wbio(m_ssl));
+        m_ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(m_ssl));
+#endif
+        return DONE;
+    }
+    switch (SSL_get_error(m_ssl, ret)) {
+        case SSL_ERROR_WANT_READ:
+            return WANT_READ;
+        case SSL_ERROR_WANT_WRITE:
+            m_want_write = true;
+            return WANT_WRITE;
+        default:
+            // 错误留在错误队列中，由调用者通过 TlsContext::last_error() 取出
+            return FAILED;
+    }
+}
+
+ssize_t TlsConn::read(Buffer &buf, int *save_errno) {
+    buf.ensure_writable(TLS_RECORD_SIZE);
+    size_t len = 0;
+    ERR_clear_error();
+    int ret = SSL_read_ex(m_ssl, buf.begin_write(), buf.writable_bytes(), &len);
+    if (ret == 1) {
+        buf.has_written(len);
+        return static_cast<ssize_t>(len);
+    }
+    switch (SSL_get_error(m_ssl, ret)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            // 读到的是握手后消息（例如会话票据）或者不完整的记录
+            *save_errno = EAGAIN;
+            return -1;
+        case SSL_ERROR_ZERO_RETURN:
+            // close_notify，或者对端直接关闭了 TCP 连接 (SSL_OP_IGNORE_UNEXPECTED_EOF)
+            return 0;
+        case SSL_ERROR_SYSCALL:
+            *save_errno = errno ? errno : ECONNRESET;
+            return -1;
+        default:
+            ERR_clear_error();
+            *save_errno = EPROTO;
+            return -1;
+    }
+}
+
+ssize_t TlsConn::writev(const struct iovec *iov, int iov_cnt) {
+    if (m_ktls_send) {
+        // 内核负责分帧和加密，直接写入明文
+        return ::writev(m_fd, iov, iov_cnt);
+    }
+    ssize_t total = 0;
+    for (int i=0; i<iov_cnt; ++i) {
+        const char *p = static_cast<const char*>(iov[i].iov_base);
+        size_t left = iov[i].iov_len;
+        while (left > 0) {
+            size_t len = 0;
+            ERR_clear_error();
+            if (SSL_write_ex(m_ssl, p, std::min<size_t>(left, INT_MAX), &len) == 1) {
+                p += len;
+                left -= len;
+                total += len;
+                continue;
+            }
+            if (total > 0) {
+                // 先报告已经发送的部分，调用者下一次从阻塞处以相同的数据重试
+                return total;
+            }
+            int err = SSL_get_error(m_ssl, 0);
+            if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) {
+                errno = EAGAIN;
+            } else if (err != SSL_ERROR_SYSCALL || errno == 0) {
+                ERR_clear_error();
+                errno = EPIPE;
+            }
+            return -1;
+        }
+    }
+    return total;
+}
+
+void TlsConn::shutdown() {
+    if (!m_ssl || !m_established) return;
+    ERR_clear_error();
+    SSL_shutdown(m_ssl);
+    ERR_clear_error();
+}
+
+bool TlsConn::session_reused() const {
+    return m_ssl && SSL_session_reused(m_ssl);
+}
+
+const char * TlsConn::version() const {
+    return m_ssl ? SSL_get_version(m_ssl) : "";
+}
+
+const char * TlsConn::cipher() const {
+    return m_ssl ? SSL_get_cipher_name(m_ssl) : "";
+}
+
+std::string TlsConn::alpn() const {
+    const unsigned char *proto = nullptr;
+    unsigned int len = 0;
+    if (m_ssl) {
+        SSL_get0_alpn_selected(m_ssl, &proto, &len);
+    }
+    return proto ? std::string(reinterpret_cast<const char*>(proto), len) : std::string();
+}
@@ -0,0 +1,149 @@
+/**
+ * @file tlsconn.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for TLS termination (OpenSSL) with kernel TLS offload
+*/
+#ifndef TLSCONN_H
+#define TLSCONN_H
+
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <openssl/ssl.h>
+#include "../buffer/buffer.h"
+#include "../config/config.h"
+
+/**
+ * @brief TLS 监听端口的参数，从配置文件中读取
+*/
+struct TlsOptions {
+    std::string cert_file;   // PEM 格式的证书链
+    std::string key_file;    // PEM 格式的私钥
+    std::string ciphers;     // TLS 1.2 的密码套件列表，为空时使用 OpenSSL 的默认值
+    long session_cache;      // 服务器端会话缓存的条目数，0 表示关闭会话缓存
+    long session_timeout;    // 会话（包括会话票据）的有效期，单位为秒
+    bool tickets;            // 是否签发会话票据 (RFC 5077 / TLS 1.3 PSK)
+    bool ktls;               // 握手完成后是否尝试把记录层的加解密交给内核 (kTLS)
+    bool h2;                 // 是否通过 ALPN 提供 h2
+
+    TlsOptions();
+
+    /**
+     * @brief 从配置中读取 TLS 参数，未配置的项使用默认值
+    */
+    static TlsOptions from_config(const Config &cfg);
+};
+
+/**
+ * @brief 所有 TLS 连接共享的 SSL_CTX：证书、会话缓存、票据密钥和 ALPN
+*/
+class TlsContext {
+public:
+    TlsContext();
+    ~TlsContext();
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    /**
+     * @brief 加载证书和私钥，设置会话恢复和 kTLS
+     * @return 是否成功，失败的原因通过`last_error()`获取
+    */
+    bool init(const TlsOptions &opts);
+
+    SSL_CTX * get() const { return m_ctx; }
+    const TlsOptions& options() const { return m_opts; }
+
+    /**
+     * @brief OpenSSL 错误队列中最近的错误，同时清空错误队列
+    */
+    static std::string last_error();
+
+    /**
+     * @brief 内核是否提供了 tls ULP（tls 模块已加载），否则 kTLS 不可能生效
+    */
+    static bool kernel_has_ktls();
+
+private:
+    static int select_alpn(SSL *ssl, const unsigned char **out, unsigned char *outlen,
+        const unsigned char *in, unsigned int inlen, void *arg);
+
+    SSL_CTX *m_ctx;
+    TlsOptions m_opts;
+    std::string m_alpn;   // 服务器支持的协议列表（ALPN 的线路格式），按优先级排列
+};
+
+/**
+ * @brief 一个 TLS 连接的记录层
+ *
+ * 接口与 read/writev 系统调用一致，在非阻塞 socket 上使用：
+ * 需要等待 socket 可读或可写时返回 -1 并把错误码设为 EAGAIN。
+ * 内核接管了发送方向的加密 (kTLS) 后，明文直接写入 socket，
+ * 静态文件的映射内存不再经过 OpenSSL 的缓冲区
+*/
+class TlsConn {
+public:
+    enum HANDSHAKE_RESULT {
+        DONE,        // 握手完成
+        WANT_READ,   // 等待 socket 可读
+        WANT_WRITE,  // 等待 socket 可写
+        FAILED       // 握手失败，连接应当关闭
+    };
+
+    TlsConn(const TlsContext &ctx, int fd);
+    ~TlsConn();
+    TlsConn(const TlsConn&) = delete;
+    TlsConn& operator=(const TlsConn&) = delete;
+
+    /**
+     * @brief 推进握手，握手完成后检查 kTLS 是否生效
+    */
+    HANDSHAKE_RESULT handshake();
+
+    bool is_established() const { return m_established; }
+
+    /**
+     * @brief 握手被阻塞在写方向上（握手消息没有写完）
+    */
+    bool want_write() const { return m_want_write; }
+
+    /**
+     * @brief 读取并解密数据，追加到缓冲区
+     * @param save_errno 出错时保存错误码，需要等待时为 EAGAIN
+     * @return 读取的明文长度，0 表示对端关闭了连接，小于零表示出错
+    */
+    ssize_t read(Buffer &buf, int *save_errno);
+
+    /**
+     * @brief 加密并发送数据，可能只发送一部分
+     * @note 返回 EAGAIN 之后必须以相同的数据重试 (SSL_write 的要求)
+     * @return 发送的明文长度，小于零表示出错，错误码保存在 errno 中
+    */
+    ssize_t writev(const struct iovec *iov, int iov_cnt);
+
+    /**
+     * @brief 尽力发送 close_notify，不等待对端的回应
+    */
+    void shutdown();
+
+    bool ktls_send() const { return m_ktls_send; }
+    bool ktls_recv() const { return m_ktls_recv; }
+    bool session_reused() const;
+    const char * version() const;
+    const char * cipher() const;
+
+    /**
+     * @brief ALPN 协商的应用层协议，没有协商时为空串
+    */
+    std::string alpn() const;
+
+private:
+    SSL *m_ssl;
+    int m_fd;
+    bool m_established;
+    bool m_want_write;
+    bool m_ktls_send;
+    bool m_ktls_recv;
+};
+
+#endif // TLSCONN_H
@@ -0,0 +1,75 @@
+/**
+ * @file bloomfilter.hpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief Bloom filter for set membership tests without false negatives
+*/
+#ifndef BLOOMFILTER_HPP
+#define BLOOMFILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief 布隆过滤器：判断为不存在的元素一定不存在，判断为可能存在的元素需要再确认
+ *
+ * k 个位置由两个 64 位哈希值按 h1 + i*h2 生成 (Kirsch-Mitzenmacher)，不是线程安全的
+*/
+class BloomFilter {
+public:
+    /**
+     * @param bits 位数组的长度，取整为 64 的倍数
+     * @param hashes 每个元素设置的位数
+    */
+    BloomFilter(size_t bits = 1 << 23, int hashes = 7)
+    : words((bits + 63) / 64 ? (bits + 63) / 64 : 1), nbits(words.size() * 64),
+      k(hashes > 0 ? hashes : 1), count(0) {}
+
+    void add(const char *data, size_t len) {
+        uint64_t h1, h2;
+        hash(data, len, h1, h2);
+        for (int i=0; i<k; ++i) {
+            uint64_t bit = (h1 + i * h2) % nbits;
+            words[bit >> 6] |= uint64_t(1) << (bit & 63);
+        }
+        ++count;
+    }
+
+    bool maybe_contains(const char *data, size_t len) const {
+        uint64_t h1, h2;
+        hash(data, len, h1, h2);
+        for (int i=0; i<k; ++i) {
+            uint64_t bit = (h1 + i * h2) % nbits;
+            if (!(words[bit >> 6] & (uint64_t(1) << (bit & 63)))) return false;
+        }
+        return true;
+    }
+
+    size_t bits() const { return nbits; }
+    size_t size() const { return count; }   // 加入的元素数（重复加入的也计数）
+
+private:
+    static void hash(const char *data, size_t len, uint64_t &h1, uint64_t &h2) {
+        // FNV-1a，再用 splitmix64 的混合函数派生出第二个哈希值
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i=0; i<len; ++i) {
+            h ^= static_cast<unsigned char>(data[i]);
+            h *= 1099511628211ULL;
+        }
+        h1 = h;
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        h2 = h | 1;   // 奇数步长
+    }
+
+    std::vector<uint64_t> words;
+    size_t nbits;
+    int k;
+    size_t count;
+};
+
+#endif // BLOOMFILTER_HPP
@@ -0,0 +1,298 @@
+/**
+ * @file regbatcher.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for the write-behind batcher of user registrations
+*/
+#include "regbatcher.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include "../pool/sqlconnRAII.hpp"
+#include "../log/log.h"
+#include "../util/util.h"
+
+// 加载用户表失败之后重试的间隔(毫秒)
+static const int RETRY_INTERVAL = 1000;
+
+/**
+ * @brief 把转义并加上引号的字符串追加到语句中
+*/
+static void append_quoted(MYSQL *conn, std::string &sql, const std::string &value) {
+    size_t pos = sql.size();
+    sql.resize(pos + value.size() * 2 + 3);
+    sql[pos] = '\'';
+    unsigned long len = mysql_real_escape_string(conn, &sql[pos + 1], value.data(), value.size());
+    sql[pos + 1 + len] = '\'';
+    sql.resize(pos + len + 2);
+}
+
+/**
+ * @brief 执行不返回结果集的语句，出错时记录日志
+*/
+static bool exec(MYSQL *conn, const char *sql, size_t len) {
+    if (mysql_real_query(conn, sql, len) != 0) {
+        LOG_ERROR("Registration batch failed: %s", mysql_error(conn));
+        return false;
+    }
+    return true;
+}
+
+static bool exec(MYSQL *conn, const char *sql) {
+    return exec(conn, sql, strlen(sql));
+}
+
+RegistrationBatcher::RegistrationBatcher(SQLConnPool *pool_, const Options &opts_):
+pool(pool_), opts(opts_), bloom(opts_.bloom_bits, opts_.bloom_hashes), indexed(false),
+is_close(false), stats() {
+    if (opts.batch_size == 0) opts.batch_size = 1;
+    if (opts.max_delay < 0) opts.max_delay = 0;
+    writer = std::thread(&RegistrationBatcher::run, this);
+}
+
+RegistrationBatcher::~RegistrationBatcher() {
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        is_close = true;
+    }
+    cond.notify_all();
+    if (writer.joinable()) writer.join();
+}
+
+void RegistrationBatcher::add(const std::string &username, const std::string &password,
+    UserStore::Done done
+) {
+    if (!UserStore::is_valid(username) || !UserStore::is_valid(password)) {
+        done(UserStore::REJECTED);
+        return;
+    }
+    bool accepted = false, wake = false;
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        if (!is_close && queue.size() < opts.max_pending) {
+            queue.push_back({username, password, std::move(done), UserStore::UNAVAILABLE,
+                monotonic_ms()});
+            accepted = true;
+            // 第一个注册开始计时，攒够一批时立即写入，其余情况写入线程自己醒来
+            wake = queue.size() == 1 || queue.size() == opts.batch_size;
+        }
+    }
+    if (!accepted) {
+        done(UserStore::UNAVAILABLE);
+        return;
+    }
+    if (wake) cond.notify_one();
+}
+
+RegistrationBatcher::Stats RegistrationBatcher::get_stats() {
+    std::lock_guard<std::mutex> lck(mtx);
+    Stats s = stats;
+    s.pending = queue.size();
+    return s;
+}
+
+void RegistrationBatcher::run() {
+    int64_t last_try = -RETRY_INTERVAL;
+    std::vector<Item> batch;
+    for (;;) {
+        if (!indexed && monotonic_ms() - last_try >= RETRY_INTERVAL) {
+            last_try = monotonic_ms();
+            indexed = load_index();
+        }
+        {
+            std::unique_lock<std::mutex> lck(mtx);
+            while (!is_close && queue.size() < opts.batch_size) {
+                if (queue.empty()) {
+                    if (indexed) {
+                        cond.wait(lck);
+                    } else if (cond.wait_for(lck, std::chrono::milliseconds(RETRY_INTERVAL)) ==
+                        std::cv_status::timeout) {
+                        break;
+                    }
+                    continue;
+                }
+                int64_t left = queue.front().enqueued + opts.max_delay - monotonic_ms();
+                if (left <= 0) break;
+                cond.wait_for(lck, std::chrono::milliseconds(left));
+            }
+            if (queue.empty()) {
+                if (is_close) return;
+                continue;
+            }
+            // 关闭时也按批写完排队的注册
+            size_t n = std::min(queue.size(), opts.batch_size);
+            std::move(queue.begin(), queue.begin() + n, std::back_inserter(batch));
+            queue.erase(queue.begin(), queue.begin() + n);
+        }
+        write_batch(batch);
+        batch.clear();
+    }
+}
+
+bool RegistrationBatcher::load_index() {
+    SQLConnRAII guard(pool);
+    if (!guard) return false;
+    MYSQL *conn = guard.get();
+    if (!exec(conn, "SELECT username FROM users")) {
+        if (mysql_errno(conn) >= CLIENT_ERR_MIN) guard.discard();
+        return false;
+    }
+    // 逐行读取，不把整张表放在客户端的内存里
+    MYSQL_RES *res = mysql_use_result(conn);
+    if (!res) {
+        LOG_ERROR("Failed to load usernames: %s", mysql_error(conn));
+        guard.discard();
+        return false;
+    }
+    size_t n = 0;
+    while (MYSQL_ROW row = mysql_fetch_row(res)) {
+        unsigned long *lens = mysql_fetch_lengths(res);
+        if (row[0]) {
+            bloom.add(row[0], lens[0]);
+            ++n;
+        }
+    }
+    bool ok = mysql_errno(conn) == 0;
+    mysql_free_result(res);
+    if (!ok) {
+        LOG_ERROR("Failed to load usernames: %s", mysql_error(conn));
+        guard.discard();
+        return false;
+    }
+    LOG_INFO("Registration batcher indexed %zu usernames (%zu bits)", n, bloom.bits());
+    std::lock_guard<std::mutex> lck(mtx);
+    stats.indexed = bloom.size();
+    return true;
+}
+
+void RegistrationBatcher::write_batch(std::vector<Item> &batch) {
+    std::vector<Item*> rows, probes;
+    std::unordered_set<std::string> seen;
+    uint64_t skips = 0;
+    for (auto &item : batch) {
+        if (!seen.insert(item.username).second) {
+            // 同一批中重复的用户名，先到的注册有效
+            item.result = UserStore::REJECTED;
+            continue;
+        }
+        if (bloom.maybe_contains(item.username.data(), item.username.size())) {
+            probes.push_back(&item);
+        } else {
+            ++skips;
+        }
+        rows.push_back(&item);
+    }
+
+    SQLConnRAII guard(pool);
+    if (guard && (probes.empty() || reject_existing(guard, probes))) {
+        rows.erase(std::remove_if(rows.begin(), rows.end(), [](const Item *item) {
+            return item->result == UserStore::REJECTED;
+        }), rows.end());
+        if (!rows.empty()) insert_rows(guard, rows);
+    }
+    guard.release();
+
+    Stats delta = {};
+    for (auto &item : batch) {
+        if (item.result == UserStore::OK) {
+            bloom.add(item.username.data(), item.username.size());
+            UserStore::invalidate(item.username);
+            ++delta.inserted;
+        } else if (item.result == UserStore::REJECTED) {
+            ++delta.duplicates;
+        } else {
+            ++delta.failures;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        ++stats.batches;
+        stats.inserted += delta.inserted;
+        stats.duplicates += delta.duplicates;
+        stats.failures += delta.failures;
+        stats.bloom_skips += skips;
+        stats.indexed = bloom.size();
+    }
+    LOG_DEBUG("Registration batch: %zu requests, %llu inserted, %llu duplicates",
+        batch.size(), (unsigned long long)delta.inserted, (unsigned long long)delta.duplicates);
+    for (auto &item : batch) {
+        item.done(item.result);
+    }
+}
+
+bool RegistrationBatcher::reject_existing(SQLConnRAII &guard, std::vector<Item*> &probes) {
+    MYSQL *conn = guard.get();
+    std::string sql = "SELECT username FROM users WHERE username IN (";
+    for (size_t i=0; i<probes.size(); ++i) {
+        if (i > 0) sql.push_back(',');
+        append_quoted(conn, sql, probes[i]->username);
+    }
+    sql.push_back(')');
+    MYSQL_RES *res = nullptr;
+    if (!exec(conn, sql.data(), sql.size()) || !(res = mysql_store_result(conn))) {
+        if (mysql_errno(conn) >= CLIENT_ERR_MIN) guard.discard();
+        return false;
+    }
+    std::unordered_map<std::string, Item*> index;
+    for (auto item : probes) index.emplace(item->username, item);
+    while (MYSQL_ROW row = mysql_fetch_row(res)) {
+        unsigned long *lens = mysql_fetch_lengths(res);
+        if (!row[0]) continue;
+        auto it = index.find(std::string(row[0], lens[0]));
+        if (it != index.end()) it->second->result = UserStore::REJECTED;
+    }
+    mysql_free_result(res);
+    return true;
+}
+
+void RegistrationBatcher::insert_rows(SQLConnRAII &guard, std::vector<Item*> &rows) {
+    MYSQL *conn = guard.get();
+    std::string sql = "INSERT INTO users(username, password) VALUES ";
+    for (size_t i=0; i<rows.size(); ++i) {
+        sql.append(i > 0 ? ",(" : "(");
+        append_quoted(conn, sql, rows[i]->username);
+        sql.push_back(',');
+        append_quoted(conn, sql, rows[i]->password);
+        sql.push_back(')');
+    }
+    if (exec(conn, "START TRANSACTION") && exec(conn, sql.data(), sql.size()) &&
+        exec(conn, "COMMIT")) {
+        for (auto item : rows) item->result = UserStore::OK;
+        return;
+    }
+    unsigned int err = mysql_errno(conn);
+    if (err >= CLIENT_ERR_MIN) {
+        guard.discard();
+        return;
+    }
+    exec(conn, "ROLLBACK");
+    if (err != ERR_DUP_ENTRY) return;
+
+    // 布隆过滤器没有拦下的重复（例如刚刚由其他进程注册），逐行插入以确定是哪一行；
+    // 失败的语句只回滚它自己，仍然在一个事务中提交
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        ++stats.fallbacks;
+    }
+    if (!exec(conn, "START TRANSACTION")) {
+        if (mysql_errno(conn) >= CLIENT_ERR_MIN) guard.discard();
+        return;
+    }
+    for (auto item : rows) {
+        item->result = UserStore::add(guard, item->username, item->password);
+        if (item->result == UserStore::UNAVAILABLE) break;
+    }
+    bool failed = std::any_of(rows.begin(), rows.end(), [](const Item *item) {
+        return item->result == UserStore::UNAVAILABLE;
+    });
+    if (failed || !exec(conn, "COMMIT")) {
+        if (mysql_errno(conn) >= CLIENT_ERR_MIN) {
+            guard.discard();
+        } else {
+            exec(conn, "ROLLBACK");
+        }
+        for (auto item : rows) item->result = UserStore::UNAVAILABLE;
+    }
+}
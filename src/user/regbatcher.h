@@ -0,0 +1,110 @@
+/**
+ * @file regbatcher.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for the write-behind batcher of user registrations
+*/
+#ifndef REGBATCHER_H
+#define REGBATCHER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "userstore.h"
+#include "bloomfilter.hpp"
+
+class SQLConnPool;
+class SQLConnRAII;
+
+/**
+ * @brief 把许多请求的注册合并成多行的 INSERT，在一个事务中提交
+ *
+ * 注册由写入线程收集，攒够 batch_size 个或者最早的一个等待了 max_delay 毫秒之后写入一批，
+ * 每一批只提交一次事务，数据库的刷盘次数随之减少。用户名是否已经存在先查布隆过滤器
+ * （启动时从用户表加载），只有可能存在的用户名才在一次 SELECT ... IN 中确认；
+ * 最终仍由用户名上的唯一键保证不重复，批量插入遇到重复时改为逐行插入
+*/
+class RegistrationBatcher {
+public:
+    struct Options {
+        size_t batch_size;     // 一批最多的注册数
+        int max_delay;         // 第一个注册最多等待多久(毫秒)就写入
+        size_t max_pending;    // 排队的注册数上限，超出时立即返回 UNAVAILABLE
+        size_t bloom_bits;     // 布隆过滤器的位数
+        int bloom_hashes;      // 布隆过滤器的哈希函数个数
+
+        Options() : batch_size(64), max_delay(5), max_pending(4096), bloom_bits(1 << 23),
+            bloom_hashes(7) {}
+    };
+
+    struct Stats {
+        uint64_t batches;      // 写入的批数
+        uint64_t inserted;     // 插入的用户数
+        uint64_t duplicates;   // 用户名已存在的注册数
+        uint64_t bloom_skips;  // 布隆过滤器判断为不存在、不需要查询的注册数
+        uint64_t fallbacks;    // 批量插入失败改为逐行插入的批数
+        uint64_t failures;     // 因为数据库不可用而失败的注册数
+        size_t pending;        // 排队的注册数
+        size_t indexed;        // 布隆过滤器中的用户名数
+    };
+
+    RegistrationBatcher(SQLConnPool *pool, const Options &opts);
+    /**
+     * @brief 写完排队的注册之后停止写入线程
+    */
+    ~RegistrationBatcher();
+
+    RegistrationBatcher(const RegistrationBatcher&) = delete;
+    RegistrationBatcher& operator=(const RegistrationBatcher&) = delete;
+
+    /**
+     * @brief 提交一个注册，线程安全
+     * @param done 所在的一批提交（或失败）之后在写入线程中调用；
+     *             输入不合法或者队列已满时立即在当前线程中调用
+    */
+    void add(const std::string &username, const std::string &password, UserStore::Done done);
+
+    Stats get_stats();
+
+private:
+    struct Item {
+        std::string username;
+        std::string password;
+        UserStore::Done done;
+        UserStore::RESULT result;
+        int64_t enqueued;      // 提交的时间
+    };
+
+    void run();
+    /**
+     * @brief 把用户表中已有的用户名加入布隆过滤器
+     * @return 是否加载成功；失败时布隆过滤器不完整，重复的用户名由唯一键拦下
+    */
+    bool load_index();
+    void write_batch(std::vector<Item> &batch);
+    /**
+     * @brief 用一次查询确认哪些用户名已经存在，把它们标记为 REJECTED
+     * @return 查询是否成功
+    */
+    bool reject_existing(SQLConnRAII &conn, std::vector<Item*> &probes);
+    /**
+     * @brief 在一个事务中用一条多行的 INSERT 插入所有的注册，重复时回滚并逐行插入
+    */
+    void insert_rows(SQLConnRAII &conn, std::vector<Item*> &rows);
+
+    SQLConnPool *pool;
+    Options opts;
+    BloomFilter bloom;          // 仅由写入线程访问
+    bool indexed;               // 布隆过滤器是否已经加载了用户表，仅由写入线程访问
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::vector<Item> queue;    // 由 mtx 保护
+    bool is_close;
+    Stats stats;                // 由 mtx 保护
+    std::thread writer;
+};
+
+#endif // REGBATCHER_H
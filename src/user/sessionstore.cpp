@@ -0,0 +1,289 @@
+/**
+ * @file sessionstore.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for the in-memory session table
+*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include "sessionstore.h"
+#include "../log/log.h"
+#include "../util/util.h"
+
+static const char SNAPSHOT_MAGIC[] = "yawn-sessions 1";
+// 会话编号的字节数，Cookie 中是它的十六进制表示
+static const size_t ID_BYTES = 16;
+
+static int64_t wall_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+static bool random_id(std::string &id) {
+    unsigned char buf[ID_BYTES];
+    size_t got = 0;
+    while (got < sizeof(buf)) {
+        ssize_t n = getrandom(buf + got, sizeof(buf) - got, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        got += n;
+    }
+    static const char HEX[] = "0123456789abcdef";
+    id.resize(ID_BYTES * 2);
+    for (size_t i=0; i<ID_BYTES; ++i) {
+        id[2*i] = HEX[buf[i] >> 4];
+        id[2*i+1] = HEX[buf[i] & 0xf];
+    }
+    return true;
+}
+
+static bool is_valid_id(const char *s, size_t len) {
+    if (len != ID_BYTES * 2) return false;
+    for (size_t i=0; i<len; ++i) {
+        if (!((s[i] >= '0' && s[i] <= '9') || (s[i] >= 'a' && s[i] <= 'f'))) return false;
+    }
+    return true;
+}
+
+SessionStore* SessionStore::get_instance() {
+    static SessionStore store;
+    return &store;
+}
+
+void SessionStore::init(const Options &opts_) {
+    opts = opts_;
+    if (!opts.enable) return;
+    opts.ttl = std::max(opts.ttl, 1);
+    opts.max_sessions = std::max<size_t>(opts.max_sessions, 1);
+    size_t n = table.reset(std::max<size_t>(opts.shards, 1));
+    shard_cap = (opts.max_sessions + n - 1) / n;
+    protected_paths.clear();
+    protected_paths.insert(opts.protected_paths.begin(), opts.protected_paths.end());
+    if (!opts.snapshot_path.empty()) {
+        load();
+    }
+}
+
+void SessionStore::insert_locked(Shard &shard, const std::string &id,
+    const std::string &username, int64_t expires
+) {
+    auto it = shard.find(id);
+    if (shard.found(it)) {
+        shard.erase(it);
+    }
+    while (shard.size() >= shard_cap) {
+        shard.erase(shard.oldest());
+        ++evicted;
+    }
+    shard.push_front({id, username, expires});
+}
+
+std::string SessionStore::create(const std::string &username) {
+    std::string id;
+    if (table.empty() || !random_id(id)) {
+        return std::string();
+    }
+    Shard &shard = table.shard_of(id);
+    {
+        std::lock_guard<std::mutex> lck(shard.mtx);
+        insert_locked(shard, id, username, monotonic_ms() + opts.ttl);
+    }
+    ++created;
+    return id;
+}
+
+bool SessionStore::lookup(const std::string &id, std::string *username) {
+    if (table.empty() || !is_valid_id(id.data(), id.size())) {
+        ++misses;
+        return false;
+    }
+    Shard &shard = table.shard_of(id);
+    int64_t now = monotonic_ms();
+    std::lock_guard<std::mutex> lck(shard.mtx);
+    auto entry = shard.find(id);
+    if (!shard.found(entry)) {
+        ++misses;
+        return false;
+    }
+    if (entry->expires <= now) {
+        shard.erase(entry);
+        ++expired;
+        ++misses;
+        return false;
+    }
+    // 续期并移到 LRU 链表的头部，链表仍然按过期时间排序
+    entry->expires = now + opts.ttl;
+    shard.touch(entry);
+    if (username) *username = entry->username;
+    ++hits;
+    return true;
+}
+
+void SessionStore::remove(const std::string &id) {
+    if (table.empty()) return;
+    Shard &shard = table.shard_of(id);
+    std::lock_guard<std::mutex> lck(shard.mtx);
+    auto it = shard.find(id);
+    if (shard.found(it)) {
+        shard.erase(it);
+    }
+}
+
+size_t SessionStore::expire() {
+    size_t n = 0;
+    int64_t now = monotonic_ms();
+    for (auto &shard : table) {
+        std::lock_guard<std::mutex> lck(shard->mtx);
+        while (!shard->empty() && shard->oldest()->expires <= now) {
+            shard->erase(shard->oldest());
+            ++n;
+        }
+    }
+    expired += n;
+    return n;
+}
+
+void SessionStore::clear() {
+    for (auto &shard : table) {
+        std::lock_guard<std::mutex> lck(shard->mtx);
+        shard->clear();
+    }
+}
+
+bool SessionStore::save() const {
+    if (opts.snapshot_path.empty() || table.empty()) return false;
+    std::string tmp = opts.snapshot_path + ".tmp";
+    // 快照中的会话编号等同于登录凭据，只允许所有者读写
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    FILE *fp = fd >= 0 ? fdopen(fd, "w") : nullptr;
+    if (!fp) {
+        LOG_ERROR("Failed to open session snapshot %s: %s", tmp.c_str(), strerror(errno));
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    // 过期时间换算为墙上时间，重启之后单调时钟的起点不同
+    const int64_t offset = wall_ms() - monotonic_ms();
+    size_t count = 0;
+    fprintf(fp, "%s\n", SNAPSHOT_MAGIC);
+    for (auto &shard : table) {
+        std::lock_guard<std::mutex> lck(shard->mtx);
+        for (const auto &e : shard->lru) {
+            fprintf(fp, "%s\t%s\t%lld\n", e.id.c_str(), e.username.c_str(),
+                static_cast<long long>(e.expires + offset));
+            ++count;
+        }
+    }
+    bool ok = fflush(fp) == 0 && fsync(fd) == 0;
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), opts.snapshot_path.c_str()) != 0) {
+        LOG_ERROR("Failed to write session snapshot %s: %s", opts.snapshot_path.c_str(),
+            strerror(errno));
+        unlink(tmp.c_str());
+        return false;
+    }
+    LOG_DEBUG("Saved %zu sessions to %s", count, opts.snapshot_path.c_str());
+    return true;
+}
+
+bool SessionStore::load() {
+    if (opts.snapshot_path.empty() || table.empty()) return false;
+    FILE *fp = fopen(opts.snapshot_path.c_str(), "re");
+    if (!fp) {
+        if (errno != ENOENT) {
+            LOG_WARN("Failed to open session snapshot %s: %s", opts.snapshot_path.c_str(),
+                strerror(errno));
+        }
+        return false;
+    }
+    char *line = nullptr;
+    size_t cap = 0;
+    ssize_t len = getline(&line, &cap, fp);
+    if (len < 0 || std::strncmp(line, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC) - 1) != 0) {
+        LOG_WARN("Ignoring session snapshot %s: unknown format", opts.snapshot_path.c_str());
+        free(line);
+        fclose(fp);
+        return false;
+    }
+    const int64_t offset = wall_ms() - monotonic_ms();
+    const int64_t now = monotonic_ms();
+    std::vector<Entry> entries;
+    while ((len = getline(&line, &cap, fp)) > 0) {
+        if (line[len-1] == '\n') line[--len] = '\0';
+        char *tab1 = static_cast<char*>(memchr(line, '\t', len));
+        char *tab2 = tab1 ? static_cast<char*>(memchr(tab1 + 1, '\t', line + len - tab1 - 1)) :
+            nullptr;
+        if (!tab2 || !is_valid_id(line, tab1 - line)) continue;
+        int64_t expires = std::strtoll(tab2 + 1, nullptr, 10) - offset;
+        if (expires <= now) continue;
+        // 恢复时不超过当前的有效期，配置缩短了 ttl 也能立即生效
+        expires = std::min(expires, now + opts.ttl);
+        entries.push_back({std::string(line, tab1), std::string(tab1 + 1, tab2), expires});
+    }
+    free(line);
+    fclose(fp);
+    // 按过期时间从早到晚插入到链表头部，使每个分片的链表尾部仍是最早过期的会话
+    std::sort(entries.begin(), entries.end(),
+        [](const Entry &a, const Entry &b) { return a.expires < b.expires; });
+    for (const auto &e : entries) {
+        Shard &shard = table.shard_of(e.id);
+        std::lock_guard<std::mutex> lck(shard.mtx);
+        insert_locked(shard, e.id, e.username, e.expires);
+    }
+    LOG_INFO("Restored %zu sessions from %s", entries.size(), opts.snapshot_path.c_str());
+    return true;
+}
+
+SessionStore::Stats SessionStore::get_stats() const {
+    Stats st;
+    st.sessions = 0;
+    for (auto &shard : table) {
+        std::lock_guard<std::mutex> lck(shard->mtx);
+        st.sessions += shard->size();
+    }
+    st.created = created;
+    st.hits = hits;
+    st.misses = misses;
+    st.expired = expired;
+    st.evicted = evicted;
+    return st;
+}
+
+bool SessionStore::is_protected(const char *path, size_t len) const {
+    return !protected_paths.empty() && protected_paths.count(std::string(path, len));
+}
+
+std::string SessionStore::parse_cookie(const char *header, size_t len) const {
+    // cookie-string = cookie-pair *( ";" SP cookie-pair )
+    const char *p = header, *end = header + len;
+    const size_t name_len = opts.cookie_name.size();
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == ';')) ++p;
+        const char *pair_end = std::find(p, end, ';');
+        const char *eq = std::find(p, pair_end, '=');
+        if (eq != pair_end && static_cast<size_t>(eq - p) == name_len &&
+            std::memcmp(p, opts.cookie_name.data(), name_len) == 0 &&
+            is_valid_id(eq + 1, pair_end - eq - 1)) {
+            return std::string(eq + 1, pair_end);
+        }
+        p = pair_end;
+    }
+    return std::string();
+}
+
+std::string SessionStore::make_cookie(const std::string &id) const {
+    std::string cookie = opts.cookie_name + "=" + id + "; Path=/; HttpOnly; SameSite=Lax; Max-Age=";
+    cookie += id.empty() ? "0" : std::to_string(opts.ttl / 1000);
+    if (opts.cookie_secure) {
+        cookie += "; Secure";
+    }
+    return cookie;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file sessionstore.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for the in-memory session table
+*/
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "../util/shardedlru.hpp"
+
+/**
+ * @brief 登录之后的会话表
+ *
+ * 会话编号是 128 位的随机数，通过 Cookie 发给客户端，验证会话只查内存中的表，不访问数据库。
+ * 每次访问都把会话的有效期延长到 ttl 毫秒之后，所以最久没有访问的会话也是最早过期的会话，
+ * 定时清理只需要从它开始删除；会话数达到上限时同样先淘汰它。可以把会话保存到文件中，重启后继续有效
+*/
+class SessionStore {
+public:
+    struct Options {
+        bool enable;
+        int ttl;                    // 会话的空闲有效期(毫秒)
+        size_t max_sessions;        // 会话数的上限
+        size_t shards;              // 分片数，取整为 2 的幂
+        std::string cookie_name;
+        bool cookie_secure;         // Cookie 是否只通过 HTTPS 发送
+        std::vector<std::string> protected_paths;   // 需要登录才能访问的路径
+        std::string snapshot_path;  // 保存会话的文件，为空表示不保存
+
+        Options() : enable(false), ttl(1800000), max_sessions(100000), shards(16),
+            cookie_name("sid"), cookie_secure(false) {}
+    };
+
+    struct Stats {
+        size_t sessions;     // 当前的会话数
+        uint64_t created;
+        uint64_t hits;       // 找到有效会话的查找
+        uint64_t misses;     // 没有找到或者已经过期的查找
+        uint64_t expired;    // 过期删除的会话数
+        uint64_t evicted;    // 因为达到上限被淘汰的会话数
+    };
+
+    static SessionStore* get_instance();
+
+    /**
+     * @brief 设置参数，并从快照文件中恢复没有过期的会话
+    */
+    void init(const Options &opts);
+    bool enabled() const { return opts.enable; }
+    int ttl() const { return opts.ttl; }
+
+    /**
+     * @brief 为用户创建会话
+     * @return 会话编号，生成随机数失败时返回空串
+    */
+    std::string create(const std::string &username);
+
+    /**
+     * @brief 查找会话并续期
+     * @param username 找到时保存会话所属的用户名，可以为空
+     * @return 会话是否存在并且没有过期
+    */
+    bool lookup(const std::string &id, std::string *username = nullptr);
+
+    void remove(const std::string &id);
+
+    /**
+     * @brief 删除所有已经过期的会话，由主线程的定时器周期性调用
+     * @return 删除的会话数
+    */
+    size_t expire();
+
+    /**
+     * @brief 把没有过期的会话写入快照文件（先写临时文件再重命名）
+    */
+    bool save() const;
+    /**
+     * @brief 从快照文件恢复会话，过期的会话被跳过
+    */
+    bool load();
+
+    Stats get_stats() const;
+
+    /**
+     * @brief 路径是否需要登录才能访问
+    */
+    bool is_protected(const char *path, size_t len) const;
+
+    /**
+     * @brief 从请求的 Cookie 头中取出会话编号
+    */
+    std::string parse_cookie(const char *header, size_t len) const;
+
+    /**
+     * @brief 发放或者清除会话 Cookie 的 Set-Cookie 头的值
+     * @param id 会话编号，为空表示清除
+    */
+    std::string make_cookie(const std::string &id) const;
+
+    /**
+     * @brief 清空所有的会话，主要用于测试
+    */
+    void clear();
+
+    SessionStore(const SessionStore&) = delete;
+    SessionStore& operator=(const SessionStore&) = delete;
+
+private:
+    SessionStore() {}
+
+    struct Entry {
+        std::string id;
+        std::string username;
+        int64_t expires;     // 过期时间 (steady_clock 的毫秒数)
+    };
+
+    using Table = ShardedLru<Entry, &Entry::id>;
+    using Shard = Table::Shard;
+
+    /**
+     * @brief 插入会话，分片已满时淘汰最久没有访问的会话；调用者持有分片的锁
+    */
+    void insert_locked(Shard &shard, const std::string &id, const std::string &username,
+        int64_t expires);
+
+    Options opts;
+    size_t shard_cap = 0;    // 每个分片的会话数上限
+    Table table;
+    std::unordered_set<std::string> protected_paths;
+    std::atomic<uint64_t> created{0}, hits{0}, misses{0}, expired{0}, evicted{0};
+};
+
+#endif // SESSIONSTORE_H
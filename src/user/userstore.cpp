@@ -0,0 +1,104 @@
+/**
+ * @file userstore.cpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief source file for user account storage (MySQL table `users`)
+*/
+#include "userstore.h"
+#include "../pool/sqlstmt.h"
+#include "../pool/asyncsqlpool.h"
+#include "../log/log.h"
+
+// 同步的版本把语句准备在连接上，异步的版本由 AsyncSQLPool::bind 把 `?` 替换为转义后的参数
+static const char SELECT_SQL[] = "SELECT password FROM users WHERE username = ? LIMIT 1";
+// 用户名上有唯一键，由数据库判断是否重复，不必先查询
+static const char INSERT_SQL[] = "INSERT INTO users(username, password) VALUES(?, ?)";
+static const SQLStmt::Id SELECT_STMT = SQLStmt::define(SELECT_SQL);
+static const SQLStmt::Id INSERT_STMT = SQLStmt::define(INSERT_SQL);
+
+bool UserStore::is_valid(const std::string &field) {
+    if (field.empty() || field.size() > MAX_FIELD_LEN) return false;
+    for (unsigned char ch : field) {
+        if (ch < 0x20 || ch == 0x7f) return false;
+    }
+    return true;
+}
+
+UserStore::RESULT UserStore::verify(const std::string &username, const std::string &password) {
+    if (!is_valid(username) || !is_valid(password)) return REJECTED;
+    // 开启了查询缓存时，有效期内重复的登录不访问数据库；用户不存在的结果不缓存：
+    // 多进程模式下每个进程有自己的缓存，注册只能让本进程缓存的结果失效，
+    // 缓存的“不存在”会让新用户在其他进程上登录失败
+    auto rows = SQLStmt::query(SQLConnPool::get_instance(), SELECT_STMT, {username}, 0, false);
+    if (!rows) return UNAVAILABLE;
+    if (!rows->empty() && !rows->front().empty() && rows->front()[0] == password) {
+        return OK;
+    }
+    return REJECTED;
+}
+
+void UserStore::invalidate(const std::string &username) {
+    QueryCache::get_instance()->invalidate(SELECT_STMT, {username});
+}
+
+UserStore::RESULT UserStore::add(const std::string &username, const std::string &password) {
+    if (!is_valid(username) || !is_valid(password)) return REJECTED;
+    SQLConnRAII guard(SQLConnPool::get_instance());
+    if (!guard) return UNAVAILABLE;
+    RESULT res = add(guard, username, password);
+    if (res == OK) invalidate(username);
+    return res;
+}
+
+UserStore::RESULT UserStore::add(SQLConnRAII &conn, const std::string &username,
+    const std::string &password
+) {
+    SQLStmt stmt(conn, INSERT_STMT);
+    if (!stmt || !stmt.bind(username).bind(password).execute()) {
+        if (stmt.error_code() == ERR_DUP_ENTRY) {
+            return REJECTED;
+        }
+        LOG_ERROR("Failed to add user: %s", stmt.error().c_str());
+        if (stmt.error_code() >= CLIENT_ERR_MIN) conn.discard();
+        return UNAVAILABLE;
+    }
+    return OK;
+}
+
+void UserStore::verify(AsyncSQLPool &db, const std::string &username,
+    const std::string &password, Done done
+) {
+    if (!is_valid(username) || !is_valid(password)) {
+        done(REJECTED);
+        return;
+    }
+    db.query(SELECT_SQL, {username}, [password, done](const SQLResult &res) {
+        if (!res.ok()) {
+            LOG_ERROR("Failed to query user: %s", res.error.c_str());
+            done(UNAVAILABLE);
+            return;
+        }
+        bool match = !res.rows.empty() && !res.rows[0].empty() && res.rows[0][0] == password;
+        done(match ? OK : REJECTED);
+    });
+}
+
+void UserStore::add(AsyncSQLPool &db, const std::string &username,
+    const std::string &password, Done done
+) {
+    if (!is_valid(username) || !is_valid(password)) {
+        done(REJECTED);
+        return;
+    }
+    db.query(INSERT_SQL, {username, password}, [username, done](const SQLResult &res) {
+        if (res.err == ERR_DUP_ENTRY) {
+            done(REJECTED);
+        } else if (!res.ok()) {
+            LOG_ERROR("Failed to add user: %s", res.error.c_str());
+            done(UNAVAILABLE);
+        } else {
+            invalidate(username);
+            done(OK);
+        }
+    });
+}
@@ -0,0 +1,78 @@
+/**
+ * @file userstore.h
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief header file for user account storage (MySQL table `users`)
+*/
+#ifndef USERSTORE_H
+#define USERSTORE_H
+
+#include <functional>
+#include <string>
+
+class AsyncSQLPool;
+class SQLConnRAII;
+
+/**
+ * @brief 登录和注册表单使用的用户表，表结构见 README
+ *
+ * 同步的版本通过 SQLConnPool 上缓存的预处理语句访问数据库，会阻塞调用的线程，只应在数据库线程池中调用；
+ * 异步的版本通过 AsyncSQLPool 访问数据库，查询期间不占用线程
+*/
+class UserStore {
+public:
+    enum RESULT {
+        OK,           // 验证通过或者注册成功
+        REJECTED,     // 用户名或密码错误、用户名已被注册，或者输入不合法
+        UNAVAILABLE   // 没有可用的数据库连接或者查询出错
+    };
+
+    /**
+     * @brief 用户名和密码的最大长度，与表中 CHAR(50) 的定义一致
+    */
+    static const size_t MAX_FIELD_LEN = 50;
+
+    // 异步操作完成后的回调，数据库访问完成时在主线程中调用，输入不合法时立即在当前线程中调用
+    using Done = std::function<void(RESULT)>;
+
+    /**
+     * @brief 检查用户名和密码
+    */
+    static RESULT verify(const std::string &username, const std::string &password);
+
+    /**
+     * @brief 注册新用户
+    */
+    static RESULT add(const std::string &username, const std::string &password);
+
+    /**
+     * @brief 在已经借出的连接上注册新用户，可以在调用者的事务中执行
+     * @note 不检查输入是否合法；连接不可用时调用 conn.discard()；
+     *       提交之后由调用者调用 invalidate()
+    */
+    static RESULT add(SQLConnRAII &conn, const std::string &username, const std::string &password);
+
+    /**
+     * @brief 异步地检查用户名和密码
+    */
+    static void verify(AsyncSQLPool &db, const std::string &username,
+        const std::string &password, Done done);
+
+    /**
+     * @brief 异步地注册新用户
+    */
+    static void add(AsyncSQLPool &db, const std::string &username,
+        const std::string &password, Done done);
+
+    /**
+     * @brief 用户表中的一行改变之后调用，让查询缓存中这个用户的结果失效
+    */
+    static void invalidate(const std::string &username);
+
+    /**
+     * @brief 用户名和密码是否可以写入用户表：非空、不超过最大长度、不含控制字符
+    */
+    static bool is_valid(const std::string &field);
+};
+
+#endif // USERSTORE_H
@@ -0,0 +1,111 @@
+/**
+ * @file shardedlru.hpp
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief hash-sharded table with a lock, an index and an LRU list per shard
+*/
+#ifndef SHARDEDLRU_HPP
+#define SHARDEDLRU_HPP
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 分片上没有附加的数据
+struct NoShardState {};
+
+/**
+ * @brief 按键的哈希分成多个分片的 LRU 表
+ *
+ * 每个分片有自己的锁、从键到链表节点的索引和按访问顺序排列的链表（头部是最近访问的条目），
+ * 查找、移动和删除都是 O(1)。表只维护索引和链表，调用者持有分片的锁操作其中的条目，
+ * 容量、有效期和淘汰的时机由使用者决定
+ * @tparam Key 条目中保存键的成员
+ * @tparam State 附加在每个分片上、同样受分片的锁保护的数据
+*/
+template <typename Entry, std::string Entry::*Key, typename State = NoShardState>
+class ShardedLru {
+public:
+    using iterator = typename std::list<Entry>::iterator;
+
+    struct Shard : State {
+        mutable std::mutex mtx;
+        std::list<Entry> lru;
+        std::unordered_map<std::string, iterator> index;
+
+        // 以下操作的调用者持有 mtx
+
+        iterator find(const std::string &key) {
+            auto it = index.find(key);
+            return it == index.end() ? lru.end() : it->second;
+        }
+
+        bool found(iterator it) const { return it != lru.end(); }
+
+        // 移到链表头部
+        void touch(iterator it) { lru.splice(lru.begin(), lru, it); }
+
+        // 插入到链表头部，调用者保证键不存在
+        iterator push_front(Entry entry) {
+            lru.push_front(std::move(entry));
+            index.emplace(lru.front().*Key, lru.begin());
+            return lru.begin();
+        }
+
+        void erase(iterator it) {
+            index.erase((*it).*Key);
+            lru.erase(it);
+        }
+
+        // 最久没有访问的条目，调用者保证分片不为空
+        iterator oldest() { return std::prev(lru.end()); }
+
+        bool empty() const { return lru.empty(); }
+        size_t size() const { return lru.size(); }
+
+        void clear() {
+            lru.clear();
+            index.clear();
+        }
+    };
+
+    /**
+     * @brief 丢弃所有的条目，重新创建分片；分片数取整为 2 的幂，为 0 时不创建分片
+     * @return 分片数
+    */
+    size_t reset(size_t n) {
+        shards.clear();
+        if (n == 0) return 0;
+        size_t count = 1;
+        while (count < n) count <<= 1;
+        for (size_t i=0; i<count; ++i) {
+            shards.emplace_back(new Shard());
+        }
+        return count;
+    }
+
+    bool empty() const { return shards.empty(); }
+
+    Shard& shard_of(const std::string &key) const {
+        return *shards[std::hash<std::string>()(key) & (shards.size() - 1)];
+    }
+
+    // 逐个访问分片，例如 for (auto &shard : table)
+    typename std::vector<std::unique_ptr<Shard>>::const_iterator begin() const {
+        return shards.begin();
+    }
+    typename std::vector<std::unique_ptr<Shard>>::const_iterator end() const {
+        return shards.end();
+    }
+
+private:
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+#endif // SHARDEDLRU_HPP
@@ -4,27 +4,33 @@
  * @date 2024-05-20
  * @brief source file for utilities
 */
+#include <cstring>
 #include "util.h"
 
 std::string http_gmt() {
-    auto now = std::time(nullptr);
-    auto now_tm = std::gmtime(&now);
-    char gmt[40] = {0};
-    // Date: <day-name>, <day> <month> <year> <hour>:<minute>:<second> GMT
-    char fmt[] = "%a, %d %b %Y %H:%M:%S GMT";
-    std::strftime(gmt, sizeof(gmt)-1, fmt, now_tm);
-    return gmt;
+    return http_gmt(std::time(nullptr));
 }
 
 std::string http_gmt(time_t tm_) {
-    auto now_tm = std::gmtime(&tm_);
     char gmt[40] = {0};
-    // Date: <day-name>, <day> <month> <year> <hour>:<minute>:<second> GMT
-    char fmt[] = "%a, %d %b %Y %H:%M:%S GMT";
-    std::strftime(gmt, sizeof(gmt)-1, fmt, now_tm);
+    http_gmt(gmt, sizeof(gmt), tm_);
     return gmt;
 }
 
+size_t http_gmt(char *buf, size_t size, time_t tm_) {
+    struct tm gmt_tm;
+    // gmtime 返回的是静态存储区，工作线程中需使用可重入的 gmtime_r
+    if (!gmtime_r(&tm_, &gmt_tm)) return 0;
+    // Date: <day-name>, <day> <month> <year> <hour>:<minute>:<second> GMT
+    return std::strftime(buf, size, "%a, %d %b %Y %H:%M:%S GMT", &gmt_tm);
+}
+
+int64_t monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
 int hexch2dec(char ch) {
     if (ch <= 'F' && ch >= 'A') return ch - 'A' + 10;
     if (ch <= 'f' && ch >= 'a') return ch - 'a' + 10;
@@ -51,6 +57,17 @@ std::string str_lower(std::string str) {
     return str;
 }
 
+bool str_case_equal(const char *s1, size_t len1, const char *s2) {
+    if (std::strlen(s2) != len1) return false;
+    for (size_t i=0; i<len1; ++i) {
+        char c1 = s1[i], c2 = s2[i];
+        if (c1 >= 'A' && c1 <= 'Z') c1 += 32;
+        if (c2 >= 'A' && c2 <= 'Z') c2 += 32;
+        if (c1 != c2) return false;
+    }
+    return true;
+}
+
 tm get_current_time() {
     time_t now = time(nullptr);
     tm now_tm;
@@ -7,6 +7,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <cstdint>
 #include <ctime>
 #include <string>
 
@@ -29,6 +30,20 @@ std::string http_gmt();
 */
 std::string http_gmt(time_t tm_);
 
+/**
+ * @brief 将指定时间的 http 格式字符串写入调用者提供的缓冲区（不分配内存）
+ * @param buf 缓冲区，长度至少为 30 个字节
+ * @param size 缓冲区的长度
+ * @param tm_ 指定的时间
+ * @return 写入的字符数（不含结尾的 '\0'），失败时为 0
+*/
+size_t http_gmt(char *buf, size_t size, time_t tm_);
+
+/**
+ * @brief 单调时钟的当前时间(毫秒)，不受系统时间调整的影响，用于计算超时和间隔
+*/
+int64_t monotonic_ms();
+
 /**
  * @brief 将一个十六进制字符转换成十进制数
  * @param ch 十六进制字符 (ABCDEFabcdef)
@@ -50,6 +65,15 @@ char dec2hexch(int num);
 */
 std::string str_lower(std::string str);
 
+/**
+ * @brief 忽略拉丁字母的大小写，比较两个字符串是否相等
+ * @param s1 字符串 1 的起始地址
+ * @param len1 字符串 1 的长度
+ * @param s2 以 '\0' 结尾的字符串 2
+ * @return 是否相等
+*/
+bool str_case_equal(const char *s1, size_t len1, const char *s2);
+
 /**
  * @brief 将十进制数字转换成十六进制字符表示的字符串
  * @param num 十进制数字
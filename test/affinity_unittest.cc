@@ -0,0 +1,40 @@
+/**
+ * @file affinity_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief affinity 模块的测试程序
+*/
+#include <gtest/gtest.h>
+#include "../src/affinity/affinity.h"
+
+// 测试 parse_cpu_list
+TEST(AffinityTest, ParseCpuList) {
+    CpuList cpus;
+    EXPECT_TRUE(parse_cpu_list("0-3,8,10-11", cpus));
+    EXPECT_EQ(cpus, CpuList({0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_TRUE(parse_cpu_list("5, 1-2,2", cpus));
+    EXPECT_EQ(cpus, CpuList({1, 2, 5}));
+    EXPECT_FALSE(parse_cpu_list("", cpus));
+    EXPECT_FALSE(parse_cpu_list("3-1", cpus));
+    EXPECT_FALSE(parse_cpu_list("a", cpus));
+    EXPECT_FALSE(parse_cpu_list("1-", cpus));
+}
+
+// 测试 cpu_list_to_string
+TEST(AffinityTest, CpuListToString) {
+    EXPECT_EQ(cpu_list_to_string({0, 1, 2, 3, 8, 10, 11}), "0-3,8,10-11");
+    EXPECT_EQ(cpu_list_to_string({7}), "7");
+    EXPECT_EQ(cpu_list_to_string({}), "");
+}
+
+// 测试拓扑中每个 CPU 都属于某个节点
+TEST(AffinityTest, Topology) {
+    const auto &topo = NumaTopology::get_instance();
+    ASSERT_GE(topo.node_count(), 1);
+    for (int node=0; node<topo.node_count(); ++node) {
+        for (int cpu : topo.node_cpus(node)) {
+            EXPECT_EQ(topo.node_of_cpu(cpu), node);
+        }
+    }
+    EXPECT_EQ(topo.node_of_cpu(-1), -1);
+}
@@ -0,0 +1,62 @@
+/**
+ * @file arena_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief arena 模块的测试程序
+*/
+#include <gtest/gtest.h>
+#include "../src/arena/arena.h"
+
+// 测试分配的内存满足对齐要求，且 reset 之后复用同一块内存
+TEST(ArenaTest, AllocateAndReset) {
+    Arena arena(256);
+    void *p1 = arena.allocate(10, 1);
+    void *p2 = arena.allocate(8, 8);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p2) % 8, 0);
+    EXPECT_NE(p1, p2);
+    EXPECT_GE(arena.used_bytes(), 18);
+    arena.reset();
+    EXPECT_EQ(arena.used_bytes(), 0);
+    EXPECT_EQ(arena.allocate(10, 1), p1);
+}
+
+// 测试超过块大小的分配，以及 reset 之后不再向系统申请内存
+TEST(ArenaTest, LargeAllocationIsRetained) {
+    Arena arena(128);
+    arena.allocate(100);
+    arena.allocate(1000);
+    arena.allocate(100);
+    auto reserved = arena.reserved_bytes();
+    EXPECT_GE(reserved, 1200);
+    for (int i=0; i<10; ++i) {
+        arena.reset();
+        arena.allocate(100);
+        arena.allocate(1000);
+        arena.allocate(100);
+        EXPECT_EQ(arena.reserved_bytes(), reserved);
+    }
+    arena.release();
+    EXPECT_EQ(arena.reserved_bytes(), 0);
+}
+
+// 测试 ArenaMap 的键和值都分配在同一个 Arena 中
+TEST(ArenaTest, ContainersUseArena) {
+    Arena arena;
+    ArenaMap<ArenaString> headers(&arena);
+    headers["user-agent"].assign("a rather long header value exceeding the SSO buffer");
+    auto &val = headers.find("user-agent")->second;
+    EXPECT_EQ(val.get_allocator().arena(), &arena);
+    EXPECT_EQ(headers.begin()->first.get_allocator().arena(), &arena);
+    EXPECT_GT(arena.used_bytes(), 0);
+
+    release_container(headers);
+    EXPECT_TRUE(headers.empty());
+    EXPECT_EQ(headers.get_allocator().arena(), &arena);
+}
+
+// 测试不绑定 Arena 的分配器退化为全局堆
+TEST(ArenaTest, DefaultAllocatorUsesHeap) {
+    ArenaString str("a string that is too long for the small string buffer");
+    EXPECT_EQ(str.get_allocator().arena(), nullptr);
+    EXPECT_EQ(str.size(), 53);
+}
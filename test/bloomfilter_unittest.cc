@@ -0,0 +1,48 @@
+/**
+ * @file bloomfilter_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief bloomfilter 模块的测试程序
+*/
+#include <string>
+#include <gtest/gtest.h>
+#include "../src/user/bloomfilter.hpp"
+
+// 测试加入的元素总是判断为可能存在
+TEST(BloomFilterTest, NoFalseNegatives) {
+    BloomFilter bloom(1 << 16, 5);
+    for (int i=0; i<2000; ++i) {
+        std::string name = "user" + std::to_string(i);
+        bloom.add(name.data(), name.size());
+    }
+    EXPECT_EQ(bloom.size(), 2000u);
+    for (int i=0; i<2000; ++i) {
+        std::string name = "user" + std::to_string(i);
+        EXPECT_TRUE(bloom.maybe_contains(name.data(), name.size())) << name;
+    }
+}
+
+// 测试误判率接近理论值：m/n = 32，k = 5 时约为 0.2%
+TEST(BloomFilterTest, FalsePositiveRate) {
+    BloomFilter bloom(1 << 16, 5);
+    for (int i=0; i<2000; ++i) {
+        std::string name = "user" + std::to_string(i);
+        bloom.add(name.data(), name.size());
+    }
+    int hits = 0;
+    for (int i=0; i<100000; ++i) {
+        std::string name = "guest" + std::to_string(i);
+        hits += bloom.maybe_contains(name.data(), name.size());
+    }
+    EXPECT_LT(hits, 1000);
+}
+
+// 测试位数取整和空的过滤器
+TEST(BloomFilterTest, Sizing) {
+    BloomFilter bloom(100, 0);
+    EXPECT_EQ(bloom.bits(), 128u);
+    EXPECT_FALSE(bloom.maybe_contains("alice", 5));
+    bloom.add("alice", 5);
+    EXPECT_TRUE(bloom.maybe_contains("alice", 5));
+    EXPECT_FALSE(BloomFilter(0, 3).maybe_contains("", 0));
+}
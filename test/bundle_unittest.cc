@@ -0,0 +1,206 @@
+/**
+ * @file bundle_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief bundle 模块的测试程序
+*/
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "../src/bundle/bundle.h"
+#include "../src/bundle/bundlewriter.h"
+
+static std::string temp_bundle() {
+    char name[] = "/tmp/yawn_bundle_XXXXXX";
+    int fd = mkstemp(name);
+    close(fd);
+    return name;
+}
+
+static std::string text(size_t len, unsigned seed) {
+    std::string s;
+    while (s.size() < len) {
+        s.append("body { margin: 0; padding: ").append(std::to_string(seed)).append("px; }\n");
+    }
+    s.resize(len);
+    return s;
+}
+
+static std::string noise(size_t len) {
+    std::string s(len, '\0');
+    uint64_t x = 88172645463325252ULL;
+    for (auto &c : s) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        c = static_cast<char>(x);
+    }
+    return s;
+}
+
+// 测试写入之后每个路径都能找到，内容、ETag 和压缩的版本都正确
+TEST(BundleTest, RoundTrip) {
+    std::string filename = temp_bundle();
+    BundleWriter::Options opts;
+    opts.brotli = false;
+    BundleWriter writer(opts);
+    const int N = 500;
+    for (int i=0; i<N; ++i) {
+        std::string path = "/css/file" + std::to_string(i) + ".css";
+        ASSERT_TRUE(writer.add(path, text(100 + i * 7, i), "text/css", 1000 + i));
+    }
+    ASSERT_TRUE(writer.add("/images/noise.png", noise(5000), "image/png", 7));
+    ASSERT_TRUE(writer.add("/empty.txt", "", "text/plain", 8));
+    EXPECT_FALSE(writer.add("/empty.txt", "again", "text/plain", 8));
+    EXPECT_FALSE(writer.add("relative.txt", "x", "text/plain", 8));
+    ASSERT_TRUE(writer.write(filename));
+    EXPECT_EQ(writer.get_stats().files, static_cast<size_t>(N + 2));
+
+    StaticBundle bundle;
+    ASSERT_TRUE(bundle.open(filename)) << bundle.error();
+    EXPECT_EQ(bundle.file_count(), static_cast<size_t>(N + 2));
+    for (int i=0; i<N; ++i) {
+        std::string path = "/css/file" + std::to_string(i) + ".css";
+        const StaticBundle::File *f = bundle.find(path.data(), path.size());
+        ASSERT_NE(f, nullptr) << path;
+        std::string content = text(100 + i * 7, i);
+        ASSERT_EQ(f->body_len[BUNDLE_IDENTITY], content.size());
+        EXPECT_EQ(std::memcmp(f->body[BUNDLE_IDENTITY], content.data(), content.size()), 0);
+        EXPECT_EQ(std::string(f->mime, f->mime_len), "text/css");
+        EXPECT_EQ(f->mtime, 1000 + i);
+        // 每个编码的内容都从页边界开始
+        for (int enc=0; enc<BUNDLE_ENCODING_COUNT; ++enc) {
+            if (!f->body[enc]) continue;
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(f->body[enc]) % BUNDLE_ALIGN, 0u);
+        }
+        // 小于 min_size 的文件不压缩
+        EXPECT_EQ(f->has(BUNDLE_GZIP), content.size() >= opts.min_size) << path;
+        EXPECT_FALSE(f->has(BUNDLE_BROTLI));
+        if (f->has(BUNDLE_GZIP)) {
+            std::string etag(f->etag[BUNDLE_IDENTITY], f->etag_len[BUNDLE_IDENTITY]);
+            EXPECT_EQ(std::string(f->etag[BUNDLE_GZIP], f->etag_len[BUNDLE_GZIP]),
+                etag + "-gzip");
+            EXPECT_LT(f->body_len[BUNDLE_GZIP], content.size());
+        }
+    }
+    // 压缩后不会更小的内容只保存原始版本
+    const StaticBundle::File *png = bundle.find("/images/noise.png", 17);
+    ASSERT_NE(png, nullptr);
+    EXPECT_FALSE(png->has_variants());
+    const StaticBundle::File *empty = bundle.find("/empty.txt", 10);
+    ASSERT_NE(empty, nullptr);
+    EXPECT_TRUE(empty->has(BUNDLE_IDENTITY));
+    EXPECT_EQ(empty->body_len[BUNDLE_IDENTITY], 0u);
+
+    EXPECT_EQ(bundle.find("/css/file500.css", 16), nullptr);
+    EXPECT_EQ(bundle.find("/css/file1.cs", 13), nullptr);
+    EXPECT_EQ(bundle.find("", 0), nullptr);
+    unlink(filename.c_str());
+}
+
+// 测试同样的内容得到同样的 ETag，内容不同则 ETag 不同
+TEST(BundleTest, ContentETag) {
+    std::string filename = temp_bundle();
+    BundleWriter writer;
+    ASSERT_TRUE(writer.add("/a.js", text(1000, 1), "text/javascript", 1));
+    ASSERT_TRUE(writer.add("/b.js", text(1000, 1), "text/javascript", 2));
+    ASSERT_TRUE(writer.add("/c.js", text(1000, 2), "text/javascript", 1));
+    ASSERT_TRUE(writer.write(filename));
+    StaticBundle bundle;
+    ASSERT_TRUE(bundle.open(filename)) << bundle.error();
+    auto etag = [&bundle](const char *path) {
+        const StaticBundle::File *f = bundle.find(path, strlen(path));
+        return std::string(f->etag[BUNDLE_IDENTITY], f->etag_len[BUNDLE_IDENTITY]);
+    };
+    EXPECT_EQ(etag("/a.js"), etag("/b.js"));
+    EXPECT_NE(etag("/a.js"), etag("/c.js"));
+    unlink(filename.c_str());
+}
+
+// 测试没有文件的打包
+TEST(BundleTest, Empty) {
+    std::string filename = temp_bundle();
+    BundleWriter writer;
+    ASSERT_TRUE(writer.write(filename));
+    StaticBundle bundle;
+    ASSERT_TRUE(bundle.open(filename)) << bundle.error();
+    EXPECT_EQ(bundle.file_count(), 0u);
+    EXPECT_EQ(bundle.find("/index.html", 11), nullptr);
+    unlink(filename.c_str());
+}
+
+// 测试拒绝不存在、截断和损坏的打包文件
+TEST(BundleTest, RejectBadFiles) {
+    StaticBundle bundle;
+    EXPECT_FALSE(bundle.open("/tmp/yawn_bundle_does_not_exist"));
+    EXPECT_FALSE(bundle.error().empty());
+
+    std::string filename = temp_bundle();
+    BundleWriter writer;
+    ASSERT_TRUE(writer.add("/index.html", text(3000, 3), "text/html", 1));
+    ASSERT_TRUE(writer.add("/style.css", text(3000, 4), "text/css", 1));
+    ASSERT_TRUE(writer.write(filename));
+    std::string data;
+    {
+        std::ifstream in(filename, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto open_modified = [&](const std::string &content) {
+        std::ofstream(filename, std::ios::binary | std::ios::trunc) << content;
+        StaticBundle b;
+        return b.open(filename);
+    };
+    EXPECT_TRUE(open_modified(data));
+    EXPECT_FALSE(open_modified(data.substr(0, data.size() - 1)));
+    std::string bad = data;
+    bad[0] = 'X';
+    EXPECT_FALSE(open_modified(bad));
+    // 槽位表指向错误的文件
+    const BundleHeader *hdr = reinterpret_cast<const BundleHeader*>(data.data());
+    bad = data;
+    uint32_t *slots = reinterpret_cast<uint32_t*>(&bad[hdr->slots_off]);
+    for (uint32_t i=0; i<hdr->slot_count; ++i) {
+        if (slots[i] != BUNDLE_EMPTY_SLOT) slots[i] ^= 1;
+    }
+    EXPECT_FALSE(open_modified(bad));
+    // 文件内容超出打包文件
+    bad = data;
+    BundleEntry *entries = reinterpret_cast<BundleEntry*>(&bad[hdr->entries_off]);
+    entries[1].body[BUNDLE_IDENTITY].len = data.size();
+    EXPECT_FALSE(open_modified(bad));
+    unlink(filename.c_str());
+}
+
+// 测试按 Accept-Encoding 选择编码
+TEST(BundleTest, Negotiate) {
+    StaticBundle::File f;
+    std::memset(&f, 0, sizeof(f));
+    const char *body = "x";
+    f.body[BUNDLE_IDENTITY] = f.body[BUNDLE_GZIP] = f.body[BUNDLE_BROTLI] = body;
+    auto pick = [&f](const char *value) {
+        return StaticBundle::negotiate(f, value, strlen(value));
+    };
+    EXPECT_EQ(pick(""), BUNDLE_IDENTITY);
+    EXPECT_EQ(pick("gzip"), BUNDLE_GZIP);
+    EXPECT_EQ(pick("gzip, deflate, br"), BUNDLE_BROTLI);
+    EXPECT_EQ(pick("GZIP , BR"), BUNDLE_BROTLI);
+    EXPECT_EQ(pick("br;q=0, gzip;q=0.8"), BUNDLE_GZIP);
+    EXPECT_EQ(pick("br; q=0.000, gzip; q=0"), BUNDLE_IDENTITY);
+    EXPECT_EQ(pick("x-gzip"), BUNDLE_GZIP);
+    EXPECT_EQ(pick("*"), BUNDLE_BROTLI);
+    EXPECT_EQ(pick("*, br;q=0"), BUNDLE_GZIP);
+    EXPECT_EQ(pick("deflate, identity"), BUNDLE_IDENTITY);
+    EXPECT_EQ(pick("gzipx, brotli"), BUNDLE_IDENTITY);
+
+    // 只选择文件已有的编码
+    f.body[BUNDLE_BROTLI] = nullptr;
+    EXPECT_EQ(pick("br, gzip"), BUNDLE_GZIP);
+    f.body[BUNDLE_GZIP] = nullptr;
+    EXPECT_EQ(pick("br, gzip"), BUNDLE_IDENTITY);
+    EXPECT_EQ(StaticBundle::encoding_name(BUNDLE_GZIP), std::string("gzip"));
+    EXPECT_EQ(StaticBundle::encoding_name(BUNDLE_IDENTITY), nullptr);
+}
@@ -6,6 +6,7 @@
 */
 #include <gtest/gtest.h>
 #include "../src/config/config.h"
+#include "../src/config/rcuptr.hpp"
 
 
 class ConfigTest: public testing::Test {
@@ -57,4 +58,41 @@ TEST_F(ConfigTest, UpdateItem) {
     EXPECT_EQ(cfg.get_string("rick"), "morty");
     cfg.update("rick", "mooooorty");
     EXPECT_EQ(cfg.get_string("rick"), "mooooorty");
-}
\ No newline at end of file
+}
+// 测试比较两份配置
+TEST_F(ConfigTest, Diff) {
+    EXPECT_TRUE(cfg.loaded());
+    EXPECT_EQ(cfg.get_filename(), "./test_server.cfg");
+    Config other("./test_server.cfg");
+    EXPECT_TRUE(cfg.diff(other).empty());
+    other.update("timeout", "1000");
+    other.add("rick", "morty");
+    cfg.add("summer", "smith");
+    std::vector<std::string> expected = {"rick", "summer", "timeout"};
+    EXPECT_EQ(cfg.diff(other), expected);
+    EXPECT_EQ(other.diff(cfg), expected);
+
+    Config missing("./no_such_server.cfg");
+    EXPECT_FALSE(missing.loaded());
+}
+
+// 测试旧快照在读者退出之后才被释放
+TEST(RcuPtrTest, ReclaimAfterReaders) {
+    RcuPtr<int> ptr(std::unique_ptr<int>(new int(1)));
+    const int *first = nullptr;
+    {
+        RcuReadGuard guard;
+        first = ptr.get();
+        ptr.publish(std::unique_ptr<int>(new int(2)));
+        EXPECT_EQ(*ptr, 2);
+        // 读者仍然持有第一个版本，推进多少次都不能释放
+        for (int i = 0; i < 4; ++i) {
+            EXPECT_TRUE(ptr.reclaim());
+        }
+        EXPECT_EQ(*first, 1);
+        EXPECT_EQ(ptr.version_count(), 2);
+    }
+    while (ptr.reclaim()) {}
+    EXPECT_EQ(ptr.version_count(), 1);
+    EXPECT_FALSE(ptr.reclaim());
+}
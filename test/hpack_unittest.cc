@@ -0,0 +1,227 @@
+/**
+ * @file hpack_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief hpack 模块的测试程序，测试数据来自 RFC 7541 附录 C
+*/
+#include <string>
+#include <gtest/gtest.h>
+#include "../src/http/hpack.h"
+
+// 十六进制字符串转换成字节串，忽略空格
+static std::string from_hex(const char *hex) {
+    std::string out;
+    int hi = -1;
+    for (const char *p = hex; *p; ++p) {
+        if (*p == ' ') continue;
+        int v = (*p >= 'a') ? *p - 'a' + 10 : *p - '0';
+        if (hi < 0) {
+            hi = v;
+        } else {
+            out.push_back(static_cast<char>(hi << 4 | v));
+            hi = -1;
+        }
+    }
+    return out;
+}
+
+static bool decode(HpackDecoder &decoder, const std::string &block, HpackHeaderList &headers) {
+    headers.clear();
+    return decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), block.size(),
+        headers, 16384);
+}
+
+// 测试整数的编码与解码 (C.1)
+TEST(HpackTest, Integer) {
+    std::string out;
+    hpack_encode_integer(out, 10, 5, 0);
+    EXPECT_EQ(out, from_hex("0a"));
+    out.clear();
+    hpack_encode_integer(out, 1337, 5, 0);
+    EXPECT_EQ(out, from_hex("1f9a0a"));
+    out.clear();
+    hpack_encode_integer(out, 42, 8, 0);
+    EXPECT_EQ(out, from_hex("2a"));
+
+    uint64_t value = 0;
+    const std::string in = from_hex("1f9a0a");
+    const uint8_t *p = reinterpret_cast<const uint8_t*>(in.data());
+    EXPECT_EQ(hpack_decode_integer(p, p + in.size(), 5, value), 3u);
+    EXPECT_EQ(value, 1337u);
+    // 数据不完整
+    EXPECT_EQ(hpack_decode_integer(p, p + 2, 5, value), 0u);
+    // 溢出
+    const std::string big = from_hex("1fffffffffffff7f");
+    p = reinterpret_cast<const uint8_t*>(big.data());
+    EXPECT_EQ(hpack_decode_integer(p, p + big.size(), 5, value), 0u);
+}
+
+// 测试 Huffman 编码与解码
+TEST(HpackTest, Huffman) {
+    std::string out;
+    huffman_encode(out, "www.example.com", 15);
+    EXPECT_EQ(out, from_hex("f1e3 c2e5 f23a 6ba0 ab90 f4ff"));
+    EXPECT_EQ(huffman_encoded_len("www.example.com", 15), out.size());
+
+    std::string text;
+    EXPECT_TRUE(huffman_decode(text, reinterpret_cast<const uint8_t*>(out.data()), out.size()));
+    EXPECT_EQ(text, "www.example.com");
+
+    // 所有的字节都能还原
+    std::string all;
+    for (int c = 0; c < 256; ++c) all.push_back(static_cast<char>(c));
+    out.clear();
+    text.clear();
+    huffman_encode(out, all.data(), all.size());
+    EXPECT_TRUE(huffman_decode(text, reinterpret_cast<const uint8_t*>(out.data()), out.size()));
+    EXPECT_EQ(text, all);
+
+    // 填充不是全 1
+    const std::string bad = from_hex("f1e3 c2e5 f23a 6ba0 ab90 f4fe");
+    text.clear();
+    EXPECT_FALSE(huffman_decode(text, reinterpret_cast<const uint8_t*>(bad.data()), bad.size()));
+}
+
+// 测试不使用 Huffman 编码的请求 (C.3)
+TEST(HpackTest, DecodeRequestsWithoutHuffman) {
+    HpackDecoder decoder;
+    HpackHeaderList headers;
+    ASSERT_TRUE(decode(decoder, from_hex(
+        "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d"), headers));
+    ASSERT_EQ(headers.size(), 4u);
+    EXPECT_EQ(headers[0].first, ":method");
+    EXPECT_EQ(headers[0].second, "GET");
+    EXPECT_EQ(headers[1].second, "http");
+    EXPECT_EQ(headers[2].second, "/");
+    EXPECT_EQ(headers[3].first, ":authority");
+    EXPECT_EQ(headers[3].second, "www.example.com");
+
+    ASSERT_TRUE(decode(decoder, from_hex("8286 84be 5808 6e6f 2d63 6163 6865"), headers));
+    ASSERT_EQ(headers.size(), 5u);
+    EXPECT_EQ(headers[3].second, "www.example.com");
+    EXPECT_EQ(headers[4].first, "cache-control");
+    EXPECT_EQ(headers[4].second, "no-cache");
+
+    ASSERT_TRUE(decode(decoder, from_hex(
+        "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65"), headers));
+    ASSERT_EQ(headers.size(), 5u);
+    EXPECT_EQ(headers[1].second, "https");
+    EXPECT_EQ(headers[2].second, "/index.html");
+    EXPECT_EQ(headers[3].second, "www.example.com");
+    EXPECT_EQ(headers[4].first, "custom-key");
+    EXPECT_EQ(headers[4].second, "custom-value");
+}
+
+// 测试使用 Huffman 编码的请求 (C.4)
+TEST(HpackTest, DecodeRequestsWithHuffman) {
+    HpackDecoder decoder;
+    HpackHeaderList headers;
+    ASSERT_TRUE(decode(decoder, from_hex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"), headers));
+    ASSERT_EQ(headers.size(), 4u);
+    EXPECT_EQ(headers[3].second, "www.example.com");
+
+    ASSERT_TRUE(decode(decoder, from_hex("8286 84be 5886 a8eb 1064 9cbf"), headers));
+    ASSERT_EQ(headers.size(), 5u);
+    EXPECT_EQ(headers[4].second, "no-cache");
+
+    ASSERT_TRUE(decode(decoder, from_hex(
+        "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf"), headers));
+    ASSERT_EQ(headers.size(), 5u);
+    EXPECT_EQ(headers[4].first, "custom-key");
+    EXPECT_EQ(headers[4].second, "custom-value");
+}
+
+// 测试非法的头部块
+TEST(HpackTest, DecodeErrors) {
+    HpackHeaderList headers;
+    {
+        // 索引超出范围
+        HpackDecoder decoder;
+        EXPECT_FALSE(decode(decoder, from_hex("be"), headers));
+    }
+    {
+        // 索引 0
+        HpackDecoder decoder;
+        EXPECT_FALSE(decode(decoder, from_hex("80"), headers));
+    }
+    {
+        // 表大小更新超过 SETTINGS 声明的上限
+        HpackDecoder decoder;
+        EXPECT_FALSE(decode(decoder, from_hex("3fe21f"), headers));
+    }
+    {
+        // 表大小更新出现在字段之后
+        HpackDecoder decoder;
+        EXPECT_FALSE(decode(decoder, from_hex("8220"), headers));
+    }
+    {
+        // 字符串被截断
+        HpackDecoder decoder;
+        EXPECT_FALSE(decode(decoder, from_hex("4108 6162"), headers));
+    }
+    {
+        // 头部列表过大
+        HpackDecoder decoder;
+        const std::string block = from_hex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff");
+        EXPECT_FALSE(decoder.decode(reinterpret_cast<const uint8_t*>(block.data()),
+            block.size(), headers, 64));
+    }
+}
+
+// 测试编码器的输出与 RFC 的示例一致，并且可以被解码器还原
+TEST(HpackTest, EncodeRequests) {
+    HpackEncoder encoder;
+    std::string out;
+    encoder.begin(out);
+    encoder.encode(out, ":method", "GET", true);
+    encoder.encode(out, ":scheme", "http", true);
+    encoder.encode(out, ":path", "/", true);
+    encoder.encode(out, ":authority", "www.example.com", true);
+    EXPECT_EQ(out, from_hex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"));
+
+    out.clear();
+    encoder.begin(out);
+    encoder.encode(out, ":method", "GET", true);
+    encoder.encode(out, ":scheme", "http", true);
+    encoder.encode(out, ":path", "/", true);
+    encoder.encode(out, ":authority", "www.example.com", true);
+    encoder.encode(out, "cache-control", "no-cache", true);
+    EXPECT_EQ(out, from_hex("8286 84be 5886 a8eb 1064 9cbf"));
+
+    HpackEncoder encoder2;
+    HpackDecoder decoder;
+    HpackHeaderList headers;
+    for (int i = 0; i < 3; ++i) {
+        out.clear();
+        encoder2.begin(out);
+        encoder2.encode(out, ":status", "200", true);
+        encoder2.encode(out, "content-length", std::to_string(1000 + i), false);
+        encoder2.encode(out, "x-custom", std::string(100, 'a' + i), true);
+        ASSERT_TRUE(decode(decoder, out, headers));
+        ASSERT_EQ(headers.size(), 3u);
+        EXPECT_EQ(headers[1].second, std::to_string(1000 + i));
+        EXPECT_EQ(headers[2].second, std::string(100, 'a' + i));
+    }
+
+    // 缩小动态表后在下一个头部块的开头通知对端
+    encoder2.set_max_table_size(0);
+    out.clear();
+    encoder2.begin(out);
+    encoder2.encode(out, "x-custom", "abc", true);
+    EXPECT_EQ(static_cast<uint8_t>(out[0]), 0x20);
+    ASSERT_TRUE(decode(decoder, out, headers));
+    EXPECT_EQ(headers[0].second, "abc");
+}
+
+// 测试动态表的淘汰
+TEST(HpackTest, TableEviction) {
+    HpackTable table(100);
+    table.add("a", std::string(30, 'x'));   // 63
+    EXPECT_EQ(table.size(), 63u);
+    table.add("b", std::string(10, 'y'));   // 43，淘汰第一个
+    EXPECT_EQ(table.count(), 1u);
+    EXPECT_EQ(table.get(0).first, "b");
+    table.add("c", std::string(200, 'z'));  // 比整个表还大
+    EXPECT_EQ(table.count(), 0u);
+    EXPECT_EQ(table.size(), 0u);
+}
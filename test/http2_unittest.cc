@@ -0,0 +1,170 @@
+/**
+ * @file http2_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief http2 模块的测试程序
+*/
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../src/http/http2.h"
+
+struct Frame {
+    uint8_t type;
+    uint8_t flags;
+    uint32_t id;
+    std::string payload;
+};
+
+// 取出缓冲区中所有完整的帧
+static std::vector<Frame> take_frames(Buffer &buf) {
+    std::vector<Frame> frames;
+    while (buf.readable_bytes() >= 9) {
+        const uint8_t *p = reinterpret_cast<const uint8_t*>(buf.peek());
+        size_t len = (p[0] << 16) | (p[1] << 8) | p[2];
+        if (buf.readable_bytes() < 9 + len) break;
+        Frame f;
+        f.type = p[3];
+        f.flags = p[4];
+        f.id = ((p[5] & 0x7f) << 24) | (p[6] << 16) | (p[7] << 8) | p[8];
+        f.payload.assign(buf.peek() + 9, len);
+        frames.push_back(f);
+        buf.retrieve(9 + len);
+    }
+    return frames;
+}
+
+static void put_frame(Buffer &buf, uint8_t type, uint8_t flags, uint32_t id,
+    const std::string &payload) {
+    char h[9] = {
+        static_cast<char>(payload.size() >> 16), static_cast<char>(payload.size() >> 8),
+        static_cast<char>(payload.size()), static_cast<char>(type), static_cast<char>(flags),
+        static_cast<char>(id >> 24), static_cast<char>(id >> 16), static_cast<char>(id >> 8),
+        static_cast<char>(id)
+    };
+    buf.append(h, sizeof(h));
+    buf.append(payload);
+}
+
+// 返回固定响应体的处理者
+struct FixedHandler : public Http2Handler {
+    void on_request(Http2Stream &stream) override {
+        paths.push_back(stream.header(":path"));
+        stream.status = 200;
+        stream.resp_headers.emplace_back("content-length", std::to_string(body.size()));
+        stream.body = body.data();
+        stream.body_len = body.size();
+    }
+    std::string body;
+    std::vector<std::string> paths;
+};
+
+static std::string request_block(HpackEncoder &encoder, const char *path) {
+    std::string block;
+    encoder.begin(block);
+    encoder.encode(block, ":method", "GET", true);
+    encoder.encode(block, ":scheme", "http", true);
+    encoder.encode(block, ":path", path, true);
+    encoder.encode(block, ":authority", "localhost", true);
+    return block;
+}
+
+// 测试一个完整的请求和响应
+TEST(Http2SessionTest, SimpleRequest) {
+    FixedHandler handler;
+    handler.body = "hello, world";
+    Http2Session session(&handler);
+    Buffer in, out;
+    session.start(out);
+
+    HpackEncoder encoder;
+    in.append(Http2Session::PREFACE, Http2Session::PREFACE_LEN);
+    put_frame(in, 0x4, 0, 0, "");
+    put_frame(in, 0x1, 0x5, 1, request_block(encoder, "/index.html"));
+    ASSERT_TRUE(session.receive(in, out));
+    EXPECT_EQ(in.readable_bytes(), 0u);
+    session.send(out, 65536);
+
+    auto frames = take_frames(out);
+    ASSERT_EQ(frames.size(), 4u);
+    EXPECT_EQ(frames[0].type, 0x4);     // SETTINGS
+    EXPECT_EQ(frames[1].type, 0x4);     // SETTINGS ACK
+    EXPECT_EQ(frames[1].flags, 0x1);
+    EXPECT_EQ(frames[2].type, 0x1);     // HEADERS
+    EXPECT_EQ(frames[2].id, 1u);
+    EXPECT_EQ(frames[3].type, 0x0);     // DATA
+    EXPECT_EQ(frames[3].flags, 0x1);    // END_STREAM
+    EXPECT_EQ(frames[3].payload, handler.body);
+
+    HpackDecoder decoder;
+    HpackHeaderList headers;
+    ASSERT_TRUE(decoder.decode(reinterpret_cast<const uint8_t*>(frames[2].payload.data()),
+        frames[2].payload.size(), headers, 16384));
+    ASSERT_FALSE(headers.empty());
+    EXPECT_EQ(headers[0].first, ":status");
+    EXPECT_EQ(headers[0].second, "200");
+    EXPECT_FALSE(session.has_streams());
+    ASSERT_EQ(handler.paths.size(), 1u);
+    EXPECT_EQ(handler.paths[0], "/index.html");
+}
+
+// 测试发送窗口耗尽后等待 WINDOW_UPDATE，多个流轮流发送
+TEST(Http2SessionTest, FlowControl) {
+    FixedHandler handler;
+    handler.body.assign(100, 'x');
+    Http2Session session(&handler);
+    Buffer in, out;
+    session.start(out);
+
+    HpackEncoder encoder;
+    in.append(Http2Session::PREFACE, Http2Session::PREFACE_LEN);
+    // SETTINGS_INITIAL_WINDOW_SIZE = 30
+    put_frame(in, 0x4, 0, 0, std::string("\x00\x04\x00\x00\x00\x1e", 6));
+    put_frame(in, 0x1, 0x5, 1, request_block(encoder, "/a"));
+    put_frame(in, 0x1, 0x5, 3, request_block(encoder, "/b"));
+    ASSERT_TRUE(session.receive(in, out));
+    session.send(out, 65536);
+
+    size_t data[4] = {0, 0, 0, 0};
+    for (const auto &f : take_frames(out)) {
+        if (f.type == 0x0) data[f.id] += f.payload.size();
+    }
+    EXPECT_EQ(data[1], 30u);
+    EXPECT_EQ(data[3], 30u);
+
+    // 只给流 3 增加窗口
+    put_frame(in, 0x8, 0, 3, std::string("\x00\x00\x00\x46", 4));
+    ASSERT_TRUE(session.receive(in, out));
+    session.send(out, 65536);
+    for (const auto &f : take_frames(out)) {
+        if (f.type == 0x0) data[f.id] += f.payload.size();
+    }
+    EXPECT_EQ(data[1], 30u);
+    EXPECT_EQ(data[3], 100u);
+    EXPECT_TRUE(session.has_streams());
+
+    put_frame(in, 0x8, 0, 1, std::string("\x00\x00\x00\x46", 4));
+    ASSERT_TRUE(session.receive(in, out));
+    session.send(out, 65536);
+    for (const auto &f : take_frames(out)) {
+        if (f.type == 0x0) data[f.id] += f.payload.size();
+    }
+    EXPECT_EQ(data[1], 100u);
+    EXPECT_FALSE(session.has_streams());
+}
+
+// 测试连接错误：第一个帧不是 SETTINGS
+TEST(Http2SessionTest, ProtocolError) {
+    FixedHandler handler;
+    Http2Session session(&handler);
+    Buffer in, out;
+    session.start(out);
+    in.append(Http2Session::PREFACE, Http2Session::PREFACE_LEN);
+    put_frame(in, 0x6, 0, 0, std::string(8, '\0'));
+    EXPECT_FALSE(session.receive(in, out));
+    EXPECT_EQ(session.get_error(), static_cast<uint32_t>(Http2Session::PROTOCOL_ERROR));
+    EXPECT_TRUE(session.is_finished());
+    auto frames = take_frames(out);
+    ASSERT_FALSE(frames.empty());
+    EXPECT_EQ(frames.back().type, 0x7);  // GOAWAY
+}
@@ -0,0 +1,80 @@
+/**
+ * @file httpbody_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief httpbody 模块的测试程序
+*/
+#include <unistd.h>
+#include <cstring>
+#include <string>
+#include <gtest/gtest.h>
+#include "../src/http/httpbody.h"
+
+struct StringSink : public BodySink {
+    bool write(const char *data, size_t len) override {
+        str.append(data, len);
+        return true;
+    }
+    std::string str;
+};
+
+// 测试完整的 chunked 请求体（带块扩展和尾部字段），以及之后属于下一个请求的数据
+TEST(ChunkedDecoderTest, DecodeWhole) {
+    const std::string body = "4;name=val\r\nWiki\r\n5\r\npedia\r\nE\r\n in\r\n\r\nchunks.\r\n"
+        "0\r\nExpires: never\r\n\r\nGET /";
+    ChunkedDecoder dec;
+    StringSink sink;
+    size_t consumed = 0;
+    EXPECT_EQ(dec.feed(body.data(), body.size(), consumed, sink), ChunkedDecoder::DONE);
+    EXPECT_EQ(sink.str, "Wikipedia in\r\n\r\nchunks.");
+    EXPECT_EQ(body.substr(consumed), "GET /");
+}
+
+// 测试数据被逐字节截断时解码结果不变
+TEST(ChunkedDecoderTest, DecodeByteByByte) {
+    const std::string body = "a\r\n0123456789\r\n1F\r\n0123456789012345678901234567890\r\n0\r\n\r\n";
+    ChunkedDecoder dec;
+    StringSink sink;
+    ChunkedDecoder::RESULT res = ChunkedDecoder::NEED_MORE;
+    for (size_t i=0; i<body.size(); ++i) {
+        size_t consumed = 0;
+        res = dec.feed(body.data() + i, 1, consumed, sink);
+        ASSERT_EQ(consumed, 1);
+        if (i + 1 < body.size()) {
+            ASSERT_EQ(res, ChunkedDecoder::NEED_MORE);
+        }
+    }
+    EXPECT_EQ(res, ChunkedDecoder::DONE);
+    EXPECT_EQ(sink.str, "01234567890123456789012345678901234567890");
+}
+
+// 测试格式错误的 chunked 请求体
+TEST(ChunkedDecoderTest, Malformed) {
+    const char *cases[] = {
+        "x\r\n",                   // 块大小不是十六进制数
+        "3\r\nabcX\r\n",           // 块数据之后缺少 CRLF
+        "3\nabc\r\n",              // 块大小之后缺少 CR
+        "1000000000000000\r\n",    // 块大小溢出
+    };
+    for (const char *c : cases) {
+        ChunkedDecoder dec;
+        StringSink sink;
+        size_t consumed = 0;
+        EXPECT_EQ(dec.feed(c, strlen(c), consumed, sink), ChunkedDecoder::ERROR) << c;
+    }
+}
+
+// 测试临时文件的写入和读回
+TEST(FileSpoolTest, WriteAndReadBack) {
+    FileSpool spool;
+    ASSERT_TRUE(spool.open("/tmp"));
+    ASSERT_TRUE(spool.write("hello, ", 7));
+    ASSERT_TRUE(spool.write("world", 5));
+    EXPECT_EQ(spool.size(), 12);
+    ASSERT_TRUE(spool.finish());
+    char buf[32] = {0};
+    EXPECT_EQ(read(spool.get_fd(), buf, sizeof(buf)), 12);
+    EXPECT_STREQ(buf, "hello, world");
+    spool.close();
+    EXPECT_EQ(spool.get_fd(), -1);
+}
@@ -0,0 +1,108 @@
+/**
+ * @file multipart_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief multipart 模块的测试程序
+*/
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../src/http/multipart.h"
+
+// 测试 BMH 查找的结果与 std::string::find 一致
+TEST(BMHSearcherTest, Find) {
+    BMHSearcher bmh;
+    bmh.set_pattern("\r\n--abc");
+    const std::string texts[] = {
+        "", "\r\n--ab", "\r\n--abc", "xx\r\n--abc\r\n--abc", "\r\n-\r\n--abx\r\n--abc", "no match here"
+    };
+    for (const auto &text : texts) {
+        size_t expect = text.find(bmh.pattern());
+        if (expect == std::string::npos) expect = text.size();
+        EXPECT_EQ(bmh.find(text.data(), text.size()), expect) << text;
+    }
+}
+
+// 测试从 Content-Type 中提取 boundary
+TEST(MultipartParserTest, GetBoundary) {
+    std::string boundary;
+    EXPECT_TRUE(MultipartParser::get_boundary(
+        "multipart/form-data; boundary=----WebKitFormBoundary7MA4", boundary));
+    EXPECT_EQ(boundary, "----WebKitFormBoundary7MA4");
+    EXPECT_TRUE(MultipartParser::get_boundary(
+        "Multipart/Form-Data; charset=utf-8; boundary=\"a b;c\"", boundary));
+    EXPECT_EQ(boundary, "a b;c");
+    EXPECT_FALSE(MultipartParser::get_boundary("multipart/form-data", boundary));
+    EXPECT_FALSE(MultipartParser::get_boundary("text/plain; boundary=x", boundary));
+}
+
+struct PartCollector : public MultipartHandler {
+    bool on_part_begin(const MultipartPart &part) override {
+        parts.push_back(part);
+        data.emplace_back();
+        return true;
+    }
+    bool on_part_data(const char *p, size_t len) override {
+        data.back().append(p, len);
+        return true;
+    }
+    bool on_part_end() override {
+        ++ended;
+        return true;
+    }
+    std::vector<MultipartPart> parts;
+    std::vector<std::string> data;
+    int ended = 0;
+};
+
+static const char FORM_BODY[] =
+    "preamble\r\n"
+    "--XyZ\r\n"
+    "Content-Disposition: form-data; name=\"title\"\r\n"
+    "\r\n"
+    "hello\r\n--XyW not a boundary\r\n"
+    "--XyZ\r\n"
+    "Content-Disposition: form-data; name=\"pic\"; filename=\"a.png\"\r\n"
+    "Content-Type: image/png\r\n"
+    "\r\n"
+    "\x89PNG\r\n\r\n-\r\n--Xy\r\n"
+    "--XyZ--\r\n"
+    "epilogue";
+
+// 测试以各种大小切分请求体时解析结果都相同
+TEST(MultipartParserTest, ParseInChunks) {
+    const std::string body(FORM_BODY, sizeof(FORM_BODY) - 1);
+    for (size_t chunk=1; chunk<=body.size(); ++chunk) {
+        PartCollector collector;
+        MultipartParser parser;
+        parser.reset("XyZ", &collector);
+        for (size_t i=0; i<body.size(); i+=chunk) {
+            ASSERT_TRUE(parser.write(body.data() + i, std::min(chunk, body.size() - i)))
+                << "chunk size " << chunk;
+        }
+        ASSERT_TRUE(parser.finish()) << "chunk size " << chunk;
+        ASSERT_EQ(collector.parts.size(), 2);
+        EXPECT_EQ(collector.ended, 2);
+        EXPECT_EQ(collector.parts[0].name, "title");
+        EXPECT_TRUE(collector.parts[0].filename.empty());
+        EXPECT_EQ(collector.data[0], "hello\r\n--XyW not a boundary");
+        EXPECT_EQ(collector.parts[1].name, "pic");
+        EXPECT_EQ(collector.parts[1].filename, "a.png");
+        EXPECT_EQ(collector.parts[1].content_type, "image/png");
+        EXPECT_EQ(collector.data[1], "\x89PNG\r\n\r\n-\r\n--Xy");
+    }
+}
+
+// 测试缺少结尾分隔符或部分头部格式错误
+TEST(MultipartParserTest, Malformed) {
+    PartCollector collector;
+    MultipartParser parser;
+    parser.reset("b", &collector);
+    const std::string truncated = "--b\r\nContent-Disposition: form-data; name=\"x\"\r\n\r\nabc";
+    EXPECT_TRUE(parser.write(truncated.data(), truncated.size()));
+    EXPECT_FALSE(parser.finish());
+
+    parser.reset("b", &collector);
+    const std::string bad_header = "--b\r\nno colon here\r\n\r\nabc\r\n--b--";
+    EXPECT_FALSE(parser.write(bad_header.data(), bad_header.size()));
+}
@@ -0,0 +1,170 @@
+/**
+ * @file querycache_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief querycache 模块的测试程序
+*/
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../src/pool/querycache.h"
+
+// 每个测试从一个清空了的缓存开始（1 MB，结果一分钟内有效，4 个分片），
+// 需要其他参数的测试修改 opts 之后调用 restart()
+class QueryCacheTest : public testing::Test {
+protected:
+    void SetUp() override {
+        opts.enable = true;
+        opts.max_bytes = 1 << 20;
+        opts.ttl = 60000;
+        opts.shards = 4;
+        restart();
+    }
+
+    void restart() { cache->init(opts); }
+
+    QueryCache::Options opts;
+    QueryCache *cache = QueryCache::get_instance();
+};
+
+// 返回一行一列的 value，并记录调用次数
+static QueryCache::Loader counting_loader(std::atomic<int> &calls, const std::string &value) {
+    return [&calls, value](QueryCache::Rows &rows) {
+        ++calls;
+        rows.push_back({value});
+        return true;
+    };
+}
+
+// 测试有效期内的命中和过期后的重新查询
+TEST_F(QueryCacheTest, HitAndExpire) {
+    opts.ttl = 100;
+    restart();
+    std::atomic<int> calls{0};
+    auto r1 = cache->get(1, {"alice"}, 0, counting_loader(calls, "x"));
+    auto r2 = cache->get(1, {"alice"}, 0, counting_loader(calls, "y"));
+    ASSERT_TRUE(r1 && r2);
+    EXPECT_EQ((*r2)[0][0], "x");
+    EXPECT_EQ(calls, 1);
+    // 语句编号和参数都是键的一部分
+    cache->get(2, {"alice"}, 0, counting_loader(calls, "z"));
+    cache->get(1, {"ali", "ce"}, 0, counting_loader(calls, "z"));
+    EXPECT_EQ(calls, 3);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    auto r3 = cache->get(1, {"alice"}, 0, counting_loader(calls, "y"));
+    EXPECT_EQ((*r3)[0][0], "y");
+    EXPECT_EQ(calls, 4);
+    auto st = cache->get_stats();
+    EXPECT_EQ(st.hits, 1u);
+    EXPECT_EQ(st.misses, 4u);
+}
+
+// 测试失败的查询不缓存
+TEST_F(QueryCacheTest, FailureNotCached) {
+    int calls = 0;
+    auto fail = [&calls](QueryCache::Rows&) { ++calls; return false; };
+    EXPECT_FALSE(cache->get(1, {"bob"}, 0, fail));
+    EXPECT_FALSE(cache->get(1, {"bob"}, 0, fail));
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(cache->get_stats().entries, 0u);
+}
+
+// 测试可以不缓存没有行的结果
+TEST_F(QueryCacheTest, EmptyNotCached) {
+    int calls = 0;
+    auto empty = [&calls](QueryCache::Rows&) { ++calls; return true; };
+    auto r1 = cache->get(1, {"carol"}, 0, empty, false);
+    ASSERT_TRUE(r1);
+    EXPECT_TRUE(r1->empty());
+    EXPECT_TRUE(cache->get(1, {"carol"}, 0, empty, false));
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(cache->get_stats().entries, 0u);
+    // 有行的结果照常缓存
+    std::atomic<int> loads{0};
+    cache->get(1, {"carol"}, 0, counting_loader(loads, "x"), false);
+    cache->get(1, {"carol"}, 0, counting_loader(loads, "y"), false);
+    EXPECT_EQ(loads, 1);
+    // 默认缓存没有行的结果
+    cache->get(1, {"dave"}, 0, empty);
+    cache->get(1, {"dave"}, 0, empty);
+    EXPECT_EQ(calls, 3);
+}
+
+// 测试同一个键同时未命中时只执行一次查询
+TEST_F(QueryCacheTest, SingleFlight) {
+    std::atomic<int> calls{0};
+    auto slow = [&calls](QueryCache::Rows &rows) {
+        ++calls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        rows.push_back({"v"});
+        return true;
+    };
+    std::atomic<int> ok{0};
+    std::vector<std::thread> threads;
+    for (int i=0; i<8; ++i) {
+        threads.emplace_back([&] {
+            auto r = cache->get(7, {"carol"}, 0, slow);
+            if (r && (*r)[0][0] == "v") ++ok;
+        });
+    }
+    for (auto &t : threads) t.join();
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(ok, 8);
+    EXPECT_EQ(cache->get_stats().coalesced, 7u);
+}
+
+// 测试按键和按语句失效，以及执行期间失效的结果不被缓存
+TEST_F(QueryCacheTest, Invalidate) {
+    std::atomic<int> calls{0};
+    cache->get(1, {"a"}, 0, counting_loader(calls, "1"));
+    cache->get(1, {"b"}, 0, counting_loader(calls, "1"));
+    cache->get(2, {"a"}, 0, counting_loader(calls, "1"));
+    cache->invalidate(1, {"a"});
+    cache->get(1, {"a"}, 0, counting_loader(calls, "2"));
+    cache->get(1, {"b"}, 0, counting_loader(calls, "2"));
+    EXPECT_EQ(calls, 4);
+
+    cache->invalidate(1);
+    EXPECT_EQ(cache->get_stats().entries, 1u);
+    cache->get(2, {"a"}, 0, counting_loader(calls, "2"));
+    EXPECT_EQ(calls, 4);
+
+    // 查询执行期间被失效，读到的可能是旧数据，不缓存
+    auto racing = [this, &calls](QueryCache::Rows &rows) {
+        ++calls;
+        cache->invalidate(3, {"d"});
+        rows.push_back({"old"});
+        return true;
+    };
+    EXPECT_TRUE(cache->get(3, {"d"}, 0, racing));
+    cache->get(3, {"d"}, 0, counting_loader(calls, "new"));
+    EXPECT_EQ(calls, 6);
+}
+
+// 测试超出内存预算时淘汰最久没有访问的结果
+TEST_F(QueryCacheTest, Budget) {
+    opts.max_bytes = 4096;
+    opts.shards = 1;
+    restart();
+    std::atomic<int> calls{0};
+    const std::string big(600, 'x');
+    for (int i=0; i<10; ++i) {
+        cache->get(1, {std::to_string(i)}, 0, counting_loader(calls, big));
+        // 0 号一直被访问，不会被淘汰
+        cache->get(1, {"0"}, 0, counting_loader(calls, big));
+    }
+    auto st = cache->get_stats();
+    EXPECT_LE(st.bytes, 4096u);
+    EXPECT_GT(st.evicted, 0u);
+    int before = calls;
+    cache->get(1, {"0"}, 0, counting_loader(calls, big));
+    EXPECT_EQ(calls, before);
+    // 大于预算的结果直接返回，不缓存
+    EXPECT_TRUE(cache->get(1, {"huge"}, 0, counting_loader(calls, std::string(8192, 'y'))));
+    EXPECT_TRUE(cache->get(1, {"huge"}, 0, counting_loader(calls, "y")));
+    EXPECT_EQ(calls, before + 2);
+}
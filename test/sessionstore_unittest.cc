@@ -0,0 +1,119 @@
+/**
+ * @file sessionstore_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief sessionstore 模块的测试程序
+*/
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "../src/user/sessionstore.h"
+
+static SessionStore::Options make_options(int ttl, size_t max_sessions, size_t shards) {
+    SessionStore::Options opts;
+    opts.enable = true;
+    opts.ttl = ttl;
+    opts.max_sessions = max_sessions;
+    opts.shards = shards;
+    return opts;
+}
+
+// 测试创建、查找和删除会话
+TEST(SessionStoreTest, CreateLookupRemove) {
+    SessionStore *store = SessionStore::get_instance();
+    store->init(make_options(60000, 100, 4));
+    std::string id = store->create("alice");
+    ASSERT_EQ(id.size(), 32u);
+    EXPECT_NE(store->create("alice"), id);
+
+    std::string user;
+    EXPECT_TRUE(store->lookup(id, &user));
+    EXPECT_EQ(user, "alice");
+    EXPECT_FALSE(store->lookup("0123456789abcdef0123456789abcdef"));
+    EXPECT_FALSE(store->lookup("not-a-session-id"));
+
+    store->remove(id);
+    EXPECT_FALSE(store->lookup(id));
+    EXPECT_EQ(store->get_stats().sessions, 1u);
+}
+
+// 测试过期：访问会续期，expire() 删除过期的会话
+TEST(SessionStoreTest, Expiry) {
+    SessionStore *store = SessionStore::get_instance();
+    store->init(make_options(100, 100, 2));
+    std::string idle = store->create("idle");
+    std::string active = store->create("active");
+    for (int i=0; i<3; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ASSERT_TRUE(store->lookup(active));
+    }
+    // idle 已经 150ms 没有访问
+    EXPECT_EQ(store->expire(), 1u);
+    EXPECT_FALSE(store->lookup(idle));
+    EXPECT_TRUE(store->lookup(active));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_FALSE(store->lookup(active));
+    EXPECT_EQ(store->get_stats().sessions, 0u);
+}
+
+// 测试达到上限时淘汰最久没有访问的会话
+TEST(SessionStoreTest, LruEviction) {
+    SessionStore *store = SessionStore::get_instance();
+    store->init(make_options(60000, 3, 1));
+    std::string a = store->create("a");
+    std::string b = store->create("b");
+    std::string c = store->create("c");
+    ASSERT_TRUE(store->lookup(a));   // b 成为最久没有访问的会话
+    std::string d = store->create("d");
+    EXPECT_EQ(store->get_stats().sessions, 3u);
+    EXPECT_TRUE(store->lookup(a));
+    EXPECT_FALSE(store->lookup(b));
+    EXPECT_TRUE(store->lookup(c));
+    EXPECT_TRUE(store->lookup(d));
+}
+
+// 测试快照的保存和恢复
+TEST(SessionStoreTest, Snapshot) {
+    char path[] = "/tmp/yawn_sessions_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    SessionStore *store = SessionStore::get_instance();
+    auto opts = make_options(60000, 100, 4);
+    opts.snapshot_path = path;
+    store->init(opts);
+    std::string id = store->create("bob");
+    std::string gone = store->create("carol");
+    store->remove(gone);
+    ASSERT_TRUE(store->save());
+
+    // 重新初始化相当于重启：内存中的会话清空，再从快照中恢复
+    store->init(opts);
+    std::string user;
+    EXPECT_TRUE(store->lookup(id, &user));
+    EXPECT_EQ(user, "bob");
+    EXPECT_FALSE(store->lookup(gone));
+    EXPECT_EQ(store->get_stats().sessions, 1u);
+    unlink(path);
+}
+
+// 测试 Cookie 的解析和生成
+TEST(SessionStoreTest, Cookie) {
+    SessionStore *store = SessionStore::get_instance();
+    store->init(make_options(1800000, 100, 4));
+    const std::string id = "00112233445566778899aabbccddeeff";
+    std::string header = "theme=dark; sid=" + id + "; lang=en";
+    EXPECT_EQ(store->parse_cookie(header.data(), header.size()), id);
+    header = "xsid=" + id;
+    EXPECT_EQ(store->parse_cookie(header.data(), header.size()), "");
+    header = "sid=../../etc/passwd";
+    EXPECT_EQ(store->parse_cookie(header.data(), header.size()), "");
+
+    EXPECT_EQ(store->make_cookie(id), "sid=" + id + "; Path=/; HttpOnly; SameSite=Lax; Max-Age=1800");
+    EXPECT_EQ(store->make_cookie(""), "sid=; Path=/; HttpOnly; SameSite=Lax; Max-Age=0");
+}
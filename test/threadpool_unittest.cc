@@ -0,0 +1,117 @@
+/**
+ * @file threadpool_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief threadpool 模块的测试程序
+*/
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <gtest/gtest.h>
+#include "../src/pool/threadpool.hpp"
+
+// 测试队列长度和排空通知
+TEST(ThreadPoolTest, DrainNotification) {
+    ThreadPool pool(1);
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::atomic<int> done(0);
+    // 第一个任务阻塞唯一的工作线程，其余的任务留在队列中
+    pool.add_task([opened, &done] { opened.wait(); ++done; });
+    for (int i=0; i<9; ++i) {
+        pool.add_task([&done] { ++done; });
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pool.queue_size() != 9 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(pool.queue_size(), 9u);
+
+    // 队列的长度已经不超过低水位时不登记
+    EXPECT_FALSE(pool.notify_when_drained(9, [] {}));
+
+    std::promise<size_t> drained;
+    ASSERT_TRUE(pool.notify_when_drained(3, [&pool, &drained] {
+        drained.set_value(pool.queue_size());
+    }));
+    gate.set_value();
+    auto f = drained.get_future();
+    ASSERT_EQ(f.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    // 通知只调用一次，调用时队列恰好降到低水位
+    EXPECT_EQ(f.get(), 3u);
+    while (done != 10 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(done, 10);
+    EXPECT_EQ(pool.queue_size(), 0u);
+}
+
+// 等待条件成立，最多等待 5 秒
+template <typename Pred>
+static bool wait_until(Pred pred) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// 测试弹性模式：任务排队过久时增加线程，空闲超时后退出
+TEST(ThreadPoolTest, ElasticGrowAndRetire) {
+    ThreadPool pool(ThreadPool::Options(1, 3, 5, 100));
+    EXPECT_EQ(pool.get_thread_count(), 1u);
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::atomic<int> running(0);
+    for (int i=0; i<4; ++i) {
+        pool.add_task([opened, &running] { ++running; opened.wait(); --running; });
+    }
+    // 前三个任务各占一个线程，线程数不超过上限
+    ASSERT_TRUE(wait_until([&] { return running == 3; }));
+    EXPECT_EQ(pool.get_thread_count(), 3u);
+    EXPECT_EQ(pool.queue_size(), 1u);
+    EXPECT_EQ(pool.get_stats().spawned, 2u);
+
+    gate.set_value();
+    ASSERT_TRUE(wait_until([&] { return pool.get_thread_count() == 1; }));
+    auto stats = pool.get_stats();
+    EXPECT_EQ(stats.retired, 2u);
+    EXPECT_EQ(stats.peak, 3u);
+    EXPECT_EQ(pool.queue_size(), 0u);
+}
+
+// 测试工作线程声明阻塞后立即补充线程
+TEST(ThreadPoolTest, BlockingScope) {
+    ThreadPool pool(ThreadPool::Options(1, 2, 60000, 60000));
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::atomic<bool> blocked(false), second(false);
+    pool.add_task([opened, &blocked] {
+        ThreadPool::BlockingScope scope;
+        blocked = true;
+        opened.wait();
+    });
+    ASSERT_TRUE(wait_until([&] { return blocked.load(); }));
+    // 排队时间远小于目标，但唯一的线程正在阻塞
+    pool.add_task([&second] { second = true; });
+    EXPECT_TRUE(wait_until([&] { return second.load(); }));
+    EXPECT_EQ(pool.get_stats().blocked, 1u);
+    gate.set_value();
+    EXPECT_TRUE(wait_until([&] { return pool.get_stats().blocked == 0; }));
+}
+
+// 测试析构时执行完剩余的任务并等待线程退出
+TEST(ThreadPoolTest, JoinOnShutdown) {
+    std::atomic<int> done(0);
+    {
+        ThreadPool pool(ThreadPool::Options(2, 4, 1, 10));
+        for (int i=0; i<100; ++i) {
+            pool.add_task([&done] {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                ++done;
+            });
+        }
+    }
+    EXPECT_EQ(done, 100);
+}
@@ -0,0 +1,289 @@
+/**
+ * @file tls_unittest.cc
+ * @author Fansure Grin
+ * @date 2026-10-18
+ * @brief tls 模块的测试程序
+*/
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <gtest/gtest.h>
+#include "../src/tls/tlsconn.h"
+
+// 生成自签名证书和私钥，写入临时文件
+class TlsTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        EVP_PKEY *key = EVP_EC_gen("P-256");
+        X509 *cert = X509_new();
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME *name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+            reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        X509_sign(cert, key, EVP_sha256());
+
+        char cert_tmpl[] = "/tmp/yawn_cert_XXXXXX";
+        char key_tmpl[] = "/tmp/yawn_key_XXXXXX";
+        close(mkstemp(cert_tmpl));
+        close(mkstemp(key_tmpl));
+        cert_file = cert_tmpl;
+        key_file = key_tmpl;
+        FILE *fp = fopen(cert_file.c_str(), "w");
+        PEM_write_X509(fp, cert);
+        fclose(fp);
+        fp = fopen(key_file.c_str(), "w");
+        PEM_write_PrivateKey(fp, key, nullptr, nullptr, 0, nullptr, nullptr);
+        fclose(fp);
+        X509_free(cert);
+        EVP_PKEY_free(key);
+    }
+
+    static void TearDownTestSuite() {
+        unlink(cert_file.c_str());
+        unlink(key_file.c_str());
+    }
+
+    void SetUp() override {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        client_ctx = SSL_CTX_new(TLS_client_method());
+    }
+
+    void TearDown() override {
+        SSL_CTX_free(client_ctx);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    TlsOptions options() const {
+        TlsOptions opts;
+        opts.cert_file = cert_file;
+        opts.key_file = key_file;
+        opts.ktls = false;
+        return opts;
+    }
+
+    /**
+     * @brief 交替推进客户端和服务器端的握手，直到双方都完成
+    */
+    static bool run_handshake(SSL *client, TlsConn &server) {
+        for (int i=0; i<100; ++i) {
+            int c = SSL_do_handshake(client);
+            auto s = server.handshake();
+            if (s == TlsConn::FAILED) return false;
+            if (c == 1 && s == TlsConn::DONE) return true;
+        }
+        return false;
+    }
+
+    static std::string cert_file;
+    static std::string key_file;
+    int fds[2];   // fds[0] 属于服务器端，fds[1] 属于客户端
+    SSL_CTX *client_ctx;
+};
+
+std::string TlsTest::cert_file;
+std::string TlsTest::key_file;
+
+// 测试握手、ALPN 和双向的数据传输
+TEST_F(TlsTest, HandshakeAndTransfer) {
+    TlsOptions opts = options();
+    opts.h2 = true;
+    TlsContext ctx;
+    ASSERT_TRUE(ctx.init(opts)) << TlsContext::last_error();
+
+    SSL *client = SSL_new(client_ctx);
+    SSL_set_fd(client, fds[1]);
+    SSL_set_connect_state(client);
+    static const unsigned char PROTOS[] = "\x02h2\x08http/1.1";
+    SSL_set_alpn_protos(client, PROTOS, sizeof(PROTOS) - 1);
+
+    TlsConn server(ctx, fds[0]);
+    Buffer buf;
+    int err = 0;
+    // 握手完成之前没有应用数据
+    EXPECT_EQ(server.handshake(), TlsConn::WANT_READ);
+    ASSERT_TRUE(run_handshake(client, server));
+    EXPECT_TRUE(server.is_established());
+    EXPECT_EQ(server.alpn(), "h2");
+    EXPECT_FALSE(server.session_reused());
+
+    EXPECT_EQ(server.read(buf, &err), -1);
+    EXPECT_EQ(err, EAGAIN);
+    const std::string request = "GET / HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(SSL_write(client, request.data(), request.size()),
+        static_cast<int>(request.size()));
+    EXPECT_EQ(server.read(buf, &err), static_cast<ssize_t>(request.size()));
+    EXPECT_EQ(buf.retrieve_all_as_str(), request);
+
+    std::string head = "HTTP/1.1 200 OK\r\n\r\n", body(40000, 'x');
+    struct iovec iov[2] = {
+        {const_cast<char*>(head.data()), head.size()},
+        {const_cast<char*>(body.data()), body.size()}
+    };
+    ssize_t sent = 0;
+    std::string received;
+    char tmp[16384];
+    while (sent < static_cast<ssize_t>(head.size() + body.size())) {
+        ssize_t len = server.writev(iov, 2);
+        if (len > 0) {
+            sent += len;
+            for (auto &v : iov) {
+                size_t n = std::min(static_cast<size_t>(len), v.iov_len);
+                v.iov_base = static_cast<char*>(v.iov_base) + n;
+                v.iov_len -= n;
+                len -= n;
+            }
+        } else {
+            ASSERT_EQ(errno, EAGAIN);
+        }
+        int n;
+        while ((n = SSL_read(client, tmp, sizeof(tmp))) > 0) {
+            received.append(tmp, n);
+        }
+    }
+    int n;
+    while ((n = SSL_read(client, tmp, sizeof(tmp))) > 0) {
+        received.append(tmp, n);
+    }
+    EXPECT_EQ(received, head + body);
+
+    // 对端发送 close_notify 后读取返回 0
+    SSL_shutdown(client);
+    EXPECT_EQ(server.read(buf, &err), 0);
+    SSL_free(client);
+}
+
+// 测试通过会话缓存（会话 ID）和会话票据恢复会话
+TEST_F(TlsTest, SessionResumption) {
+    for (bool tickets : {true, false}) {
+        TlsOptions opts = options();
+        opts.tickets = tickets;
+        TlsContext ctx;
+        ASSERT_TRUE(ctx.init(opts)) << TlsContext::last_error();
+        SSL_CTX_set_max_proto_version(client_ctx, TLS1_2_VERSION);
+
+        SSL_SESSION *session = nullptr;
+        for (int round=0; round<2; ++round) {
+            int pair[2];
+            ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+            fcntl(pair[0], F_SETFL, O_NONBLOCK);
+            fcntl(pair[1], F_SETFL, O_NONBLOCK);
+            SSL *client = SSL_new(client_ctx);
+            SSL_set_fd(client, pair[1]);
+            SSL_set_connect_state(client);
+            if (session) {
+                SSL_set_session(client, session);
+            }
+            {
+                TlsConn server(ctx, pair[0]);
+                ASSERT_TRUE(run_handshake(client, server));
+                EXPECT_EQ(server.session_reused(), round == 1) << "tickets " << tickets;
+                // 服务器端没有发送 close_notify 就释放了连接，会话仍然可以恢复
+            }
+            if (!session) {
+                session = SSL_get1_session(client);
+            }
+            SSL_set_shutdown(client, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+            SSL_free(client);
+            close(pair[0]);
+            close(pair[1]);
+        }
+        SSL_SESSION_free(session);
+    }
+}
+
+// 测试 Expect: 100-continue 的临时响应经过记录层发送：客户端先收到 100 Continue 再发送请求体；
+// 临时响应被阻塞时留在写缓冲区中，与最终的响应一起重试，客户端收到的数据流保持完整
+TEST_F(TlsTest, ExpectContinue) {
+    TlsContext ctx;
+    ASSERT_TRUE(ctx.init(options())) << TlsContext::last_error();
+    SSL *client = SSL_new(client_ctx);
+    SSL_set_fd(client, fds[1]);
+    SSL_set_connect_state(client);
+    TlsConn server(ctx, fds[0]);
+    ASSERT_TRUE(run_handshake(client, server));
+
+    // 与 HttpConn 一样，只发送写缓冲区开头的数据，写出多少就取出多少
+    Buffer write_buf;
+    auto flush = [&server, &write_buf]() {
+        struct iovec v = {const_cast<char*>(write_buf.peek()), write_buf.readable_bytes()};
+        ssize_t len = server.writev(&v, 1);
+        if (len > 0) {
+            write_buf.retrieve(len);
+        }
+        return len;
+    };
+    char tmp[16384];
+    auto drain = [client, &tmp](std::string &received) {
+        int n;
+        while ((n = SSL_read(client, tmp, sizeof(tmp))) > 0) {
+            received.append(tmp, n);
+        }
+        return SSL_get_error(client, n) == SSL_ERROR_WANT_READ;
+    };
+    const std::string interim = "HTTP/1.1 100 Continue\r\n\r\n";
+    const std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+
+    const std::string head = "POST /upload HTTP/1.1\r\nExpect: 100-continue\r\n"
+        "Content-Length: 4\r\n\r\n";
+    ASSERT_EQ(SSL_write(client, head.data(), head.size()), static_cast<int>(head.size()));
+    Buffer read_buf;
+    int err = 0;
+    EXPECT_EQ(server.read(read_buf, &err), static_cast<ssize_t>(head.size()));
+    write_buf.append(interim);
+    EXPECT_EQ(flush(), static_cast<ssize_t>(interim.size()));
+    std::string received;
+    ASSERT_TRUE(drain(received));
+    EXPECT_EQ(received, interim);
+    ASSERT_EQ(SSL_write(client, "body", 4), 4);
+    read_buf.retrieve_all();
+    EXPECT_EQ(server.read(read_buf, &err), 4);
+    write_buf.append(response);
+    EXPECT_EQ(flush(), static_cast<ssize_t>(response.size()));
+    received.clear();
+    ASSERT_TRUE(drain(received));
+    EXPECT_EQ(received, response);
+
+    // 客户端不读取，socket 被上一个响应填满后临时响应发不出去
+    const std::string previous(1 << 20, 'x');
+    write_buf.append(previous);
+    while (flush() > 0) {}
+    ASSERT_EQ(errno, EAGAIN);
+    ASSERT_GT(write_buf.readable_bytes(), 0u);
+    write_buf.append(interim);
+    EXPECT_EQ(flush(), -1);
+    write_buf.append(response);
+    received.clear();
+    for (int i=0; i<1000 && write_buf.readable_bytes() > 0; ++i) {
+        ASSERT_TRUE(drain(received));
+        if (flush() < 0) {
+            ASSERT_EQ(errno, EAGAIN);
+        }
+    }
+    EXPECT_EQ(write_buf.readable_bytes(), 0u);
+    ASSERT_TRUE(drain(received));
+    EXPECT_EQ(received, previous + interim + response);
+    SSL_free(client);
+}
+
+// 测试证书和私钥不存在时初始化失败
+TEST_F(TlsTest, BadCertificate) {
+    TlsOptions opts = options();
+    opts.cert_file = "/nonexistent/cert.pem";
+    TlsContext ctx;
+    EXPECT_FALSE(ctx.init(opts));
+    EXPECT_FALSE(TlsContext::last_error().empty());
+}
@@ -70,4 +70,20 @@ TEST(UtilTest, StrLower) {
     EXPECT_EQ(str_lower("I'm fine"), "i'm fine");
     EXPECT_EQ(str_lower("User-Agent"), "user-agent");
     EXPECT_EQ(str_lower("我 LiKE 橘子"), "我 like 橘子");
-}
\ No newline at end of file
+}
+// 测试 http_gmt(char *, size_t, time_t)
+TEST(UtilTest, HttpGmtBuf) {
+    char buf[40];
+    EXPECT_EQ(http_gmt(buf, sizeof(buf), 1716214212), 29);
+    EXPECT_STREQ(buf, "Mon, 20 May 2024 14:10:12 GMT");
+    EXPECT_EQ(http_gmt(buf, 10, 1716214212), 0);
+}
+
+// 测试 str_case_equal
+TEST(UtilTest, StrCaseEqual) {
+    EXPECT_TRUE(str_case_equal("Keep-Alive", 10, "keep-alive"));
+    EXPECT_TRUE(str_case_equal("CLOSE", 5, "close"));
+    EXPECT_FALSE(str_case_equal("close", 5, "closed"));
+    EXPECT_FALSE(str_case_equal("keep-alive", 4, "keep-alive"));
+    EXPECT_FALSE(str_case_equal("upgrade", 7, "Upgrade!"));
+}